@@ -64,11 +64,10 @@ void ElementDetector::StartDetection(content::WebContents* web_contents,
         }
       };
 
-      document.querySelectorAll(tags.join(", ")).forEach(processElement);
-
-      attributes.forEach(attr => {
-        document.querySelectorAll(`[${attr}]`).forEach(processElement);
-      });
+      // One selector list means one traversal, and each element is reported
+      // once even when it matches several tags or attributes.
+      const selector = tags.concat(attributes.map(attr => `[${attr}]`)).join(", ");
+      document.querySelectorAll(selector).forEach(processElement);
 
       return JSON.stringify(interactiveElements);
     })();
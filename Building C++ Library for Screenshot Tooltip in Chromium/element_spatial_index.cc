@@ -0,0 +1,243 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "chrome/browser/tooltip/element_spatial_index.h"
+
+#include <algorithm>
+
+namespace tooltip {
+
+namespace {
+
+// Bounds on the grid cell edge, in pixels.
+constexpr int kMinCellSize = 16;
+constexpr int kMaxCellSize = 1024;
+
+// Keeps the grid at most this many cells per element.
+constexpr int64_t kMaxCellsPerElement = 4;
+
+// Elements overlapping more cells than this go to the large list.
+constexpr int64_t kLargeElementCells = 16;
+
+}  // namespace
+
+ElementSpatialIndex::ElementSpatialIndex() = default;
+
+ElementSpatialIndex::~ElementSpatialIndex() = default;
+
+void ElementSpatialIndex::Build(const std::vector<gfx::Rect>& rects) {
+  Clear();
+  rects_ = rects;
+  areas_.reserve(rects_.size());
+
+  // Bounding box of everything and the typical element extent.
+  int64_t min_x = 0;
+  int64_t min_y = 0;
+  int64_t max_x = 0;
+  int64_t max_y = 0;
+  int64_t extent_sum = 0;
+  size_t non_empty = 0;
+  for (const gfx::Rect& rect : rects_) {
+    areas_.push_back(static_cast<int64_t>(rect.width()) * rect.height());
+    if (rect.IsEmpty())
+      continue;
+    if (non_empty == 0) {
+      min_x = rect.x();
+      min_y = rect.y();
+      max_x = rect.right();
+      max_y = rect.bottom();
+    } else {
+      min_x = std::min<int64_t>(min_x, rect.x());
+      min_y = std::min<int64_t>(min_y, rect.y());
+      max_x = std::max<int64_t>(max_x, rect.right());
+      max_y = std::max<int64_t>(max_y, rect.bottom());
+    }
+    extent_sum += std::max(rect.width(), rect.height());
+    ++non_empty;
+  }
+  if (non_empty == 0)
+    return;
+
+  // Cells about the size of an average element, grown until the grid stays
+  // proportional to the element count.
+  int64_t cell_size = std::clamp<int64_t>(
+      extent_sum / static_cast<int64_t>(non_empty), kMinCellSize, kMaxCellSize);
+  int64_t columns = 0;
+  int64_t rows = 0;
+  const int64_t max_cells =
+      kMaxCellsPerElement * static_cast<int64_t>(non_empty) + 64;
+  while (true) {
+    columns = (max_x - min_x + cell_size - 1) / cell_size;
+    rows = (max_y - min_y + cell_size - 1) / cell_size;
+    if (columns * rows <= max_cells)
+      break;
+    cell_size *= 2;
+  }
+
+  origin_x_ = static_cast<int>(min_x);
+  origin_y_ = static_cast<int>(min_y);
+  cell_size_ = static_cast<int>(cell_size);
+  columns_ = static_cast<int>(std::max<int64_t>(columns, 1));
+  rows_ = static_cast<int>(std::max<int64_t>(rows, 1));
+
+  // Two passes over the elements: count per cell, then fill, so every cell
+  // list lives in one contiguous array.
+  const size_t cell_count = static_cast<size_t>(columns_) * rows_;
+  cell_starts_.assign(cell_count + 1, 0);
+  std::vector<bool> is_large(rects_.size(), false);
+  for (size_t i = 0; i < rects_.size(); ++i) {
+    if (rects_[i].IsEmpty())
+      continue;
+    CellRange range = CellsFor(rects_[i]);
+    int64_t covered =
+        static_cast<int64_t>(range.last_column - range.first_column + 1) *
+        (range.last_row - range.first_row + 1);
+    if (covered > kLargeElementCells) {
+      is_large[i] = true;
+      large_elements_.push_back(static_cast<uint32_t>(i));
+      continue;
+    }
+    for (int row = range.first_row; row <= range.last_row; ++row) {
+      for (int column = range.first_column; column <= range.last_column;
+           ++column) {
+        ++cell_starts_[static_cast<size_t>(row) * columns_ + column + 1];
+      }
+    }
+  }
+  for (size_t cell = 0; cell < cell_count; ++cell)
+    cell_starts_[cell + 1] += cell_starts_[cell];
+
+  cell_entries_.resize(cell_starts_[cell_count]);
+  std::vector<uint32_t> cursor(cell_starts_.begin(), cell_starts_.end() - 1);
+  for (size_t i = 0; i < rects_.size(); ++i) {
+    if (rects_[i].IsEmpty() || is_large[i])
+      continue;
+    CellRange range = CellsFor(rects_[i]);
+    for (int row = range.first_row; row <= range.last_row; ++row) {
+      for (int column = range.first_column; column <= range.last_column;
+           ++column) {
+        size_t cell = static_cast<size_t>(row) * columns_ + column;
+        cell_entries_[cursor[cell]++] = static_cast<uint32_t>(i);
+      }
+    }
+  }
+}
+
+void ElementSpatialIndex::Clear() {
+  rects_.clear();
+  areas_.clear();
+  cell_starts_.clear();
+  cell_entries_.clear();
+  large_elements_.clear();
+  origin_x_ = 0;
+  origin_y_ = 0;
+  cell_size_ = 1;
+  columns_ = 0;
+  rows_ = 0;
+}
+
+ElementSpatialIndex::CellRange ElementSpatialIndex::CellsFor(
+    const gfx::Rect& rect) const {
+  auto column_of = [this](int64_t x) {
+    return static_cast<int>(std::clamp<int64_t>(
+        (x - origin_x_) / cell_size_, 0, columns_ - 1));
+  };
+  auto row_of = [this](int64_t y) {
+    return static_cast<int>(
+        std::clamp<int64_t>((y - origin_y_) / cell_size_, 0, rows_ - 1));
+  };
+  // right()/bottom() are exclusive.
+  return {column_of(rect.x()), column_of(static_cast<int64_t>(rect.right()) - 1),
+          row_of(rect.y()), row_of(static_cast<int64_t>(rect.bottom()) - 1)};
+}
+
+bool ElementSpatialIndex::CellAt(const gfx::Point& point, size_t* cell) const {
+  if (columns_ == 0 || point.x() < origin_x_ || point.y() < origin_y_)
+    return false;
+  int64_t column = (static_cast<int64_t>(point.x()) - origin_x_) / cell_size_;
+  int64_t row = (static_cast<int64_t>(point.y()) - origin_y_) / cell_size_;
+  if (column >= columns_ || row >= rows_)
+    return false;
+  *cell = static_cast<size_t>(row) * columns_ + static_cast<size_t>(column);
+  return true;
+}
+
+bool ElementSpatialIndex::IsPreferred(size_t a, size_t b) const {
+  if (areas_[a] != areas_[b])
+    return areas_[a] < areas_[b];
+  return a > b;
+}
+
+size_t ElementSpatialIndex::FindAt(const gfx::Point& point) const {
+  size_t best = kNotFound;
+  auto consider = [&](size_t candidate) {
+    if (rects_[candidate].Contains(point) &&
+        (best == kNotFound || IsPreferred(candidate, best))) {
+      best = candidate;
+    }
+  };
+
+  size_t cell;
+  if (CellAt(point, &cell)) {
+    for (uint32_t i = cell_starts_[cell]; i < cell_starts_[cell + 1]; ++i)
+      consider(cell_entries_[i]);
+  }
+  for (uint32_t candidate : large_elements_)
+    consider(candidate);
+  return best;
+}
+
+std::vector<size_t> ElementSpatialIndex::FindAllAt(
+    const gfx::Point& point) const {
+  std::vector<size_t> hits;
+  size_t cell;
+  if (CellAt(point, &cell)) {
+    for (uint32_t i = cell_starts_[cell]; i < cell_starts_[cell + 1]; ++i) {
+      if (rects_[cell_entries_[i]].Contains(point))
+        hits.push_back(cell_entries_[i]);
+    }
+  }
+  for (uint32_t candidate : large_elements_) {
+    if (rects_[candidate].Contains(point))
+      hits.push_back(candidate);
+  }
+  std::sort(hits.begin(), hits.end(),
+            [this](size_t a, size_t b) { return IsPreferred(a, b); });
+  return hits;
+}
+
+std::vector<size_t> ElementSpatialIndex::FindIntersecting(
+    const gfx::Rect& rect) const {
+  std::vector<size_t> hits;
+  if (rect.IsEmpty() || columns_ == 0)
+    return hits;
+
+  // An element spanning several cells is seen once per cell; sorting the
+  // hits and dropping repeats keeps the cost to the cells visited.
+  auto consider = [&](uint32_t candidate) {
+    if (rects_[candidate].Intersects(rect))
+      hits.push_back(candidate);
+  };
+
+  gfx::Rect grid_bounds(origin_x_, origin_y_, columns_ * cell_size_,
+                        rows_ * cell_size_);
+  if (grid_bounds.Intersects(rect)) {
+    CellRange range = CellsFor(rect);
+    for (int row = range.first_row; row <= range.last_row; ++row) {
+      for (int column = range.first_column; column <= range.last_column;
+           ++column) {
+        size_t cell = static_cast<size_t>(row) * columns_ + column;
+        for (uint32_t i = cell_starts_[cell]; i < cell_starts_[cell + 1]; ++i)
+          consider(cell_entries_[i]);
+      }
+    }
+  }
+  for (uint32_t candidate : large_elements_)
+    consider(candidate);
+  std::sort(hits.begin(), hits.end());
+  hits.erase(std::unique(hits.begin(), hits.end()), hits.end());
+  return hits;
+}
+
+}  // namespace tooltip
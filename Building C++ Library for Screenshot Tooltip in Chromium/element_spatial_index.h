@@ -0,0 +1,85 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_TOOLTIP_ELEMENT_SPATIAL_INDEX_H_
+#define CHROME_BROWSER_TOOLTIP_ELEMENT_SPATIAL_INDEX_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "ui/gfx/geometry/point.h"
+#include "ui/gfx/geometry/rect.h"
+
+namespace tooltip {
+
+// Uniform-grid index over element rectangles for hover hit testing.
+// Elements are referred to by their position in the vector passed to
+// Build(). Each element is bucketed into every grid cell it overlaps; the
+// few elements that cover a large part of the page (containers, overlays)
+// are kept in a separate list instead of being copied into many cells.
+class ElementSpatialIndex {
+ public:
+  static constexpr size_t kNotFound = static_cast<size_t>(-1);
+
+  ElementSpatialIndex();
+  ~ElementSpatialIndex();
+
+  ElementSpatialIndex(const ElementSpatialIndex&) = delete;
+  ElementSpatialIndex& operator=(const ElementSpatialIndex&) = delete;
+
+  // Replaces the indexed set. Empty rectangles are never returned.
+  void Build(const std::vector<gfx::Rect>& rects);
+  void Clear();
+
+  bool empty() const { return rects_.empty(); }
+  size_t size() const { return rects_.size(); }
+
+  // The element that should own a hover at |point|: the smallest containing
+  // element, with ties going to the later (topmost) one.
+  size_t FindAt(const gfx::Point& point) const;
+
+  // Every element containing |point|, smallest first.
+  std::vector<size_t> FindAllAt(const gfx::Point& point) const;
+
+  // Every element intersecting |rect|, in build order.
+  std::vector<size_t> FindIntersecting(const gfx::Rect& rect) const;
+
+ private:
+  // Grid cell range covered by a rectangle, clamped to the grid.
+  struct CellRange {
+    int first_column;
+    int last_column;
+    int first_row;
+    int last_row;
+  };
+
+  CellRange CellsFor(const gfx::Rect& rect) const;
+  bool CellAt(const gfx::Point& point, size_t* cell) const;
+
+  // Orders hits so the preferred hover target comes first.
+  bool IsPreferred(size_t a, size_t b) const;
+
+  std::vector<gfx::Rect> rects_;
+  std::vector<int64_t> areas_;
+
+  // Grid geometry
+  int origin_x_ = 0;
+  int origin_y_ = 0;
+  int cell_size_ = 1;
+  int columns_ = 0;
+  int rows_ = 0;
+
+  // Compressed cell lists: cell c holds
+  // cell_entries_[cell_starts_[c] .. cell_starts_[c + 1]).
+  std::vector<uint32_t> cell_starts_;
+  std::vector<uint32_t> cell_entries_;
+
+  // Elements spanning too many cells to bucket, checked on every query.
+  std::vector<uint32_t> large_elements_;
+};
+
+}  // namespace tooltip
+
+#endif  // CHROME_BROWSER_TOOLTIP_ELEMENT_SPATIAL_INDEX_H_
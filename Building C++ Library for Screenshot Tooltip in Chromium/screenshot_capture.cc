@@ -47,6 +47,16 @@ void ScreenshotCapture::Capture(
                      rect));
 }
 
+void ScreenshotCapture::CaptureView(
+    content::WebContents* web_contents,
+    base::OnceCallback<void(gfx::Image)> callback) {
+  DCHECK(web_contents);
+  DCHECK(!callback.is_null());
+  gfx::Rect view_bounds(web_contents->GetContainerBounds().size());
+  ui::GrabViewSnapshotAsync(web_contents->GetNativeView(), view_bounds,
+                            std::move(callback));
+}
+
 void ScreenshotCapture::CaptureOnWorkerThread(
     content::WebContents* web_contents,
     const gfx::Rect& rect) {
@@ -37,6 +37,11 @@ class ScreenshotCapture : public content::WebContentsObserver {
                const std::string& element_identifier,
                base::OnceCallback<void(const std::string&, const gfx::Image&)> callback);
 
+  // Grabs the whole view of `web_contents` for callers that crop it
+  // themselves. The `callback` gets an empty image if the grab fails.
+  void CaptureView(content::WebContents* web_contents,
+                   base::OnceCallback<void(gfx::Image)> callback);
+
  private:
   // Called when the screenshot is ready.
   void OnScreenshotCaptured(const std::string& element_identifier, const SkBitmap& bitmap);
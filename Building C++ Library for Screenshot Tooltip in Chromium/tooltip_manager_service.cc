@@ -7,18 +7,87 @@
 #include "base/base66_encode.h"
 #include "base/functional/bind.h"
 #include "base/logging.h"
+#include "base/system/sys_info.h"
+#include "base/task/sequenced_task_runner.h"
 #include "chrome/browser/tooltip/local_storage_manager.h"
 #include "chrome/browser/tooltip/tooltip_ui_controller.h"
 #include "content/public/browser/web_contents.h"
-#include "ui/gfx/codec/png_codec.h"
+#include "src/navigrab/capture_pipeline.h"
+#include "third_party/skia/include/core/SkBitmap.h"
 
 namespace tooltip {
 
+namespace {
+
+constexpr char kViewFrameKey[] = "view";
+
+navigrab::PixelFormat N32PixelFormat() {
+  return kN32_SkColorType == kBGRA_8888_SkColorType
+             ? navigrab::PixelFormat::BGRA_8888
+             : navigrab::PixelFormat::RGBA_8888;
+}
+
+// PNG holds unpremultiplied color, so N32 grabs known to be opaque or
+// unpremultiplied are encoded as they are. Telling whether a premultiplied
+// grab is opaque takes a pass over its pixels, so those are converted too.
+bool NeedsConversion(const SkBitmap& bitmap) {
+  return bitmap.colorType() != kN32_SkColorType ||
+         bitmap.alphaType() == kPremul_SkAlphaType;
+}
+
+// Wraps |bitmap| without copying; the frame keeps the pixels alive.
+std::shared_ptr<const navigrab::Bitmap> WrapFrame(const SkBitmap& bitmap) {
+  auto* frame = new navigrab::Bitmap(navigrab::Bitmap::Wrap(
+      static_cast<uint8_t*>(bitmap.getPixels()), bitmap.width(),
+      bitmap.height(), bitmap.rowBytes(), N32PixelFormat()));
+  return std::shared_ptr<const navigrab::Bitmap>(
+      frame, [bitmap](const navigrab::Bitmap* view) { delete view; });
+}
+
+// Converts |bitmap| into |frame|. Runs on a pipeline capture worker.
+bool ConvertFrame(const SkBitmap& bitmap, navigrab::Bitmap* frame) {
+  if (!frame->Allocate(bitmap.width(), bitmap.height(), N32PixelFormat())) {
+    return false;
+  }
+  SkImageInfo info = SkImageInfo::Make(bitmap.width(), bitmap.height(),
+                                       kN32_SkColorType, kUnpremul_SkAlphaType);
+  return bitmap.readPixels(info, frame->Row(0), frame->Stride(), 0, 0);
+}
+
+}  // namespace
+
 TooltipManagerService::TooltipManagerService()
     : element_detector_(std::make_unique<ElementDetector>()),
       screenshot_capture_(std::make_unique<ScreenshotCapture>()),
       local_storage_manager_(std::make_unique<LocalStorageManager>()),
-      tooltip_ui_controller_(std::make_unique<TooltipUIController>()) {}
+      tooltip_ui_controller_(std::make_unique<TooltipUIController>()) {
+  // The UI thread only hands frames in: the capture and crop queues drop
+  // their oldest frame rather than wait, and a newer grab replaces a queued
+  // one. Encoding, the costly stage, gets a worker per core.
+  navigrab::CapturePipelineOptions options;
+  for (auto stage :
+       {navigrab::PipelineStage::CAPTURE, navigrab::PipelineStage::CROP}) {
+    navigrab::PipelineStageOptions& stage_options =
+        options.stages[static_cast<size_t>(stage)];
+    stage_options.queue_capacity = 2;
+    stage_options.overflow = navigrab::OverflowPolicy::DROP_OLDEST;
+  }
+  options.stages[static_cast<size_t>(navigrab::PipelineStage::ENCODE)].workers =
+      static_cast<size_t>(base::SysInfo::NumberOfProcessors());
+  // Stored screenshots go back to the UI thread as Base64.
+  scoped_refptr<base::SequencedTaskRunner> task_runner =
+      base::SequencedTaskRunner::GetCurrentDefault();
+  base::WeakPtr<TooltipManagerService> service = weak_ptr_factory_.GetWeakPtr();
+  options.store = [task_runner,
+                   service](const navigrab::CaptureResult& result) {
+    return task_runner->PostTask(
+        FROM_HERE, base::BindOnce(&TooltipManagerService::OnScreenshotEncoded,
+                                  service, result.key,
+                                  base::Base64Encode(result.data)));
+  };
+  capture_pipeline_ =
+      std::make_unique<navigrab::CapturePipeline>(std::move(options));
+}
 
 TooltipManagerService::~TooltipManagerService() = default;
 
@@ -33,6 +102,8 @@ void TooltipManagerService::StartCrawlingAndCapture(
     content::WebContents* web_contents, bool proactive) {
   DCHECK(web_contents);
   element_info_map_.clear();
+  element_index_.Clear();
+  indexed_identifiers_.clear();
 
   element_detector_->StartDetection(
       web_contents,
@@ -42,15 +113,14 @@ void TooltipManagerService::StartCrawlingAndCapture(
 
 void TooltipManagerService::ShowTooltip(
     content::WebContents* web_contents, const gfx::Point& screen_point) {
-  // Find if the screen_point is within any detected element.
-  for (const auto& pair : element_info_map_) {
-    if (pair.second.bounding_box.Contains(screen_point)) {
-      const std::string& identifier = pair.first;
-      std::string base64_image = local_storage_manager_->RetrieveImage(identifier);
-      if (!base64_image.empty()) {
-        tooltip_ui_controller_->DisplayTooltip(base64_image, screen_point);
-        return;
-      }
+  // Elements under the point, innermost first; the first one with a stored
+  // screenshot wins.
+  for (size_t index : element_index_.FindAllAt(screen_point)) {
+    const std::string& identifier = indexed_identifiers_[index];
+    std::string base64_image = local_storage_manager_->RetrieveImage(identifier);
+    if (!base64_image.empty()) {
+      tooltip_ui_controller_->DisplayTooltip(base64_image, screen_point);
+      return;
     }
   }
   HideTooltip();
@@ -65,40 +135,75 @@ void TooltipManagerService::OnElementsDetected(
     const std::vector<std::string>& identifiers) {
   DCHECK_EQ(elements.size(), identifiers.size());
 
-  for (size_t i = 0; i < elements.size(); ++i) {
-    const std::string& identifier = identifiers[i];
-    const gfx::Rect& rect = elements[i];
+  element_index_.Build(elements);
+  indexed_identifiers_ = identifiers;
 
+  for (size_t i = 0; i < elements.size(); ++i) {
     ElementInfo info;
-    info.bounding_box = rect;
+    info.bounding_box = elements[i];
     // TODO(manus): Populate url_or_action from element attributes if available.
-    element_info_map_[identifier] = info;
-
-    // Capture screenshot for each detected element.
-    screenshot_capture_->Capture(
-        element_detector_->web_contents(), rect, identifier,
-        base::BindOnce(&TooltipManagerService::OnScreenshotCaptured,
-                       weak_ptr_factory_.GetWeakPtr()));
+    element_info_map_[identifiers[i]] = info;
   }
+
+  // One view grab covers every element; the pipeline crops and encodes them.
+  screenshot_capture_->CaptureView(
+      element_detector_->web_contents(),
+      base::BindOnce(&TooltipManagerService::OnViewCaptured,
+                     weak_ptr_factory_.GetWeakPtr(), elements, identifiers));
 }
 
-void TooltipManagerService::OnScreenshotCaptured(
-    const std::string& element_identifier, const gfx::Image& image) {
-  if (image.IsEmpty()) {
-    LOG(ERROR) << "Failed to capture screenshot for element: " << element_identifier;
-    return;
+void TooltipManagerService::OnViewCaptured(
+    const std::vector<gfx::Rect>& elements,
+    const std::vector<std::string>& identifiers,
+    gfx::Image image) {
+  // Identifiers are the pipeline keys, so a screenshot still queued from an
+  // earlier detection is dropped once its element is submitted again.
+  scoped_refptr<base::SequencedTaskRunner> task_runner =
+      base::SequencedTaskRunner::GetCurrentDefault();
+  base::WeakPtr<TooltipManagerService> service = weak_ptr_factory_.GetWeakPtr();
+  std::vector<navigrab::CaptureRequest> requests(elements.size());
+  for (size_t i = 0; i < elements.size(); ++i) {
+    requests[i].key = identifiers[i];
+    requests[i].rect = {elements[i].x(), elements[i].y(), elements[i].width(),
+                        elements[i].height()};
+    requests[i].done = [task_runner, service,
+                        identifier = identifiers[i]](bool stored) {
+      if (!stored) {
+        task_runner->PostTask(
+            FROM_HERE,
+            base::BindOnce(&TooltipManagerService::OnScreenshotEncoded,
+                           service, identifier, std::string()));
+      }
+    };
   }
 
-  // Convert gfx::Image to SkBitmap, then to PNG, then to Base64.
-  SkBitmap bitmap = image.AsBitmap();
-  std::vector<unsigned char> png_data;
-  if (!gfx::PNGCodec::Encode(bitmap, gfx::PNGCodec::ProcessPNGOptions(), &png_data)) {
-    LOG(ERROR) << "Failed to encode screenshot to PNG for element: " << element_identifier;
+  SkBitmap bitmap = image.IsEmpty() ? SkBitmap() : image.AsBitmap();
+  if (bitmap.drawsNothing()) {
+    LOG(ERROR) << "Failed to capture the view for " << elements.size()
+               << " elements";
+    capture_pipeline_->SubmitFrame(kViewFrameKey, nullptr, std::move(requests));
+    return;
+  }
+  bitmap.setImmutable();
+  if (!NeedsConversion(bitmap)) {
+    capture_pipeline_->SubmitFrame(kViewFrameKey, WrapFrame(bitmap),
+                                   std::move(requests));
     return;
   }
+  // The conversion copies the frame, so it runs on a capture worker.
+  capture_pipeline_->Submit(
+      kViewFrameKey,
+      [bitmap](navigrab::Bitmap* frame) { return ConvertFrame(bitmap, frame); },
+      std::move(requests));
+}
 
-  std::string base64_image;
-  base::Base64Encode(std::string(png_data.begin(), png_data.end()), &base64_image);
+void TooltipManagerService::OnScreenshotEncoded(
+    const std::string& element_identifier, const std::string& base64_image) {
+  if (base64_image.empty()) {
+    // Outside the view, superseded by a newer grab or failed to encode.
+    VLOG(1) << "No screenshot stored for element: " << element_identifier;
+    return;
+  }
 
   local_storage_manager_->StoreImage(element_identifier, base64_image);
   VLOG(1) << "Screenshot captured and stored for element: " << element_identifier;
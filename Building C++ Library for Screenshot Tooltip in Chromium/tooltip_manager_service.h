@@ -13,6 +13,7 @@
 #include "base/functional/callback.h"
 #include "base/memory/weak_ptr.h"
 #include "chrome/browser/tooltip/element_detector.h"
+#include "chrome/browser/tooltip/element_spatial_index.h"
 #include "chrome/browser/tooltip/screenshot_capture.h"
 #include "content/public/browser/web_contents_observer.h"
 #include "ui/gfx/geometry/point.h"
@@ -23,6 +24,10 @@ namespace content {
 class WebContents;
 }
 
+namespace navigrab {
+class CapturePipeline;
+}
+
 namespace tooltip {
 
 struct ElementInfo {
@@ -58,17 +63,30 @@ class TooltipManagerService {
   // Callbacks for ElementDetector and ScreenshotCapture.
   void OnElementsDetected(const std::vector<gfx::Rect>& elements,
                           const std::vector<std::string>& identifiers);
-  void OnScreenshotCaptured(const std::string& element_identifier,
-                            const gfx::Image& image);
+  // Hands one grab of the view and the elements in it to the pipeline.
+  void OnViewCaptured(const std::vector<gfx::Rect>& elements,
+                      const std::vector<std::string>& identifiers,
+                      gfx::Image image);
+  // Stores a screenshot once the pipeline has encoded it; empty if the
+  // element was given up.
+  void OnScreenshotEncoded(const std::string& element_identifier,
+                           const std::string& base64_image);
 
   std::unique_ptr<ElementDetector> element_detector_;
   std::unique_ptr<ScreenshotCapture> screenshot_capture_;
   std::unique_ptr<LocalStorageManager> local_storage_manager_;
   std::unique_ptr<TooltipUIController> tooltip_ui_controller_;
+  // Crops, encodes and stores element screenshots off the UI thread.
+  std::unique_ptr<navigrab::CapturePipeline> capture_pipeline_;
 
   // Map to store element identifiers to their bounding boxes and associated URLs/actions.
   std::map<std::string, ElementInfo> element_info_map_;
 
+  // Hit-testing index over the detected rectangles, rebuilt on every
+  // detection. Result i refers to indexed_identifiers_[i].
+  ElementSpatialIndex element_index_;
+  std::vector<std::string> indexed_identifiers_;
+
   base::WeakPtrFactory<TooltipManagerService> weak_ptr_factory_{this};
 };
 
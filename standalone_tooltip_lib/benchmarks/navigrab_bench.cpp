@@ -0,0 +1,597 @@
+// NaviGrab benchmark suite.
+//
+// Micro benchmarks time one call in a tight loop (selector matching, cache
+// lookups, ImageStorage); macro benchmarks time whole operations such as
+// ProactiveScraper::ScrapePage. Each benchmark is calibrated and warmed up,
+// then repeated; the summary is printed and, with --json, written in a
+// stable format for comparing releases.
+//
+//   navigrab_bench [--filter=TEXT] [--repetitions=N] [--warmup=N]
+//                  [--min-time-ms=N] [--json=PATH] [--list]
+
+#include "capture_pipeline.h"
+#include "dom.h"
+#include "html_tokenizer.h"
+#include "image_codec.h"
+#include "image_hash.h"
+#include "image_resampler.h"
+#include "jpeg_encoder.h"
+#include "link_extractor.h"
+#include "logging.h"
+#include "navigrab_core.h"
+#include "page_backend.h"
+#include "parallel.h"
+#include "proactive_scraper.h"
+#include "selector_engine.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef NAVIGRAB_BENCH_VERSION
+#define NAVIGRAB_BENCH_VERSION "dev"
+#endif
+
+using namespace navigrab;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Keeps |value| alive so the optimizer cannot drop the work that made it
+template <typename T>
+void DoNotOptimize(const T& value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct Options {
+    std::string filter;
+    int repetitions = 10;
+    int warmup = 2;
+    double min_time_ms = 50;
+    std::string json_path;
+    bool list = false;
+};
+
+// Runs the measured operation |iterations| times
+using BenchmarkBody = std::function<void(uint64_t iterations)>;
+
+struct Benchmark {
+    std::string name;
+    const char* kind;           // "micro" or "macro"
+    BenchmarkBody body;
+};
+
+struct Summary {
+    double min = 0;
+    double max = 0;
+    double mean = 0;
+    double median = 0;
+    double stddev = 0;
+    double cv = 0;              // stddev / mean
+};
+
+struct BenchmarkResult {
+    std::string name;
+    const char* kind;
+    uint64_t iterations = 0;    // Per repetition
+    std::vector<double> ns_per_op;
+    Summary summary;
+};
+
+Summary Summarize(std::vector<double> samples) {
+    Summary summary;
+    if (samples.empty()) return summary;
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    summary.min = samples.front();
+    summary.max = samples.back();
+    summary.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    double sum = 0;
+    for (double sample : samples) sum += sample;
+    summary.mean = sum / static_cast<double>(n);
+    double squares = 0;
+    for (double sample : samples) squares += (sample - summary.mean) * (sample - summary.mean);
+    summary.stddev = n > 1 ? std::sqrt(squares / static_cast<double>(n - 1)) : 0;
+    summary.cv = summary.mean > 0 ? summary.stddev / summary.mean : 0;
+    return summary;
+}
+
+double TimeIterations(const BenchmarkBody& body, uint64_t iterations) {
+    auto start = Clock::now();
+    body(iterations);
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+BenchmarkResult Run(const Benchmark& benchmark, const Options& options) {
+    BenchmarkResult result;
+    result.name = benchmark.name;
+    result.kind = benchmark.kind;
+
+    // Grow the iteration count until one repetition lasts --min-time-ms
+    double target_ns = options.min_time_ms * 1e6;
+    uint64_t iterations = 1;
+    for (;;) {
+        double elapsed = TimeIterations(benchmark.body, iterations);
+        if (elapsed >= target_ns || iterations >= (uint64_t{1} << 30)) break;
+        double scale = elapsed > 0 ? 1.4 * target_ns / elapsed : 100;
+        iterations = static_cast<uint64_t>(static_cast<double>(iterations) * std::min(std::max(scale, 2.0), 100.0));
+    }
+    result.iterations = iterations;
+
+    for (int i = 0; i < options.warmup; ++i) TimeIterations(benchmark.body, iterations);
+    for (int i = 0; i < options.repetitions; ++i) {
+        result.ns_per_op.push_back(TimeIterations(benchmark.body, iterations) / static_cast<double>(iterations));
+    }
+    result.summary = Summarize(result.ns_per_op);
+    return result;
+}
+
+// Sample page with |sections| repeated blocks of navigation, forms, headings,
+// text, lists and tables: about 40 elements per section.
+std::string MakePage(int sections) {
+    std::string html = "<!DOCTYPE html><html><head><title>Benchmark page</title></head><body>";
+    html += "<nav id=\"top\"><a href=\"/\">Home</a><a href=\"/docs\">Docs</a><a href=\"/about\">About</a></nav>";
+    for (int i = 0; i < sections; ++i) {
+        std::string n = std::to_string(i);
+        html += "<section id=\"s" + n + "\" class=\"card" + (i % 3 == 0 ? " featured" : "") + "\">";
+        html += "<h2>Section " + n + "</h2>";
+        html += "<p class=\"lead\">Intro text for section " + n + " with <a href=\"/s/" + n + "\">a link</a>.</p>";
+        html += "<form action=\"/submit/" + n + "\"><label for=\"q" + n + "\">Query</label>";
+        html += "<input id=\"q" + n + "\" type=\"text\" name=\"q\"><input type=\"hidden\" name=\"t\" value=\"1\">";
+        html += "<select name=\"o\"><option>a</option><option>b</option></select>";
+        html += "<textarea name=\"c\"></textarea><button type=\"submit\" class=\"btn primary\">Go</button></form>";
+        html += "<ul>";
+        for (int j = 0; j < 5; ++j) html += "<li><a href=\"/s/" + n + "/" + std::to_string(j) + "\">Item</a></li>";
+        html += "</ul><table><tr><th>Key</th><th>Value</th></tr>";
+        for (int j = 0; j < 3; ++j) html += "<tr><td>k" + std::to_string(j) + "</td><td>v</td></tr>";
+        html += "</table><img src=\"/i/" + n + ".png\" alt=\"Figure\"></section>";
+    }
+    html += "</body></html>";
+    return html;
+}
+
+std::vector<Benchmark> MakeBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+
+    // Shared fixtures, built once
+    auto html = std::make_shared<std::string>(MakePage(200));
+    auto document = std::make_shared<dom::Document>();
+    document->Load(*html);
+
+    SimulationOptions simulation;
+    simulation.latency = LatencyModel::Zero();
+    auto backend = std::make_shared<SimulatedBrowserBackend>(simulation);
+    backend->SetDefaultContent(*html);
+    SetDefaultBrowserBackend(backend);
+
+    // Selector matching
+    const char* complex_selector = "section.card.featured form > button.btn.primary, ul li a[href^=\"/s/1\"]";
+    benchmarks.push_back({"selector/compile", "micro", [complex_selector](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) DoNotOptimize(CompiledSelector::Compile(complex_selector));
+    }});
+    SelectorCache::GetInstance().Get(complex_selector);
+    benchmarks.push_back({"selector/cache_hit", "micro", [complex_selector](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) DoNotOptimize(SelectorCache::GetInstance().Get(complex_selector));
+    }});
+    const std::pair<const char*, const char*> queries[] = {
+        {"selector/query_all/id", "#q150"},
+        {"selector/query_all/tag", "button"},
+        {"selector/query_all/descendant", "section ul li a"},
+        {"selector/query_all/complex", complex_selector},
+    };
+    for (const auto& query : queries) {
+        auto compiled = CompiledSelector::Compile(query.second);
+        benchmarks.push_back({query.first, "micro", [document, compiled](uint64_t n) {
+            SelectorMatcher matcher(*document);
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(matcher.QueryAll(*compiled));
+        }});
+    }
+    {
+        auto interactive = CompiledSelector::Compile("a[href], button, input:not([type=hidden]), select, textarea");
+        auto form = CompiledSelector::Compile("input:not([type=hidden]), select, textarea");
+        auto navigation = CompiledSelector::Compile("nav, nav a[href]");
+        benchmarks.push_back({"selector/query_many/discovery", "micro", [document, interactive, form, navigation](uint64_t n) {
+            SelectorMatcher matcher(*document);
+            std::vector<const CompiledSelector*> programs = {interactive.get(), form.get(), navigation.get()};
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(matcher.QueryMany(programs));
+        }});
+    }
+    // Stage 1 of the tokenizer alone, once per supported instruction set
+    const SimdLevel levels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+    for (SimdLevel level : levels) {
+        if (level > DetectSimdLevel()) break;
+        std::string name = std::string("html/structural_index/") + SimdLevelName(level);
+        benchmarks.push_back({name, "micro", [html, level](uint64_t n) {
+            html::StructuralIndex index;
+            for (uint64_t i = 0; i < n; ++i) {
+                html::BuildStructuralIndex(*html, &index, level);
+                DoNotOptimize(index.positions.size());
+            }
+        }});
+    }
+    benchmarks.push_back({"dom/load", "macro", [html](uint64_t n) {
+        dom::Document parsed;
+        for (uint64_t i = 0; i < n; ++i) {
+            parsed.Load(*html);
+            DoNotOptimize(parsed.Size());
+        }
+    }});
+
+    benchmarks.push_back({"links/extract", "micro", [document](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) DoNotOptimize(ExtractLinks(*document, "https://bench.test/docs/"));
+    }});
+    benchmarks.push_back({"links/extract_html", "micro", [html](uint64_t n) {
+        for (uint64_t i = 0; i < n; ++i) DoNotOptimize(ExtractLinksFromHtml(*html, "https://bench.test/docs/"));
+    }});
+
+    // Whole scrapes per depth. Screenshots are off so the numbers measure
+    // loading, matching and bookkeeping rather than file writes.
+    const std::pair<const char*, ScrapingDepth> depths[] = {
+        {"scrape/quick", ScrapingDepth::QUICK},
+        {"scrape/standard", ScrapingDepth::STANDARD},
+        {"scrape/deep", ScrapingDepth::DEEP},
+    };
+    for (const auto& depth : depths) {
+        auto scraper = std::make_shared<ProactiveScraper>();
+        scraper->SetCacheEnabled(false);
+        scraper->SetScreenshotEnabled(false);
+        ScrapingDepth level = depth.second;
+        benchmarks.push_back({depth.first, "macro", [scraper, level](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(scraper->ScrapePage("https://bench.test/", level));
+        }});
+    }
+    {
+        auto scraper = std::make_shared<ProactiveScraper>();
+        scraper->SetScreenshotEnabled(false);
+        scraper->ScrapePage("https://bench.test/cached", ScrapingDepth::STANDARD);
+        benchmarks.push_back({"scrape/cache_hit", "micro", [scraper](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) {
+                DoNotOptimize(scraper->ScrapePage("https://bench.test/cached", ScrapingDepth::STANDARD));
+            }
+        }});
+    }
+
+    // Captures of the sample page into reused buffers, singly and as a
+    // batch, and thumbnails of the encoded 1280x720 viewport
+    {
+        auto page = std::make_shared<Page>();
+        page->SetContent(*html);
+        auto capture = std::shared_ptr<ScreenshotCapture>(CreateScreenshotCapture());
+        capture->AttachPage(page.get());
+        auto frame = std::make_shared<Bitmap>();
+        benchmarks.push_back({"capture/viewport_bitmap", "micro", [page, capture, frame](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(capture->CaptureToMemory(*frame));
+        }});
+        benchmarks.push_back({"capture/element_bitmap", "micro", [page, capture, frame](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(capture->CaptureElementToMemory("#q150", *frame));
+        }});
+        // Every interactive element of the page in one batch
+        auto selectors = std::make_shared<std::vector<std::string>>(
+            Locator(page.get()).FindBySelector("a[href], button, input:not([type=hidden]), select, textarea"));
+        auto bitmaps = std::make_shared<std::vector<Bitmap>>();
+        benchmarks.push_back({"capture/elements_batch", "macro", [page, capture, selectors, bitmaps](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(capture->CaptureElementsToMemory(*selectors, *bitmaps));
+        }});
+        auto encoded = std::make_shared<std::vector<uint8_t>>();
+        benchmarks.push_back({"capture/viewport_png", "macro", [page, capture, encoded](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(capture->CaptureToMemory(*encoded));
+        }});
+        auto full_page = std::shared_ptr<ScreenshotCapture>(CreateScreenshotCapture());
+        full_page->AttachPage(page.get());
+        full_page->SetFullPage(true);
+        benchmarks.push_back({"capture/full_page_png", "macro", [page, full_page, encoded](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(full_page->CaptureToMemory(*encoded));
+        }});
+        auto image = std::make_shared<std::vector<uint8_t>>(capture->CapturePageData());
+        benchmarks.push_back({"thumbnail/generate", "macro", [page, capture, image](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(capture->GenerateThumbnail(*image, 200, 150));
+        }});
+    }
+
+    // A 1280x720 viewport cut into 64 thumbnails through the capture
+    // pipeline, with one encoder and with one per core
+    {
+        auto page = std::make_shared<Page>();
+        page->SetContent(*html);
+        auto frame = std::make_shared<Bitmap>();
+        auto capture = std::shared_ptr<ScreenshotCapture>(CreateScreenshotCapture());
+        capture->AttachPage(page.get());
+        capture->CaptureToMemory(*frame);
+        const std::pair<const char*, size_t> encoders[] = {
+            {"pipeline/thumbnails_1_encoder", 1},
+            {"pipeline/thumbnails", static_cast<size_t>(HardwareConcurrency())},
+        };
+        for (const auto& encoder : encoders) {
+            CapturePipelineOptions options;
+            options.stages[static_cast<size_t>(PipelineStage::ENCODE)].workers = encoder.second;
+            auto pipeline = std::make_shared<CapturePipeline>(std::move(options));
+            benchmarks.push_back({encoder.first, "macro", [frame, pipeline](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) {
+                    std::vector<CaptureRequest> requests(64);
+                    for (size_t k = 0; k < requests.size(); ++k) {
+                        requests[k].rect = {static_cast<int>(k % 8) * 160, static_cast<int>(k / 8) * 90, 160, 90};
+                        requests[k].max_width = 80;
+                    }
+                    // Borrowed: Drain() returns before the next iteration
+                    std::shared_ptr<const Bitmap> view(frame.get(), [](const Bitmap*) {});
+                    DoNotOptimize(pipeline->SubmitFrame(std::string(), std::move(view), std::move(requests)));
+                    pipeline->Drain();
+                }
+            }});
+        }
+    }
+
+    // Resampling a captured 1280x720 viewport to thumbnail size with each
+    // filter at each SIMD level, plus a whole-factor box halving and the
+    // difference hash the scraper uses to spot unchanged elements
+    {
+        auto page = std::make_shared<Page>();
+        page->SetContent(*html);
+        auto capture = std::shared_ptr<ScreenshotCapture>(CreateScreenshotCapture());
+        capture->AttachPage(page.get());
+        auto frame = std::make_shared<Bitmap>();
+        capture->CaptureToMemory(*frame);
+        const std::pair<const char*, ResampleFilter> filters[] = {
+            {"box", ResampleFilter::BOX},
+            {"bilinear", ResampleFilter::BILINEAR},
+            {"lanczos3", ResampleFilter::LANCZOS3},
+        };
+        const SimdLevel levels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+        for (const auto& filter : filters) {
+            for (SimdLevel level : levels) {
+                if (level > DetectSimdLevel()) break;
+                ResampleOptions options;
+                options.filter = filter.second;
+                options.simd = level;
+                auto thumbnail = std::make_shared<Bitmap>();
+                std::string name = std::string("resample/") + filter.first + "/" + SimdLevelName(level);
+                benchmarks.push_back({name, "micro", [frame, thumbnail, options](uint64_t n) {
+                    for (uint64_t i = 0; i < n; ++i) DoNotOptimize(ResampleBitmap(*frame, 200, 113, thumbnail.get(), options));
+                }});
+            }
+        }
+        auto half = std::make_shared<Bitmap>();
+        benchmarks.push_back({"resample/box_half", "micro", [frame, half](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(ResampleBitmap(*frame, 640, 360, half.get()));
+        }});
+        benchmarks.push_back({"hash/difference", "micro", [frame](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(DifferenceHash(*frame));
+        }});
+    }
+
+    // PNG encoding of a captured 1280x720 viewport across the compression
+    // levels, JPEG across qualities and chroma subsampling, both codecs on
+    // the full page at their defaults, then thumbnail encode and decode per
+    // codec
+    {
+        auto page = std::make_shared<Page>();
+        page->SetContent(*html);
+        auto capture = std::shared_ptr<ScreenshotCapture>(CreateScreenshotCapture());
+        capture->AttachPage(page.get());
+        auto frame = std::make_shared<Bitmap>();
+        capture->CaptureToMemory(*frame);
+        auto encoded = std::make_shared<std::vector<uint8_t>>();
+        for (int level : {0, 1, 6, 9}) {
+            EncodeOptions options;
+            options.compression_level = level;
+            benchmarks.push_back({"encode/png/level" + std::to_string(level), "macro", [frame, encoded, options](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) DoNotOptimize(EncodePng(*frame, encoded.get(), options));
+            }});
+        }
+        const std::pair<const char*, ChromaSubsampling> subsamplings[] = {
+            {"444", ChromaSubsampling::YUV444}, {"420", ChromaSubsampling::YUV420}};
+        for (int quality : {50, 90}) {
+            for (const auto& subsampling : subsamplings) {
+                JpegOptions options;
+                options.quality = quality;
+                options.subsampling = subsampling.second;
+                std::string name = "encode/jpeg/q" + std::to_string(quality) + "_" + subsampling.first;
+                benchmarks.push_back({name, "macro", [frame, encoded, options](uint64_t n) {
+                    for (uint64_t i = 0; i < n; ++i) DoNotOptimize(EncodeJpeg(*frame, encoded.get(), options));
+                }});
+            }
+        }
+        auto full = std::make_shared<Bitmap>();
+        capture->SetFullPage(true);
+        capture->CaptureToMemory(*full);
+        benchmarks.push_back({"encode/png/full_page", "macro", [full, encoded](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(EncodePng(*full, encoded.get()));
+        }});
+        benchmarks.push_back({"encode/jpeg/full_page", "macro", [full, encoded](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(EncodeJpeg(*full, encoded.get()));
+        }});
+
+        // 200x113 thumbnail round trips, PNG against QOI
+        auto thumbnail = std::make_shared<Bitmap>();
+        ResampleBitmap(*frame, 200, 113, thumbnail.get());
+        auto decoded = std::make_shared<Bitmap>();
+        for (ImageFormat format : {ImageFormat::PNG, ImageFormat::QOI}) {
+            auto bytes = std::make_shared<std::vector<uint8_t>>();
+            EncodeImage(*thumbnail, format, bytes.get());
+            std::string name = ImageFormatName(format);
+            benchmarks.push_back({"encode/" + name + "/thumbnail", "micro", [thumbnail, format, encoded](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) DoNotOptimize(EncodeImage(*thumbnail, format, encoded.get()));
+            }});
+            benchmarks.push_back({"decode/" + name + "/thumbnail", "micro", [bytes, decoded](uint64_t n) {
+                for (uint64_t i = 0; i < n; ++i) DoNotOptimize(DecodeImage(*bytes, decoded.get()));
+            }});
+        }
+    }
+
+    // ImageStorage with 256 entries of 16 KB
+    {
+        auto storage = std::shared_ptr<ImageStorage>(CreateImageStorage());
+        storage->Initialize("bench_storage");
+        auto image = std::make_shared<std::vector<uint8_t>>(16 * 1024, uint8_t{0x42});
+        auto keys = std::make_shared<std::vector<std::string>>();
+        for (int i = 0; i < 256; ++i) {
+            keys->push_back("element_" + std::to_string(i));
+            storage->StoreImage(keys->back(), *image);
+        }
+        benchmarks.push_back({"image_storage/put", "micro", [storage, image, keys](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(storage->StoreImage((*keys)[i % keys->size()], *image));
+        }});
+        benchmarks.push_back({"image_storage/get_hit", "micro", [storage, keys](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(storage->GetImage((*keys)[i % keys->size()]));
+        }});
+        benchmarks.push_back({"image_storage/get_miss", "micro", [storage](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(storage->GetImage("missing"));
+        }});
+        benchmarks.push_back({"image_storage/exists_hit", "micro", [storage, keys](uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) DoNotOptimize(storage->ImageExists((*keys)[i % keys->size()]));
+        }});
+    }
+
+    return benchmarks;
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* prefix) -> const char* {
+            size_t length = std::char_traits<char>::length(prefix);
+            return arg.compare(0, length, prefix) == 0 ? arg.c_str() + length : nullptr;
+        };
+        if (const char* v = value("--filter=")) {
+            options->filter = v;
+        } else if (const char* v = value("--repetitions=")) {
+            options->repetitions = std::max(1, std::atoi(v));
+        } else if (const char* v = value("--warmup=")) {
+            options->warmup = std::max(0, std::atoi(v));
+        } else if (const char* v = value("--min-time-ms=")) {
+            options->min_time_ms = std::max(1.0, std::atof(v));
+        } else if (const char* v = value("--json=")) {
+            options->json_path = v;
+        } else if (arg == "--list") {
+            options->list = true;
+        } else {
+            std::fprintf(stderr,
+                         "usage: navigrab_bench [--filter=TEXT] [--repetitions=N] [--warmup=N]\n"
+                         "                      [--min-time-ms=N] [--json=PATH] [--list]\n");
+            return false;
+        }
+    }
+    return true;
+}
+
+void AppendNumber(std::string* out, const char* name, double value, bool last = false) {
+    char buffer[96];
+    std::snprintf(buffer, sizeof(buffer), "\"%s\": %.3f%s", name, value, last ? "" : ", ");
+    *out += buffer;
+}
+
+bool WriteJson(const std::string& path, const Options& options, const std::vector<BenchmarkResult>& results) {
+    char date[32] = "";
+    std::time_t now = std::time(nullptr);
+    std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+
+    std::string out = "{\n  \"context\": {";
+    out += "\"version\": \"" NAVIGRAB_BENCH_VERSION "\", \"date\": \"" + std::string(date) + "\", ";
+#if defined(__clang__)
+    out += "\"compiler\": \"clang " __clang_version__ "\", ";
+#elif defined(__GNUC__)
+    out += "\"compiler\": \"gcc " __VERSION__ "\", ";
+#elif defined(_MSC_VER)
+    out += "\"compiler\": \"msvc " + std::to_string(_MSC_VER) + "\", ";
+#endif
+#ifdef NDEBUG
+    out += "\"build\": \"release\", ";
+#else
+    out += "\"build\": \"debug\", ";
+#endif
+    out += "\"repetitions\": " + std::to_string(options.repetitions) +
+           ", \"warmup\": " + std::to_string(options.warmup) + ", ";
+    AppendNumber(&out, "min_time_ms", options.min_time_ms, true);
+    out += "},\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& result = results[i];
+        out += i ? ",\n    {" : "\n    {";
+        out += "\"name\": \"" + result.name + "\", \"kind\": \"" + result.kind + "\", ";
+        out += "\"iterations\": " + std::to_string(result.iterations) + ", \"unit\": \"ns/op\", ";
+        AppendNumber(&out, "min", result.summary.min);
+        AppendNumber(&out, "median", result.summary.median);
+        AppendNumber(&out, "mean", result.summary.mean);
+        AppendNumber(&out, "max", result.summary.max);
+        AppendNumber(&out, "stddev", result.summary.stddev);
+        AppendNumber(&out, "cv", result.summary.cv);
+        out += "\"samples\": [";
+        for (size_t j = 0; j < result.ns_per_op.size(); ++j) {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%s%.3f", j ? ", " : "", result.ns_per_op[j]);
+            out += buffer;
+        }
+        out += "]}";
+    }
+    out += "\n  ]\n}\n";
+
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(out.data(), 1, out.size(), file) == out.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+// 1234.5 ns -> "1.23 us"
+std::string FormatTime(double ns) {
+    char buffer[32];
+    if (ns < 1e3) {
+        std::snprintf(buffer, sizeof(buffer), "%.1f ns", ns);
+    } else if (ns < 1e6) {
+        std::snprintf(buffer, sizeof(buffer), "%.2f us", ns / 1e3);
+    } else {
+        std::snprintf(buffer, sizeof(buffer), "%.2f ms", ns / 1e6);
+    }
+    return buffer;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, &options)) return 2;
+
+    // Keep per-scrape INFO lines out of the measurements
+    SetLogLevel(LogLevel::LOG_WARNING);
+
+    std::vector<Benchmark> benchmarks = MakeBenchmarks();
+    std::vector<BenchmarkResult> results;
+    if (!options.list) {
+        std::printf("%-34s %-6s %12s %12s %12s %7s %10s\n", "benchmark", "kind", "min", "median", "mean", "cv", "iters");
+    }
+    for (const Benchmark& benchmark : benchmarks) {
+        if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos) continue;
+        if (options.list) {
+            std::printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+        results.push_back(Run(benchmark, options));
+        const BenchmarkResult& result = results.back();
+        std::printf("%-34s %-6s %12s %12s %12s %6.1f%% %10llu\n", result.name.c_str(), result.kind,
+                    FormatTime(result.summary.min).c_str(), FormatTime(result.summary.median).c_str(),
+                    FormatTime(result.summary.mean).c_str(), result.summary.cv * 100,
+                    static_cast<unsigned long long>(result.iterations));
+        std::fflush(stdout);
+    }
+
+    if (!options.json_path.empty() && !options.list) {
+        if (!WriteJson(options.json_path, options, results)) {
+            std::fprintf(stderr, "navigrab_bench: cannot write %s\n", options.json_path.c_str());
+            return 1;
+        }
+        std::printf("Wrote %s\n", options.json_path.c_str());
+    }
+    return 0;
+}
@@ -54,8 +54,8 @@ struct Config {
     size_t max_cache_size_mb;
     bool enable_dark_mode;
     bool enable_animations;
-    std::string image_format;
-    int compression_quality;
+    std::string image_format;       // "png", "jpeg" for archived pages, or "qoi" for tooltip-only thumbnails
+    int compression_quality;        // JPEG quality (1-100)
     
     Config() : max_cache_size_mb(100), enable_dark_mode(false), 
                enable_animations(true), image_format("png"), compression_quality(85) {}
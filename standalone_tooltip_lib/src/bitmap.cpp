@@ -0,0 +1,240 @@
+#include "bitmap.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+namespace navigrab {
+
+namespace {
+
+int HighestBit(size_t value) {
+    int bit = 0;
+    while (value >>= 1) ++bit;
+    return bit;
+}
+
+size_t AlignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+// Byte order of a 0xRRGGBBAA color in |format|
+void ColorBytes(uint32_t rgba, PixelFormat format, uint8_t bytes[kBytesPerPixel]) {
+    uint8_t r = static_cast<uint8_t>(rgba >> 24);
+    uint8_t g = static_cast<uint8_t>(rgba >> 16);
+    uint8_t b = static_cast<uint8_t>(rgba >> 8);
+    uint8_t a = static_cast<uint8_t>(rgba);
+    bytes[0] = format == PixelFormat::BGRA_8888 ? b : r;
+    bytes[1] = g;
+    bytes[2] = format == PixelFormat::BGRA_8888 ? r : b;
+    bytes[3] = a;
+}
+
+} // namespace
+
+// BitmapPool implementation
+BitmapPool& BitmapPool::GetInstance() {
+    // Never destroyed: bitmaps in other statics may release into it at exit
+    static BitmapPool* pool = new BitmapPool();
+    return *pool;
+}
+
+size_t BitmapPool::ClassSize(size_t bytes) {
+    if (bytes <= kMinClassBytes) return kMinClassBytes;
+    size_t base = size_t{1} << HighestBit(bytes - 1);
+    size_t step = base / 4;
+    return base + ((bytes - 1 - base) / step + 1) * step;
+}
+
+uint8_t* BitmapPool::Acquire(size_t bytes, size_t* capacity) {
+    size_t size = ClassSize(bytes);
+    *capacity = size;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = idle_.find(size);
+        if (it != idle_.end() && !it->second.empty()) {
+            uint8_t* buffer = it->second.back();
+            it->second.pop_back();
+            stats_.hits++;
+            stats_.bytes_idle -= size;
+            stats_.bytes_in_use += size;
+            return buffer;
+        }
+        stats_.misses++;
+        stats_.bytes_in_use += size;
+    }
+    return static_cast<uint8_t*>(::operator new[](size, std::align_val_t(kAlignment)));
+}
+
+void BitmapPool::Release(uint8_t* buffer, size_t capacity) {
+    if (!buffer) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.bytes_in_use -= capacity;
+        if (stats_.bytes_idle + capacity <= retained_bytes_) {
+            idle_[capacity].push_back(buffer);
+            stats_.bytes_idle += capacity;
+            return;
+        }
+    }
+    ::operator delete[](buffer, std::align_val_t(kAlignment));
+}
+
+void BitmapPool::SetRetainedBytes(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    retained_bytes_ = bytes;
+    TrimLocked(bytes);
+}
+
+void BitmapPool::Trim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TrimLocked(0);
+}
+
+void BitmapPool::TrimLocked(size_t limit) {
+    // Largest classes first: they free the most memory per buffer
+    std::vector<size_t> sizes;
+    for (const auto& entry : idle_) sizes.push_back(entry.first);
+    std::sort(sizes.rbegin(), sizes.rend());
+    for (size_t size : sizes) {
+        auto& buffers = idle_[size];
+        while (stats_.bytes_idle > limit && !buffers.empty()) {
+            ::operator delete[](buffers.back(), std::align_val_t(kAlignment));
+            buffers.pop_back();
+            stats_.bytes_idle -= size;
+        }
+    }
+}
+
+BitmapPoolStats BitmapPool::GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+// Bitmap implementation
+Bitmap::Bitmap(int width, int height, PixelFormat format) {
+    Allocate(width, height, format);
+}
+
+Bitmap::~Bitmap() {
+    ReleasePixels();
+}
+
+Bitmap::Bitmap(Bitmap&& other) noexcept {
+    *this = std::move(other);
+}
+
+Bitmap& Bitmap::operator=(Bitmap&& other) noexcept {
+    if (this == &other) return *this;
+    ReleasePixels();
+    pixels_ = other.pixels_;
+    capacity_ = other.capacity_;
+    stride_ = other.stride_;
+    width_ = other.width_;
+    height_ = other.height_;
+    format_ = other.format_;
+    owned_ = other.owned_;
+    other.pixels_ = nullptr;
+    other.capacity_ = 0;
+    other.stride_ = 0;
+    other.width_ = 0;
+    other.height_ = 0;
+    other.owned_ = false;
+    return *this;
+}
+
+Bitmap Bitmap::Wrap(uint8_t* pixels, int width, int height, size_t stride, PixelFormat format) {
+    Bitmap bitmap;
+    if (!pixels || width <= 0 || height <= 0 || stride < static_cast<size_t>(width) * kBytesPerPixel) {
+        return bitmap;
+    }
+    bitmap.pixels_ = pixels;
+    bitmap.capacity_ = stride * static_cast<size_t>(height);
+    bitmap.stride_ = stride;
+    bitmap.width_ = width;
+    bitmap.height_ = height;
+    bitmap.format_ = format;
+    return bitmap;
+}
+
+bool Bitmap::Allocate(int width, int height, PixelFormat format) {
+    if (width <= 0 || height <= 0 || width > kMaxDimension || height > kMaxDimension) return false;
+    if (IsWrapped() && width == width_ && height == height_) {
+        format_ = format;
+        return true;    // Keep the caller's stride
+    }
+    size_t stride = AlignUp(static_cast<size_t>(width) * kBytesPerPixel, kRowAlignment);
+    size_t bytes = stride * static_cast<size_t>(height);
+    if (bytes > capacity_) {
+        if (IsWrapped()) return false;
+        ReleasePixels();
+        pixels_ = BitmapPool::GetInstance().Acquire(bytes, &capacity_);
+        owned_ = true;
+    }
+    stride_ = stride;
+    width_ = width;
+    height_ = height;
+    format_ = format;
+    return true;
+}
+
+void Bitmap::Reset() {
+    ReleasePixels();
+    stride_ = 0;
+    width_ = 0;
+    height_ = 0;
+}
+
+void Bitmap::ReleasePixels() {
+    if (owned_) BitmapPool::GetInstance().Release(pixels_, capacity_);
+    pixels_ = nullptr;
+    capacity_ = 0;
+    owned_ = false;
+}
+
+void Bitmap::Fill(uint32_t rgba) {
+    FillRect(0, 0, width_, height_, rgba);
+}
+
+void Bitmap::FillRect(int x, int y, int width, int height, uint32_t rgba) {
+    int left = std::max(x, 0);
+    int top = std::max(y, 0);
+    int right = std::min(x + width, width_);
+    int bottom = std::min(y + height, height_);
+    if (left >= right || top >= bottom) return;
+
+    uint8_t color[kBytesPerPixel];
+    ColorBytes(rgba, format_, color);
+    // Build one row of the span, then copy it down
+    uint8_t* first = Row(top) + static_cast<size_t>(left) * kBytesPerPixel;
+    size_t span = static_cast<size_t>(right - left) * kBytesPerPixel;
+    for (size_t i = 0; i < span; i += kBytesPerPixel) std::memcpy(first + i, color, kBytesPerPixel);
+    for (int row = top + 1; row < bottom; ++row) {
+        std::memcpy(Row(row) + static_cast<size_t>(left) * kBytesPerPixel, first, span);
+    }
+}
+
+bool Bitmap::CopyFrom(const Bitmap& source, int x, int y, int width, int height, PixelFormat format) {
+    if (&source == this || x < 0 || y < 0 || width <= 0 || height <= 0 ||
+        x + width > source.Width() || y + height > source.Height()) {
+        return false;
+    }
+    if (!Allocate(width, height, format)) return false;
+    size_t span = static_cast<size_t>(width) * kBytesPerPixel;
+    for (int row = 0; row < height; ++row) {
+        const uint8_t* from = source.Row(y + row) + static_cast<size_t>(x) * kBytesPerPixel;
+        uint8_t* to = Row(row);
+        if (source.Format() == format) {
+            std::memcpy(to, from, span);
+            continue;
+        }
+        for (size_t i = 0; i < span; i += kBytesPerPixel) {
+            to[i] = from[i + 2];
+            to[i + 1] = from[i + 1];
+            to[i + 2] = from[i];
+            to[i + 3] = from[i + 3];
+        }
+    }
+    return true;
+}
+
+} // namespace navigrab
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace navigrab {
+
+// Byte order of a pixel in memory. Both are 4 bytes per pixel, straight alpha.
+enum class PixelFormat : uint8_t {
+    RGBA_8888,
+    BGRA_8888
+};
+
+constexpr size_t kBytesPerPixel = 4;
+
+struct BitmapPoolStats {
+    uint64_t hits = 0;          // Acquisitions served from an idle buffer
+    uint64_t misses = 0;        // Acquisitions that allocated
+    size_t bytes_idle = 0;      // Held for reuse
+    size_t bytes_in_use = 0;    // Handed out and not yet released
+};
+
+// Recycles pixel buffers by size class, so a burst of captures of similar
+// size allocates once. Classes are a quarter of a power of two apart from
+// 64 KB up, which bounds the waste per buffer to 25%. Idle buffers beyond
+// the retention limit are freed on release.
+class BitmapPool {
+public:
+    static constexpr size_t kAlignment = 64;
+    static constexpr size_t kMinClassBytes = 64 * 1024;
+    static constexpr size_t kDefaultRetainedBytes = 64 * 1024 * 1024;
+
+    static BitmapPool& GetInstance();
+
+    // A buffer of at least |bytes|, kAlignment-aligned. |capacity| receives
+    // its real size, which must be passed back to Release().
+    uint8_t* Acquire(size_t bytes, size_t* capacity);
+    void Release(uint8_t* buffer, size_t capacity);
+
+    // Lowering the limit frees idle buffers at once
+    void SetRetainedBytes(size_t bytes);
+    void Trim();    // Frees every idle buffer
+    BitmapPoolStats GetStats() const;
+
+    static size_t ClassSize(size_t bytes);
+
+private:
+    BitmapPool() = default;
+
+    void TrimLocked(size_t limit);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<size_t, std::vector<uint8_t*>> idle_;    // By class size
+    size_t retained_bytes_ = kDefaultRetainedBytes;
+    BitmapPoolStats stats_;
+};
+
+// A raster image. Rows are Stride() bytes apart and start 32-byte aligned.
+// Pixels come from the BitmapPool and return to it when the bitmap is reset
+// or destroyed; reallocating to a size that fits keeps the buffer, so a
+// bitmap reused across frames allocates once. Move-only.
+class Bitmap {
+public:
+    static constexpr size_t kRowAlignment = 32;
+    static constexpr int kMaxDimension = 1 << 15;
+
+    Bitmap() = default;
+    Bitmap(int width, int height, PixelFormat format = PixelFormat::RGBA_8888);
+    ~Bitmap();
+
+    Bitmap(Bitmap&& other) noexcept;
+    Bitmap& operator=(Bitmap&& other) noexcept;
+    Bitmap(const Bitmap&) = delete;
+    Bitmap& operator=(const Bitmap&) = delete;
+
+    // Views caller-owned pixels. The bitmap never frees them, and Allocate()
+    // only succeeds while the new image fits in |stride| * |height| bytes.
+    static Bitmap Wrap(uint8_t* pixels, int width, int height, size_t stride,
+                       PixelFormat format = PixelFormat::RGBA_8888);
+
+    // Reshapes the bitmap, keeping the buffer when it is large enough. Pixel
+    // contents are unspecified afterwards. False for sizes outside
+    // [1, kMaxDimension] or a wrapped buffer that is too small.
+    bool Allocate(int width, int height, PixelFormat format = PixelFormat::RGBA_8888);
+    void Reset();
+
+    int Width() const { return width_; }
+    int Height() const { return height_; }
+    size_t Stride() const { return stride_; }
+    PixelFormat Format() const { return format_; }
+    bool IsEmpty() const { return width_ == 0 || height_ == 0; }
+    bool IsWrapped() const { return pixels_ && !owned_; }
+    size_t Capacity() const { return capacity_; }
+
+    uint8_t* Row(int y) { return pixels_ + static_cast<size_t>(y) * stride_; }
+    const uint8_t* Row(int y) const { return pixels_ + static_cast<size_t>(y) * stride_; }
+
+    // Colors are 0xRRGGBBAA regardless of the pixel format
+    void Fill(uint32_t rgba);
+    void FillRect(int x, int y, int width, int height, uint32_t rgba);    // Clipped to the bitmap
+
+    // Copies the given part of |source| into this bitmap, converting the
+    // pixel format if needed. False when the rectangle is not inside |source|.
+    bool CopyFrom(const Bitmap& source, int x, int y, int width, int height,
+                  PixelFormat format = PixelFormat::RGBA_8888);
+
+private:
+    void ReleasePixels();
+
+    uint8_t* pixels_ = nullptr;
+    size_t capacity_ = 0;
+    size_t stride_ = 0;
+    int width_ = 0;
+    int height_ = 0;
+    PixelFormat format_ = PixelFormat::RGBA_8888;
+    bool owned_ = false;
+};
+
+} // namespace navigrab
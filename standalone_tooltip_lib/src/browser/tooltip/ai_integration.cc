@@ -4,6 +4,8 @@
 
 #include "ai_integration.h"
 
+#include "src/navigrab/trace.h"
+
 #ifdef STANDALONE_TOOLTIP_BUILD
 #include "base/base_stubs.h"
 #else
@@ -81,6 +83,29 @@ void AIIntegration::AnalyzeElement(
       });
 }
 
+void AIIntegration::GetDescription(
+    const ElementInfo& element_info,
+    const gfx::Image& screenshot,
+    base::OnceCallback<void(const AIResponse&)> callback) {
+  NAVIGRAB_TRACE_SPAN("tooltip", "AIIntegration::GetDescription",
+                      element_info.trace_id);
+  NAVIGRAB_TRACE_ASYNC_BEGIN("tooltip", "ai", element_info.trace_id);
+
+  // Tag the response so the view and the service can close the hover trace.
+  AnalyzeElement(
+      element_info, screenshot,
+      base::BindOnce(
+          [](uint64_t trace_id,
+             base::OnceCallback<void(const AIResponse&)> callback,
+             const AIResponse& response) {
+            NAVIGRAB_TRACE_ASYNC_END("tooltip", "ai", trace_id);
+            AIResponse traced_response = response;
+            traced_response.trace_id = trace_id;
+            std::move(callback).Run(traced_response);
+          },
+          element_info.trace_id, std::move(callback)));
+}
+
 void AIIntegration::SetConfiguration(const AIConfig& config) {
   ai_config_ = config;
   LOG(INFO) << "🔧 TOOLTIP: AI Configuration updated";
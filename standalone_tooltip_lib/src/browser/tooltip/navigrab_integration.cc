@@ -5,17 +5,83 @@
 #include "navigrab_integration.h"
 
 #include <algorithm>
-#include <sstream>
+#include <iterator>
 
 #include "base/functional/bind.h"
 #include "base/logging.h"
 #include "base/strings/string_util.h"
 #include "base/time/time.h"
 #include "content/public/browser/web_contents.h"
+#include "src/navigrab/metrics.h"
 #include "ui/gfx/codec/png_codec.h"
 
 namespace tooltip {
 
+namespace {
+
+// Appends [name="value"], escaping quotes and backslashes in |value|.
+void AppendAttributeSelector(const char* name,
+                             const std::string& value,
+                             std::string* selector) {
+  if (value.empty())
+    return;
+  selector->push_back('[');
+  selector->append(name);
+  selector->append("=\"");
+  for (char c : value) {
+    if (c == '"' || c == '\\')
+      selector->push_back('\\');
+    selector->push_back(c);
+  }
+  selector->append("\"]");
+}
+
+// Latency histogram for one action type, "automation.<action>".
+navigrab::LatencyHistogram& ActionHistogram(AutomationActionType type) {
+  static navigrab::LatencyHistogram* const histograms[] = {
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.click_element"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.type_text"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.hover_element"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.capture_screenshot"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.fill_form"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.navigate_to_link"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.execute_script"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.wait_for_element"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.get_element_text"),
+      &navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.get_element_attribute"),
+  };
+  static navigrab::LatencyHistogram& unknown =
+      navigrab::MetricsRegistry::GetInstance().GetHistogram(
+          "automation.unknown");
+  size_t index = static_cast<size_t>(type);
+  return index < std::size(histograms) ? *histograms[index] : unknown;
+}
+
+// Stamps |result| with the time since |start_time| and records it.
+void OnActionTimed(AutomationActionType type,
+                   base::TimeTicks start_time,
+                   base::OnceCallback<void(const AutomationResult&)> callback,
+                   const AutomationResult& result) {
+  base::TimeDelta elapsed = base::TimeTicks::Now() - start_time;
+  ActionHistogram(type).RecordMicroseconds(
+      static_cast<uint64_t>(std::max<int64_t>(elapsed.InMicroseconds(), 0)));
+  AutomationResult timed_result = result;
+  timed_result.execution_time_ms = elapsed.InMilliseconds();
+  std::move(callback).Run(timed_result);
+}
+
+}  // namespace
+
 // AutomationAction implementation
 AutomationAction::AutomationAction() 
     : type(AutomationActionType::CLICK_ELEMENT),
@@ -151,6 +217,7 @@ void NaviGrabIntegration::InitializeNaviGrab() {
   browser_ = navigrab::CreateBrowser();
   page_ = navigrab::CreatePage();
   screenshot_capture_ = navigrab::CreateScreenshotCapture();
+  web_automation_->AttachPage(page_.get());
   
   LOG(INFO) << "NaviGrab components created successfully with factory functions";
 }
@@ -192,7 +259,10 @@ void NaviGrabIntegration::ExecuteAction(
     return;
   }
 
-  // base::TimeTicks start_time = base::TimeTicks::Now(); // TODO: Add timing
+  // Every branch below reports through the timed callback, which fills in
+  // execution_time_ms and the per-action latency histogram.
+  callback = base::BindOnce(&OnActionTimed, action.type,
+                            base::TimeTicks::Now(), std::move(callback));
   
   switch (action.type) {
     case AutomationActionType::CLICK_ELEMENT:
@@ -442,9 +512,9 @@ void NaviGrabIntegration::GetElementText(
   
   std::string selector = CreateSelector(element_info);
   
-  // Use Locator's GetText method instead
-  std::unique_ptr<navigrab::Locator> locator = std::make_unique<navigrab::Locator>();
-  std::string text = locator->GetText(selector);
+  // Use Locator's GetText method against the page DOM
+  navigrab::Locator locator(page_.get());
+  std::string text = locator.GetText(selector);
   AutomationResult result = ProcessResult(true, text, "");
   std::move(callback).Run(result);
 }
@@ -456,46 +526,53 @@ void NaviGrabIntegration::GetElementAttribute(
   
   std::string selector = CreateSelector(element_info);
   
-  // Use Locator's GetAttribute method instead
-  std::unique_ptr<navigrab::Locator> locator = std::make_unique<navigrab::Locator>();
-  std::string attribute_value = locator->GetAttribute(selector, attribute_name);
+  // Use Locator's GetAttribute method against the page DOM
+  navigrab::Locator locator(page_.get());
+  std::string attribute_value = locator.GetAttribute(selector, attribute_name);
   AutomationResult result = ProcessResult(true, attribute_value, "");
   std::move(callback).Run(result);
 }
 
 std::string NaviGrabIntegration::CreateSelector(const ElementInfo& element_info) const {
-  std::stringstream selector;
-  
+  // Built by appending into one reserved buffer; the selector engine caches
+  // compiled programs by this text, so equal elements must produce equal
+  // strings.
+  std::string selector;
+  selector.reserve(element_info.tag_name.size() + element_info.id.size() +
+                   element_info.class_name.size() + element_info.href.size() +
+                   element_info.src.size() + element_info.title.size() + 32);
+
   // Start with tag name
-  selector << element_info.tag_name;
-  
+  selector.append(element_info.tag_name);
+
   // Add ID if available
   if (!element_info.id.empty()) {
-    selector << "#" << element_info.id;
-    return selector.str(); // ID is unique, return early
+    selector.push_back('#');
+    selector.append(element_info.id);
+    return selector;  // ID is unique, return early
   }
-  
-  // Add class if available
-  if (!element_info.class_name.empty()) {
-    std::string class_name = element_info.class_name;
-    base::ReplaceChars(class_name, " ", ".", &class_name);
-    selector << "." << class_name;
+
+  // Add one .class per whitespace-separated class name
+  const std::string& class_name = element_info.class_name;
+  size_t pos = 0;
+  while (pos < class_name.size()) {
+    size_t start = class_name.find_first_not_of(" \t\n\r\f", pos);
+    if (start == std::string::npos)
+      break;
+    size_t end = class_name.find_first_of(" \t\n\r\f", start);
+    if (end == std::string::npos)
+      end = class_name.size();
+    selector.push_back('.');
+    selector.append(class_name, start, end - start);
+    pos = end;
   }
-  
+
   // Add attribute selectors for more specificity
-  if (!element_info.href.empty()) {
-    selector << "[href=\"" << element_info.href << "\"]";
-  }
-  
-  if (!element_info.src.empty()) {
-    selector << "[src=\"" << element_info.src << "\"]";
-  }
-  
-  if (!element_info.title.empty()) {
-    selector << "[title=\"" << element_info.title << "\"]";
-  }
-  
-  return selector.str();
+  AppendAttributeSelector("href", element_info.href, &selector);
+  AppendAttributeSelector("src", element_info.src, &selector);
+  AppendAttributeSelector("title", element_info.title, &selector);
+
+  return selector;
 }
 
 AutomationResult NaviGrabIntegration::ProcessResult(
@@ -507,7 +584,7 @@ AutomationResult NaviGrabIntegration::ProcessResult(
   result.success = success;
   result.result_data = result_data;
   result.error_message = error_message;
-  result.execution_time_ms = 0; // TODO: Add timing
+  result.execution_time_ms = 0;  // Filled in by ExecuteAction()
   
   return result;
 }
@@ -590,13 +667,12 @@ void NaviGrabIntegration::PerformFreshCrawl(base::OnceCallback<void(bool)> callb
   
   // Re-discover elements on the page
   if (web_automation_) {
-    auto interactive_elements = web_automation_->DiscoverInteractiveElements();
-    auto form_elements = web_automation_->DiscoverFormElements();
-    auto nav_elements = web_automation_->DiscoverNavigationElements();
+    // One shared pass instead of a traversal per category
+    navigrab::DiscoveredElements elements = web_automation_->DiscoverElements();
     
-    LOG(INFO) << "Fresh crawl discovered " << interactive_elements.size() 
-              << " interactive elements, " << form_elements.size() 
-              << " form elements, " << nav_elements.size() 
+    LOG(INFO) << "Fresh crawl discovered " << elements.interactive.size() 
+              << " interactive elements, " << elements.form.size() 
+              << " form elements, " << elements.navigation.size() 
               << " navigation elements";
   }
   
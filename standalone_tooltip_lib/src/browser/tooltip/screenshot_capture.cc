@@ -4,15 +4,17 @@
 
 #include "screenshot_capture.h"
 
+#include <algorithm>
+
 #include "base/functional/bind.h"
 #include "base/logging.h"
 #include "base/task/task_runner.h"
 #include "base/task/thread_pool.h"
 #include "content/public/browser/render_frame_host.h"
 #include "content/public/browser/web_contents.h"
-#include "ui/gfx/codec/png_codec.h"
+#include "src/navigrab/image_resampler.h"
+#include "src/navigrab/trace.h"
 #include "ui/gfx/image/image.h"
-#include "ui/gfx/image/image_skia.h"
 #include "ui/snapshot/snapshot.h"
 
 namespace tooltip {
@@ -45,12 +47,27 @@ void ScreenshotCapture::CaptureElement(
 
   DCHECK_CURRENTLY_ON(content::BrowserThread::UI);
 
-  // For now, capture the entire viewport and crop to element
-  // In a full implementation, we'd use more sophisticated methods
-  CaptureViewport(web_contents, 
-                  base::BindOnce(&ScreenshotCapture::OnViewportCaptured,
-                                weak_factory_.GetWeakPtr(),
-                                element_info, std::move(callback)));
+  NAVIGRAB_TRACE_SPAN("tooltip", "ScreenshotCapture::CaptureElement",
+                      element_info.trace_id);
+  if (element_info.trace_id) {
+    // Spans the viewport grab, the background processing and the reply.
+    NAVIGRAB_TRACE_ASYNC_BEGIN("tooltip", "capture", element_info.trace_id);
+    callback = base::BindOnce(
+        [](uint64_t trace_id,
+           base::OnceCallback<void(const gfx::Image&)> callback,
+           const gfx::Image& image) {
+          NAVIGRAB_TRACE_ASYNC_END("tooltip", "capture", trace_id);
+          std::move(callback).Run(image);
+        },
+        element_info.trace_id, std::move(callback));
+  }
+
+  // Capture the entire viewport once and take the element as a view of it
+  CaptureViewportFrame(
+      web_contents,
+      base::BindOnce(&ScreenshotCapture::OnViewportCaptured,
+                     weak_factory_.GetWeakPtr(), element_info,
+                     std::move(callback)));
 }
 
 void ScreenshotCapture::CapturePage(
@@ -93,6 +110,20 @@ void ScreenshotCapture::CaptureViewport(
                      weak_factory_.GetWeakPtr(), std::move(callback)));
 }
 
+void ScreenshotCapture::CaptureViewportFrame(
+    content::WebContents* web_contents,
+    base::OnceCallback<void(scoped_refptr<ViewportFrame>)> callback) {
+  CaptureViewport(
+      web_contents,
+      base::BindOnce(
+          [](base::OnceCallback<void(scoped_refptr<ViewportFrame>)> callback,
+             const gfx::Image& image) {
+            // Shares the snapshot's pixels rather than copying them
+            std::move(callback).Run(ViewportFrame::FromImage(image));
+          },
+          std::move(callback)));
+}
+
 void ScreenshotCapture::OnScreenshotCaptured(
     base::OnceCallback<void(const gfx::Image&)> callback,
     const gfx::Image& image) {
@@ -112,85 +143,65 @@ void ScreenshotCapture::OnScreenshotCaptured(
 void ScreenshotCapture::OnViewportCaptured(
     const ElementInfo& element_info,
     base::OnceCallback<void(const gfx::Image&)> callback,
-    const gfx::Image& viewport_image) {
+    scoped_refptr<ViewportFrame> frame) {
   
-  if (viewport_image.IsEmpty()) {
+  if (!frame) {
     std::move(callback).Run(gfx::Image());
     return;
   }
 
-  // Process the image on a background thread
+  // Process the image on a background thread; the task holds a reference
+  // to the frame instead of a copy of it
   base::ThreadPool::PostTaskAndReplyWithResult(
       FROM_HERE,
-      base::BindOnce(&ScreenshotCapture::ProcessImage,
-                     viewport_image, element_info),
+      base::BindOnce(&ScreenshotCapture::ProcessImage, frame->View(),
+                     element_info),
       std::move(callback));
 }
 
-gfx::Image ScreenshotCapture::ProcessImage(const gfx::Image& image,
+// static
+gfx::Image ScreenshotCapture::ProcessImage(const ViewportFrameView& frame,
                                           const ElementInfo& element_info) {
+  NAVIGRAB_TRACE_SPAN("tooltip", "ScreenshotCapture::ProcessImage",
+                      element_info.trace_id);
+
   // Crop to element bounds if specified
-  gfx::Image processed_image = image;
+  ViewportFrameView view = frame;
   
   if (!element_info.bounds.IsEmpty()) {
-    processed_image = CropToElement(image, element_info.bounds);
+    view = CropToElement(frame, element_info.bounds);
   }
   
   // Resize if needed (max 1024px)
-  processed_image = ResizeImage(processed_image, 1024);
-  
-  return processed_image;
+  return ResizeImage(view, 1024);
 }
 
-gfx::Image ScreenshotCapture::CropToElement(const gfx::Image& image,
-                                           const gfx::Rect& element_bounds) {
-  if (image.IsEmpty() || element_bounds.IsEmpty()) {
-    return image;
-  }
-
-  // Get the image representation
-  const gfx::ImageSkia* image_skia = image.ToImageSkia();
-  if (!image_skia || image_skia->isNull()) {
-    return image;
-  }
-
-  // Create a cropped version
-  gfx::ImageSkia cropped_skia = gfx::ImageSkia::CreateFrom1xBitmap(
-      image_skia->GetRepresentation(1.0f).GetBitmap());
-  
-  // Crop to the element bounds
-  gfx::Rect crop_bounds = element_bounds;
-  crop_bounds.Intersect(gfx::Rect(image_skia->size()));
-  
-  if (crop_bounds.IsEmpty()) {
-    return image;
+// static
+ViewportFrameView ScreenshotCapture::CropToElement(
+    const ViewportFrameView& frame,
+    const gfx::Rect& element_bounds) {
+  if (frame.IsEmpty() || element_bounds.IsEmpty()) {
+    return frame;
   }
 
-  // Extract the cropped region
-  SkBitmap cropped_bitmap;
-  if (image_skia->GetRepresentation(1.0f).GetBitmap().extractSubset(
-          &cropped_bitmap, gfx::RectToSkIRect(crop_bounds))) {
-    return gfx::Image::CreateFrom1xBitmap(cropped_bitmap);
-  }
-
-  return image;
+  // A crop is a narrower view of the same pixels
+  ViewportFrameView cropped = frame.Crop(element_bounds);
+  return cropped.IsEmpty() ? frame : cropped;
 }
 
-gfx::Image ScreenshotCapture::ResizeImage(const gfx::Image& image, int max_size) {
-  if (image.IsEmpty()) {
-    return image;
-  }
-
-  const gfx::ImageSkia* image_skia = image.ToImageSkia();
-  if (!image_skia || image_skia->isNull()) {
-    return image;
+// static
+gfx::Image ScreenshotCapture::ResizeImage(const ViewportFrameView& view,
+                                          int max_size) {
+  if (view.IsEmpty()) {
+    return gfx::Image();
   }
 
-  gfx::Size current_size = image_skia->size();
+  gfx::Size current_size = view.rect().size();
   
-  // Don't resize if already smaller than max_size
+  // Don't resize if already smaller than max_size; the image then shares
+  // the frame's pixels
   if (current_size.width() <= max_size && current_size.height() <= max_size) {
-    return image;
+    return view.ToImage();
   }
 
   // Calculate new size maintaining aspect ratio
@@ -202,21 +213,27 @@ gfx::Image ScreenshotCapture::ResizeImage(const gfx::Image& image, int max_size)
   }
 
   gfx::Size new_size(
-      static_cast<int>(current_size.width() * scale),
-      static_cast<int>(current_size.height() * scale));
+      std::max(1, static_cast<int>(current_size.width() * scale)),
+      std::max(1, static_cast<int>(current_size.height() * scale)));
 
-  // Create resized image
-  gfx::ImageSkia resized_skia = gfx::ImageSkia::CreateFrom1xBitmap(
-      image_skia->GetRepresentation(1.0f).GetBitmap());
-  
-  // Scale the image
   SkBitmap resized_bitmap;
-  if (resized_skia.GetRepresentation(1.0f).GetBitmap().scalePixels(
-          &resized_bitmap, SkFilterQuality::kMedium_SkFilterQuality)) {
-    return gfx::Image::CreateFrom1xBitmap(resized_bitmap);
-  }
-
-  return image;
+  if (!resized_bitmap.tryAllocPixels(view.frame()->bitmap().info().makeWH(
+          new_size.width(), new_size.height()))) {
+    return view.ToImage();
+  }
+
+  // Area-average straight from the frame's pixels into the new bitmap, the
+  // only copy made for a scaled thumbnail
+  navigrab::Bitmap source_pixels = view.Pixels();
+  navigrab::Bitmap resized_pixels = navigrab::Bitmap::Wrap(
+      static_cast<uint8_t*>(resized_bitmap.getPixels()), new_size.width(),
+      new_size.height(), resized_bitmap.rowBytes(), source_pixels.Format());
+  if (!navigrab::ResampleBitmap(source_pixels, new_size.width(),
+                                new_size.height(), &resized_pixels)) {
+    return view.ToImage();
+  }
+  resized_bitmap.setImmutable();
+  return gfx::Image::CreateFrom1xBitmap(resized_bitmap);
 }
 
 }  // namespace tooltip
@@ -8,8 +8,10 @@
 #include <memory>
 
 #include "base/functional/callback.h"
+#include "base/memory/scoped_refptr.h"
 #include "base/memory/weak_ptr.h"
 #include "chrome/browser/tooltip/tooltip_service.h"
+#include "chrome/browser/tooltip/viewport_frame.h"
 #include "content/public/browser/web_contents_observer.h"
 #include "ui/gfx/image/image.h"
 
@@ -41,19 +43,34 @@ class ScreenshotCapture : public content::WebContentsObserver {
   void CaptureViewport(content::WebContents* web_contents,
                       base::OnceCallback<void(const gfx::Image&)> callback);
 
+  // Capture the viewport as a shared frame, so element crops, thumbnails
+  // and AI inputs taken from it as views all reference the same pixels.
+  // Runs |callback| with null if the capture fails.
+  void CaptureViewportFrame(
+      content::WebContents* web_contents,
+      base::OnceCallback<void(scoped_refptr<ViewportFrame>)> callback);
+
+  // Crop |frame| to the element and scale it down to at most 1024px. The
+  // result shares the frame's pixels unless it had to be scaled.
+  static gfx::Image ProcessImage(const ViewportFrameView& frame,
+                                 const ElementInfo& element_info);
+
  private:
   // Handle screenshot capture completion
   void OnScreenshotCaptured(base::OnceCallback<void(const gfx::Image&)> callback,
                            const gfx::Image& image);
 
-  // Process captured image
-  gfx::Image ProcessImage(const gfx::Image& image, const ElementInfo& element_info);
+  // Continue an element capture once its viewport frame is in
+  void OnViewportCaptured(const ElementInfo& element_info,
+                          base::OnceCallback<void(const gfx::Image&)> callback,
+                          scoped_refptr<ViewportFrame> frame);
 
-  // Crop image to element bounds
-  gfx::Image CropToElement(const gfx::Image& image, const gfx::Rect& element_bounds);
+  // Narrow the view to element bounds; the whole view if they miss it
+  static ViewportFrameView CropToElement(const ViewportFrameView& frame,
+                                         const gfx::Rect& element_bounds);
 
   // Resize image if needed
-  gfx::Image ResizeImage(const gfx::Image& image, int max_size);
+  static gfx::Image ResizeImage(const ViewportFrameView& view, int max_size);
 
   bool initialized_;
   base::WeakPtrFactory<ScreenshotCapture> weak_factory_{this};
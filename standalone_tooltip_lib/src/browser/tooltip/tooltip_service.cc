@@ -13,6 +13,7 @@
 #include "chrome/browser/tooltip/navigrab_integration.h"
 #include "chrome/browser/ui/views/tooltip/tooltip_view.h"
 #include "content/public/browser/web_contents.h"
+#include "src/navigrab/trace.h"
 #include "ui/gfx/geometry/rect.h"
 #include "ui/gfx/geometry/size.h"
 
@@ -111,6 +112,12 @@ void TooltipService::ShowTooltipForElement(
   // Hide any existing tooltip
   HideTooltip();
 
+  // One trace id follows this hover through capture, AI and the view.
+  hover_trace_id_ = navigrab::NewTraceId();
+  NAVIGRAB_TRACE_ASYNC_BEGIN("tooltip", "hover", hover_trace_id_);
+  NAVIGRAB_TRACE_SPAN("tooltip", "TooltipService::ShowTooltipForElement",
+                      hover_trace_id_);
+
   // Set element information
   tooltip_view_->SetElementInfo(element_info);
 
@@ -129,7 +136,9 @@ void TooltipService::ShowTooltipForElement(
 
   // Capture screenshot if auto-capture is enabled
   if (prefs_->GetAutoCapture()) {
-    CaptureElementScreenshot(web_contents, element_info);
+    ElementInfo traced_info = element_info;
+    traced_info.trace_id = hover_trace_id_;
+    CaptureElementScreenshot(web_contents, traced_info);
   }
 
   VLOG(1) << "Tooltip shown for element: " << element_info.tag_name;
@@ -144,6 +153,7 @@ void TooltipService::HideTooltip() {
 
   tooltip_view_->Hide();
   tooltip_visible_ = false;
+  EndHoverTrace();
 
   // Notify observers
   NotifyTooltipHidden();
@@ -175,9 +185,14 @@ void TooltipService::GetAIDescription(const ElementInfo& element_info,
 
   // DCHECK_CURRENTLY_ON is deprecated, using task runner check instead
 
+  ElementInfo traced_info = element_info;
+  if (!traced_info.trace_id) {
+    traced_info.trace_id = hover_trace_id_;
+  }
+
   // Get AI description asynchronously
   ai_integration_->GetDescription(
-      element_info, screenshot,
+      traced_info, screenshot,
       base::BindOnce(&TooltipService::NotifyAIResponseReceived,
                      base::Unretained(this)));
 }
@@ -248,6 +263,11 @@ void TooltipService::NotifyAIResponseReceived(const AIResponse& response) {
   if (tooltip_view_) {
     tooltip_view_->SetAIResponse(response);
   }
+
+  // The hover is complete once its description is on screen.
+  if (response.trace_id && response.trace_id == hover_trace_id_) {
+    EndHoverTrace();
+  }
   
   // Notify observers
   for (auto& observer : observers_) {
@@ -274,6 +294,14 @@ void TooltipService::NotifyError(const std::string& error_message) {
   }
 }
 
+void TooltipService::EndHoverTrace() {
+  if (!hover_trace_id_) {
+    return;
+  }
+  NAVIGRAB_TRACE_ASYNC_END("tooltip", "hover", hover_trace_id_);
+  hover_trace_id_ = 0;
+}
+
 // NaviGrab automation integration methods
 void TooltipService::ExecuteAutomationAction(
     const ElementInfo& element_info,
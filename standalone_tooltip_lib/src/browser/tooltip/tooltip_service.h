@@ -61,6 +61,8 @@ struct ElementInfo {
   std::string type;
   gfx::Rect bounds;
   std::string computed_styles;
+  // Correlates the trace spans of one hover; 0 when not traced.
+  uint64_t trace_id = 0;
   
   ElementInfo();
   ~ElementInfo();
@@ -73,6 +75,7 @@ struct AIResponse {
   std::string confidence;
   int64_t timestamp;
   std::vector<std::string> suggested_actions;
+  uint64_t trace_id = 0;  // Copied from the ElementInfo it describes
   
   AIResponse();
   ~AIResponse();
@@ -165,6 +168,9 @@ class TooltipService : public base::Singleton<TooltipService> {
   void NotifyAIResponseReceived(const AIResponse& response);
   void NotifyError(const std::string& error_message);
 
+  // Closes the "hover" trace span of the current tooltip, if open.
+  void EndHoverTrace();
+
   // Component instances
   std::unique_ptr<ElementDetector> element_detector_;
   std::unique_ptr<ScreenshotCapture> screenshot_capture_;
@@ -177,6 +183,7 @@ class TooltipService : public base::Singleton<TooltipService> {
   bool initialized_;
   bool enabled_;
   bool tooltip_visible_;
+  uint64_t hover_trace_id_ = 0;
   base::ObserverList<TooltipObserver> observers_;
 
   TooltipService(const TooltipService&) = delete;
@@ -0,0 +1,127 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include "viewport_frame.h"
+
+#include <utility>
+
+#include "third_party/skia/include/core/SkImageInfo.h"
+#include "third_party/skia/include/core/SkPixmap.h"
+#include "ui/gfx/geometry/skia_conversions.h"
+#include "ui/gfx/image/image_skia.h"
+#include "ui/gfx/image/image_skia_rep.h"
+
+namespace tooltip {
+
+namespace {
+
+// Either N32 byte order keeps alpha last, which is all navigrab relies on
+constexpr navigrab::PixelFormat kN32PixelFormat =
+    kN32_SkColorType == kBGRA_8888_SkColorType
+        ? navigrab::PixelFormat::BGRA_8888
+        : navigrab::PixelFormat::RGBA_8888;
+
+}  // namespace
+
+// static
+scoped_refptr<ViewportFrame> ViewportFrame::Create(const SkBitmap& bitmap) {
+  if (bitmap.drawsNothing() || !bitmap.getPixels()) {
+    return nullptr;
+  }
+  if (bitmap.colorType() == kN32_SkColorType) {
+    // Copying an SkBitmap shares its pixel ref
+    SkBitmap shared = bitmap;
+    shared.setImmutable();
+    return base::WrapRefCounted(new ViewportFrame(shared));
+  }
+  SkBitmap converted;
+  if (!converted.tryAllocPixels(
+          bitmap.info().makeColorType(kN32_SkColorType)) ||
+      !bitmap.readPixels(converted.pixmap())) {
+    return nullptr;
+  }
+  converted.setImmutable();
+  return base::WrapRefCounted(new ViewportFrame(converted));
+}
+
+// static
+scoped_refptr<ViewportFrame> ViewportFrame::FromImage(const gfx::Image& image) {
+  if (image.IsEmpty()) {
+    return nullptr;
+  }
+  const gfx::ImageSkia* image_skia = image.ToImageSkia();
+  if (!image_skia || image_skia->isNull()) {
+    return nullptr;
+  }
+  return Create(image_skia->GetRepresentation(1.0f).GetBitmap());
+}
+
+ViewportFrame::ViewportFrame(const SkBitmap& bitmap) : bitmap_(bitmap) {}
+
+ViewportFrame::~ViewportFrame() = default;
+
+ViewportFrameView ViewportFrame::View() const {
+  return ViewportFrameView(base::WrapRefCounted(this), bounds());
+}
+
+ViewportFrameView::ViewportFrameView() = default;
+
+ViewportFrameView::ViewportFrameView(scoped_refptr<const ViewportFrame> frame,
+                                     const gfx::Rect& rect)
+    : frame_(std::move(frame)), rect_(rect) {
+  if (frame_) {
+    rect_.Intersect(frame_->bounds());
+  } else {
+    rect_ = gfx::Rect();
+  }
+}
+
+ViewportFrameView::ViewportFrameView(const ViewportFrameView& other) = default;
+
+ViewportFrameView& ViewportFrameView::operator=(
+    const ViewportFrameView& other) = default;
+
+ViewportFrameView::~ViewportFrameView() = default;
+
+ViewportFrameView ViewportFrameView::Crop(const gfx::Rect& rect) const {
+  gfx::Rect cropped = rect_;
+  cropped.Intersect(rect);
+  return ViewportFrameView(frame_, cropped);
+}
+
+SkBitmap ViewportFrameView::ToSkBitmap() const {
+  SkBitmap subset;
+  if (IsEmpty()) {
+    return subset;
+  }
+  if (rect_ == frame_->bounds()) {
+    return frame_->bitmap();
+  }
+  // extractSubset points into the same pixel ref; nothing is copied
+  if (!frame_->bitmap().extractSubset(&subset, gfx::RectToSkIRect(rect_))) {
+    return SkBitmap();
+  }
+  return subset;
+}
+
+gfx::Image ViewportFrameView::ToImage() const {
+  SkBitmap bitmap = ToSkBitmap();
+  if (bitmap.drawsNothing()) {
+    return gfx::Image();
+  }
+  return gfx::Image::CreateFrom1xBitmap(bitmap);
+}
+
+navigrab::Bitmap ViewportFrameView::Pixels() const {
+  if (IsEmpty()) {
+    return navigrab::Bitmap();
+  }
+  const SkBitmap& bitmap = frame_->bitmap();
+  auto* origin = static_cast<uint8_t*>(
+      const_cast<void*>(bitmap.getAddr(rect_.x(), rect_.y())));
+  return navigrab::Bitmap::Wrap(origin, rect_.width(), rect_.height(),
+                                bitmap.rowBytes(), kN32PixelFormat);
+}
+
+}  // namespace tooltip
@@ -0,0 +1,79 @@
+// Copyright 2024 The Chromium Authors
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#ifndef CHROME_BROWSER_TOOLTIP_VIEWPORT_FRAME_H_
+#define CHROME_BROWSER_TOOLTIP_VIEWPORT_FRAME_H_
+
+#include "base/memory/ref_counted.h"
+#include "src/navigrab/bitmap.h"
+#include "third_party/skia/include/core/SkBitmap.h"
+#include "ui/gfx/geometry/rect.h"
+#include "ui/gfx/image/image.h"
+
+namespace tooltip {
+
+class ViewportFrameView;
+
+// The pixels of one viewport capture, immutable and shared by every element
+// crop, thumbnail and AI input taken from it. Reference counted so the
+// capture lives exactly as long as some view of it does.
+class ViewportFrame : public base::RefCountedThreadSafe<ViewportFrame> {
+ public:
+  // Shares |bitmap|'s pixels and marks them immutable. Only a bitmap that
+  // is not N32 is copied, to convert it. Null if |bitmap| has no pixels.
+  static scoped_refptr<ViewportFrame> Create(const SkBitmap& bitmap);
+  static scoped_refptr<ViewportFrame> FromImage(const gfx::Image& image);
+
+  const SkBitmap& bitmap() const { return bitmap_; }
+  gfx::Rect bounds() const { return gfx::Rect(bitmap_.width(), bitmap_.height()); }
+
+  // View of the whole frame
+  ViewportFrameView View() const;
+
+ private:
+  friend class base::RefCountedThreadSafe<ViewportFrame>;
+
+  explicit ViewportFrame(const SkBitmap& bitmap);
+  ~ViewportFrame();
+
+  const SkBitmap bitmap_;
+};
+
+// A rectangle of a ViewportFrame. Copying a view copies a pointer and a
+// rect; pixels are copied only when a caller needs an image that differs
+// from the captured one, such as a scaled thumbnail.
+class ViewportFrameView {
+ public:
+  ViewportFrameView();
+  // |rect| is in frame coordinates and is clipped to the frame
+  ViewportFrameView(scoped_refptr<const ViewportFrame> frame,
+                    const gfx::Rect& rect);
+  ViewportFrameView(const ViewportFrameView& other);
+  ViewportFrameView& operator=(const ViewportFrameView& other);
+  ~ViewportFrameView();
+
+  bool IsEmpty() const { return !frame_ || rect_.IsEmpty(); }
+  const gfx::Rect& rect() const { return rect_; }
+  const ViewportFrame* frame() const { return frame_.get(); }
+
+  // Narrows the view to |rect|, given in frame coordinates. The result is
+  // empty if |rect| misses the view.
+  ViewportFrameView Crop(const gfx::Rect& rect) const;
+
+  // Skia bitmap and image that share the frame's pixels
+  SkBitmap ToSkBitmap() const;
+  gfx::Image ToImage() const;
+
+  // Wraps the view's pixels for navigrab's resampler and encoders, which
+  // only read them. Empty for an empty view.
+  navigrab::Bitmap Pixels() const;
+
+ private:
+  scoped_refptr<const ViewportFrame> frame_;
+  gfx::Rect rect_;
+};
+
+}  // namespace tooltip
+
+#endif  // CHROME_BROWSER_TOOLTIP_VIEWPORT_FRAME_H_
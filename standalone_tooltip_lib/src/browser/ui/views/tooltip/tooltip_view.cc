@@ -8,6 +8,7 @@
 #include "base/strings/utf_string_conversions.h"
 #include "base/functional/bind.h"
 #include "chrome/browser/tooltip/tooltip_service.h"
+#include "src/navigrab/trace.h"
 #include "ui/gfx/canvas.h"
 #include "ui/gfx/color_palette.h"
 #include "ui/gfx/font_list.h"
@@ -48,6 +49,8 @@ void TooltipView::SetScreenshot(const gfx::Image& screenshot) {
 }
 
 void TooltipView::SetAIResponse(const AIResponse& response) {
+  NAVIGRAB_TRACE_SPAN("tooltip", "TooltipView::SetAIResponse",
+                      response.trace_id);
   ai_response_ = response;
   loading_ = false;
   UpdateContent();
@@ -0,0 +1,296 @@
+#include "browser_pool.h"
+#include "logging.h"
+#include "navigrab_core.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace navigrab {
+
+namespace {
+
+using SteadyClock = std::chrono::steady_clock;
+
+} // namespace
+
+class BrowserPool::Impl {
+public:
+    explicit Impl(BrowserPoolOptions options) : options_(std::move(options)) {
+        options_.browsers = std::max<size_t>(options_.browsers, 1);
+        options_.max_pages_per_browser = std::max<size_t>(options_.max_pages_per_browser, 1);
+        browsers_.resize(options_.browsers);
+    }
+
+    bool WarmUp() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (shut_down_) return false;
+        bool ok = true;
+        for (size_t i = 0; i < browsers_.size(); ++i) {
+            if (!EnsureLaunched(i)) {
+                ok = false;
+                continue;
+            }
+            BrowserSlot& browser = browsers_[i];
+            while (browser.idle.size() < options_.warm_pages_per_browser &&
+                   browser.page_count < options_.max_pages_per_browser) {
+                browser.idle.push_back({std::make_unique<Page>(browser.backend->CreatePage()), SteadyClock::now()});
+                ++browser.page_count;
+                ++stats_.pages_created;
+            }
+        }
+        return ok;
+    }
+
+    // Takes an idle page or makes one; an empty lease when every browser is
+    // full. Called with |mutex_| held.
+    PageLease TryLease(const std::shared_ptr<Impl>& self) {
+        // Most recently returned idle page first: it is the warmest
+        size_t best = browsers_.size();
+        for (size_t i = 0; i < browsers_.size(); ++i) {
+            const BrowserSlot& browser = browsers_[i];
+            if (browser.idle.empty()) continue;
+            if (best == browsers_.size() || browser.idle.back().since > browsers_[best].idle.back().since) best = i;
+        }
+        if (best != browsers_.size()) {
+            BrowserSlot& browser = browsers_[best];
+            std::unique_ptr<Page> page = std::move(browser.idle.back().page);
+            browser.idle.pop_back();
+            ++browser.leased;
+            ++stats_.leases;
+            ++stats_.reused;
+            return PageLease(std::move(page), self, best);
+        }
+
+        // No idle page: create one on the least loaded browser with room
+        for (size_t i = 0; i < browsers_.size(); ++i) {
+            if (browsers_[i].page_count >= options_.max_pages_per_browser) continue;
+            if (best == browsers_.size() || browsers_[i].page_count < browsers_[best].page_count) best = i;
+        }
+        if (best == browsers_.size() || !EnsureLaunched(best)) return PageLease();
+        BrowserSlot& browser = browsers_[best];
+        ++browser.page_count;
+        ++browser.leased;
+        ++stats_.pages_created;
+        ++stats_.leases;
+        return PageLease(std::make_unique<Page>(browser.backend->CreatePage()), self, best);
+    }
+
+    PageLease Acquire(const std::shared_ptr<Impl>& self, const SteadyClock::time_point* deadline) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!shut_down_) {
+            PageLease lease = TryLease(self);
+            if (lease || !BeforeDeadline(deadline)) return lease;
+            if (deadline) {
+                if (returned_.wait_until(lock, *deadline) == std::cv_status::timeout) return TryLease(self);
+            } else {
+                returned_.wait(lock);
+            }
+        }
+        return PageLease();
+    }
+
+    // Resets a returned page and keeps it idle, or destroys it when the pool
+    // is full, shut down, or the page cannot be reset.
+    void Release(std::unique_ptr<Page> page, size_t index) {
+        bool shut_down;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            shut_down = shut_down_;
+        }
+        // Reset outside the lock: it talks to the engine
+        bool reusable = !shut_down && page->PendingOperations() == 0 && page->Reset();
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        BrowserSlot& browser = browsers_[index];
+        --browser.leased;
+        if (reusable && !shut_down_ && IdleCount() < options_.max_idle_pages) {
+            browser.idle.push_back({std::move(page), SteadyClock::now()});
+        } else {
+            --browser.page_count;
+            ++stats_.discarded;
+            lock.unlock();
+            page.reset();
+            lock.lock();
+        }
+        TrimLocked();
+        lock.unlock();
+        returned_.notify_one();
+    }
+
+    void TrimIdle() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        TrimLocked();
+    }
+
+    void Shutdown() {
+        std::vector<std::unique_ptr<Page>> closing;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (shut_down_) return;
+            shut_down_ = true;
+            for (BrowserSlot& browser : browsers_) {
+                for (IdlePage& idle : browser.idle) closing.push_back(std::move(idle.page));
+                browser.page_count -= browser.idle.size();
+                stats_.discarded += browser.idle.size();
+                browser.idle.clear();
+                // Engines the pool found already running belong to someone else
+                if (browser.launched_by_pool) browser.backend->Close();
+                browser.launched = false;
+                browser.launched_by_pool = false;
+            }
+        }
+        returned_.notify_all();
+        NAVIGRAB_LOG(INFO) << "BrowserPool: Shut down, " << closing.size() << " idle pages closed";
+    }
+
+    BrowserPoolStats GetStats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        BrowserPoolStats stats = stats_;
+        stats.idle_pages = IdleCount();
+        for (const BrowserSlot& browser : browsers_) stats.leased_pages += browser.leased;
+        return stats;
+    }
+
+private:
+    struct IdlePage {
+        std::unique_ptr<Page> page;
+        SteadyClock::time_point since;
+    };
+
+    struct BrowserSlot {
+        std::shared_ptr<BrowserBackend> backend;
+        bool launched = false;
+        bool launched_by_pool = false;
+        size_t page_count = 0;      // Leased plus idle
+        size_t leased = 0;
+        std::vector<IdlePage> idle; // Oldest first
+    };
+
+    static bool BeforeDeadline(const SteadyClock::time_point* deadline) {
+        return !deadline || SteadyClock::now() < *deadline;
+    }
+
+    bool EnsureLaunched(size_t index) {
+        BrowserSlot& browser = browsers_[index];
+        if (browser.launched) return true;
+        if (!browser.backend) {
+            browser.backend = options_.backend_factory ? options_.backend_factory() : GetDefaultBrowserBackend();
+        }
+        if (!browser.backend) return false;
+        // A shared engine that is already up is reused as is
+        if (!browser.backend->IsRunning()) {
+            if (!browser.backend->Launch()) {
+                NAVIGRAB_LOG(WARNING) << "BrowserPool: Launch failed for browser " << index;
+                return false;
+            }
+            ++stats_.launches;
+            browser.launched_by_pool = true;
+        }
+        browser.launched = true;
+        return true;
+    }
+
+    size_t IdleCount() const {
+        size_t count = 0;
+        for (const BrowserSlot& browser : browsers_) count += browser.idle.size();
+        return count;
+    }
+
+    void TrimLocked() {
+        auto cutoff = SteadyClock::now() - options_.max_idle_time;
+        size_t excess = IdleCount() > options_.max_idle_pages ? IdleCount() - options_.max_idle_pages : 0;
+        for (BrowserSlot& browser : browsers_) {
+            auto& idle = browser.idle;
+            size_t drop = 0;
+            while (drop < idle.size() && (idle[drop].since < cutoff || excess > 0)) {
+                if (excess > 0) --excess;
+                ++drop;
+            }
+            if (drop == 0) continue;
+            idle.erase(idle.begin(), idle.begin() + static_cast<std::ptrdiff_t>(drop));
+            browser.page_count -= drop;
+            stats_.discarded += drop;
+        }
+    }
+
+    BrowserPoolOptions options_;
+    mutable std::mutex mutex_;
+    std::condition_variable returned_;
+    std::vector<BrowserSlot> browsers_;
+    BrowserPoolStats stats_;
+    bool shut_down_ = false;
+};
+
+// BrowserPool implementation
+BrowserPool::BrowserPool(BrowserPoolOptions options) {
+    bool eager = options.warm_up == WarmUpPolicy::EAGER;
+    impl_ = std::make_shared<Impl>(std::move(options));
+    if (eager) impl_->WarmUp();
+}
+
+BrowserPool::~BrowserPool() {
+    impl_->Shutdown();
+}
+
+bool BrowserPool::WarmUp() {
+    return impl_->WarmUp();
+}
+
+PageLease BrowserPool::Acquire() {
+    return impl_->Acquire(impl_, nullptr);
+}
+
+PageLease BrowserPool::TryAcquire() {
+    auto deadline = std::chrono::steady_clock::now();
+    return impl_->Acquire(impl_, &deadline);
+}
+
+PageLease BrowserPool::AcquireFor(std::chrono::milliseconds timeout) {
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    return impl_->Acquire(impl_, &deadline);
+}
+
+void BrowserPool::TrimIdle() {
+    impl_->TrimIdle();
+}
+
+void BrowserPool::Shutdown() {
+    impl_->Shutdown();
+}
+
+BrowserPoolStats BrowserPool::GetStats() const {
+    return impl_->GetStats();
+}
+
+// PageLease implementation
+PageLease::PageLease(std::unique_ptr<Page> page, std::weak_ptr<BrowserPool::Impl> pool, size_t browser)
+    : page_(std::move(page)), pool_(std::move(pool)), browser_(browser) {}
+
+PageLease::~PageLease() {
+    Return();
+}
+
+PageLease::PageLease(PageLease&& other) noexcept
+    : page_(std::move(other.page_)), pool_(std::move(other.pool_)), browser_(other.browser_) {}
+
+PageLease& PageLease::operator=(PageLease&& other) noexcept {
+    if (this != &other) {
+        Return();
+        page_ = std::move(other.page_);
+        pool_ = std::move(other.pool_);
+        browser_ = other.browser_;
+    }
+    return *this;
+}
+
+void PageLease::Return() {
+    if (!page_) return;
+    if (auto pool = pool_.lock()) {
+        pool->Release(std::move(page_), browser_);
+    }
+    page_.reset();
+    pool_.reset();
+}
+
+} // namespace navigrab
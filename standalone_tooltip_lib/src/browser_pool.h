@@ -0,0 +1,107 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "page_backend.h"
+
+namespace navigrab {
+
+class Page;
+
+// When the pool pays for browser launches and page creation
+enum class WarmUpPolicy {
+    LAZY,   // On the first lease that needs them
+    EAGER   // Up front, in the constructor
+};
+
+struct BrowserPoolOptions {
+    size_t browsers = 1;                    // Launched browsers kept by the pool
+    size_t warm_pages_per_browser = 2;      // Idle pages created at warm-up
+    size_t max_pages_per_browser = 16;      // Leased plus idle; Acquire() waits beyond this
+    size_t max_idle_pages = 8;              // Pages returned past this are destroyed
+    std::chrono::milliseconds max_idle_time{std::chrono::minutes(5)};  // Older idle pages are trimmed
+    WarmUpPolicy warm_up = WarmUpPolicy::EAGER;
+    // Makes each browser's engine; null shares GetDefaultBrowserBackend()
+    BrowserBackendFactory backend_factory;
+};
+
+struct BrowserPoolStats {
+    uint64_t launches = 0;
+    uint64_t pages_created = 0;
+    uint64_t leases = 0;
+    uint64_t reused = 0;         // Leases served by an idle page
+    uint64_t discarded = 0;      // Pages destroyed on return or by trimming
+    size_t idle_pages = 0;
+    size_t leased_pages = 0;
+};
+
+class PageLease;
+
+// Keeps launched browsers and warmed pages so jobs skip the launch and
+// page-creation cost. Pages are reset to about:blank when returned instead
+// of being destroyed. Thread-safe.
+class BrowserPool {
+public:
+    explicit BrowserPool(BrowserPoolOptions options = BrowserPoolOptions());
+    ~BrowserPool();
+
+    BrowserPool(const BrowserPool&) = delete;
+    BrowserPool& operator=(const BrowserPool&) = delete;
+
+    // Launches the browsers and fills the idle pages (idempotent)
+    bool WarmUp();
+
+    // Leases an idle page, creating one when a browser has room. Acquire()
+    // waits for a return when every browser is full; TryAcquire() gives an
+    // empty lease instead, and AcquireFor() waits at most |timeout|.
+    PageLease Acquire();
+    PageLease TryAcquire();
+    PageLease AcquireFor(std::chrono::milliseconds timeout);
+
+    // Destroys idle pages beyond max_idle_pages or older than max_idle_time
+    void TrimIdle();
+
+    // Closes every browser; pages still leased are destroyed on return
+    void Shutdown();
+
+    BrowserPoolStats GetStats() const;
+
+private:
+    friend class PageLease;
+    class Impl;
+    // Shared with outstanding leases, which may outlive the pool
+    std::shared_ptr<Impl> impl_;
+};
+
+// A page on loan from a BrowserPool. Goes back to the pool (and is reset)
+// when the lease is destroyed or Return() is called. Movable, not copyable.
+class PageLease {
+public:
+    PageLease() = default;
+    ~PageLease();
+    PageLease(PageLease&& other) noexcept;
+    PageLease& operator=(PageLease&& other) noexcept;
+    PageLease(const PageLease&) = delete;
+    PageLease& operator=(const PageLease&) = delete;
+
+    Page* get() const { return page_.get(); }
+    Page* operator->() const { return page_.get(); }
+    Page& operator*() const { return *page_; }
+    explicit operator bool() const { return page_ != nullptr; }
+
+    void Return();
+
+private:
+    friend class BrowserPool;
+    PageLease(std::unique_ptr<Page> page, std::weak_ptr<BrowserPool::Impl> pool, size_t browser);
+
+    std::unique_ptr<Page> page_;
+    std::weak_ptr<BrowserPool::Impl> pool_;
+    size_t browser_ = 0;
+};
+
+} // namespace navigrab
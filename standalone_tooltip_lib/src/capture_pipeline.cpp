@@ -0,0 +1,548 @@
+#include "capture_pipeline.h"
+#include "image_resampler.h"
+#include "logging.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+namespace navigrab {
+
+const char* PipelineStageName(PipelineStage stage) {
+    switch (stage) {
+        case PipelineStage::CAPTURE:
+            return "capture";
+        case PipelineStage::CROP:
+            return "crop";
+        case PipelineStage::RESIZE:
+            return "resize";
+        case PipelineStage::ENCODE:
+            return "encode";
+        case PipelineStage::STORE:
+            break;
+    }
+    return "store";
+}
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Submissions of each key still in the pipeline. A job is stale once a
+// newer one for its key is in flight or has finished; a newer one given up
+// does not count. Keys are forgotten when their last job leaves, so the map
+// only holds work in flight.
+class KeyTracker {
+public:
+    uint64_t Begin(const std::string& key) {
+        if (key.empty()) return 0;
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t sequence = ++sequence_;
+        keys_[key].live.push_back(sequence);
+        return sequence;
+    }
+
+    bool IsStale(const std::string& key, uint64_t sequence) const {
+        if (key.empty()) return false;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = keys_.find(key);
+        if (it == keys_.end()) return false;
+        const KeyState& state = it->second;
+        return sequence < state.finished || sequence < *std::max_element(state.live.begin(), state.live.end());
+    }
+
+    // |finished| is true when the job got through rather than being given up
+    void End(const std::string& key, uint64_t sequence, bool finished) {
+        if (key.empty()) return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = keys_.find(key);
+        if (it == keys_.end()) return;
+        KeyState& state = it->second;
+        state.live.erase(std::find(state.live.begin(), state.live.end(), sequence));
+        if (finished) state.finished = std::max(state.finished, sequence);
+        if (state.live.empty()) keys_.erase(it);
+    }
+
+private:
+    struct KeyState {
+        std::vector<uint64_t> live;     // Usually one
+        uint64_t finished = 0;
+    };
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, KeyState> keys_;
+    uint64_t sequence_ = 0;
+};
+
+// An element between submission and its crop
+struct PendingElement {
+    CaptureRequest request;
+    uint64_t sequence = 0;
+};
+
+struct FrameJob {
+    std::string key;
+    uint64_t sequence = 0;
+    FrameCapture capture;
+    std::shared_ptr<const Bitmap> frame;
+    std::vector<PendingElement> elements;
+};
+
+struct ElementJob {
+    std::string key;
+    uint64_t sequence = 0;
+    CaptureRequest request;
+    std::shared_ptr<const Bitmap> frame;    // Owns the pixels |view| points into
+    Bitmap view;
+    Bitmap resized;                         // Empty when the view already fits
+    CaptureResult result;
+};
+
+// One stage: a bounded queue drained by its own workers. Run() returns
+// false for a job it could not do; that job, and any the stage turns away,
+// goes to Discard() so its requests hear back.
+template <typename Job>
+class Stage {
+public:
+    using Run = std::function<bool(Job&)>;
+    using Discard = std::function<void(Job&)>;
+    using IsStale = std::function<bool(const Job&)>;
+
+    Stage(const PipelineStageOptions& options, Run run, Discard discard, IsStale is_stale)
+        : workers_(std::max<size_t>(1, options.workers)),
+          capacity_(std::max<size_t>(1, options.queue_capacity)),
+          overflow_(options.overflow),
+          run_(std::move(run)),
+          discard_(std::move(discard)),
+          is_stale_(std::move(is_stale)) {}
+
+    void Start() {
+        for (size_t i = 0; i < workers_; ++i) threads_.emplace_back([this] { Work(); });
+    }
+
+    // Gives up whatever is queued; jobs already running finish
+    void Stop() {
+        std::deque<Entry> abandoned;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (stopping_) return;
+            stopping_ = true;
+            abandoned.swap(queue_);
+        }
+        not_empty_.notify_all();
+        not_full_.notify_all();
+        idle_.notify_all();
+        for (auto& thread : threads_) thread.join();
+        threads_.clear();
+        for (Entry& entry : abandoned) discard_(entry.job);
+    }
+
+    // Queues |job| under the overflow policy, first replacing a queued job
+    // with the same key. False if |job| was turned away or is older than the
+    // queued job it would replace.
+    bool Push(Job job) {
+        std::optional<Job> evicted;
+        bool queued = false;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            for (;;) {
+                if (stopping_) break;
+                auto same = job.key.empty() ? queue_.end()
+                                            : std::find_if(queue_.begin(), queue_.end(), [&job](const Entry& entry) {
+                                                  return entry.job.key == job.key;
+                                              });
+                if (same != queue_.end() && same->job.sequence > job.sequence) {
+                    // Out-of-order handoff; the queued job is the newer one
+                    coalesced_++;
+                    break;
+                }
+                if (same != queue_.end()) {
+                    evicted = std::move(same->job);
+                    same->job = std::move(job);
+                    same->queued_at = Clock::now();
+                    coalesced_++;
+                    queued = true;
+                    break;
+                }
+                if (queue_.size() < capacity_) {
+                    Enqueue(std::move(job));
+                    queued = true;
+                    break;
+                }
+                if (overflow_ == OverflowPolicy::DROP_NEWEST) {
+                    dropped_++;
+                    break;
+                }
+                if (overflow_ == OverflowPolicy::DROP_OLDEST) {
+                    evicted = std::move(queue_.front().job);
+                    queue_.pop_front();
+                    dropped_++;
+                    Enqueue(std::move(job));
+                    queued = true;
+                    break;
+                }
+                not_full_.wait(lock);
+            }
+        }
+        if (evicted) discard_(*evicted);
+        if (!queued) discard_(job);
+        return queued;
+    }
+
+    // Waits until nothing is queued or running, so the counters are final
+    void WaitIdle() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        idle_.wait(lock, [this] { return stopping_ || (queue_.empty() && busy_ == 0); });
+    }
+
+    PipelineStageStats Stats() const {
+        PipelineStageStats stats;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats.queue_depth = queue_.size();
+            stats.max_queue_depth = max_depth_;
+            stats.busy_workers = busy_;
+            stats.dropped = dropped_;
+            stats.coalesced = coalesced_;
+        }
+        stats.processed = processed_;
+        stats.failed = failed_;
+        stats.stale = stale_;
+        stats.queue_latency = queue_latency_.Snapshot();
+        stats.run_latency = run_latency_.Snapshot();
+        return stats;
+    }
+
+private:
+    struct Entry {
+        Job job;
+        Clock::time_point queued_at;
+    };
+
+    // Called with |mutex_| held
+    void Enqueue(Job job) {
+        queue_.push_back({std::move(job), Clock::now()});
+        max_depth_ = std::max(max_depth_, queue_.size());
+        not_empty_.notify_one();
+    }
+
+    void Work() {
+        for (;;) {
+            Entry entry;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                not_empty_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (stopping_) return;
+                entry = std::move(queue_.front());
+                queue_.pop_front();
+                busy_++;
+            }
+            not_full_.notify_one();
+            queue_latency_.Record(Clock::now() - entry.queued_at);
+
+            if (is_stale_(entry.job)) {
+                stale_++;
+                discard_(entry.job);
+            } else {
+                bool done;
+                {
+                    ScopedLatencyTimer timer(run_latency_);
+                    done = run_(entry.job);
+                }
+                if (done) {
+                    processed_++;
+                } else {
+                    failed_++;
+                    discard_(entry.job);
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (--busy_ == 0 && queue_.empty()) idle_.notify_all();
+        }
+    }
+
+    const size_t workers_;
+    const size_t capacity_;
+    const OverflowPolicy overflow_;
+    const Run run_;
+    const Discard discard_;
+    const IsStale is_stale_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::condition_variable idle_;
+    std::deque<Entry> queue_;
+    std::vector<std::thread> threads_;
+    bool stopping_ = false;
+    size_t busy_ = 0;
+    size_t max_depth_ = 0;
+    uint64_t dropped_ = 0;
+    uint64_t coalesced_ = 0;
+    std::atomic<uint64_t> processed_{0};
+    std::atomic<uint64_t> failed_{0};
+    std::atomic<uint64_t> stale_{0};
+    LatencyHistogram queue_latency_;
+    LatencyHistogram run_latency_;
+};
+
+} // namespace
+
+class CapturePipeline::Impl {
+public:
+    explicit Impl(CapturePipelineOptions options)
+        : options_(std::move(options)),
+          capture_(StageOptions(PipelineStage::CAPTURE),
+                   [this](FrameJob& job) { return Capture(job); },
+                   [this](FrameJob& job) { DiscardFrame(job); },
+                   [this](const FrameJob& job) { return frame_keys_.IsStale(job.key, job.sequence); }),
+          crop_(StageOptions(PipelineStage::CROP),
+                [this](FrameJob& job) { return Crop(job); },
+                [this](FrameJob& job) { DiscardFrame(job); },
+                [this](const FrameJob& job) { return frame_keys_.IsStale(job.key, job.sequence); }),
+          resize_(StageOptions(PipelineStage::RESIZE),
+                  [this](ElementJob& job) { return Resize(job); },
+                  [this](ElementJob& job) { FinishElement(job.request, job.sequence, false); },
+                  [this](const ElementJob& job) { return element_keys_.IsStale(job.key, job.sequence); }),
+          encode_(StageOptions(PipelineStage::ENCODE),
+                  [this](ElementJob& job) { return Encode(job); },
+                  [this](ElementJob& job) { FinishElement(job.request, job.sequence, false); },
+                  [this](const ElementJob& job) { return element_keys_.IsStale(job.key, job.sequence); }),
+          store_(StageOptions(PipelineStage::STORE),
+                 [this](ElementJob& job) { return Store(job); },
+                 [this](ElementJob& job) { FinishElement(job.request, job.sequence, false); },
+                 [this](const ElementJob& job) { return element_keys_.IsStale(job.key, job.sequence); }) {
+        // Each job runs on one worker; the stages are what spread the load
+        options_.encode.max_threads = 1;
+        capture_.Start();
+        crop_.Start();
+        resize_.Start();
+        encode_.Start();
+        store_.Start();
+    }
+
+    ~Impl() { Shutdown(); }
+
+    bool Submit(const std::string& frame_key, FrameCapture capture, std::shared_ptr<const Bitmap> frame,
+                std::vector<CaptureRequest> requests) {
+        FrameJob job;
+        job.key = frame_key;
+        job.capture = std::move(capture);
+        job.frame = std::move(frame);
+        job.elements.reserve(requests.size());
+        {
+            std::lock_guard<std::mutex> lock(outstanding_mutex_);
+            outstanding_ += 1 + requests.size();
+        }
+        job.sequence = frame_keys_.Begin(job.key);
+        for (CaptureRequest& request : requests) {
+            uint64_t sequence = element_keys_.Begin(request.key);
+            job.elements.push_back({std::move(request), sequence});
+        }
+        if (!accepting_) {
+            DiscardFrame(job);
+            return false;
+        }
+        // A frame captured already skips the capture stage
+        return job.frame ? crop_.Push(std::move(job)) : capture_.Push(std::move(job));
+    }
+
+    void Drain() {
+        std::unique_lock<std::mutex> lock(outstanding_mutex_);
+        idle_.wait(lock, [this] { return outstanding_ == 0; });
+        lock.unlock();
+        // A worker reports its last job done before it updates its stage's
+        // counters; wait for that too, so GetStats() after Drain() is exact
+        capture_.WaitIdle();
+        crop_.WaitIdle();
+        resize_.WaitIdle();
+        encode_.WaitIdle();
+        store_.WaitIdle();
+    }
+
+    void Shutdown() {
+        if (!accepting_.exchange(false)) return;
+        // Upstream first, so jobs still running hand off to stages that are
+        // still up, and then are given up there
+        capture_.Stop();
+        crop_.Stop();
+        resize_.Stop();
+        encode_.Stop();
+        store_.Stop();
+    }
+
+    PipelineStageStats GetStats(PipelineStage stage) const {
+        switch (stage) {
+            case PipelineStage::CAPTURE:
+                return capture_.Stats();
+            case PipelineStage::CROP:
+                return crop_.Stats();
+            case PipelineStage::RESIZE:
+                return resize_.Stats();
+            case PipelineStage::ENCODE:
+                return encode_.Stats();
+            case PipelineStage::STORE:
+                break;
+        }
+        return store_.Stats();
+    }
+
+private:
+    const PipelineStageOptions& StageOptions(PipelineStage stage) const {
+        return options_.stages[static_cast<size_t>(stage)];
+    }
+
+    bool Capture(FrameJob& job) {
+        auto frame = std::make_shared<Bitmap>();
+        if (!job.capture || !job.capture(frame.get()) || frame->IsEmpty()) return false;
+        job.frame = std::move(frame);
+        job.capture = nullptr;
+        crop_.Push(std::move(job));
+        return true;
+    }
+
+    // Every element becomes a view of the frame; nothing is copied here
+    bool Crop(FrameJob& job) {
+        const Bitmap& frame = *job.frame;
+        for (PendingElement& element : job.elements) {
+            dom::Box rect = element.request.rect;
+            if (rect.IsEmpty()) rect = {0, 0, frame.Width(), frame.Height()};
+            int left = std::max(rect.x, 0);
+            int top = std::max(rect.y, 0);
+            int right = std::min(rect.x + rect.width, frame.Width());
+            int bottom = std::min(rect.y + rect.height, frame.Height());
+            if (right <= left || bottom <= top) {
+                NAVIGRAB_LOG(DEBUG) << "CapturePipeline: " << element.request.key << " is outside its frame";
+                FinishElement(element.request, element.sequence, false);
+                continue;
+            }
+            ElementJob next;
+            next.key = element.request.key;
+            next.sequence = element.sequence;
+            next.request = std::move(element.request);
+            next.frame = job.frame;
+            next.view = Bitmap::Wrap(const_cast<uint8_t*>(frame.Row(top)) + static_cast<size_t>(left) * kBytesPerPixel,
+                                     right - left, bottom - top, frame.Stride(), frame.Format());
+            resize_.Push(std::move(next));
+        }
+        job.elements.clear();
+        FinishFrame(job, true);
+        return true;
+    }
+
+    bool Resize(ElementJob& job) {
+        int width = job.view.Width();
+        int height = job.view.Height();
+        double scale = 1.0;
+        if (job.request.max_width > 0) scale = std::min(scale, static_cast<double>(job.request.max_width) / width);
+        if (job.request.max_height > 0) scale = std::min(scale, static_cast<double>(job.request.max_height) / height);
+        if (scale < 1.0) {
+            ResampleOptions options;
+            options.max_threads = 1;
+            int target_width = std::max(1, static_cast<int>(width * scale + 0.5));
+            int target_height = std::max(1, static_cast<int>(height * scale + 0.5));
+            if (!ResampleBitmap(job.view, target_width, target_height, &job.resized, options)) return false;
+        }
+        encode_.Push(std::move(job));
+        return true;
+    }
+
+    bool Encode(ElementJob& job) {
+        const Bitmap& source = job.resized.IsEmpty() ? job.view : job.resized;
+        job.result.key = job.key;
+        job.result.destination = job.request.destination;
+        job.result.format = options_.format;
+        job.result.width = source.Width();
+        job.result.height = source.Height();
+        if (!EncodeImage(source, options_.format, &job.result.data, options_.encode)) return false;
+        // Only the bytes go on to the store queue; the frame can be freed
+        job.view.Reset();
+        job.resized.Reset();
+        job.frame.reset();
+        store_.Push(std::move(job));
+        return true;
+    }
+
+    bool Store(ElementJob& job) {
+        if (options_.store && !options_.store(job.result)) return false;
+        FinishElement(job.request, job.sequence, true);
+        return true;
+    }
+
+    void DiscardFrame(FrameJob& job) {
+        for (PendingElement& element : job.elements) FinishElement(element.request, element.sequence, false);
+        job.elements.clear();
+        FinishFrame(job, false);
+    }
+
+    void FinishFrame(const FrameJob& job, bool cropped) {
+        frame_keys_.End(job.key, job.sequence, cropped);
+        Release();
+    }
+
+    void FinishElement(CaptureRequest& request, uint64_t sequence, bool stored) {
+        element_keys_.End(request.key, sequence, stored);
+        if (request.done) request.done(stored);
+        Release();
+    }
+
+    void Release() {
+        std::lock_guard<std::mutex> lock(outstanding_mutex_);
+        if (--outstanding_ == 0) idle_.notify_all();
+    }
+
+    CapturePipelineOptions options_;
+    std::atomic<bool> accepting_{true};
+    KeyTracker frame_keys_;
+    KeyTracker element_keys_;
+
+    std::mutex outstanding_mutex_;
+    std::condition_variable idle_;
+    size_t outstanding_ = 0;    // Frames and elements not yet stored or given up
+
+    Stage<FrameJob> capture_;
+    Stage<FrameJob> crop_;
+    Stage<ElementJob> resize_;
+    Stage<ElementJob> encode_;
+    Stage<ElementJob> store_;
+};
+
+CapturePipeline::CapturePipeline(CapturePipelineOptions options) : impl_(std::make_unique<Impl>(std::move(options))) {}
+CapturePipeline::~CapturePipeline() = default;
+
+bool CapturePipeline::Submit(const std::string& frame_key, FrameCapture capture, std::vector<CaptureRequest> requests) {
+    return impl_->Submit(frame_key, std::move(capture), nullptr, std::move(requests));
+}
+
+bool CapturePipeline::SubmitFrame(const std::string& frame_key, std::shared_ptr<const Bitmap> frame,
+                                  std::vector<CaptureRequest> requests) {
+    if (frame && frame->IsEmpty()) frame.reset();
+    if (!frame) {
+        // Nothing to crop; every request hears back at once
+        for (CaptureRequest& request : requests) {
+            if (request.done) request.done(false);
+        }
+        return false;
+    }
+    return impl_->Submit(frame_key, nullptr, std::move(frame), std::move(requests));
+}
+
+void CapturePipeline::Drain() {
+    impl_->Drain();
+}
+
+void CapturePipeline::Shutdown() {
+    impl_->Shutdown();
+}
+
+PipelineStageStats CapturePipeline::GetStats(PipelineStage stage) const {
+    return impl_->GetStats(stage);
+}
+
+} // namespace navigrab
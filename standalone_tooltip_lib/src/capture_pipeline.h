@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "bitmap.h"
+#include "dom.h"
+#include "image_codec.h"
+#include "metrics.h"
+
+namespace navigrab {
+
+// Stages a screenshot passes through, in order. Capture renders or grabs a
+// frame, crop takes each element as a view of it, resize fits the view to
+// its thumbnail bounds, encode compresses it and store hands the bytes on.
+enum class PipelineStage {
+    CAPTURE,
+    CROP,
+    RESIZE,
+    ENCODE,
+    STORE
+};
+
+constexpr size_t kPipelineStageCount = 5;
+
+const char* PipelineStageName(PipelineStage stage);
+
+// What a full stage queue does with one more job
+enum class OverflowPolicy {
+    BLOCK,          // The producer waits for room, so backpressure reaches it
+    DROP_NEWEST,    // The new job is dropped
+    DROP_OLDEST     // The oldest queued job is dropped to make room
+};
+
+struct PipelineStageOptions {
+    size_t workers = 1;
+    size_t queue_capacity = 64;
+    OverflowPolicy overflow = OverflowPolicy::BLOCK;
+};
+
+struct PipelineStageStats {
+    size_t queue_depth = 0;
+    size_t max_queue_depth = 0;
+    size_t busy_workers = 0;
+    uint64_t processed = 0;
+    uint64_t failed = 0;
+    uint64_t dropped = 0;       // Turned away or evicted by a full queue
+    uint64_t coalesced = 0;     // Replaced in the queue by newer work for the same key
+    uint64_t stale = 0;         // Skipped because newer work for the key was submitted
+    LatencySnapshot queue_latency;
+    LatencySnapshot run_latency;
+};
+
+// One element to take from a frame to storage
+struct CaptureRequest {
+    std::string key;            // Names the element; empty never coalesces or goes stale
+    dom::Box rect{0, 0, 0, 0};  // Frame coordinates, clipped to it; empty takes the whole frame
+    int max_width = 0;          // Thumbnail bounds, aspect kept; 0 leaves that side as is
+    int max_height = 0;
+    std::string destination;    // Passed through to the store, e.g. a file name
+    // Runs on a store worker once the element is stored, or wherever it was
+    // given up (false), so every request hears back exactly once
+    std::function<void(bool stored)> done;
+};
+
+struct CaptureResult {
+    std::string key;
+    std::string destination;
+    ImageFormat format = ImageFormat::PNG;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> data;
+};
+
+struct CapturePipelineOptions {
+    std::array<PipelineStageOptions, kPipelineStageCount> stages;
+    ImageFormat format = ImageFormat::PNG;
+    EncodeOptions encode;       // max_threads is forced to 1; stages give the parallelism
+    // Called on store workers; false counts the element as failed
+    std::function<bool(const CaptureResult&)> store;
+};
+
+// Renders or grabs a frame; runs on a capture worker
+using FrameCapture = std::function<bool(Bitmap* frame)>;
+
+// Multi-stage screenshot pipeline. Each stage has its own workers and a
+// bounded queue, so a slow encoder holds back cropping rather than piling
+// up frames, and throughput grows with the workers given to the stage that
+// limits it. A frame is captured once and every element cropped from it is
+// a view of its pixels until it is resized or encoded.
+//
+// Work carries a key. Queuing a job whose key is already waiting replaces
+// the waiting one, and a job whose key has been submitted again since is
+// dropped at the next stage it reaches, so a page that keeps changing
+// costs one capture of its latest state rather than a backlog. Thread-safe.
+class CapturePipeline {
+public:
+    explicit CapturePipeline(CapturePipelineOptions options);
+    ~CapturePipeline();     // Shutdown()
+
+    CapturePipeline(const CapturePipeline&) = delete;
+    CapturePipeline& operator=(const CapturePipeline&) = delete;
+
+    // Queues a frame to capture and the elements to take from it. |frame_key|
+    // coalesces frames as element keys do elements. Returns false if the
+    // capture queue turned the frame away; its requests then hear false.
+    // Waits for room only under OverflowPolicy::BLOCK, so a UI thread should
+    // give the capture stage a drop policy.
+    bool Submit(const std::string& frame_key, FrameCapture capture, std::vector<CaptureRequest> requests);
+    // Same, for a frame captured already; it starts at the crop stage
+    bool SubmitFrame(const std::string& frame_key, std::shared_ptr<const Bitmap> frame,
+                     std::vector<CaptureRequest> requests);
+
+    // Waits until everything submitted so far has been stored or given up
+    // and every stage is idle, so GetStats() then counts all of it
+    void Drain();
+    // Gives up queued work and stops the workers. Later submissions fail.
+    void Shutdown();
+
+    PipelineStageStats GetStats(PipelineStage stage) const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace navigrab
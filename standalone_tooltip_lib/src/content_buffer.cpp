@@ -0,0 +1,41 @@
+#include "content_buffer.h"
+#include <algorithm>
+#include <functional>
+
+namespace navigrab {
+
+ContentBuffer::ContentBuffer(std::string text) {
+    if (text.empty()) return;
+    auto storage = std::make_shared<const std::string>(std::move(text));
+    data_ = storage->data();
+    size_ = storage->size();
+    owner_ = std::move(storage);
+}
+
+ContentBuffer::ContentBuffer(std::shared_ptr<const void> owner, std::string_view view) {
+    if (!owner || view.empty()) return;
+    owner_ = std::move(owner);
+    data_ = view.data();
+    size_ = view.size();
+}
+
+ContentBuffer ContentBuffer::Slice(size_t offset, size_t length) const {
+    offset = std::min(offset, size_);
+    return SliceOf(std::string_view(data_ + offset, std::min(length, size_ - offset)));
+}
+
+ContentBuffer ContentBuffer::SliceOf(std::string_view part) const {
+    // std::less gives a total order even for pointers into different objects
+    std::less<const char*> before;
+    if (part.empty() || before(part.data(), data_) ||
+        before(data_ + size_, part.data() + part.size())) {
+        return ContentBuffer();
+    }
+    return ContentBuffer(owner_, part);
+}
+
+bool ContentBuffer::SharesStorageWith(const ContentBuffer& other) const {
+    return owner_ && !owner_.owner_before(other.owner_) && !other.owner_.owner_before(owner_);
+}
+
+} // namespace navigrab
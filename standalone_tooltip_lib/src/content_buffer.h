@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+
+namespace navigrab {
+
+// Immutable, reference-counted bytes: a page body, or a run of text taken
+// from a parsed document. Copies and slices share the storage, so content can
+// be handed to the scraper, prompt builders and storage for the cost of a
+// reference count. The storage is released with the last buffer viewing it.
+class ContentBuffer {
+public:
+    ContentBuffer() = default;
+
+    // Takes over |text| without copying its bytes
+    explicit ContentBuffer(std::string text);
+
+    // Views |view|, which must stay valid for as long as |owner| is alive
+    ContentBuffer(std::shared_ptr<const void> owner, std::string_view view);
+
+    std::string_view View() const { return std::string_view(data_, size_); }
+    const char* Data() const { return data_; }
+    size_t Size() const { return size_; }
+    bool IsEmpty() const { return size_ == 0; }
+
+    // Copies out, for APIs that need their own string
+    std::string ToString() const { return std::string(data_, size_); }
+
+    // Part of this buffer, sharing its storage. Out-of-range requests are clamped.
+    ContentBuffer Slice(size_t offset, size_t length = std::string_view::npos) const;
+
+    // Buffer for |part|, which must point into View(); empty otherwise
+    ContentBuffer SliceOf(std::string_view part) const;
+
+    // True when both buffers keep the same storage alive
+    bool SharesStorageWith(const ContentBuffer& other) const;
+
+private:
+    std::shared_ptr<const void> owner_;
+    const char* data_ = "";
+    size_t size_ = 0;
+};
+
+} // namespace navigrab
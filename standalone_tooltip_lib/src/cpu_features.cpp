@@ -0,0 +1,49 @@
+#include "cpu_features.h"
+
+#if NAVIGRAB_X86 && defined(_MSC_VER) && !defined(__clang__)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace navigrab {
+
+SimdLevel DetectSimdLevel() {
+    static const SimdLevel level = [] {
+#if NAVIGRAB_X86
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        int max_leaf = info[0];
+        __cpuid(info, 1);
+        bool os_avx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        if (os_avx && max_leaf >= 7) {
+            __cpuidex(info, 7, 0);
+            if (info[1] & (1 << 5)) return SimdLevel::AVX2;
+        }
+        return SimdLevel::SSE2;
+#else
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+        if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+        return SimdLevel::SCALAR;
+#endif
+#else
+        return SimdLevel::SCALAR;
+#endif
+    }();
+    return level;
+}
+
+const char* SimdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::SCALAR:
+            return "scalar";
+        case SimdLevel::SSE2:
+            return "sse2";
+        case SimdLevel::AVX2:
+            return "avx2";
+    }
+    return "unknown";
+}
+
+} // namespace navigrab
@@ -0,0 +1,29 @@
+#pragma once
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define NAVIGRAB_X86 1
+#else
+#define NAVIGRAB_X86 0
+#endif
+
+// Lets one translation unit carry AVX2 code without building it all for AVX2
+#if NAVIGRAB_X86 && (defined(__GNUC__) || defined(__clang__))
+#define NAVIGRAB_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define NAVIGRAB_TARGET_AVX2
+#endif
+
+namespace navigrab {
+
+// Instruction sets the SIMD kernels can use, in increasing order
+enum class SimdLevel {
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// Best level this CPU supports (checked once)
+SimdLevel DetectSimdLevel();
+const char* SimdLevelName(SimdLevel level);
+
+} // namespace navigrab
@@ -0,0 +1,935 @@
+#include "deflate.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstring>
+
+namespace navigrab {
+
+namespace {
+
+constexpr uint32_t kAdlerModulus = 65521;
+// Most bytes Adler-32 can sum before its 32-bit halves could overflow
+constexpr size_t kAdlerBlock = 5552;
+
+// Slice-by-8 tables: entry [k][n] advances byte n through k further zero bytes
+struct Crc32Tables {
+    uint32_t values[8][256];
+    Crc32Tables() {
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            values[0][n] = c;
+        }
+        for (int k = 1; k < 8; ++k) {
+            for (int n = 0; n < 256; ++n) values[k][n] = (values[k - 1][n] >> 8) ^ values[0][values[k - 1][n] & 0xFF];
+        }
+    }
+};
+
+uint32_t LoadLittleEndian32(const uint8_t* data) {
+    return uint32_t{data[0]} | (uint32_t{data[1]} << 8) | (uint32_t{data[2]} << 16) | (uint32_t{data[3]} << 24);
+}
+
+void AppendBigEndian(std::vector<uint8_t>* out, uint32_t value) {
+    out->push_back(static_cast<uint8_t>(value >> 24));
+    out->push_back(static_cast<uint8_t>(value >> 16));
+    out->push_back(static_cast<uint8_t>(value >> 8));
+    out->push_back(static_cast<uint8_t>(value));
+}
+
+// LSB-first bit reader for deflate. Reads past the end yield zero bits and
+// are counted, so a truncated stream fails instead of reading out of bounds.
+class BitReader {
+public:
+    BitReader(const uint8_t* data, size_t size) : data_(data), size_(size) {}
+
+    uint32_t Peek(int count) {
+        Refill();
+        return static_cast<uint32_t>(buffer_ & ((uint64_t{1} << count) - 1));
+    }
+    void Drop(int count) {
+        buffer_ >>= count;
+        bits_ -= count;
+    }
+    uint32_t Read(int count) {
+        uint32_t value = Peek(count);
+        Drop(count);
+        return value;
+    }
+    void AlignToByte() { Drop(bits_ % 8); }
+
+    // Copies |count| whole bytes after AlignToByte()
+    bool ReadBytes(uint8_t* out, size_t count) {
+        while (count > 0 && bits_ >= 8) {
+            *out++ = static_cast<uint8_t>(Read(8));
+            --count;
+        }
+        if (count == 0) return true;
+        if (count > size_ - position_) return false;
+        std::memcpy(out, data_ + position_, count);
+        position_ += count;
+        return true;
+    }
+    bool Overrun() const { return padding_bits_ > bits_; }
+
+private:
+    void Refill() {
+        while (bits_ <= 56) {
+            uint64_t byte = 0;
+            if (position_ < size_) {
+                byte = data_[position_++];
+            } else {
+                padding_bits_ += 8;
+            }
+            buffer_ |= byte << bits_;
+            bits_ += 8;
+        }
+    }
+
+    const uint8_t* data_;
+    size_t size_;
+    size_t position_ = 0;
+    uint64_t buffer_ = 0;
+    int bits_ = 0;
+    int padding_bits_ = 0;
+};
+
+// Canonical Huffman decoder: a table for codes up to kFastBits long, and a
+// count-based walk for the rare longer ones.
+class Huffman {
+public:
+    static constexpr int kFastBits = 9;
+    static constexpr int kMaxBits = 15;
+
+    bool Build(const uint8_t* lengths, int count) {
+        std::memset(counts_, 0, sizeof(counts_));
+        std::memset(fast_, 0, sizeof(fast_));
+        for (int i = 0; i < count; ++i) counts_[lengths[i]]++;
+        counts_[0] = 0;
+        int left = 1;
+        for (int length = 1; length <= kMaxBits; ++length) {
+            left = (left << 1) - counts_[length];
+            if (left < 0) return false;     // Over-subscribed
+        }
+        uint16_t offsets[kMaxBits + 2];
+        offsets[1] = 0;
+        for (int length = 1; length <= kMaxBits; ++length) offsets[length + 1] = offsets[length] + counts_[length];
+        for (int i = 0; i < count; ++i) {
+            if (lengths[i]) symbols_[offsets[lengths[i]]++] = static_cast<uint16_t>(i);
+        }
+
+        int code = 0;
+        int index = 0;
+        for (int length = 1; length <= kFastBits; ++length) {
+            for (int i = 0; i < counts_[length]; ++i, ++code, ++index) {
+                int reversed = 0;
+                for (int bit = 0; bit < length; ++bit) reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+                uint16_t entry = static_cast<uint16_t>(symbols_[index] << 4 | length);
+                for (int slot = reversed; slot < (1 << kFastBits); slot += 1 << length) fast_[slot] = entry;
+            }
+            code <<= 1;
+        }
+        return true;
+    }
+
+    // Next symbol, or -1 for an invalid code
+    int Decode(BitReader* reader) const {
+        uint32_t bits = reader->Peek(kMaxBits);
+        uint16_t entry = fast_[bits & ((1u << kFastBits) - 1)];
+        if (entry) {
+            reader->Drop(entry & 15);
+            return entry >> 4;
+        }
+        int code = 0;
+        int first = 0;
+        int index = 0;
+        for (int length = 1; length <= kMaxBits; ++length) {
+            code |= (bits >> (length - 1)) & 1;
+            int count = counts_[length];
+            if (code - first < count) {
+                reader->Drop(length);
+                return symbols_[index + code - first];
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+        return -1;
+    }
+
+private:
+    uint16_t counts_[kMaxBits + 1];
+    uint16_t symbols_[288];
+    uint16_t fast_[1 << kFastBits];
+};
+
+const uint16_t kLengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                  35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+const uint8_t kLengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                  3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+const uint16_t kDistanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129,
+                                    193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097,
+                                    6145, 8193, 12289, 16385, 24577};
+const uint8_t kDistanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6,
+                                    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+bool InflateCodes(BitReader* reader, const Huffman& literals, const Huffman& distances,
+                  std::vector<uint8_t>* out, size_t limit) {
+    for (;;) {
+        int symbol = literals.Decode(reader);
+        if (symbol < 0 || reader->Overrun()) return false;
+        if (symbol < 256) {
+            if (out->size() >= limit) return false;
+            out->push_back(static_cast<uint8_t>(symbol));
+            continue;
+        }
+        if (symbol == 256) return true;
+        symbol -= 257;
+        if (symbol >= 29) return false;
+        size_t length = kLengthBase[symbol] + reader->Read(kLengthExtra[symbol]);
+        int distance_symbol = distances.Decode(reader);
+        if (distance_symbol < 0 || distance_symbol >= 30) return false;
+        size_t distance = kDistanceBase[distance_symbol] + reader->Read(kDistanceExtra[distance_symbol]);
+        if (distance > out->size() || out->size() + length > limit) return false;
+        size_t from = out->size() - distance;
+        for (size_t i = 0; i < length; ++i) out->push_back((*out)[from + i]);
+    }
+}
+
+// Inflates a zlib stream into |out|, failing if it would exceed |limit| bytes
+bool Inflate(const uint8_t* data, size_t size, size_t limit, std::vector<uint8_t>* out) {
+    if (size < 2 || (data[0] & 0x0F) != 8 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20)) {
+        return false;
+    }
+    out->clear();
+    out->reserve(limit);
+    BitReader reader(data + 2, size - 2);
+    Huffman literals;
+    Huffman distances;
+    bool last = false;
+    while (!last) {
+        last = reader.Read(1);
+        uint32_t type = reader.Read(2);
+        if (type == 0) {
+            reader.AlignToByte();
+            uint32_t length = reader.Read(16);
+            uint32_t inverse = reader.Read(16);
+            if ((length ^ 0xFFFF) != inverse || out->size() + length > limit) return false;
+            size_t start = out->size();
+            out->resize(start + length);
+            if (!reader.ReadBytes(out->data() + start, length)) return false;
+        } else if (type == 1) {
+            uint8_t lengths[288 + 30];
+            std::fill(lengths, lengths + 144, 8);
+            std::fill(lengths + 144, lengths + 256, 9);
+            std::fill(lengths + 256, lengths + 280, 7);
+            std::fill(lengths + 280, lengths + 288, 8);
+            std::fill(lengths + 288, lengths + 318, 5);
+            literals.Build(lengths, 288);
+            distances.Build(lengths + 288, 30);
+            if (!InflateCodes(&reader, literals, distances, out, limit)) return false;
+        } else if (type == 2) {
+            int literal_count = static_cast<int>(reader.Read(5)) + 257;
+            int distance_count = static_cast<int>(reader.Read(5)) + 1;
+            int code_count = static_cast<int>(reader.Read(4)) + 4;
+            static const uint8_t kOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+            uint8_t code_lengths[19] = {};
+            for (int i = 0; i < code_count; ++i) code_lengths[kOrder[i]] = static_cast<uint8_t>(reader.Read(3));
+            Huffman lengths_code;
+            if (!lengths_code.Build(code_lengths, 19)) return false;
+            uint8_t lengths[288 + 32] = {};
+            int total = literal_count + distance_count;
+            for (int i = 0; i < total;) {
+                int symbol = lengths_code.Decode(&reader);
+                if (symbol < 0 || reader.Overrun()) return false;
+                if (symbol < 16) {
+                    lengths[i++] = static_cast<uint8_t>(symbol);
+                    continue;
+                }
+                uint8_t repeat_value = 0;
+                int repeat = 0;
+                if (symbol == 16) {
+                    if (i == 0) return false;
+                    repeat_value = lengths[i - 1];
+                    repeat = 3 + static_cast<int>(reader.Read(2));
+                } else if (symbol == 17) {
+                    repeat = 3 + static_cast<int>(reader.Read(3));
+                } else {
+                    repeat = 11 + static_cast<int>(reader.Read(7));
+                }
+                if (i + repeat > total) return false;
+                while (repeat--) lengths[i++] = repeat_value;
+            }
+            if (lengths[256] == 0) return false;    // No end-of-block code
+            if (!literals.Build(lengths, literal_count) ||
+                !distances.Build(lengths + literal_count, distance_count) ||
+                !InflateCodes(&reader, literals, distances, out, limit)) {
+                return false;
+            }
+        } else {
+            return false;
+        }
+        if (reader.Overrun()) return false;
+    }
+    // The stream ends with the Adler-32 of the data, most significant byte first
+    reader.AlignToByte();
+    uint32_t adler = 0;
+    for (int i = 0; i < 4; ++i) adler = adler << 8 | reader.Read(8);
+    return !reader.Overrun() && adler == Adler32(1, out->data(), out->size());
+}
+
+constexpr int kWindowSize = 32768;
+constexpr int kMinMatch = 4;    // Deflate allows 3, but 4-byte matches rarely pay for their codes
+constexpr int kMaxMatch = 258;
+constexpr int kHashBits = 15;
+constexpr size_t kBlockTokens = 32768;
+constexpr size_t kMaxStoredBlock = 65535;
+// Large inputs are cut at fixed offsets whatever the thread count, so the
+// output is the same on every machine. Chunks stay big enough that priming
+// each with the previous window is cheap next to compressing it.
+constexpr size_t kChunkBytes = 256 * 1024;
+
+// Per-level effort: hash chain candidates tried, match length that ends the
+// search, longest match whose positions still go into the hash, and lazy
+// matching (defer a match by a byte when the next one is longer)
+struct LevelConfig {
+    int max_chain;
+    int nice_length;
+    int max_insert;
+    bool lazy;
+};
+
+const LevelConfig kLevels[10] = {
+    {0, 0, 0, false},
+    {4, 16, 8, false},
+    {8, 32, 16, false},
+    {16, 64, 32, false},
+    {16, 64, 32, true},
+    {32, 128, 64, true},
+    {64, 258, 128, true},
+    {128, 258, kMaxMatch, true},
+    {512, 258, kMaxMatch, true},
+    {2048, 258, kMaxMatch, true},
+};
+
+constexpr int kLiteralCodes = 286;
+constexpr int kDistanceCodes = 30;
+constexpr int kEndOfBlock = 256;
+const uint8_t kCodeLengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+// Match length -> length code - 257; distance - 1 -> distance code, split
+// like zlib's: values under 256 directly, larger ones by their top bits
+struct SymbolTables {
+    uint8_t length_code[kMaxMatch + 1];
+    uint8_t distance_code[512];
+    SymbolTables() {
+        for (int code = 0; code < 29; ++code) {
+            for (int length = kLengthBase[code]; length < kLengthBase[code] + (1 << kLengthExtra[code]); ++length) {
+                if (length <= kMaxMatch) length_code[length] = static_cast<uint8_t>(code);
+            }
+        }
+        for (int code = 0; code < kDistanceCodes; ++code) {
+            for (int d = kDistanceBase[code] - 1; d < kDistanceBase[code] - 1 + (1 << kDistanceExtra[code]); ++d) {
+                distance_code[d < 256 ? d : 256 + (d >> 7)] = static_cast<uint8_t>(code);
+            }
+        }
+    }
+    int DistanceCode(int distance) const {
+        int d = distance - 1;
+        return distance_code[d < 256 ? d : 256 + (d >> 7)];
+    }
+};
+
+const SymbolTables& Symbols() {
+    static const SymbolTables tables;
+    return tables;
+}
+
+// LSB-first bit writer for deflate
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>* out) : out_(out) {}
+
+    void Write(uint32_t value, int count) {
+        buffer_ |= uint64_t{value} << count_;
+        count_ += count;
+        if (count_ >= 32) {
+            size_t size = out_->size();
+            out_->resize(size + 4);
+            uint8_t* bytes = out_->data() + size;
+            for (int i = 0; i < 4; ++i) bytes[i] = static_cast<uint8_t>(buffer_ >> (8 * i));
+            buffer_ >>= 32;
+            count_ -= 32;
+        }
+    }
+
+    // Pads with zero bits to a byte boundary and emits everything pending
+    void Flush() {
+        for (; count_ > 0; count_ -= 8) {
+            out_->push_back(static_cast<uint8_t>(buffer_));
+            buffer_ >>= 8;
+        }
+        buffer_ = 0;
+        count_ = 0;
+    }
+
+    std::vector<uint8_t>* out() const { return out_; }
+
+private:
+    std::vector<uint8_t>* out_;
+    uint64_t buffer_ = 0;
+    int count_ = 0;
+};
+
+// Huffman code lengths for |freqs|, no longer than |limit|. Builds the
+// optimal tree with two queues over the sorted leaves, then pushes leaves
+// above the limit up the way JPEG's Annex K.3 does, keeping the code
+// complete. A lone symbol gets length 1.
+void BuildCodeLengths(const uint32_t* freqs, int count, int limit, uint8_t* lengths) {
+    std::fill(lengths, lengths + count, 0);
+    int symbols[kLiteralCodes];
+    int used = 0;
+    for (int i = 0; i < count; ++i) {
+        if (freqs[i]) symbols[used++] = i;
+    }
+    if (used == 0) return;
+    if (used == 1) {
+        lengths[symbols[0]] = 1;
+        return;
+    }
+    std::sort(symbols, symbols + used, [freqs](int a, int b) {
+        return freqs[a] != freqs[b] ? freqs[a] < freqs[b] : a < b;
+    });
+
+    uint64_t weights[2 * kLiteralCodes];
+    int parents[2 * kLiteralCodes];
+    for (int i = 0; i < used; ++i) weights[i] = freqs[symbols[i]];
+    int leaf = 0;
+    int node = used;
+    int nodes = used;
+    auto take = [&]() {
+        if (leaf < used && (node == nodes || weights[leaf] <= weights[node])) return leaf++;
+        return node++;
+    };
+    while (nodes < 2 * used - 1) {
+        int a = take();
+        int b = take();
+        weights[nodes] = weights[a] + weights[b];
+        parents[a] = parents[b] = nodes;
+        ++nodes;
+    }
+
+    // Parents always come after their children, so one backward pass sets depths
+    int depths[2 * kLiteralCodes];
+    int length_counts[2 * kLiteralCodes] = {};
+    int max_length = 0;
+    depths[nodes - 1] = 0;
+    for (int i = nodes - 2; i >= 0; --i) depths[i] = depths[parents[i]] + 1;
+    for (int i = 0; i < used; ++i) {
+        length_counts[depths[i]]++;
+        max_length = std::max(max_length, depths[i]);
+    }
+    for (int length = max_length; length > limit; --length) {
+        while (length_counts[length] > 0) {
+            int shorter = length - 2;
+            while (length_counts[shorter] == 0) --shorter;
+            length_counts[length] -= 2;
+            length_counts[length - 1] += 1;
+            length_counts[shorter + 1] += 2;
+            length_counts[shorter] -= 1;
+        }
+    }
+
+    // Shortest codes to the most frequent symbols
+    int index = used - 1;
+    for (int length = 1; length <= std::min(max_length, limit); ++length) {
+        for (int n = length_counts[length]; n > 0; --n) lengths[symbols[index--]] = static_cast<uint8_t>(length);
+    }
+}
+
+// Canonical codes for |lengths|, bit-reversed for the LSB-first writer
+void BuildCodes(const uint8_t* lengths, int count, uint16_t* codes) {
+    int length_counts[16] = {};
+    for (int i = 0; i < count; ++i) length_counts[lengths[i]]++;
+    length_counts[0] = 0;
+    int next[16] = {};
+    for (int length = 1, code = 0; length < 16; ++length) {
+        code = (code + length_counts[length - 1]) << 1;
+        next[length] = code;
+    }
+    for (int i = 0; i < count; ++i) {
+        int length = lengths[i];
+        if (length == 0) continue;
+        int code = next[length]++;
+        int reversed = 0;
+        for (int bit = 0; bit < length; ++bit) reversed |= ((code >> bit) & 1) << (length - 1 - bit);
+        codes[i] = static_cast<uint16_t>(reversed);
+    }
+}
+
+// Literal or match found by the parser; |distance| 0 marks a literal
+struct Token {
+    uint16_t value;
+    uint16_t distance;
+};
+
+// Hash tables and token buffer, kept per thread across calls
+struct DeflateScratch {
+    std::vector<int32_t> head = std::vector<int32_t>(size_t{1} << kHashBits);
+    std::vector<int32_t> prev = std::vector<int32_t>(kWindowSize);
+    std::vector<Token> tokens;
+};
+
+// Compresses one chunk as a run of deflate blocks. Positions are relative to
+// the start of the priming window, so the chain tables never need rebasing.
+class ChunkDeflater {
+public:
+    ChunkDeflater(const LevelConfig& config, DeflateScratch* scratch, std::vector<uint8_t>* out)
+        : config_(config), scratch_(scratch), writer_(out) {
+        scratch_->tokens.reserve(kBlockTokens);
+    }
+
+    // Deflates data[begin, end). The last chunk carries BFINAL; others end
+    // with an empty stored block so the next chunk starts byte aligned.
+    void Compress(const uint8_t* data, size_t begin, size_t end, bool last) {
+        size_t history = std::min<size_t>(begin, kWindowSize);
+        base_ = data + begin - history;
+        stop_ = static_cast<int32_t>(history + end - begin);
+        std::fill(scratch_->head.begin(), scratch_->head.end(), -1);
+        int32_t pos = static_cast<int32_t>(history);
+        for (int32_t p = 0; p < pos && p + kMinMatch <= stop_; ++p) Insert(p);
+        block_start_ = pos;
+        ResetBlock();
+
+        const bool lazy = config_.lazy;
+        while (pos < stop_) {
+            if (stop_ - pos < kMinMatch) {
+                AddLiteral(base_[pos++]);
+                continue;
+            }
+            int length = 0;
+            int distance = 0;
+            FindMatch(pos, &length, &distance);
+            Insert(pos);
+            int32_t hashed = pos + 1;
+            if (lazy && length >= kMinMatch && length < config_.nice_length && pos + 1 + kMinMatch <= stop_) {
+                int next_length = 0;
+                int next_distance = 0;
+                FindMatch(pos + 1, &next_length, &next_distance);
+                Insert(pos + 1);
+                hashed = pos + 2;
+                if (next_length > length) {
+                    AddLiteral(base_[pos++]);
+                    length = next_length;
+                    distance = next_distance;
+                }
+            }
+            if (length >= kMinMatch) {
+                AddMatch(length, distance);
+                int32_t match_end = pos + length;
+                if (length <= config_.max_insert) {
+                    for (int32_t p = hashed; p < match_end && p + kMinMatch <= stop_; ++p) Insert(p);
+                }
+                pos = match_end;
+            } else {
+                AddLiteral(base_[pos++]);
+            }
+            if (scratch_->tokens.size() >= kBlockTokens) FlushBlock(pos, false);
+        }
+        FlushBlock(pos, last);
+        if (!last) {
+            writer_.Write(0, 3);    // Empty stored block, BFINAL clear
+            writer_.Flush();
+            const uint8_t kEmptyStored[4] = {0x00, 0x00, 0xFF, 0xFF};
+            writer_.out()->insert(writer_.out()->end(), kEmptyStored, kEmptyStored + 4);
+        } else {
+            writer_.Flush();
+        }
+    }
+
+private:
+    uint32_t Hash(int32_t pos) const {
+        return (LoadLittleEndian32(base_ + pos) * 2654435761u) >> (32 - kHashBits);
+    }
+
+    void Insert(int32_t pos) {
+        int32_t& head = scratch_->head[Hash(pos)];
+        scratch_->prev[pos & (kWindowSize - 1)] = head;
+        head = pos;
+    }
+
+    // Longest match for |pos| among earlier positions with its hash. Chain
+    // links are only trusted while they point backwards and into the window;
+    // leftovers from earlier chunks fail the byte comparison.
+    void FindMatch(int32_t pos, int* length, int* distance) const {
+        const uint8_t* current = base_ + pos;
+        const int max_length = std::min<int32_t>(kMaxMatch, stop_ - pos);
+        const int32_t oldest = pos - kWindowSize;
+        const uint32_t prefix = LoadLittleEndian32(current);
+        int best = kMinMatch - 1;
+        int chain = config_.max_chain;
+        int32_t candidate = scratch_->head[Hash(pos)];
+        while (candidate >= 0 && candidate >= oldest && chain-- > 0) {
+            const uint8_t* match = base_ + candidate;
+            if (match[best] == current[best] && LoadLittleEndian32(match) == prefix) {
+                int n = kMinMatch + MatchLength(match + kMinMatch, current + kMinMatch, max_length - kMinMatch);
+                if (n > best) {
+                    best = n;
+                    *distance = pos - candidate;
+                    if (n >= config_.nice_length || n >= max_length) break;
+                }
+            }
+            int32_t next = scratch_->prev[candidate & (kWindowSize - 1)];
+            if (next >= candidate) break;
+            candidate = next;
+        }
+        *length = best >= kMinMatch ? best : 0;
+    }
+
+    static int MatchLength(const uint8_t* a, const uint8_t* b, int max) {
+        int n = 0;
+        for (; n + 8 <= max; n += 8) {
+            uint64_t x;
+            uint64_t y;
+            std::memcpy(&x, a + n, 8);
+            std::memcpy(&y, b + n, 8);
+            if (x != y) {
+                while (a[n] == b[n]) ++n;
+                return n;
+            }
+        }
+        while (n < max && a[n] == b[n]) ++n;
+        return n;
+    }
+
+    void ResetBlock() {
+        scratch_->tokens.clear();
+        std::fill(literal_freqs_, literal_freqs_ + kLiteralCodes, 0);
+        std::fill(distance_freqs_, distance_freqs_ + kDistanceCodes, 0);
+        extra_bits_ = 0;
+    }
+
+    void AddLiteral(uint8_t value) {
+        scratch_->tokens.push_back({value, 0});
+        literal_freqs_[value]++;
+    }
+
+    void AddMatch(int length, int distance) {
+        scratch_->tokens.push_back({static_cast<uint16_t>(length), static_cast<uint16_t>(distance)});
+        int length_code = Symbols().length_code[length];
+        int distance_code = Symbols().DistanceCode(distance);
+        literal_freqs_[257 + length_code]++;
+        distance_freqs_[distance_code]++;
+        extra_bits_ += kLengthExtra[length_code] + kDistanceExtra[distance_code];
+    }
+
+    // Writes the tokens since the last block as dynamic Huffman, or stored
+    // when that would be smaller (noise, tiny blocks)
+    void FlushBlock(int32_t pos, bool final) {
+        literal_freqs_[kEndOfBlock]++;
+        uint8_t literal_lengths[kLiteralCodes];
+        uint8_t distance_lengths[kDistanceCodes];
+        BuildCodeLengths(literal_freqs_, kLiteralCodes, 15, literal_lengths);
+        BuildCodeLengths(distance_freqs_, kDistanceCodes, 15, distance_lengths);
+        if (std::all_of(distance_lengths, distance_lengths + kDistanceCodes, [](uint8_t l) { return l == 0; })) {
+            distance_lengths[0] = 1;    // Decoders expect at least one distance code
+        }
+        int literal_count = kLiteralCodes;
+        while (literal_count > 257 && literal_lengths[literal_count - 1] == 0) --literal_count;
+        int distance_count = kDistanceCodes;
+        while (distance_count > 1 && distance_lengths[distance_count - 1] == 0) --distance_count;
+
+        // Run-length code both length sets as one sequence (symbols 16-18)
+        uint8_t all_lengths[kLiteralCodes + kDistanceCodes];
+        std::copy(literal_lengths, literal_lengths + literal_count, all_lengths);
+        std::copy(distance_lengths, distance_lengths + distance_count, all_lengths + literal_count);
+        int total = literal_count + distance_count;
+        uint8_t rle_symbols[kLiteralCodes + kDistanceCodes];
+        uint8_t rle_extra[kLiteralCodes + kDistanceCodes];
+        int rle_count = 0;
+        uint32_t code_length_freqs[19] = {};
+        auto emit = [&](int symbol, int extra) {
+            rle_symbols[rle_count] = static_cast<uint8_t>(symbol);
+            rle_extra[rle_count++] = static_cast<uint8_t>(extra);
+            code_length_freqs[symbol]++;
+        };
+        for (int i = 0; i < total;) {
+            uint8_t value = all_lengths[i];
+            int run = 1;
+            while (i + run < total && all_lengths[i + run] == value) ++run;
+            i += run;
+            if (value == 0) {
+                for (; run >= 11; run -= std::min(run, 138)) emit(18, std::min(run, 138) - 11);
+                if (run >= 3) {
+                    emit(17, run - 3);
+                    run = 0;
+                }
+            } else {
+                emit(value, 0);
+                --run;
+                for (; run >= 3; run -= std::min(run, 6)) emit(16, std::min(run, 6) - 3);
+            }
+            while (run-- > 0) emit(value, 0);
+        }
+        uint8_t code_length_lengths[19];
+        BuildCodeLengths(code_length_freqs, 19, 7, code_length_lengths);
+        // The code length code must be complete, so a lone symbol gets a partner
+        if (std::count_if(code_length_lengths, code_length_lengths + 19, [](uint8_t l) { return l != 0; }) == 1) {
+            code_length_lengths[code_length_lengths[0] ? 1 : 0] = 1;
+        }
+        int code_length_count = 19;
+        while (code_length_count > 4 && code_length_lengths[kCodeLengthOrder[code_length_count - 1]] == 0) {
+            --code_length_count;
+        }
+
+        uint64_t dynamic_bits = 3 + 14 + 3 * code_length_count + extra_bits_;
+        for (int i = 0; i < 19; ++i) dynamic_bits += uint64_t{code_length_freqs[i]} * code_length_lengths[i];
+        for (int i = 0; i < rle_count; ++i) dynamic_bits += rle_symbols[i] == 16 ? 2 : rle_symbols[i] == 17 ? 3 : rle_symbols[i] == 18 ? 7 : 0;
+        for (int i = 0; i < kLiteralCodes; ++i) dynamic_bits += uint64_t{literal_freqs_[i]} * literal_lengths[i];
+        for (int i = 0; i < kDistanceCodes; ++i) dynamic_bits += uint64_t{distance_freqs_[i]} * distance_lengths[i];
+        size_t raw = static_cast<size_t>(pos - block_start_);
+        size_t stored_blocks = std::max<size_t>(1, (raw + kMaxStoredBlock - 1) / kMaxStoredBlock);
+        uint64_t stored_bits = (raw + 5 * stored_blocks) * 8 + 7;
+
+        if (stored_bits < dynamic_bits) {
+            WriteStored(base_ + block_start_, raw, final);
+        } else {
+            uint16_t literal_codes[kLiteralCodes];
+            uint16_t distance_codes[kDistanceCodes];
+            uint16_t code_length_codes[19];
+            BuildCodes(literal_lengths, kLiteralCodes, literal_codes);
+            BuildCodes(distance_lengths, kDistanceCodes, distance_codes);
+            BuildCodes(code_length_lengths, 19, code_length_codes);
+
+            writer_.Write(final ? 1 : 0, 1);
+            writer_.Write(2, 2);
+            writer_.Write(static_cast<uint32_t>(literal_count - 257), 5);
+            writer_.Write(static_cast<uint32_t>(distance_count - 1), 5);
+            writer_.Write(static_cast<uint32_t>(code_length_count - 4), 4);
+            for (int i = 0; i < code_length_count; ++i) writer_.Write(code_length_lengths[kCodeLengthOrder[i]], 3);
+            for (int i = 0; i < rle_count; ++i) {
+                int symbol = rle_symbols[i];
+                writer_.Write(code_length_codes[symbol], code_length_lengths[symbol]);
+                if (symbol >= 16) writer_.Write(rle_extra[i], symbol == 16 ? 2 : symbol == 17 ? 3 : 7);
+            }
+            const SymbolTables& symbols = Symbols();
+            for (const Token& token : scratch_->tokens) {
+                if (token.distance == 0) {
+                    writer_.Write(literal_codes[token.value], literal_lengths[token.value]);
+                    continue;
+                }
+                int length_code = symbols.length_code[token.value];
+                writer_.Write(literal_codes[257 + length_code], literal_lengths[257 + length_code]);
+                writer_.Write(token.value - kLengthBase[length_code], kLengthExtra[length_code]);
+                int distance_code = symbols.DistanceCode(token.distance);
+                writer_.Write(distance_codes[distance_code], distance_lengths[distance_code]);
+                writer_.Write(token.distance - kDistanceBase[distance_code], kDistanceExtra[distance_code]);
+            }
+            writer_.Write(literal_codes[kEndOfBlock], literal_lengths[kEndOfBlock]);
+        }
+        block_start_ = pos;
+        ResetBlock();
+    }
+
+    void WriteStored(const uint8_t* data, size_t size, bool final) {
+        do {
+            size_t length = std::min(size, kMaxStoredBlock);
+            writer_.Write(final && length == size ? 1 : 0, 3);    // BFINAL, BTYPE 00
+            writer_.Flush();
+            const uint8_t header[4] = {static_cast<uint8_t>(length), static_cast<uint8_t>(length >> 8),
+                                       static_cast<uint8_t>(~length), static_cast<uint8_t>(~length >> 8)};
+            std::vector<uint8_t>* out = writer_.out();
+            out->insert(out->end(), header, header + 4);
+            out->insert(out->end(), data, data + length);
+            data += length;
+            size -= length;
+        } while (size > 0);
+    }
+
+    const LevelConfig& config_;
+    DeflateScratch* scratch_;
+    BitWriter writer_;
+    const uint8_t* base_ = nullptr;
+    int32_t stop_ = 0;
+    int32_t block_start_ = 0;
+    uint32_t literal_freqs_[kLiteralCodes];
+    uint32_t distance_freqs_[kDistanceCodes];
+    uint64_t extra_bits_ = 0;
+};
+
+// Level 0: stored blocks only. BFINAL is set on the last block if |last|.
+void StoreStream(const uint8_t* data, size_t size, bool last, std::vector<uint8_t>* out) {
+    out->reserve(out->size() + size + (size / kMaxStoredBlock + 1) * 5 + 4);
+    do {
+        size_t length = std::min(size, kMaxStoredBlock);
+        const uint8_t header[5] = {static_cast<uint8_t>(last && length == size ? 1 : 0), static_cast<uint8_t>(length),
+                                   static_cast<uint8_t>(length >> 8), static_cast<uint8_t>(~length),
+                                   static_cast<uint8_t>(~length >> 8)};
+        out->insert(out->end(), header, header + 5);
+        out->insert(out->end(), data, data + length);
+        data += length;
+        size -= length;
+    } while (size > 0);
+}
+
+} // namespace
+
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size) {
+    static const Crc32Tables tables;
+    const auto& t = tables.values;
+    crc = ~crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        uint32_t low = LoadLittleEndian32(data) ^ crc;
+        uint32_t high = LoadLittleEndian32(data + 4);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][high & 0xFF] ^ t[2][(high >> 8) & 0xFF] ^ t[1][(high >> 16) & 0xFF] ^ t[0][high >> 24];
+    }
+    for (size_t i = 0; i < size; ++i) crc = t[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size) {
+    uint32_t a = adler & 0xFFFF;
+    uint32_t b = adler >> 16;
+    while (size > 0) {
+        size_t block = std::min(size, kAdlerBlock);
+        size -= block;
+        for (; block >= 8; block -= 8, data += 8) {
+            a += data[0]; b += a;
+            a += data[1]; b += a;
+            a += data[2]; b += a;
+            a += data[3]; b += a;
+            a += data[4]; b += a;
+            a += data[5]; b += a;
+            a += data[6]; b += a;
+            a += data[7]; b += a;
+        }
+        for (; block > 0; --block) {
+            a += *data++;
+            b += a;
+        }
+        a %= kAdlerModulus;
+        b %= kAdlerModulus;
+    }
+    return (b << 16) | a;
+}
+
+uint32_t Adler32Combine(uint32_t first, uint32_t second, size_t second_size) {
+    uint32_t remainder = static_cast<uint32_t>(second_size % kAdlerModulus);
+    uint32_t a = first & 0xFFFF;
+    uint32_t b = static_cast<uint32_t>((uint64_t{remainder} * a) % kAdlerModulus);
+    a += (second & 0xFFFF) + kAdlerModulus - 1;
+    b += (first >> 16) + (second >> 16) + kAdlerModulus - remainder;
+    if (a >= kAdlerModulus) a -= kAdlerModulus;
+    if (a >= kAdlerModulus) a -= kAdlerModulus;
+    if (b >= 2 * kAdlerModulus) b -= 2 * kAdlerModulus;
+    if (b >= kAdlerModulus) b -= kAdlerModulus;
+    return (b << 16) | a;
+}
+
+namespace {
+
+// CMF: deflate, 32 KB window. FLG: level hint, padded to a multiple of 31.
+void AppendZlibHeader(int level, std::vector<uint8_t>* out) {
+    const uint8_t cmf = 0x78;
+    uint8_t flg = static_cast<uint8_t>((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+    flg = static_cast<uint8_t>(flg + 31 - ((cmf << 8) | flg) % 31);
+    out->push_back(cmf);
+    out->push_back(flg);
+}
+
+// Deflates data[begin, end) as the next blocks of a stream, matching into
+// up to a window of the bytes before |begin|, and returns their Adler-32.
+// Unless |last|, the blocks end on a byte boundary.
+uint32_t DeflateRange(const uint8_t* data, size_t begin, size_t end, bool last, int level, int max_threads,
+                      std::vector<uint8_t>* out) {
+    size_t size = end - begin;
+    if (level == 0) {
+        StoreStream(data + begin, size, last, out);
+        return Adler32(1, data + begin, size);
+    }
+
+    const LevelConfig& config = kLevels[level];
+    int threads = max_threads > 0 ? max_threads : HardwareConcurrency();
+    size_t chunk_size = size >= kParallelDeflateBytes ? kChunkBytes : std::max<size_t>(size, 1);
+    size_t chunks = std::max<size_t>(1, (size + chunk_size - 1) / chunk_size);
+
+    if (chunks == 1) {
+        thread_local DeflateScratch scratch;
+        out->reserve(out->size() + size / 4 + 64);
+        ChunkDeflater(config, &scratch, out).Compress(data, begin, end, last);
+        return Adler32(1, data + begin, size);
+    }
+
+    // Outputs are kept per calling thread; workers see them through references
+    thread_local std::vector<std::vector<uint8_t>> kept_pieces;
+    thread_local std::vector<uint32_t> kept_checksums;
+    std::vector<std::vector<uint8_t>>& pieces = kept_pieces;
+    std::vector<uint32_t>& checksums = kept_checksums;
+    if (pieces.size() < chunks) pieces.resize(chunks);
+    checksums.assign(chunks, 1);
+    ParallelFor(chunks, threads, [&](size_t i) {
+        thread_local DeflateScratch scratch;
+        size_t chunk_begin = begin + i * chunk_size;
+        size_t chunk_end = std::min(end, chunk_begin + chunk_size);
+        std::vector<uint8_t>& piece = pieces[i];
+        piece.clear();
+        piece.reserve((chunk_end - chunk_begin) / 4 + 64);
+        ChunkDeflater(config, &scratch, &piece).Compress(data, chunk_begin, chunk_end, last && i + 1 == chunks);
+        checksums[i] = Adler32(1, data + chunk_begin, chunk_end - chunk_begin);
+    });
+
+    size_t total = 0;
+    for (size_t i = 0; i < chunks; ++i) total += pieces[i].size();
+    out->reserve(out->size() + total + 4);
+    uint32_t adler = 1;
+    for (size_t i = 0; i < chunks; ++i) {
+        out->insert(out->end(), pieces[i].begin(), pieces[i].end());
+        size_t chunk_begin = i * chunk_size;
+        adler = Adler32Combine(adler, checksums[i], std::min(size, chunk_begin + chunk_size) - chunk_begin);
+    }
+    return adler;
+}
+
+} // namespace
+
+void ZlibCompress(const uint8_t* data, size_t size, const DeflateOptions& options, std::vector<uint8_t>* out) {
+    int level = std::clamp(options.level, 0, 9);
+    AppendZlibHeader(level, out);
+    AppendBigEndian(out, DeflateRange(data, 0, size, true, level, options.max_threads, out));
+}
+
+ZlibStream::ZlibStream(const DeflateOptions& options) : options_(options) {
+    options_.level = std::clamp(options_.level, 0, 9);
+}
+
+void ZlibStream::Write(const uint8_t* data, size_t size, bool last, std::vector<uint8_t>* out) {
+    if (!started_) {
+        AppendZlibHeader(options_.level, out);
+        started_ = true;
+    }
+    if (size == 0 && !last) return;
+
+    // The window is the history followed by the new bytes, which match back into it
+    size_t history = window_.size();
+    window_.insert(window_.end(), data, data + size);
+    uint32_t adler = DeflateRange(window_.data(), history, window_.size(), last, options_.level,
+                                  options_.max_threads, out);
+    adler_ = Adler32Combine(adler_, adler, size);
+    if (last) {
+        AppendBigEndian(out, adler_);
+        window_.clear();
+        adler_ = 1;
+        started_ = false;
+        return;
+    }
+    if (window_.size() > static_cast<size_t>(kWindowSize)) {
+        window_.erase(window_.begin(), window_.end() - kWindowSize);
+    }
+}
+
+bool ZlibDecompress(const uint8_t* data, size_t size, size_t limit, std::vector<uint8_t>* out) {
+    return Inflate(data, size, limit, out);
+}
+
+} // namespace navigrab
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace navigrab {
+
+// Level 0 stores; 1-3 favour speed, 4-6 balance, 7-9 favour size
+constexpr int kDefaultCompressionLevel = 6;
+
+struct DeflateOptions {
+    int level = kDefaultCompressionLevel;
+    int max_threads = 0;    // 0 = HardwareConcurrency(); only large inputs are split
+};
+
+// Inputs of at least this many bytes are compressed in parallel chunks
+constexpr size_t kParallelDeflateBytes = 512 * 1024;
+
+// Running checksums; start from 0 for CRC-32 and 1 for Adler-32
+uint32_t Crc32(uint32_t crc, const uint8_t* data, size_t size);
+uint32_t Adler32(uint32_t adler, const uint8_t* data, size_t size);
+// Adler-32 of two buffers joined, from each one's checksum
+uint32_t Adler32Combine(uint32_t first, uint32_t second, size_t second_size);
+
+// Appends a zlib stream (RFC 1950) holding |data| to |out|. Large inputs are
+// cut into fixed-size chunks that deflate on separate threads, each still
+// matching against the 32 KB before it. Every chunk but the last ends on a
+// byte boundary with an empty stored block, so the chunks join into one
+// ordinary stream any inflater reads, and the bytes do not depend on the
+// thread count.
+void ZlibCompress(const uint8_t* data, size_t size, const DeflateOptions& options, std::vector<uint8_t>* out);
+
+// Compresses one zlib stream that arrives in pieces, such as an image a
+// strip of rows at a time. Each Write appends the blocks for its bytes and
+// keeps only the last 32 KB as history for matching, so memory follows the
+// piece size rather than the stream length. Pieces of at least
+// kParallelDeflateBytes are split across threads as in ZlibCompress.
+class ZlibStream {
+public:
+    explicit ZlibStream(const DeflateOptions& options = DeflateOptions());
+
+    // Appends the next part of the stream to |out|: the header on the first
+    // call, and the final block and checksum when |last| is set, after which
+    // the stream starts over. Output always ends on a byte boundary.
+    void Write(const uint8_t* data, size_t size, bool last, std::vector<uint8_t>* out);
+
+private:
+    DeflateOptions options_;
+    std::vector<uint8_t> window_;   // History, then the bytes being compressed
+    uint32_t adler_ = 1;
+    bool started_ = false;
+};
+
+// Replaces |out| with the inflated zlib stream. False if the stream is
+// malformed or would exceed |limit| bytes.
+bool ZlibDecompress(const uint8_t* data, size_t size, size_t limit, std::vector<uint8_t>* out);
+
+} // namespace navigrab
@@ -0,0 +1,547 @@
+#include "dom.h"
+#include <algorithm>
+#include <cstring>
+
+namespace navigrab {
+namespace dom {
+
+namespace {
+
+constexpr int kIndent = 8;
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool IsOneOf(std::string_view value, std::initializer_list<std::string_view> list) {
+    for (std::string_view item : list) {
+        if (value == item) return true;
+    }
+    return false;
+}
+
+bool IsHiddenTag(std::string_view tag) {
+    return IsOneOf(tag, {"head", "script", "style", "title", "meta", "link",
+                         "template", "noscript", "base"});
+}
+
+bool IsReplacedElement(std::string_view tag) {
+    return IsOneOf(tag, {"img", "input", "select", "textarea", "video", "canvas",
+                         "iframe", "embed", "object", "svg", "audio"});
+}
+
+int ParsePixels(std::string_view value) {
+    int result = 0;
+    for (char c : value) {
+        if (c < '0' || c > '9') break;
+        result = result * 10 + (c - '0');
+        if (result > 100000) break;
+    }
+    return result;
+}
+
+} // namespace
+
+bool IsVoidElement(std::string_view tag) {
+    return IsOneOf(tag, {"area", "base", "br", "col", "embed", "hr", "img", "input",
+                         "link", "meta", "param", "source", "track", "wbr"});
+}
+
+bool IsRawTextElement(std::string_view tag) {
+    return html::IsRawTextElement(tag);
+}
+
+// Arena implementation
+Arena::Arena(size_t min_block_size)
+    : min_block_size_(min_block_size), cursor_(nullptr), limit_(nullptr), bytes_used_(0) {}
+
+Arena::~Arena() = default;
+
+void Arena::AddBlock(size_t min_size) {
+    size_t size = std::max(min_block_size_, min_size);
+    Block block{std::unique_ptr<char[]>(new char[size]), size};
+    cursor_ = block.data.get();
+    limit_ = cursor_ + size;
+    blocks_.push_back(std::move(block));
+}
+
+void* Arena::Allocate(size_t size, size_t alignment) {
+    uintptr_t current = reinterpret_cast<uintptr_t>(cursor_);
+    uintptr_t aligned = (current + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    if (!cursor_ || aligned + size > reinterpret_cast<uintptr_t>(limit_)) {
+        AddBlock(size + alignment);
+        current = reinterpret_cast<uintptr_t>(cursor_);
+        aligned = (current + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1);
+    }
+    cursor_ = reinterpret_cast<char*>(aligned + size);
+    bytes_used_ += size;
+    return reinterpret_cast<void*>(aligned);
+}
+
+std::string_view Arena::CopyString(std::string_view text) {
+    if (text.empty()) return {};
+    char* copy = static_cast<char*>(Allocate(text.size(), 1));
+    std::memcpy(copy, text.data(), text.size());
+    return std::string_view(copy, text.size());
+}
+
+void Arena::Reset() {
+    if (blocks_.empty()) return;
+    // Keep only the largest block so the next document usually fits in one.
+    auto largest = std::max_element(blocks_.begin(), blocks_.end(),
+                                     [](const Block& a, const Block& b) { return a.size < b.size; });
+    Block kept = std::move(*largest);
+    blocks_.clear();
+    cursor_ = kept.data.get();
+    limit_ = cursor_ + kept.size;
+    blocks_.push_back(std::move(kept));
+    bytes_used_ = 0;
+}
+
+size_t Arena::BytesReserved() const {
+    size_t total = 0;
+    for (const auto& block : blocks_) total += block.size;
+    return total;
+}
+
+// Builds the flat node table from the arena copy of the source. Scratch
+// vectors are used while the tree grows and then sealed into the arena.
+class TreeBuilder {
+public:
+    TreeBuilder(Document* document, char* buffer, size_t length)
+        : document_(document), begin_(buffer), end_(buffer + length) {}
+
+    void Build() {
+        Node root{};
+        root.type = NodeType::DOCUMENT;
+        root.parent = kInvalidNode;
+        root.first_child = kInvalidNode;
+        root.next_sibling = kInvalidNode;
+        nodes_.push_back(root);
+        open_.push_back(0);
+        last_child_.push_back(kInvalidNode);
+        element_children_.push_back(0);
+
+        // Stage 1 finds the structural characters and checks UTF-8 in one
+        // pass; stage 2 turns them into tokens for the tree.
+        html::StructuralIndex& index = document_->structural_index_;
+        html::BuildStructuralIndex(std::string_view(begin_, end_ - begin_), &index);
+        document_->valid_utf8_ = index.IsValidUtf8();
+        html::Tokenizer tokenizer(begin_, end_ - begin_, index, &attributes_);
+        html::Token token;
+        while (tokenizer.Next(&token)) {
+            switch (token.type) {
+                case html::TokenType::START_TAG:
+                    OpenElement(token.name, token.first_attribute,
+                                static_cast<uint16_t>(std::min<uint32_t>(token.attribute_count, 0xFFFF)));
+                    if (IsVoidElement(token.name) || token.self_closing) PopElement();
+                    break;
+                case html::TokenType::END_TAG:
+                    CloseElement(token.name);
+                    break;
+                case html::TokenType::TEXT:
+                    AppendText(token.text);
+                    break;
+            }
+        }
+        while (open_.size() > 1) PopElement();
+        nodes_[0].subtree_end = static_cast<NodeId>(nodes_.size());
+        Seal();
+    }
+
+private:
+    void AppendText(std::string_view text) {
+        size_t start = 0;
+        while (start < text.size() && IsSpace(text[start])) ++start;
+        if (start == text.size()) return;   // Whitespace-only runs carry no content
+
+        Node node{};
+        node.type = NodeType::TEXT;
+        node.name = text;
+        NodeId id = LinkNode(node);
+        nodes_[id].subtree_end = id + 1;
+    }
+
+    void OpenElement(std::string_view tag, uint32_t first_attribute, uint16_t attribute_count) {
+        ApplyImpliedEndTags(tag);
+        Node node{};
+        node.type = NodeType::ELEMENT;
+        node.name = tag;
+        node.first_attribute = first_attribute;
+        node.attribute_count = attribute_count;
+        NodeId id = LinkNode(node);
+        IndexElement(id, tag, first_attribute, attribute_count);
+        open_.push_back(id);
+        last_child_.push_back(kInvalidNode);
+        element_children_.push_back(0);
+    }
+
+    NodeId LinkNode(Node node) {
+        NodeId id = static_cast<NodeId>(nodes_.size());
+        NodeId parent = open_.back();
+        node.parent = parent;
+        node.first_child = kInvalidNode;
+        node.next_sibling = kInvalidNode;
+        node.depth = static_cast<uint16_t>(std::min<size_t>(open_.size(), 0xFFFF));
+        NodeId previous = last_child_.back();
+        node.element_index = node.type == NodeType::ELEMENT ? ++element_children_.back() : 0;
+        nodes_.push_back(node);
+        if (previous != kInvalidNode) {
+            nodes_[previous].next_sibling = id;
+        } else {
+            nodes_[parent].first_child = id;
+        }
+        last_child_.back() = id;
+        return id;
+    }
+
+    void PopElement() {
+        nodes_[open_.back()].subtree_end = static_cast<NodeId>(nodes_.size());
+        open_.pop_back();
+        last_child_.pop_back();
+        element_children_.pop_back();
+    }
+
+    // Ids are assigned in document order, so appending keeps every list sorted.
+    void IndexElement(NodeId id, std::string_view tag, uint32_t first_attribute, uint16_t attribute_count) {
+        document_->tag_index_[tag].push_back(id);
+        for (uint32_t i = first_attribute; i < first_attribute + attribute_count; ++i) {
+            const Attribute& attribute = attributes_[i];
+            if (attribute.name == "id") {
+                if (!attribute.value.empty()) document_->id_index_[attribute.value].push_back(id);
+            } else if (attribute.name == "class") {
+                std::string_view classes = attribute.value;
+                size_t pos = 0;
+                while (pos < classes.size()) {
+                    while (pos < classes.size() && IsSpace(classes[pos])) ++pos;
+                    size_t start = pos;
+                    while (pos < classes.size() && !IsSpace(classes[pos])) ++pos;
+                    if (pos == start) continue;
+                    NodeList& list = document_->class_index_[classes.substr(start, pos - start)];
+                    // class="a a" must not list the element twice
+                    if (list.empty() || list.back() != id) list.push_back(id);
+                }
+            }
+        }
+    }
+
+    void CloseElement(std::string_view tag) {
+        for (size_t level = open_.size() - 1; level > 0; --level) {
+            if (nodes_[open_[level]].name == tag) {
+                while (open_.size() > level) PopElement();
+                return;
+            }
+        }
+        // Unmatched end tag - ignored like a browser would.
+    }
+
+    // The handful of optional end tags that matter for common markup.
+    void ApplyImpliedEndTags(std::string_view tag) {
+        if (open_.size() <= 1) return;
+        std::string_view current = nodes_[open_.back()].name;
+        bool close = false;
+        if (current == "p") {
+            close = IsOneOf(tag, {"p", "div", "ul", "ol", "table", "form", "h1", "h2", "h3",
+                                  "h4", "h5", "h6", "section", "article", "nav", "header",
+                                  "footer", "pre", "blockquote"});
+        } else if (current == "li") {
+            close = tag == "li";
+        } else if (current == "option") {
+            close = tag == "option";
+        } else if (current == "td" || current == "th") {
+            close = tag == "td" || tag == "th" || tag == "tr";
+        } else if (current == "tr") {
+            close = tag == "tr";
+        } else if (current == "dt" || current == "dd") {
+            close = tag == "dt" || tag == "dd";
+        }
+        if (close) PopElement();
+    }
+
+    void Seal() {
+        Arena& arena = document_->arena_;
+        document_->node_count_ = static_cast<uint32_t>(nodes_.size());
+        document_->nodes_ = arena.NewArray<Node>(nodes_.size());
+        std::copy(nodes_.begin(), nodes_.end(), document_->nodes_);
+        document_->attribute_count_ = static_cast<uint32_t>(attributes_.size());
+        document_->attributes_ = arena.NewArray<Attribute>(attributes_.size());
+        std::copy(attributes_.begin(), attributes_.end(), document_->attributes_);
+
+        document_->title_ = kInvalidNode;
+        for (NodeId id = 0; id < nodes_.size(); ++id) {
+            if (nodes_[id].type == NodeType::ELEMENT && nodes_[id].name == "title") {
+                document_->title_ = id;
+                break;
+            }
+        }
+    }
+
+    Document* document_;
+    char* begin_;
+    char* end_;
+    std::vector<Node> nodes_;
+    std::vector<Attribute> attributes_;
+    std::vector<NodeId> open_;
+    std::vector<NodeId> last_child_;
+    std::vector<uint32_t> element_children_;   // Element children seen so far, per open node
+};
+
+// Document implementation
+Document::Document()
+    : nodes_(nullptr), node_count_(0), attributes_(nullptr), attribute_count_(0),
+      boxes_(nullptr), title_(kInvalidNode), viewport_width_(kDefaultViewportWidth),
+      valid_utf8_(true) {}
+
+Document::~Document() = default;
+
+bool Document::Load(std::string_view html, int viewport_width) {
+    Clear();
+    viewport_width_ = viewport_width > 0 ? viewport_width : kDefaultViewportWidth;
+
+    // The source is copied once; tag names are lower-cased and character
+    // references decoded in place, so every string view points into the arena.
+    char* buffer = static_cast<char*>(arena_.Allocate(html.size() + 1, 1));
+    std::memcpy(buffer, html.data(), html.size());
+    buffer[html.size()] = '\0';
+
+    TreeBuilder builder(this, buffer, html.size());
+    builder.Build();
+    ComputeLayout();
+    return true;
+}
+
+void Document::Clear() {
+    arena_.Reset();
+    nodes_ = nullptr;
+    node_count_ = 0;
+    attributes_ = nullptr;
+    attribute_count_ = 0;
+    boxes_ = nullptr;
+    title_ = kInvalidNode;
+    valid_utf8_ = true;
+    tag_index_.clear();
+    class_index_.clear();
+    id_index_.clear();
+}
+
+const NodeList& Document::Lookup(const std::unordered_map<std::string_view, NodeList>& index,
+                                 std::string_view key) {
+    static const NodeList kEmpty;
+    auto it = index.find(key);
+    return it != index.end() ? it->second : kEmpty;
+}
+
+const NodeList& Document::ElementsByTag(std::string_view tag) const {
+    return Lookup(tag_index_, tag);
+}
+
+const NodeList& Document::ElementsByClass(std::string_view class_name) const {
+    return Lookup(class_index_, class_name);
+}
+
+const NodeList& Document::ElementsById(std::string_view id) const {
+    return Lookup(id_index_, id);
+}
+
+std::string_view Document::TagName(NodeId id) const {
+    return nodes_[id].type == NodeType::ELEMENT ? nodes_[id].name : std::string_view();
+}
+
+const Attribute* Document::AttributesBegin(NodeId id) const {
+    return attributes_ + nodes_[id].first_attribute;
+}
+
+const Attribute* Document::AttributesEnd(NodeId id) const {
+    return attributes_ + nodes_[id].first_attribute + nodes_[id].attribute_count;
+}
+
+const Attribute* Document::FindAttribute(NodeId id, std::string_view name) const {
+    if (nodes_[id].type != NodeType::ELEMENT) return nullptr;
+    for (const Attribute* it = AttributesBegin(id); it != AttributesEnd(id); ++it) {
+        if (it->name == name) return it;
+    }
+    return nullptr;
+}
+
+std::string_view Document::GetAttribute(NodeId id, std::string_view name) const {
+    const Attribute* attribute = FindAttribute(id, name);
+    return attribute ? attribute->value : std::string_view();
+}
+
+bool Document::HasAttribute(NodeId id, std::string_view name) const {
+    return FindAttribute(id, name) != nullptr;
+}
+
+bool Document::HasClass(NodeId id, std::string_view class_name) const {
+    std::string_view classes = GetAttribute(id, "class");
+    size_t pos = 0;
+    while (pos < classes.size()) {
+        while (pos < classes.size() && IsSpace(classes[pos])) ++pos;
+        size_t start = pos;
+        while (pos < classes.size() && !IsSpace(classes[pos])) ++pos;
+        if (pos > start && classes.substr(start, pos - start) == class_name) return true;
+    }
+    return false;
+}
+
+std::string Document::TextContent(NodeId id) const {
+    std::string text;
+    std::string_view view = TextView(id, &text);
+    if (view.data() != text.data()) text.assign(view);
+    return text;
+}
+
+std::string_view Document::TextView(NodeId id, std::string* scratch) const {
+    scratch->clear();
+    NodeId begin = nodes_[id].type == NodeType::TEXT ? id : id + 1;
+    NodeId end = nodes_[id].type == NodeType::TEXT ? id + 1 : nodes_[id].subtree_end;
+    auto is_content = [this](const Node& node) {
+        if (node.type != NodeType::TEXT) return false;
+        std::string_view parent_tag = nodes_[node.parent].name;
+        return parent_tag != "script" && parent_tag != "style";
+    };
+
+    // Parsing drops whitespace-only text, so a lone text node is the whole
+    // result once trimmed, provided its inner whitespace is single spaces.
+    NodeId only = kInvalidNode;
+    for (NodeId current = begin; current < end; ++current) {
+        if (!is_content(nodes_[current])) continue;
+        if (only != kInvalidNode) {
+            only = kInvalidNode;
+            break;
+        }
+        only = current;
+    }
+    if (only != kInvalidNode) {
+        std::string_view text = nodes_[only].name;
+        while (!text.empty() && IsSpace(text.front())) text.remove_prefix(1);
+        while (!text.empty() && IsSpace(text.back())) text.remove_suffix(1);
+        bool collapsed = true;
+        for (size_t i = 0; i < text.size() && collapsed; ++i) {
+            if (IsSpace(text[i])) collapsed = text[i] == ' ' && !IsSpace(text[i + 1]);
+        }
+        if (collapsed) return text;
+    }
+
+    for (NodeId current = begin; current < end; ++current) {
+        const Node& node = nodes_[current];
+        if (!is_content(node)) continue;
+        bool pending_space = !scratch->empty();
+        for (char c : node.name) {
+            if (IsSpace(c)) {
+                pending_space = !scratch->empty();
+                continue;
+            }
+            if (pending_space) scratch->push_back(' ');
+            pending_space = false;
+            scratch->push_back(c);
+        }
+    }
+    return *scratch;
+}
+
+std::string_view Document::Title() const {
+    if (title_ == kInvalidNode) return {};
+    NodeId child = nodes_[title_].first_child;
+    if (child == kInvalidNode) return {};
+    std::string_view text = nodes_[child].name;
+    while (!text.empty() && IsSpace(text.front())) text.remove_prefix(1);
+    while (!text.empty() && IsSpace(text.back())) text.remove_suffix(1);
+    return text;
+}
+
+std::string Document::BuildSelector(NodeId id) const {
+    if (id >= node_count_ || nodes_[id].type != NodeType::ELEMENT) return {};
+
+    std::vector<std::string> steps;
+    for (NodeId current = id; current != kInvalidNode && current != Root(); current = nodes_[current].parent) {
+        std::string step(nodes_[current].name);
+        std::string_view element_id = GetId(current);
+        if (!element_id.empty()) {
+            step.append("#").append(element_id);
+            steps.push_back(std::move(step));
+            break;
+        }
+        if (step != "html" && step != "body") {
+            step.append(":nth-child(").append(std::to_string(nodes_[current].element_index)).append(")");
+        }
+        steps.push_back(std::move(step));
+    }
+
+    std::string selector;
+    for (auto it = steps.rbegin(); it != steps.rend(); ++it) {
+        if (!selector.empty()) selector.append(" > ");
+        selector.append(*it);
+    }
+    return selector;
+}
+
+void Document::ComputeLayout() {
+    boxes_ = arena_.NewArray<Box>(node_count_);
+    std::vector<bool> hidden(node_count_, false);
+    std::vector<NodeId> open;
+    int cursor = 0;
+    boxes_[0] = Box{0, 0, viewport_width_, 0};
+
+    auto close_until = [&](NodeId next) {
+        while (!open.empty() && nodes_[open.back()].subtree_end <= next) {
+            NodeId done = open.back();
+            open.pop_back();
+            if (!hidden[done]) boxes_[done].height = std::max(boxes_[done].height, cursor - boxes_[done].y);
+        }
+    };
+
+    for (NodeId id = 1; id < node_count_; ++id) {
+        close_until(id);
+        const Node& node = nodes_[id];
+        const Box& parent_box = boxes_[node.parent];
+        boxes_[id] = Box{0, 0, 0, 0};
+
+        if (hidden[node.parent]) {
+            hidden[id] = true;
+            continue;
+        }
+
+        if (node.type == NodeType::TEXT) {
+            boxes_[id] = Box{parent_box.x, cursor, parent_box.width, kLineHeight};
+            cursor += kLineHeight;
+            continue;
+        }
+
+        std::string style = std::string(GetAttribute(id, "style"));
+        style.erase(std::remove_if(style.begin(), style.end(), IsSpace), style.end());
+        if (IsHiddenTag(node.name) || HasAttribute(id, "hidden") ||
+            style.find("display:none") != std::string::npos ||
+            (node.name == "input" && GetAttribute(id, "type") == "hidden")) {
+            hidden[id] = true;
+            continue;
+        }
+
+        int indent = node.parent == Root() ? 0 : kIndent;
+        Box box{parent_box.x + indent, cursor, std::max(0, parent_box.width - 2 * indent), 0};
+        int explicit_width = ParsePixels(GetAttribute(id, "width"));
+        if (explicit_width > 0) box.width = explicit_width;
+
+        if (IsReplacedElement(node.name) && node.first_child == kInvalidNode) {
+            int explicit_height = ParsePixels(GetAttribute(id, "height"));
+            int height = explicit_height > 0 ? explicit_height
+                         : (node.name == "img" || node.name == "video" || node.name == "canvas" ||
+                            node.name == "iframe") ? 150 : kLineHeight;
+            if (explicit_width <= 0 && node.name != "img" && node.name != "video") {
+                box.width = std::min(box.width, 200);
+            }
+            box.height = height;
+            cursor += height;
+        } else if (node.name == "br" || node.name == "hr") {
+            box.height = kLineHeight / 2;
+            cursor += box.height;
+        }
+        boxes_[id] = box;
+        open.push_back(id);
+    }
+    close_until(static_cast<NodeId>(node_count_));
+    boxes_[0].height = cursor;
+}
+
+} // namespace dom
+} // namespace navigrab
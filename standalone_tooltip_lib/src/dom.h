@@ -0,0 +1,200 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "html_tokenizer.h"
+
+namespace navigrab {
+namespace dom {
+
+// Bump allocator that owns everything belonging to one parsed document.
+// Allocations are never freed individually; Reset() releases the whole
+// document at once and keeps the largest block around for the next page.
+class Arena {
+public:
+    static constexpr size_t kDefaultBlockSize = 64 * 1024;
+
+    explicit Arena(size_t min_block_size = kDefaultBlockSize);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+    // Arrays of trivially destructible types only - the arena never runs destructors.
+    template <typename T>
+    T* NewArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "Arena memory is released without running destructors");
+        if (count == 0) return nullptr;
+        return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    // Copies |text| into the arena and returns a view of the copy.
+    std::string_view CopyString(std::string_view text);
+
+    void Reset();
+
+    size_t BytesUsed() const { return bytes_used_; }
+    size_t BytesReserved() const;
+
+private:
+    struct Block {
+        std::unique_ptr<char[]> data;
+        size_t size;
+    };
+
+    void AddBlock(size_t min_size);
+
+    size_t min_block_size_;
+    std::vector<Block> blocks_;
+    char* cursor_;
+    char* limit_;
+    size_t bytes_used_;
+};
+
+using NodeId = uint32_t;
+constexpr NodeId kInvalidNode = 0xFFFFFFFFu;
+
+enum class NodeType : uint8_t {
+    DOCUMENT,
+    ELEMENT,
+    TEXT
+};
+
+// Nodes are stored flat in document (pre-)order, so the descendants of node N
+// are exactly the ids in [N + 1, subtree_end). Links are 32-bit indexes into
+// the same array rather than pointers.
+struct Node {
+    std::string_view name;      // Lower-case tag name, or character data for text nodes
+    NodeId parent;
+    NodeId first_child;
+    NodeId next_sibling;
+    NodeId subtree_end;
+    uint32_t first_attribute;
+    uint32_t element_index;     // 1-based position among element siblings, 0 for non-elements
+    uint16_t attribute_count;
+    uint16_t depth;
+    NodeType type;
+};
+
+using Attribute = html::Attribute;
+
+// Approximate layout box in CSS pixels relative to the top of the page.
+struct Box {
+    int x;
+    int y;
+    int width;
+    int height;
+
+    bool IsEmpty() const { return width <= 0 || height <= 0; }
+    bool Contains(int px, int py) const {
+        return px >= x && py >= y && px < x + width && py < y + height;
+    }
+};
+
+// Element ids in document order.
+using NodeList = std::vector<NodeId>;
+
+// In-process DOM built from page HTML. All nodes, attributes and strings live
+// in the document's arena; Load() replaces the previous document in one shot.
+class Document {
+public:
+    static constexpr int kDefaultViewportWidth = 1280;
+    static constexpr int kLineHeight = 20;
+
+    Document();
+    ~Document();
+
+    Document(const Document&) = delete;
+    Document& operator=(const Document&) = delete;
+
+    // Parse |html| and lay it out for |viewport_width|.
+    bool Load(std::string_view html, int viewport_width = kDefaultViewportWidth);
+    void Clear();
+    bool IsEmpty() const { return node_count_ <= 1; }
+
+    // False when the source had malformed UTF-8; its bytes are kept as they are
+    bool IsValidUtf8() const { return valid_utf8_; }
+
+    // Tree access
+    NodeId Root() const { return 0; }
+    size_t Size() const { return node_count_; }
+    const Node& GetNode(NodeId id) const { return nodes_[id]; }
+    bool IsElement(NodeId id) const { return nodes_[id].type == NodeType::ELEMENT; }
+    std::string_view TagName(NodeId id) const;
+
+    // Attributes
+    const Attribute* AttributesBegin(NodeId id) const;
+    const Attribute* AttributesEnd(NodeId id) const;
+    const Attribute* FindAttribute(NodeId id, std::string_view name) const;
+    std::string_view GetAttribute(NodeId id, std::string_view name) const;
+    bool HasAttribute(NodeId id, std::string_view name) const;
+    bool HasClass(NodeId id, std::string_view class_name) const;
+    std::string_view GetId(NodeId id) const { return GetAttribute(id, "id"); }
+
+    // Inverted indexes filled while parsing. Lists are in document order;
+    // unknown keys return an empty list. Tag names must be lower-case.
+    const NodeList& ElementsByTag(std::string_view tag) const;
+    const NodeList& ElementsByClass(std::string_view class_name) const;
+    const NodeList& ElementsById(std::string_view id) const;
+
+    // Content
+    std::string TextContent(NodeId id) const;   // Whitespace-collapsed descendant text
+    // TextContent() without a copy when the text is one run that needs no
+    // collapsing: the view then points into the document. Otherwise the text
+    // is collapsed into |scratch| and the view points there.
+    std::string_view TextView(NodeId id, std::string* scratch) const;
+    std::string_view Title() const;
+
+    // Layout
+    const Box& GetBox(NodeId id) const { return boxes_[id]; }
+    bool IsRendered(NodeId id) const { return !boxes_[id].IsEmpty(); }
+    int ViewportWidth() const { return viewport_width_; }
+    int PageHeight() const { return boxes_ ? boxes_[0].height : 0; }
+
+    // Canonical selector that identifies |id| (tag#id, or a child path from
+    // the nearest ancestor with an id).
+    std::string BuildSelector(NodeId id) const;
+
+    // Memory accounting
+    size_t ArenaBytesUsed() const { return arena_.BytesUsed(); }
+
+private:
+    friend class TreeBuilder;
+
+    void ComputeLayout();
+    static const NodeList& Lookup(const std::unordered_map<std::string_view, NodeList>& index,
+                                  std::string_view key);
+
+    Arena arena_;
+    Node* nodes_;
+    uint32_t node_count_;
+    Attribute* attributes_;
+    uint32_t attribute_count_;
+    Box* boxes_;
+    NodeId title_;
+    int viewport_width_;
+    bool valid_utf8_;
+    html::StructuralIndex structural_index_;   // Scratch, kept to reuse its memory
+
+    // Keys point into the arena, so the indexes are cleared with it.
+    std::unordered_map<std::string_view, NodeList> tag_index_;
+    std::unordered_map<std::string_view, NodeList> class_index_;
+    std::unordered_map<std::string_view, NodeList> id_index_;
+};
+
+// Element classification used by parsing and layout.
+bool IsVoidElement(std::string_view tag);
+bool IsRawTextElement(std::string_view tag);
+
+} // namespace dom
+} // namespace navigrab
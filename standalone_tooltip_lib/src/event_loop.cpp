@@ -0,0 +1,95 @@
+#include "event_loop.h"
+#include "page_backend.h"
+
+namespace navigrab {
+
+EventLoop::EventLoop()
+    : epoch_(std::chrono::steady_clock::now()), next_sequence_(0) {}
+
+EventLoop::EventLoop(std::shared_ptr<VirtualClock> clock)
+    : clock_(std::move(clock)), epoch_(std::chrono::steady_clock::now()), next_sequence_(0) {}
+
+EventLoop::~EventLoop() = default;
+
+std::chrono::microseconds EventLoop::Now() const {
+    if (clock_) return clock_->Now();
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - epoch_);
+}
+
+void EventLoop::Post(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void EventLoop::PostDelayed(std::chrono::microseconds delay, std::function<void()> task) {
+    if (delay.count() <= 0) {
+        Post(std::move(task));
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        timers_.push(Timer{Now() + delay, next_sequence_++, std::move(task)});
+    }
+    wake_.notify_one();
+}
+
+bool EventLoop::RunOnce() {
+    std::deque<std::function<void()>> batch;
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (ready_.empty() && timers_.empty()) return false;
+
+        if (ready_.empty()) {
+            auto deadline = timers_.top().deadline;
+            if (clock_) {
+                // Nothing else can happen before the next timer; skip to it
+                auto now = clock_->Now();
+                if (deadline > now) clock_->Advance(deadline - now);
+            } else {
+                // A timer posted from another thread meanwhile may be due
+                // sooner; the wait then starts over with the new deadline
+                while (ready_.empty() &&
+                       wake_.wait_until(lock, epoch_ + deadline, [this, deadline] {
+                           return !ready_.empty() || timers_.top().deadline < deadline;
+                       })) {
+                    deadline = timers_.top().deadline;
+                }
+            }
+        }
+
+        // Every timer that is due joins the batch in deadline order
+        auto now = Now();
+        while (!timers_.empty() && timers_.top().deadline <= now) {
+            ready_.push_back(std::move(const_cast<Timer&>(timers_.top()).task));
+            timers_.pop();
+        }
+        batch.swap(ready_);
+    }
+
+    // Tasks posted while the batch runs wait for the next round
+    for (auto& task : batch) task();
+    return true;
+}
+
+void EventLoop::Run() {
+    while (RunOnce()) {
+    }
+}
+
+bool EventLoop::RunUntil(const std::function<bool()>& done) {
+    while (!done()) {
+        if (!RunOnce()) return done();
+    }
+    return true;
+}
+
+size_t EventLoop::PendingCount() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return ready_.size() + timers_.size();
+}
+
+} // namespace navigrab
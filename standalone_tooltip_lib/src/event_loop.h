@@ -0,0 +1,196 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace navigrab {
+
+class VirtualClock;
+
+// Single-threaded task runner for asynchronous page work. Tasks and timers may
+// be posted from any thread; they run on whichever thread drives the loop.
+//
+// A loop built on a VirtualClock never sleeps: when only timers are left it
+// moves the clock to the earliest deadline, so hundreds of overlapping
+// simulated operations finish in the simulated time of the slowest one.
+class EventLoop {
+public:
+    EventLoop();  // Real time (steady_clock)
+    explicit EventLoop(std::shared_ptr<VirtualClock> clock);
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    void Post(std::function<void()> task);
+    void PostDelayed(std::chrono::microseconds delay, std::function<void()> task);
+
+    // Runs every task that is due. When nothing is due, waits for (or, in
+    // virtual time, jumps to) the next timer first. Returns false once idle.
+    bool RunOnce();
+    // Runs until no tasks or timers remain
+    void Run();
+    // Runs until |done| returns true or the loop goes idle
+    bool RunUntil(const std::function<bool()>& done);
+
+    std::chrono::microseconds Now() const;
+    bool IsVirtualTime() const { return clock_ != nullptr; }
+    const std::shared_ptr<VirtualClock>& GetClock() const { return clock_; }  // Null in real time
+    size_t PendingCount() const;
+
+private:
+    struct Timer {
+        std::chrono::microseconds deadline;
+        uint64_t sequence;
+        std::function<void()> task;
+    };
+    struct TimerLater {
+        bool operator()(const Timer& a, const Timer& b) const {
+            return a.deadline != b.deadline ? a.deadline > b.deadline : a.sequence > b.sequence;
+        }
+    };
+
+    std::shared_ptr<VirtualClock> clock_;
+    std::chrono::steady_clock::time_point epoch_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::deque<std::function<void()>> ready_;
+    std::priority_queue<Timer, std::vector<Timer>, TimerLater> timers_;
+    uint64_t next_sequence_;
+};
+
+template <typename T> class Task;
+template <typename T> class Promise;
+
+namespace internal {
+
+// Result slot shared by a Promise and its Tasks. Only touched on the loop thread.
+template <typename T>
+struct TaskState {
+    bool ready = false;
+    T value{};
+    std::vector<std::function<void(const T&)>> continuations;
+};
+
+template <typename T> struct IsTask : std::false_type {};
+template <typename T> struct IsTask<Task<T>> : std::true_type {};
+
+} // namespace internal
+
+// Write side of a Task. Set() must be called at most once, on the loop thread.
+template <typename T>
+class Promise {
+public:
+    Promise() : state_(std::make_shared<internal::TaskState<T>>()) {}
+
+    Task<T> GetTask() const { return Task<T>(state_); }
+
+    void Set(T value) {
+        if (state_->ready) return;
+        state_->value = std::move(value);
+        state_->ready = true;
+        auto continuations = std::move(state_->continuations);
+        state_->continuations.clear();
+        for (auto& continuation : continuations) continuation(state_->value);
+    }
+
+private:
+    std::shared_ptr<internal::TaskState<T>> state_;
+};
+
+// Handle to a value that becomes available later, like a single-threaded
+// std::shared_future whose continuations run when the value is set.
+// Copies share the result.
+template <typename T>
+class Task {
+public:
+    using ValueType = T;
+
+    Task() = default;  // Invalid until assigned
+
+    static Task Ready(T value) {
+        Promise<T> promise;
+        promise.Set(std::move(value));
+        return promise.GetTask();
+    }
+
+    bool IsValid() const { return state_ != nullptr; }
+    bool IsReady() const { return state_ && state_->ready; }
+    const T& Get() const { return state_->value; }  // Only once IsReady()
+
+    // Drives |loop| until the value is available
+    const T& Wait(EventLoop& loop) const {
+        loop.RunUntil([state = state_] { return state->ready; });
+        return state_->value;
+    }
+
+    // Calls |callback| with the value, immediately if it is already set
+    void OnReady(std::function<void(const T&)> callback) const {
+        if (state_->ready) {
+            callback(state_->value);
+        } else {
+            state_->continuations.push_back(std::move(callback));
+        }
+    }
+
+    // Chains |f| after this task. |f| takes the value and returns either a
+    // plain value U (giving Task<U>) or a Task<U> (flattened to Task<U>).
+    template <typename F>
+    auto Then(F f) const {
+        using Result = std::decay_t<std::invoke_result_t<F&, const T&>>;
+        if constexpr (internal::IsTask<Result>::value) {
+            using U = typename Result::ValueType;
+            Promise<U> promise;
+            OnReady([f = std::move(f), promise](const T& value) mutable {
+                Promise<U> inner = promise;
+                f(value).OnReady([inner](const U& result) mutable { inner.Set(result); });
+            });
+            return promise.GetTask();
+        } else {
+            Promise<Result> promise;
+            OnReady([f = std::move(f), promise](const T& value) mutable {
+                promise.Set(f(value));
+            });
+            return promise.GetTask();
+        }
+    }
+
+private:
+    friend class Promise<T>;
+    explicit Task(std::shared_ptr<internal::TaskState<T>> state) : state_(std::move(state)) {}
+
+    std::shared_ptr<internal::TaskState<T>> state_;
+};
+
+// Completes once every task has; result i is the value of tasks[i].
+template <typename T>
+Task<std::vector<T>> WhenAll(const std::vector<Task<T>>& tasks) {
+    struct Gather {
+        std::vector<T> values;
+        size_t remaining;
+        Promise<std::vector<T>> promise;
+    };
+    if (tasks.empty()) return Task<std::vector<T>>::Ready({});
+    auto gather = std::make_shared<Gather>();
+    gather->values.resize(tasks.size());
+    gather->remaining = tasks.size();
+    for (size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i].OnReady([gather, i](const T& value) {
+            gather->values[i] = value;
+            if (--gather->remaining == 0) gather->promise.Set(std::move(gather->values));
+        });
+    }
+    return gather->promise.GetTask();
+}
+
+} // namespace navigrab
@@ -0,0 +1,540 @@
+#include "html_tokenizer.h"
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+
+#if NAVIGRAB_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+namespace navigrab {
+namespace html {
+
+namespace {
+
+constexpr size_t kBlockSize = 64;
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+void LowerInPlace(char* begin, char* end) {
+    for (char* p = begin; p < end; ++p) *p = ToLower(*p);
+}
+
+bool IsStructural(unsigned char c) {
+    return c == '<' || c == '>' || c == '&' || c == '"' || c == '\'' || c == '=';
+}
+
+int TrailingZeros(uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+#if defined(_M_X64)
+    _BitScanForward64(&index, mask);
+#else
+    if (static_cast<uint32_t>(mask)) {
+        _BitScanForward(&index, static_cast<uint32_t>(mask));
+    } else {
+        _BitScanForward(&index, static_cast<uint32_t>(mask >> 32));
+        index += 32;
+    }
+#endif
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(mask);
+#endif
+}
+
+// Incremental UTF-8 check (Unicode Table 3-7). Blocks that are pure ASCII
+// skip it, unless a multi-byte sequence is still open from the last block.
+class Utf8Validator {
+public:
+    void Feed(const unsigned char* data, size_t length, size_t offset) {
+        for (size_t i = 0; i < length && error_ == StructuralIndex::kValidUtf8; ++i) {
+            unsigned char c = data[i];
+            if (pending_ > 0) {
+                if (c < lower_ || c > upper_) {
+                    error_ = offset + i;
+                    return;
+                }
+                lower_ = 0x80;
+                upper_ = 0xBF;
+                --pending_;
+                continue;
+            }
+            if (c < 0x80) continue;
+            if (c >= 0xC2 && c <= 0xDF) {
+                pending_ = 1;
+            } else if (c >= 0xE0 && c <= 0xEF) {
+                pending_ = 2;
+                if (c == 0xE0) lower_ = 0xA0;
+                if (c == 0xED) upper_ = 0x9F;   // No surrogates
+            } else if (c >= 0xF0 && c <= 0xF4) {
+                pending_ = 3;
+                if (c == 0xF0) lower_ = 0x90;
+                if (c == 0xF4) upper_ = 0x8F;   // Nothing above U+10FFFF
+            } else {
+                error_ = offset + i;
+            }
+        }
+    }
+
+    // An ASCII block can only be valid if no sequence is waiting for bytes
+    void FeedAscii(size_t offset) {
+        if (pending_ > 0 && error_ == StructuralIndex::kValidUtf8) error_ = offset;
+    }
+
+    size_t Finish(size_t length) {
+        if (pending_ > 0 && error_ == StructuralIndex::kValidUtf8) error_ = length;
+        return error_;
+    }
+
+private:
+    int pending_ = 0;
+    unsigned char lower_ = 0x80;
+    unsigned char upper_ = 0xBF;
+    size_t error_ = StructuralIndex::kValidUtf8;
+};
+
+// Appends the offsets of the set bits of |mask| to the index
+class PositionWriter {
+public:
+    explicit PositionWriter(std::vector<uint32_t>* positions) : positions_(positions) {
+        positions_->clear();
+    }
+
+    void Write(uint32_t base, uint64_t mask) {
+        if (!mask) return;
+        if (positions_->size() < count_ + kBlockSize) {
+            positions_->resize(std::max<size_t>(positions_->size() * 2, count_ + 4 * kBlockSize));
+        }
+        uint32_t* out = positions_->data() + count_;
+        while (mask) {
+            *out++ = base + static_cast<uint32_t>(TrailingZeros(mask));
+            mask &= mask - 1;
+        }
+        count_ = static_cast<size_t>(out - positions_->data());
+    }
+
+    void Finish() { positions_->resize(count_); }
+
+private:
+    std::vector<uint32_t>* positions_;
+    size_t count_ = 0;
+};
+
+// A batch scanner fills masks[i] with the structural bits of block i and
+// sets bit i of |ascii| when that block has no byte >= 0x80. Batches keep
+// the per-call cost off the per-block path, since the AVX2 scanner cannot
+// be inlined into code built for the baseline target.
+constexpr size_t kBatchBlocks = 64;
+using BatchScanner = void (*)(const unsigned char* data, size_t blocks, uint64_t* masks, uint64_t* ascii);
+
+void ScalarScan(const unsigned char* data, size_t blocks, uint64_t* masks, uint64_t* ascii) {
+    *ascii = 0;
+    for (size_t b = 0; b < blocks; ++b) {
+        const unsigned char* block = data + b * kBlockSize;
+        uint64_t mask = 0;
+        unsigned char high = 0;
+        for (size_t i = 0; i < kBlockSize; ++i) {
+            if (IsStructural(block[i])) mask |= uint64_t{1} << i;
+            high |= block[i];
+        }
+        masks[b] = mask;
+        if (high < 0x80) *ascii |= uint64_t{1} << b;
+    }
+}
+
+#if NAVIGRAB_X86
+void Sse2Scan(const unsigned char* data, size_t blocks, uint64_t* masks, uint64_t* ascii) {
+    const __m128i lt = _mm_set1_epi8('<');
+    const __m128i gt = _mm_set1_epi8('>');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i equals = _mm_set1_epi8('=');
+    *ascii = 0;
+    for (size_t b = 0; b < blocks; ++b) {
+        const unsigned char* block = data + b * kBlockSize;
+        uint64_t mask = 0;
+        int high = 0;
+        for (int i = 0; i < 4; ++i) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + 16 * i));
+            __m128i hits = _mm_or_si128(
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, lt), _mm_cmpeq_epi8(v, gt)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, amp), _mm_cmpeq_epi8(v, dquote))),
+                _mm_or_si128(_mm_cmpeq_epi8(v, squote), _mm_cmpeq_epi8(v, equals)));
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm_movemask_epi8(hits))) << (16 * i);
+            high |= _mm_movemask_epi8(v);
+        }
+        masks[b] = mask;
+        if (high == 0) *ascii |= uint64_t{1} << b;
+    }
+}
+
+NAVIGRAB_TARGET_AVX2
+void Avx2Scan(const unsigned char* data, size_t blocks, uint64_t* masks, uint64_t* ascii) {
+    const __m256i lt = _mm256_set1_epi8('<');
+    const __m256i gt = _mm256_set1_epi8('>');
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i squote = _mm256_set1_epi8('\'');
+    const __m256i equals = _mm256_set1_epi8('=');
+    *ascii = 0;
+    for (size_t b = 0; b < blocks; ++b) {
+        const unsigned char* block = data + b * kBlockSize;
+        uint64_t mask = 0;
+        int high = 0;
+        for (int i = 0; i < 2; ++i) {
+            __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * i));
+            __m256i hits = _mm256_or_si256(
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, lt), _mm256_cmpeq_epi8(v, gt)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, amp), _mm256_cmpeq_epi8(v, dquote))),
+                _mm256_or_si256(_mm256_cmpeq_epi8(v, squote), _mm256_cmpeq_epi8(v, equals)));
+            mask |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(hits))) << (32 * i);
+            high |= _mm256_movemask_epi8(v);
+        }
+        masks[b] = mask;
+        if (high == 0) *ascii |= uint64_t{1} << b;
+    }
+}
+#endif
+
+// One pass over the input in 64-byte blocks; the tail is padded with spaces
+size_t ScanBlocks(BatchScanner scan, const unsigned char* data, size_t length, PositionWriter* writer) {
+    Utf8Validator utf8;
+    uint64_t masks[kBatchBlocks];
+    uint64_t ascii;
+    size_t whole_blocks = length / kBlockSize;
+    for (size_t first = 0; first < whole_blocks; first += kBatchBlocks) {
+        size_t blocks = std::min(kBatchBlocks, whole_blocks - first);
+        scan(data + first * kBlockSize, blocks, masks, &ascii);
+        for (size_t b = 0; b < blocks; ++b) {
+            size_t offset = (first + b) * kBlockSize;
+            writer->Write(static_cast<uint32_t>(offset), masks[b]);
+            if (ascii >> b & 1) {
+                utf8.FeedAscii(offset);
+            } else {
+                utf8.Feed(data + offset, kBlockSize, offset);
+            }
+        }
+    }
+    size_t offset = whole_blocks * kBlockSize;
+    if (offset < length) {
+        unsigned char tail[kBlockSize];
+        std::memset(tail, ' ', sizeof(tail));
+        std::memcpy(tail, data + offset, length - offset);
+        scan(tail, 1, masks, &ascii);
+        writer->Write(static_cast<uint32_t>(offset), masks[0]);
+        if (ascii & 1) {
+            utf8.FeedAscii(offset);
+        } else {
+            utf8.Feed(data + offset, length - offset, offset);
+        }
+    }
+    return utf8.Finish(length);
+}
+
+bool IsOneOf(std::string_view value, std::initializer_list<std::string_view> list) {
+    for (std::string_view item : list) {
+        if (value == item) return true;
+    }
+    return false;
+}
+
+size_t EncodeUtf8(uint32_t cp, char* out) {
+    if (cp < 0x80) {
+        out[0] = static_cast<char>(cp);
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = static_cast<char>(0xC0 | (cp >> 6));
+        out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = static_cast<char>(0xE0 | (cp >> 12));
+        out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = static_cast<char>(0xF0 | (cp >> 18));
+    out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+} // namespace
+
+bool BuildStructuralIndex(std::string_view input, StructuralIndex* index, SimdLevel level) {
+    if (input.size() >= 0xFFFFFFFFu) return false;
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(input.data());
+    PositionWriter writer(&index->positions);
+    // Never use more than the CPU has, whatever was asked for
+    level = std::min(level, DetectSimdLevel());
+    BatchScanner scan = ScalarScan;
+#if NAVIGRAB_X86
+    if (level == SimdLevel::AVX2) scan = Avx2Scan;
+    if (level == SimdLevel::SSE2) scan = Sse2Scan;
+#endif
+    index->utf8_error = ScanBlocks(scan, data, input.size(), &writer);
+    writer.Finish();
+    return true;
+}
+
+bool IsRawTextElement(std::string_view tag) {
+    return IsOneOf(tag, {"script", "style", "textarea", "title"});
+}
+
+size_t DecodeCharacterReferences(char* begin, size_t length) {
+    char* end = begin + length;
+    char* amp = static_cast<char*>(std::memchr(begin, '&', length));
+    if (!amp) return length;
+
+    char* out = amp;
+    char* p = amp;
+    while (p < end) {
+        if (*p != '&') {
+            *out++ = *p++;
+            continue;
+        }
+        char* semi = p + 1;
+        while (semi < end && semi - p <= 10 && *semi != ';') ++semi;
+        if (semi >= end || *semi != ';') {
+            *out++ = *p++;
+            continue;
+        }
+        std::string_view name(p + 1, semi - p - 1);
+        uint32_t cp = 0;
+        if (!name.empty() && name[0] == '#') {
+            bool hex = name.size() > 1 && (name[1] == 'x' || name[1] == 'X');
+            for (char c : name.substr(hex ? 2 : 1)) {
+                int digit = (c >= '0' && c <= '9') ? c - '0'
+                          : (hex && c >= 'a' && c <= 'f') ? c - 'a' + 10
+                          : (hex && c >= 'A' && c <= 'F') ? c - 'A' + 10 : -1;
+                if (digit < 0 || cp > 0x10FFFF) {
+                    cp = 0x110000;
+                    break;
+                }
+                cp = cp * (hex ? 16 : 10) + static_cast<uint32_t>(digit);
+            }
+            if (cp == 0 || cp > 0x10FFFF) cp = 0xFFFD;
+        } else if (name == "amp") {
+            cp = '&';
+        } else if (name == "lt") {
+            cp = '<';
+        } else if (name == "gt") {
+            cp = '>';
+        } else if (name == "quot") {
+            cp = '"';
+        } else if (name == "apos") {
+            cp = '\'';
+        } else if (name == "nbsp") {
+            cp = 0xA0;
+        } else if (name == "copy") {
+            cp = 0xA9;
+        } else {
+            *out++ = *p++;
+            continue;
+        }
+        out += EncodeUtf8(cp, out);
+        p = semi + 1;
+    }
+    return out - begin;
+}
+
+// Tokenizer implementation
+Tokenizer::Tokenizer(char* buffer, size_t length, const StructuralIndex& index,
+                     std::vector<Attribute>* attributes)
+    : begin_(buffer),
+      end_(buffer + length),
+      cursor_(index.positions.data()),
+      cursor_end_(index.positions.data() + index.positions.size()),
+      attributes_(attributes),
+      p_(buffer) {}
+
+char* Tokenizer::FindNext(char c, const char* from) {
+    uint32_t offset = static_cast<uint32_t>(from - begin_);
+    while (cursor_ < cursor_end_ && *cursor_ < offset) ++cursor_;
+    for (; cursor_ < cursor_end_; ++cursor_) {
+        if (begin_[*cursor_] == c) return begin_ + *cursor_;
+    }
+    return nullptr;
+}
+
+// Case-insensitive search for "</tag" that ends a raw text element
+char* Tokenizer::FindEndTag(char* from, std::string_view tag) {
+    for (char* p = FindNext('<', from); p; p = FindNext('<', p + 1)) {
+        if (p + 2 + tag.size() > end_) return nullptr;
+        if (p[1] != '/') continue;
+        bool match = true;
+        for (size_t i = 0; i < tag.size(); ++i) {
+            if (ToLower(p[2 + i]) != tag[i]) {
+                match = false;
+                break;
+            }
+        }
+        if (match) return p;
+    }
+    return nullptr;
+}
+
+void Tokenizer::EmitText(char* begin, char* end, bool decode, Token* token) {
+    size_t length = decode ? DecodeCharacterReferences(begin, end - begin) : end - begin;
+    *token = Token{TokenType::TEXT, std::string_view(), std::string_view(begin, length), 0, 0, false};
+}
+
+void Tokenizer::ParseStartTag(char* lt, Token* token) {
+    char* name_begin = lt + 1;
+    char* q = name_begin;
+    while (q < end_ && !IsSpace(*q) && *q != '>' && *q != '/') ++q;
+    LowerInPlace(name_begin, q);
+    std::string_view name(name_begin, q - name_begin);
+
+    uint32_t first_attribute = static_cast<uint32_t>(attributes_->size());
+    bool self_closing = false;
+    while (q < end_) {
+        while (q < end_ && IsSpace(*q)) ++q;
+        if (q >= end_) break;
+        if (*q == '>') {
+            ++q;
+            break;
+        }
+        if (*q == '/') {
+            self_closing = q + 1 < end_ && q[1] == '>';
+            ++q;
+            continue;
+        }
+        char* attr_begin = q;
+        while (q < end_ && !IsSpace(*q) && *q != '=' && *q != '>' && *q != '/') ++q;
+        if (q == attr_begin) {
+            ++q;    // Stray '=' - skip it
+            continue;
+        }
+        LowerInPlace(attr_begin, q);
+        Attribute attribute{std::string_view(attr_begin, q - attr_begin), std::string_view()};
+        char* r = q;
+        while (r < end_ && IsSpace(*r)) ++r;
+        if (r < end_ && *r == '=') {
+            ++r;
+            while (r < end_ && IsSpace(*r)) ++r;
+            char* value_begin = r;
+            char* value_end = r;
+            if (r < end_ && (*r == '"' || *r == '\'')) {
+                value_begin = r + 1;
+                value_end = FindNext(*r, value_begin);
+                if (!value_end) value_end = end_;
+                r = value_end < end_ ? value_end + 1 : end_;
+            } else {
+                while (r < end_ && !IsSpace(*r) && *r != '>') ++r;
+                value_end = r;
+            }
+            size_t length = DecodeCharacterReferences(value_begin, value_end - value_begin);
+            attribute.value = std::string_view(value_begin, length);
+            q = r;
+        }
+        attributes_->push_back(attribute);
+    }
+
+    p_ = q;
+    uint32_t attribute_count = static_cast<uint32_t>(attributes_->size()) - first_attribute;
+    *token = Token{TokenType::START_TAG, name, std::string_view(), first_attribute, attribute_count, self_closing};
+}
+
+bool Tokenizer::Next(Token* token) {
+    if (raw_end_pending_) {
+        *token = Token{TokenType::END_TAG, raw_tag_, std::string_view(), 0, 0, false};
+        raw_end_pending_ = false;
+        raw_tag_ = std::string_view();
+        return true;
+    }
+    if (!raw_tag_.empty()) {
+        char* text_begin = p_;
+        char* close = FindEndTag(p_, raw_tag_);
+        char* text_end = close ? close : end_;
+        char* gt = close ? FindNext('>', close) : nullptr;
+        p_ = gt ? gt + 1 : end_;
+        raw_end_pending_ = true;
+        if (text_end > text_begin) {
+            EmitText(text_begin, text_end, raw_tag_ == "textarea" || raw_tag_ == "title", token);
+            return true;
+        }
+        return Next(token);
+    }
+
+    while (p_ < end_) {
+        // Text up to the next '<', decoded only if a '&' was passed on the way
+        uint32_t offset = static_cast<uint32_t>(p_ - begin_);
+        while (cursor_ < cursor_end_ && *cursor_ < offset) ++cursor_;
+        bool has_reference = false;
+        char* lt = nullptr;
+        for (; cursor_ < cursor_end_; ++cursor_) {
+            char c = begin_[*cursor_];
+            if (c == '<') {
+                lt = begin_ + *cursor_;
+                break;
+            }
+            has_reference |= c == '&';
+        }
+        if (!lt || lt > p_) {
+            char* text_begin = p_;
+            p_ = lt ? lt : end_;
+            EmitText(text_begin, p_, has_reference, token);
+            return true;
+        }
+
+        if (lt + 1 >= end_) {
+            p_ = end_;
+            EmitText(lt, end_, false, token);
+            return true;
+        }
+        char next = lt[1];
+        if (next == '!' && end_ - lt >= 4 && lt[2] == '-' && lt[3] == '-') {
+            // "-->" no earlier than "<!---->"
+            char* gt = FindNext('>', lt + std::min<ptrdiff_t>(6, end_ - lt));
+            while (gt && !(gt[-1] == '-' && gt[-2] == '-')) gt = FindNext('>', gt + 1);
+            p_ = gt ? gt + 1 : end_;
+            continue;
+        }
+        if (next == '!' || next == '?') {
+            char* gt = FindNext('>', lt);
+            p_ = gt ? gt + 1 : end_;
+            continue;
+        }
+        if (next == '/') {
+            char* name_begin = lt + 2;
+            char* q = name_begin;
+            while (q < end_ && !IsSpace(*q) && *q != '>') ++q;
+            LowerInPlace(name_begin, q);
+            char* gt = FindNext('>', q);
+            p_ = gt ? gt + 1 : end_;
+            *token = Token{TokenType::END_TAG, std::string_view(name_begin, q - name_begin), std::string_view(),
+                           0, 0, false};
+            return true;
+        }
+        if (!IsAlpha(next)) {
+            p_ = lt + 1;
+            EmitText(lt, lt + 1, false, token);
+            return true;
+        }
+        ParseStartTag(lt, token);
+        if (!token->self_closing && IsRawTextElement(token->name)) raw_tag_ = token->name;
+        return true;
+    }
+    return false;
+}
+
+} // namespace html
+} // namespace navigrab
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "cpu_features.h"
+
+namespace navigrab {
+namespace html {
+
+// Stage 1 output: the offset of every structural character (< > & " ' =)
+// in source order, plus the UTF-8 verdict from the same pass.
+struct StructuralIndex {
+    static constexpr size_t kValidUtf8 = static_cast<size_t>(-1);
+
+    std::vector<uint32_t> positions;
+    size_t utf8_error = kValidUtf8;    // Offset of the first invalid byte
+
+    bool IsValidUtf8() const { return utf8_error == kValidUtf8; }
+};
+
+// Finds the structural characters of |input| 64 bytes at a time, using
+// movemask bitmaps on SSE2/AVX2 and a lookup table otherwise. Every level
+// produces the same index. Fails only for inputs of 4 GB or more.
+bool BuildStructuralIndex(std::string_view input, StructuralIndex* index,
+                          SimdLevel level = DetectSimdLevel());
+
+struct Attribute {
+    std::string_view name;      // Lower-case
+    std::string_view value;     // Entity-decoded
+};
+
+enum class TokenType : uint8_t {
+    START_TAG,
+    END_TAG,
+    TEXT
+};
+
+struct Token {
+    TokenType type;
+    std::string_view name;      // Lower-case tag name for tags
+    std::string_view text;      // Character data for TEXT, entity-decoded unless raw
+    uint32_t first_attribute;   // START_TAG: range in the attribute vector
+    uint32_t attribute_count;
+    bool self_closing;
+};
+
+// Stage 2: walks the structural index and yields tags and text. Comments,
+// doctypes and processing instructions are skipped. After a start tag for
+// a raw text element (script, style, textarea, title) the element's content
+// comes back as one TEXT token followed by its END_TAG.
+//
+// Works in place on |buffer|: tag and attribute names are lower-cased and
+// character references decoded, so token views stay valid as long as the
+// buffer does. Whitespace-only text is reported like any other text.
+class Tokenizer {
+public:
+    Tokenizer(char* buffer, size_t length, const StructuralIndex& index,
+              std::vector<Attribute>* attributes);
+
+    bool Next(Token* token);
+
+private:
+    // Next structural |c| at or after |from|, or null
+    char* FindNext(char c, const char* from);
+    char* FindEndTag(char* from, std::string_view tag);
+    void ParseStartTag(char* lt, Token* token);
+    void EmitText(char* begin, char* end, bool decode, Token* token);
+
+    char* begin_;
+    char* end_;
+    const uint32_t* cursor_;
+    const uint32_t* cursor_end_;
+    std::vector<Attribute>* attributes_;
+    char* p_;
+    std::string_view raw_tag_;     // Raw text element whose content comes next
+    bool raw_end_pending_ = false;
+};
+
+// Raw text elements hold character data up to their end tag
+bool IsRawTextElement(std::string_view tag);
+
+// Decodes character references in |begin|; returns the new length. Decoded
+// text is never longer than the source.
+size_t DecodeCharacterReferences(char* begin, size_t length);
+
+} // namespace html
+} // namespace navigrab
@@ -0,0 +1,789 @@
+#include "image_codec.h"
+#include "deflate.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+#if NAVIGRAB_X86
+#include <immintrin.h>
+#endif
+
+namespace navigrab {
+
+namespace {
+
+const uint8_t kPngSignature[8] = {0x89, 'P', 'N', 'G', 0x0D, 0x0A, 0x1A, 0x0A};
+
+void AppendBigEndian(std::vector<uint8_t>* out, uint32_t value) {
+    out->push_back(static_cast<uint8_t>(value >> 24));
+    out->push_back(static_cast<uint8_t>(value >> 16));
+    out->push_back(static_cast<uint8_t>(value >> 8));
+    out->push_back(static_cast<uint8_t>(value));
+}
+
+uint32_t ReadBigEndian(const uint8_t* data) {
+    return (uint32_t{data[0]} << 24) | (uint32_t{data[1]} << 16) | (uint32_t{data[2]} << 8) | data[3];
+}
+
+// Chunk length and CRC are filled in by EndChunk()
+size_t BeginChunk(std::vector<uint8_t>* out, const char type[4]) {
+    size_t start = out->size();
+    AppendBigEndian(out, 0);
+    out->insert(out->end(), type, type + 4);
+    return start;
+}
+
+void EndChunk(std::vector<uint8_t>* out, size_t start) {
+    uint32_t length = static_cast<uint32_t>(out->size() - start - 8);
+    uint8_t* header = out->data() + start;
+    header[0] = static_cast<uint8_t>(length >> 24);
+    header[1] = static_cast<uint8_t>(length >> 16);
+    header[2] = static_cast<uint8_t>(length >> 8);
+    header[3] = static_cast<uint8_t>(length);
+    AppendBigEndian(out, Crc32(0, header + 4, length + 4));
+}
+
+uint8_t Paeth(uint8_t a, uint8_t b, uint8_t c) {
+    int p = a + b - c;
+    int pa = std::abs(p - a);
+    int pb = std::abs(p - b);
+    int pc = std::abs(p - c);
+    if (pa <= pb && pa <= pc) return a;
+    return pb <= pc ? b : c;
+}
+
+// Reverses the per-row filters in place; |rows| holds a filter byte per row
+bool Unfilter(uint8_t* rows, int height, size_t row_bytes, size_t pixel_bytes) {
+    const uint8_t* previous = nullptr;
+    for (int y = 0; y < height; ++y) {
+        uint8_t filter = rows[0];
+        uint8_t* row = rows + 1;
+        for (size_t i = 0; i < row_bytes; ++i) {
+            uint8_t left = i >= pixel_bytes ? row[i - pixel_bytes] : 0;
+            uint8_t up = previous ? previous[i] : 0;
+            uint8_t up_left = previous && i >= pixel_bytes ? previous[i - pixel_bytes] : 0;
+            switch (filter) {
+                case 0: break;
+                case 1: row[i] = static_cast<uint8_t>(row[i] + left); break;
+                case 2: row[i] = static_cast<uint8_t>(row[i] + up); break;
+                case 3: row[i] = static_cast<uint8_t>(row[i] + ((left + up) >> 1)); break;
+                case 4: row[i] = static_cast<uint8_t>(row[i] + Paeth(left, up, up_left)); break;
+                default: return false;
+            }
+        }
+        previous = row;
+        rows += row_bytes + 1;
+    }
+    return true;
+}
+
+// PNG filter types, in the order the row header byte numbers them
+enum PngFilter {
+    FILTER_NONE,
+    FILTER_SUB,
+    FILTER_UP,
+    FILTER_AVERAGE,
+    FILTER_PAETH,
+    FILTER_COUNT
+};
+
+// Rows filtered per task when a large image is split across threads
+constexpr int kFilterBandRows = 32;
+// Filter scratch past this size is released after encoding, not kept
+constexpr size_t kRetainedFilterBytes = 16 * 1024 * 1024;
+// PNG chunk lengths are 31-bit; big streams are split across IDAT chunks
+constexpr size_t kMaxIdatBytes = size_t{1} << 30;
+
+// Filters bytes [begin, end) of |row| against |up| into |out| and returns
+// the sum of the outputs read as signed bytes, the usual "minimum sum of
+// absolute differences" estimate of how well a row will compress.
+template <int kFilter>
+uint64_t FilterSpanScalar(const uint8_t* row, const uint8_t* up, size_t begin, size_t end, uint8_t* out) {
+    uint64_t sum = 0;
+    for (size_t i = begin; i < end; ++i) {
+        uint8_t a = i >= kBytesPerPixel ? row[i - kBytesPerPixel] : 0;
+        uint8_t b = up[i];
+        uint8_t c = i >= kBytesPerPixel ? up[i - kBytesPerPixel] : 0;
+        uint8_t predicted = kFilter == FILTER_SUB       ? a
+                            : kFilter == FILTER_UP      ? b
+                            : kFilter == FILTER_AVERAGE ? static_cast<uint8_t>((a + b) >> 1)
+                            : kFilter == FILTER_PAETH   ? Paeth(a, b, c)
+                                                        : 0;
+        uint8_t value = static_cast<uint8_t>(row[i] - predicted);
+        out[i] = value;
+        sum += value < 128 ? value : 256 - value;
+    }
+    return sum;
+}
+
+template <int kFilter>
+uint64_t FilterRowScalar(const uint8_t* row, const uint8_t* up, size_t size, uint8_t* out) {
+    return FilterSpanScalar<kFilter>(row, up, 0, size, out);
+}
+
+#if NAVIGRAB_X86
+// Paeth predictor on 16-bit lanes
+inline __m128i PaethSse2(__m128i a, __m128i b, __m128i c) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i pa = _mm_sub_epi16(b, c);    // p - a
+    __m128i pb = _mm_sub_epi16(a, c);    // p - b
+    __m128i pc = _mm_add_epi16(pa, pb);  // p - c
+    pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+    pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+    pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+    __m128i not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+    __m128i not_b = _mm_cmpgt_epi16(pb, pc);
+    __m128i b_or_c = _mm_or_si128(_mm_and_si128(not_b, c), _mm_andnot_si128(not_b, b));
+    return _mm_or_si128(_mm_and_si128(not_a, b_or_c), _mm_andnot_si128(not_a, a));
+}
+
+// Same output and sum as FilterRowScalar; the first pixel, which has no
+// left neighbour, and the tail go through the scalar loop
+template <int kFilter>
+uint64_t FilterRowSse2(const uint8_t* row, const uint8_t* up, size_t size, uint8_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const size_t head = std::min<size_t>(size, kBytesPerPixel);
+    uint64_t sum = FilterSpanScalar<kFilter>(row, up, 0, head, out);
+    __m128i sums = zero;
+    size_t i = head;
+    for (; i + 16 <= size; i += 16) {
+        __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i predicted = zero;
+        if (kFilter == FILTER_SUB) {
+            predicted = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - kBytesPerPixel));
+        } else if (kFilter == FILTER_UP) {
+            predicted = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + i));
+        } else if (kFilter == FILTER_AVERAGE) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - kBytesPerPixel));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + i));
+            // pavgb rounds up; drop the carried half to floor
+            predicted = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+        } else if (kFilter == FILTER_PAETH) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i - kBytesPerPixel));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + i));
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + i - kBytesPerPixel));
+            __m128i low = PaethSse2(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(c, zero));
+            __m128i high = PaethSse2(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(c, zero));
+            predicted = _mm_packus_epi16(low, high);
+        }
+        __m128i value = _mm_sub_epi8(x, predicted);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), value);
+        __m128i magnitude = _mm_min_epu8(value, _mm_sub_epi8(zero, value));
+        sums = _mm_add_epi64(sums, _mm_sad_epu8(magnitude, zero));
+    }
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+    sum += lanes[0] + lanes[1];
+    return sum + FilterSpanScalar<kFilter>(row, up, i, size, out);
+}
+#endif
+
+using FilterRowFunction = uint64_t (*)(const uint8_t* row, const uint8_t* up, size_t size, uint8_t* out);
+
+const FilterRowFunction kScalarFilters[FILTER_COUNT] = {
+    FilterRowScalar<FILTER_NONE>, FilterRowScalar<FILTER_SUB>, FilterRowScalar<FILTER_UP>,
+    FilterRowScalar<FILTER_AVERAGE>, FilterRowScalar<FILTER_PAETH>};
+#if NAVIGRAB_X86
+const FilterRowFunction kSse2Filters[FILTER_COUNT] = {
+    FilterRowSse2<FILTER_NONE>, FilterRowSse2<FILTER_SUB>, FilterRowSse2<FILTER_UP>,
+    FilterRowSse2<FILTER_AVERAGE>, FilterRowSse2<FILTER_PAETH>};
+#endif
+
+const FilterRowFunction* FiltersFor(SimdLevel level) {
+#if NAVIGRAB_X86
+    if (level >= SimdLevel::SSE2) return kSse2Filters;
+#endif
+    (void)level;
+    return kScalarFilters;
+}
+
+// Filters tried per row: level 0 stores rows as they are, fast levels pick
+// between the cheap filters, the rest try all five
+int FilterCandidates(int level) {
+    return level == 0 ? 1 : level <= 3 ? FILTER_AVERAGE : FILTER_COUNT;
+}
+
+// Writes filter byte and filtered bytes for rows [first, last) into |out|,
+// choosing each row's filter by the smallest absolute sum. |above| is the
+// RGBA row over the bitmap's first, when it is a strip of a larger image.
+void FilterRows(const Bitmap& bitmap, int first, int last, const uint8_t* above, int candidates,
+                const FilterRowFunction* filters, uint8_t* out) {
+    const size_t row_bytes = static_cast<size_t>(bitmap.Width()) * kBytesPerPixel;
+    const bool swizzle = bitmap.Format() == PixelFormat::BGRA_8888;
+    // Two swizzled rows, a zero row standing in above the first, and one
+    // buffer per candidate filter
+    thread_local std::vector<uint8_t> scratch;
+    scratch.assign(row_bytes * (3 + FILTER_COUNT), 0);
+    uint8_t* swizzled[2] = {scratch.data(), scratch.data() + row_bytes};
+    const uint8_t* zeros = scratch.data() + 2 * row_bytes;
+    uint8_t* trial = scratch.data() + 3 * row_bytes;
+
+    auto source_row = [&](int y, uint8_t* buffer) -> const uint8_t* {
+        const uint8_t* row = bitmap.Row(y);
+        if (!swizzle) return row;
+        for (size_t i = 0; i < row_bytes; i += kBytesPerPixel) {
+            buffer[i] = row[i + 2];
+            buffer[i + 1] = row[i + 1];
+            buffer[i + 2] = row[i];
+            buffer[i + 3] = row[i + 3];
+        }
+        return buffer;
+    };
+
+    const uint8_t* up = first > 0 ? source_row(first - 1, swizzled[(first - 1) & 1]) : above ? above : zeros;
+    for (int y = first; y < last; ++y) {
+        const uint8_t* row = source_row(y, swizzled[y & 1]);
+        uint8_t* filtered = out + static_cast<size_t>(y - first) * (row_bytes + 1);
+        if (candidates == 1) {
+            filtered[0] = FILTER_NONE;
+            std::memcpy(filtered + 1, row, row_bytes);
+        } else {
+            int best = FILTER_NONE;
+            uint64_t best_sum = UINT64_MAX;
+            for (int filter = FILTER_NONE; filter < candidates && best_sum > 0; ++filter) {
+                uint64_t sum = filters[filter](row, up, row_bytes, trial + filter * row_bytes);
+                if (sum < best_sum) {
+                    best = filter;
+                    best_sum = sum;
+                }
+            }
+            filtered[0] = static_cast<uint8_t>(best);
+            std::memcpy(filtered + 1, trial + best * row_bytes, row_bytes);
+        }
+        up = row;
+    }
+}
+
+// Filters every row of |bitmap| into |filtered|, in bands on several
+// threads when it is large
+void FilterImage(const Bitmap& bitmap, const uint8_t* above, int level, int threads, SimdLevel simd,
+                 std::vector<uint8_t>* filtered) {
+    int height = bitmap.Height();
+    size_t row_bytes = static_cast<size_t>(bitmap.Width()) * kBytesPerPixel;
+    size_t raw_size = (row_bytes + 1) * static_cast<size_t>(height);
+    filtered->resize(raw_size);
+    uint8_t* data = filtered->data();
+    int candidates = FilterCandidates(level);
+    const FilterRowFunction* filters = FiltersFor(simd);
+    size_t bands = threads > 1 && raw_size >= kParallelDeflateBytes
+                       ? static_cast<size_t>((height + kFilterBandRows - 1) / kFilterBandRows)
+                       : 1;
+    int band_rows = bands == 1 ? height : kFilterBandRows;
+    ParallelFor(bands, threads, [&](size_t band) {
+        int first = static_cast<int>(band) * band_rows;
+        int last = std::min(height, first + band_rows);
+        FilterRows(bitmap, first, last, above, candidates, filters, data + first * (row_bytes + 1));
+    });
+}
+
+// Signature and IHDR: 8-bit RGBA, deflate, adaptive filtering, no interlace
+void AppendPngHeader(int width, int height, std::vector<uint8_t>* out) {
+    out->insert(out->end(), kPngSignature, kPngSignature + sizeof(kPngSignature));
+    size_t header = BeginChunk(out, "IHDR");
+    AppendBigEndian(out, static_cast<uint32_t>(width));
+    AppendBigEndian(out, static_cast<uint32_t>(height));
+    const uint8_t header_tail[5] = {8, 6, 0, 0, 0};
+    out->insert(out->end(), header_tail, header_tail + 5);
+    EndChunk(out, header);
+}
+
+void AppendIdatChunks(const std::vector<uint8_t>& compressed, std::vector<uint8_t>* out) {
+    for (size_t offset = 0; offset < compressed.size(); offset += kMaxIdatBytes) {
+        size_t idat = BeginChunk(out, "IDAT");
+        size_t length = std::min(kMaxIdatBytes, compressed.size() - offset);
+        out->insert(out->end(), compressed.begin() + offset, compressed.begin() + offset + length);
+        EndChunk(out, idat);
+    }
+}
+
+bool DecodePng(const uint8_t* data, size_t size, Bitmap* bitmap) {
+    size_t position = sizeof(kPngSignature);
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint8_t color_type = 0;
+    std::vector<uint8_t> compressed;
+    bool seen_header = false;
+    while (position + 12 <= size) {
+        uint32_t length = ReadBigEndian(data + position);
+        const uint8_t* type = data + position + 4;
+        const uint8_t* body = data + position + 8;
+        if (length > size - position - 12) return false;
+        if (std::memcmp(type, "IHDR", 4) == 0) {
+            if (length != 13) return false;
+            width = ReadBigEndian(body);
+            height = ReadBigEndian(body + 4);
+            color_type = body[9];
+            // 8-bit samples, standard compression and filtering, no interlacing
+            if (body[8] != 8 || body[10] != 0 || body[11] != 0 || body[12] != 0) return false;
+            seen_header = true;
+        } else if (std::memcmp(type, "IDAT", 4) == 0) {
+            compressed.insert(compressed.end(), body, body + length);
+        } else if (std::memcmp(type, "IEND", 4) == 0) {
+            break;
+        }
+        position += 12 + length;
+    }
+
+    size_t channels = color_type == 0 ? 1 : color_type == 2 ? 3 : color_type == 4 ? 2 : color_type == 6 ? 4 : 0;
+    if (!seen_header || channels == 0 || width == 0 || height == 0 ||
+        width > static_cast<uint32_t>(Bitmap::kMaxDimension) || height > static_cast<uint32_t>(Bitmap::kMaxDimension)) {
+        return false;
+    }
+    size_t row_bytes = width * channels;
+    std::vector<uint8_t> raw;
+    size_t expected = (row_bytes + 1) * height;
+    if (!ZlibDecompress(compressed.data(), compressed.size(), expected, &raw) || raw.size() != expected ||
+        !Unfilter(raw.data(), static_cast<int>(height), row_bytes, channels) ||
+        !bitmap->Allocate(static_cast<int>(width), static_cast<int>(height), PixelFormat::RGBA_8888)) {
+        return false;
+    }
+
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* in = raw.data() + y * (row_bytes + 1) + 1;
+        uint8_t* out = bitmap->Row(static_cast<int>(y));
+        if (channels == 4) {
+            std::memcpy(out, in, row_bytes);
+            continue;
+        }
+        for (uint32_t x = 0; x < width; ++x, in += channels, out += kBytesPerPixel) {
+            bool gray = channels <= 2;
+            out[0] = in[0];
+            out[1] = gray ? in[0] : in[1];
+            out[2] = gray ? in[0] : in[2];
+            out[3] = channels == 2 ? in[1] : 0xFF;
+        }
+    }
+    return true;
+}
+
+// QOI ("Quite OK Image"): byte-aligned ops against the previous pixel and a
+// 64-entry cache of recent colors, with no entropy coding, so both
+// directions are one pass over the pixels
+const uint8_t kQoiMagic[4] = {'q', 'o', 'i', 'f'};
+const uint8_t kQoiEnd[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+constexpr size_t kQoiHeaderBytes = 14;
+constexpr uint8_t kQoiOpIndex = 0x00;
+constexpr uint8_t kQoiOpDiff = 0x40;
+constexpr uint8_t kQoiOpLuma = 0x80;
+constexpr uint8_t kQoiOpRun = 0xC0;
+constexpr uint8_t kQoiOpRgb = 0xFE;
+constexpr uint8_t kQoiOpRgba = 0xFF;
+constexpr int kQoiMaxRun = 62;
+
+// Pixels are packed R | G << 8 | B << 16 | A << 24 whatever the host order
+constexpr uint32_t kQoiStartPixel = 0xFF000000u;    // Opaque black
+
+inline uint32_t QoiPack(uint32_t r, uint32_t g, uint32_t b, uint32_t a) {
+    return (r & 0xFF) | (g & 0xFF) << 8 | (b & 0xFF) << 16 | a << 24;
+}
+
+inline uint32_t QoiHash(uint32_t pixel) {
+    return ((pixel & 0xFF) * 3 + (pixel >> 8 & 0xFF) * 5 + (pixel >> 16 & 0xFF) * 7 + (pixel >> 24) * 11) & 63;
+}
+
+// Encoder state carried from one strip of rows to the next
+struct QoiState {
+    uint32_t index[64] = {};
+    uint32_t previous = kQoiStartPixel;
+    int run = 0;
+};
+
+void AppendQoiHeader(int width, int height, std::vector<uint8_t>* out) {
+    out->insert(out->end(), kQoiMagic, kQoiMagic + 4);
+    AppendBigEndian(out, static_cast<uint32_t>(width));
+    AppendBigEndian(out, static_cast<uint32_t>(height));
+    out->push_back(4);    // RGBA
+    out->push_back(0);    // sRGB with linear alpha
+}
+
+// Appends the ops for every row of |bitmap|. A run still open at the end
+// stays in |state| for the next strip or FinishQoi.
+void EncodeQoiRows(const Bitmap& bitmap, QoiState* state, std::vector<uint8_t>* out) {
+    int width = bitmap.Width();
+    int height = bitmap.Height();
+    const bool bgra = bitmap.Format() == PixelFormat::BGRA_8888;
+    // Worst case is 5 bytes a pixel plus a run carried over from the last row
+    const size_t row_worst = static_cast<size_t>(width) * 5 + 1;
+    uint32_t* index = state->index;
+    uint32_t previous = state->previous;
+    int run = state->run;
+    size_t used = out->size();
+    for (int y = 0; y < height; ++y) {
+        // Only the bytes written since the last row get zero-filled here
+        out->resize(used + row_worst);
+        uint8_t* start = out->data();
+        uint8_t* p = start + used;
+        const uint8_t* in = bitmap.Row(y);
+        for (int x = 0; x < width; ++x, in += kBytesPerPixel) {
+            uint32_t pixel = bgra ? QoiPack(in[2], in[1], in[0], in[3]) : QoiPack(in[0], in[1], in[2], in[3]);
+            if (pixel == previous) {
+                // Take the rest of the repeat in one go, comparing raw bytes
+                int repeat = 1;
+                while (x + repeat < width && std::memcmp(in, in + repeat * kBytesPerPixel, kBytesPerPixel) == 0) {
+                    ++repeat;
+                }
+                x += repeat - 1;
+                in += (repeat - 1) * kBytesPerPixel;
+                for (run += repeat; run >= kQoiMaxRun; run -= kQoiMaxRun) {
+                    *p++ = static_cast<uint8_t>(kQoiOpRun | (kQoiMaxRun - 1));
+                }
+                continue;
+            }
+            if (run > 0) {
+                *p++ = static_cast<uint8_t>(kQoiOpRun | (run - 1));
+                run = 0;
+            }
+            uint32_t slot = QoiHash(pixel);
+            if (index[slot] == pixel) {
+                *p++ = static_cast<uint8_t>(kQoiOpIndex | slot);
+            } else {
+                index[slot] = pixel;
+                if ((pixel ^ previous) >> 24 == 0) {
+                    int dr = static_cast<int8_t>((pixel & 0xFF) - (previous & 0xFF));
+                    int dg = static_cast<int8_t>((pixel >> 8 & 0xFF) - (previous >> 8 & 0xFF));
+                    int db = static_cast<int8_t>((pixel >> 16 & 0xFF) - (previous >> 16 & 0xFF));
+                    int dr_dg = dr - dg;
+                    int db_dg = db - dg;
+                    if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1) {
+                        *p++ = static_cast<uint8_t>(kQoiOpDiff | (dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    } else if (dg >= -32 && dg <= 31 && dr_dg >= -8 && dr_dg <= 7 && db_dg >= -8 && db_dg <= 7) {
+                        *p++ = static_cast<uint8_t>(kQoiOpLuma | (dg + 32));
+                        *p++ = static_cast<uint8_t>((dr_dg + 8) << 4 | (db_dg + 8));
+                    } else {
+                        *p++ = kQoiOpRgb;
+                        *p++ = static_cast<uint8_t>(pixel);
+                        *p++ = static_cast<uint8_t>(pixel >> 8);
+                        *p++ = static_cast<uint8_t>(pixel >> 16);
+                    }
+                } else {
+                    *p++ = kQoiOpRgba;
+                    *p++ = static_cast<uint8_t>(pixel);
+                    *p++ = static_cast<uint8_t>(pixel >> 8);
+                    *p++ = static_cast<uint8_t>(pixel >> 16);
+                    *p++ = static_cast<uint8_t>(pixel >> 24);
+                }
+            }
+            previous = pixel;
+        }
+        used = static_cast<size_t>(p - start);
+    }
+    out->resize(used);
+    state->previous = previous;
+    state->run = run;
+}
+
+void FinishQoi(const QoiState& state, std::vector<uint8_t>* out) {
+    if (state.run > 0) out->push_back(static_cast<uint8_t>(kQoiOpRun | (state.run - 1)));
+    out->insert(out->end(), kQoiEnd, kQoiEnd + sizeof(kQoiEnd));
+}
+
+bool EncodeQoiPixels(const Bitmap& bitmap, std::vector<uint8_t>* out) {
+    AppendQoiHeader(bitmap.Width(), bitmap.Height(), out);
+    QoiState state;
+    EncodeQoiRows(bitmap, &state, out);
+    FinishQoi(state, out);
+    return true;
+}
+
+// Accepts 3- and 4-channel files; fails on truncated op data
+bool DecodeQoi(const uint8_t* data, size_t size, Bitmap* bitmap) {
+    if (size < kQoiHeaderBytes + sizeof(kQoiEnd)) return false;
+    uint32_t width = ReadBigEndian(data + 4);
+    uint32_t height = ReadBigEndian(data + 8);
+    uint8_t channels = data[12];
+    if (width == 0 || height == 0 || width > static_cast<uint32_t>(Bitmap::kMaxDimension) ||
+        height > static_cast<uint32_t>(Bitmap::kMaxDimension) || (channels != 3 && channels != 4) || data[13] > 1 ||
+        !bitmap->Allocate(static_cast<int>(width), static_cast<int>(height), PixelFormat::RGBA_8888)) {
+        return false;
+    }
+
+    const uint8_t* p = data + kQoiHeaderBytes;
+    const uint8_t* end = data + size;
+    uint32_t index[64] = {};
+    uint32_t pixel = kQoiStartPixel;
+    int run = 0;
+    auto store = [](uint8_t* out, uint32_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+        out[2] = static_cast<uint8_t>(value >> 16);
+        out[3] = static_cast<uint8_t>(value >> 24);
+    };
+    for (uint32_t y = 0; y < height; ++y) {
+        uint8_t* out = bitmap->Row(static_cast<int>(y));
+        uint8_t* row_end = out + static_cast<size_t>(width) * kBytesPerPixel;
+        while (out < row_end) {
+            if (run > 0) {
+                // Fill as much of the run as this row holds
+                for (; run > 0 && out < row_end; --run, out += kBytesPerPixel) store(out, pixel);
+                continue;
+            }
+            if (p >= end) return false;
+            uint8_t op = *p++;
+            if (op == kQoiOpRgb) {
+                if (end - p < 3) return false;
+                pixel = QoiPack(p[0], p[1], p[2], pixel >> 24);
+                p += 3;
+            } else if (op == kQoiOpRgba) {
+                if (end - p < 4) return false;
+                pixel = QoiPack(p[0], p[1], p[2], p[3]);
+                p += 4;
+            } else if (op < kQoiOpDiff) {
+                pixel = index[op];
+            } else if (op < kQoiOpLuma) {
+                pixel = QoiPack((pixel & 0xFF) + (op >> 4 & 3) - 2, (pixel >> 8 & 0xFF) + (op >> 2 & 3) - 2,
+                                (pixel >> 16 & 0xFF) + (op & 3) - 2, pixel >> 24);
+            } else if (op < kQoiOpRun) {
+                if (p >= end) return false;
+                int dg = (op & 0x3F) - 32;
+                uint8_t deltas = *p++;
+                pixel = QoiPack((pixel & 0xFF) + dg - 8 + (deltas >> 4), (pixel >> 8 & 0xFF) + dg,
+                                (pixel >> 16 & 0xFF) + dg - 8 + (deltas & 15), pixel >> 24);
+            } else {
+                run = op & 0x3F;    // Repeats after this pixel
+            }
+            index[QoiHash(pixel)] = pixel;
+            store(out, pixel);
+            out += kBytesPerPixel;
+        }
+    }
+    return true;
+}
+
+JpegOptions ToJpegOptions(const EncodeOptions& options) {
+    JpegOptions jpeg;
+    jpeg.quality = options.quality;
+    jpeg.subsampling = options.subsampling;
+    jpeg.max_threads = options.max_threads;
+    jpeg.simd = options.simd;
+    return jpeg;
+}
+
+} // namespace
+
+ImageFormat ParseImageFormat(std::string_view name) {
+    if (name == "png" || name == "PNG") return ImageFormat::PNG;
+    if (name == "qoi" || name == "QOI") return ImageFormat::QOI;
+    if (name == "jpeg" || name == "jpg" || name == "JPEG" || name == "JPG") return ImageFormat::JPEG;
+    return ImageFormat::UNKNOWN;
+}
+
+const char* ImageFormatName(ImageFormat format) {
+    switch (format) {
+        case ImageFormat::PNG:
+            return "png";
+        case ImageFormat::QOI:
+            return "qoi";
+        case ImageFormat::JPEG:
+            return "jpeg";
+        case ImageFormat::UNKNOWN:
+            break;
+    }
+    return "unknown";
+}
+
+ImageFormat DetectImageFormat(const uint8_t* data, size_t size) {
+    if (size >= sizeof(kPngSignature) && std::memcmp(data, kPngSignature, sizeof(kPngSignature)) == 0) {
+        return ImageFormat::PNG;
+    }
+    if (size >= sizeof(kQoiMagic) && std::memcmp(data, kQoiMagic, sizeof(kQoiMagic)) == 0) {
+        return ImageFormat::QOI;
+    }
+    if (size >= 3 && data[0] == 0xFF && data[1] == 0xD8 && data[2] == 0xFF) return ImageFormat::JPEG;
+    return ImageFormat::UNKNOWN;
+}
+
+bool EncodePng(const Bitmap& bitmap, std::vector<uint8_t>* out, const EncodeOptions& options) {
+    out->clear();
+    if (bitmap.IsEmpty()) return false;
+    int width = bitmap.Width();
+    int height = bitmap.Height();
+    int level = std::clamp(options.compression_level, 0, 9);
+    int threads = options.max_threads > 0 ? options.max_threads : HardwareConcurrency();
+    size_t raw_size = (static_cast<size_t>(width) * kBytesPerPixel + 1) * static_cast<size_t>(height);
+
+    // Scratch is kept per calling thread; workers reach it through references
+    thread_local std::vector<uint8_t> kept_filtered;
+    thread_local std::vector<uint8_t> kept_compressed;
+    std::vector<uint8_t>& filtered = kept_filtered;
+    std::vector<uint8_t>& compressed = kept_compressed;
+    FilterImage(bitmap, nullptr, level, threads, options.simd, &filtered);
+
+    compressed.clear();
+    DeflateOptions deflate;
+    deflate.level = level;
+    deflate.max_threads = threads;
+    ZlibCompress(filtered.data(), raw_size, deflate, &compressed);
+    if (filtered.capacity() > kRetainedFilterBytes) std::vector<uint8_t>().swap(filtered);
+
+    // Chunk framing is under 64 bytes, plus 12 per extra IDAT
+    out->reserve(compressed.size() + compressed.size() / kMaxIdatBytes * 12 + 64);
+    AppendPngHeader(width, height, out);
+    AppendIdatChunks(compressed, out);
+    if (compressed.capacity() > kRetainedFilterBytes) std::vector<uint8_t>().swap(compressed);
+
+    EndChunk(out, BeginChunk(out, "IEND"));
+    return true;
+}
+
+bool EncodeQoi(const Bitmap& bitmap, std::vector<uint8_t>* out) {
+    out->clear();
+    if (bitmap.IsEmpty()) return false;
+    return EncodeQoiPixels(bitmap, out);
+}
+
+bool EncodeImage(const Bitmap& bitmap, ImageFormat format, std::vector<uint8_t>* out,
+                 const EncodeOptions& options) {
+    switch (format) {
+        case ImageFormat::PNG:
+            return EncodePng(bitmap, out, options);
+        case ImageFormat::QOI:
+            return EncodeQoi(bitmap, out);
+        case ImageFormat::JPEG:
+            return EncodeJpeg(bitmap, out, ToJpegOptions(options));
+        case ImageFormat::UNKNOWN:
+            break;
+    }
+    out->clear();
+    return false;
+}
+
+bool DecodeImage(const uint8_t* data, size_t size, Bitmap* bitmap) {
+    switch (DetectImageFormat(data, size)) {
+        case ImageFormat::PNG:
+            return DecodePng(data, size, bitmap);
+        case ImageFormat::QOI:
+            return DecodeQoi(data, size, bitmap);
+        case ImageFormat::JPEG:
+        case ImageFormat::UNKNOWN:
+            break;
+    }
+    return false;
+}
+
+class StreamingImageEncoder::Impl {
+public:
+    // Hands |pending| to the sink and clears it
+    bool Emit() {
+        if (!failed && !pending.empty() && !sink(pending.data(), pending.size())) failed = true;
+        pending.clear();
+        return !failed;
+    }
+
+    ImageFormat format = ImageFormat::UNKNOWN;
+    int width = 0;
+    int height = 0;
+    int strip_rows = 0;
+    int rows_added = 0;
+    bool failed = false;
+    EncodeOptions options;
+    Sink sink;
+    std::vector<uint8_t> pending;       // Bytes of the current strip, for the sink
+
+    // PNG: the stream spans every IDAT; |above| is the last row added, as RGBA
+    std::unique_ptr<ZlibStream> zlib;
+    std::vector<uint8_t> above;
+    std::vector<uint8_t> filtered;
+    std::vector<uint8_t> compressed;
+    QoiState qoi;
+    JpegStripEncoder jpeg;
+};
+
+StreamingImageEncoder::StreamingImageEncoder() : impl_(std::make_unique<Impl>()) {}
+
+StreamingImageEncoder::~StreamingImageEncoder() = default;
+
+bool StreamingImageEncoder::Begin(ImageFormat format, int width, int height, int strip_rows,
+                                  const EncodeOptions& options, Sink sink) {
+    impl_ = std::make_unique<Impl>();
+    Impl& impl = *impl_;
+    if (width <= 0 || height <= 0 || strip_rows <= 0 || !sink) return false;
+    impl.format = format;
+    impl.width = width;
+    impl.height = height;
+    impl.strip_rows = strip_rows;
+    impl.options = options;
+    impl.sink = std::move(sink);
+    switch (format) {
+        case ImageFormat::PNG: {
+            DeflateOptions deflate;
+            deflate.level = std::clamp(options.compression_level, 0, 9);
+            deflate.max_threads = options.max_threads;
+            impl.zlib = std::make_unique<ZlibStream>(deflate);
+            AppendPngHeader(width, height, &impl.pending);
+            break;
+        }
+        case ImageFormat::QOI:
+            AppendQoiHeader(width, height, &impl.pending);
+            break;
+        case ImageFormat::JPEG:
+            if (!impl.jpeg.Begin(width, height, strip_rows, ToJpegOptions(options), &impl.pending)) return false;
+            break;
+        case ImageFormat::UNKNOWN:
+            return false;
+    }
+    return impl.Emit();
+}
+
+bool StreamingImageEncoder::AddRows(const Bitmap& strip) {
+    Impl& impl = *impl_;
+    int remaining = impl.height - impl.rows_added;
+    if (impl.failed || impl.format == ImageFormat::UNKNOWN || strip.IsEmpty() || strip.Width() != impl.width ||
+        strip.Height() > remaining || (strip.Height() < remaining && strip.Height() != impl.strip_rows)) {
+        return false;
+    }
+    switch (impl.format) {
+        case ImageFormat::PNG: {
+            int level = std::clamp(impl.options.compression_level, 0, 9);
+            int threads = impl.options.max_threads > 0 ? impl.options.max_threads : HardwareConcurrency();
+            FilterImage(strip, impl.rows_added > 0 ? impl.above.data() : nullptr, level, threads,
+                        impl.options.simd, &impl.filtered);
+            impl.compressed.clear();
+            impl.zlib->Write(impl.filtered.data(), impl.filtered.size(), strip.Height() == remaining,
+                             &impl.compressed);
+            AppendIdatChunks(impl.compressed, &impl.pending);
+
+            // The next strip's first row filters against this one's last
+            const uint8_t* last = strip.Row(strip.Height() - 1);
+            size_t row_bytes = static_cast<size_t>(impl.width) * kBytesPerPixel;
+            impl.above.assign(last, last + row_bytes);
+            if (strip.Format() == PixelFormat::BGRA_8888) {
+                for (size_t i = 0; i < row_bytes; i += kBytesPerPixel) std::swap(impl.above[i], impl.above[i + 2]);
+            }
+            break;
+        }
+        case ImageFormat::QOI:
+            EncodeQoiRows(strip, &impl.qoi, &impl.pending);
+            break;
+        case ImageFormat::JPEG:
+            if (!impl.jpeg.AddRows(strip, &impl.pending)) return false;
+            break;
+        case ImageFormat::UNKNOWN:
+            return false;
+    }
+    impl.rows_added += strip.Height();
+    return impl.Emit();
+}
+
+bool StreamingImageEncoder::Finish() {
+    Impl& impl = *impl_;
+    if (impl.failed || impl.format == ImageFormat::UNKNOWN || impl.rows_added != impl.height) return false;
+    switch (impl.format) {
+        case ImageFormat::PNG:
+            EndChunk(&impl.pending, BeginChunk(&impl.pending, "IEND"));
+            break;
+        case ImageFormat::QOI:
+            FinishQoi(impl.qoi, &impl.pending);
+            break;
+        case ImageFormat::JPEG:
+            if (!impl.jpeg.Finish(&impl.pending)) return false;
+            break;
+        case ImageFormat::UNKNOWN:
+            return false;
+    }
+    impl.format = ImageFormat::UNKNOWN;
+    return impl.Emit();
+}
+
+} // namespace navigrab
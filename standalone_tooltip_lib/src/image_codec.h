@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+#include "bitmap.h"
+#include "cpu_features.h"
+#include "deflate.h"
+#include "jpeg_encoder.h"
+
+namespace navigrab {
+
+enum class ImageFormat {
+    UNKNOWN,
+    PNG,
+    QOI,    // Lossless and fast both ways; for thumbnails only we display
+    JPEG    // Lossy; encode only, for photos and archived full pages
+};
+
+// Format for a ScreenshotCapture::SetFormat() name ("png", "qoi", "jpeg"); UNKNOWN otherwise
+ImageFormat ParseImageFormat(std::string_view name);
+const char* ImageFormatName(ImageFormat format);
+
+// Format of encoded bytes, from their signature
+ImageFormat DetectImageFormat(const uint8_t* data, size_t size);
+
+struct EncodeOptions {
+    int compression_level = kDefaultCompressionLevel;  // PNG: 0 fastest/largest - 9 slowest/smallest
+    int quality = kDefaultJpegQuality;                  // JPEG: 1-100
+    ChromaSubsampling subsampling = ChromaSubsampling::YUV420;  // JPEG
+    int max_threads = 0;                                // 0 = HardwareConcurrency(); only large images are split
+    SimdLevel simd = DetectSimdLevel();
+};
+
+// Encodes |bitmap| into |out|, replacing its contents but reusing its
+// capacity, so a vector kept across frames stops allocating. The PNG is
+// 8-bit RGBA. Each row takes the filter with the smallest absolute sum
+// (levels 1-3 only try None, Sub and Up; level 0 filters nothing), and large
+// images filter and deflate on several threads. Every SIMD level and thread
+// count produces identical bytes.
+bool EncodePng(const Bitmap& bitmap, std::vector<uint8_t>* out, const EncodeOptions& options = EncodeOptions());
+// QOI keeps 8-bit RGBA losslessly in one pass of byte-aligned ops, several
+// times faster than PNG both ways at a somewhat larger size
+bool EncodeQoi(const Bitmap& bitmap, std::vector<uint8_t>* out);
+bool EncodeImage(const Bitmap& bitmap, ImageFormat format, std::vector<uint8_t>* out,
+                 const EncodeOptions& options = EncodeOptions());
+
+// Encodes an image whose rows arrive in strips, top to bottom, handing each
+// strip's bytes to a sink as soon as they are encoded, so memory follows the
+// strip height rather than the image's. PNG keeps one zlib stream across
+// IDAT chunks, QOI carries its run and index over, and JPEG makes each strip
+// whole restart intervals; the files decode like their one-shot forms.
+class StreamingImageEncoder {
+public:
+    // Receives the file's bytes in order; returning false abandons the image
+    using Sink = std::function<bool(const uint8_t* data, size_t size)>;
+
+    StreamingImageEncoder();
+    ~StreamingImageEncoder();
+
+    // Starts a |width| x |height| image and writes its header. Every strip but
+    // the last has |strip_rows| rows, a multiple of 16 for JPEG.
+    bool Begin(ImageFormat format, int width, int height, int strip_rows, const EncodeOptions& options, Sink sink);
+    bool AddRows(const Bitmap& strip);
+    // Writes the trailer; false unless every row went out to the sink
+    bool Finish();
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+// Decodes into |bitmap| as RGBA_8888, reusing its buffer when it fits.
+// Handles 8-bit non-interlaced PNG in gray, gray-alpha, RGB and RGBA, and
+// QOI with 3 or 4 channels. JPEG is not decoded.
+bool DecodeImage(const uint8_t* data, size_t size, Bitmap* bitmap);
+inline bool DecodeImage(const std::vector<uint8_t>& data, Bitmap* bitmap) {
+    return DecodeImage(data.data(), data.size(), bitmap);
+}
+
+} // namespace navigrab
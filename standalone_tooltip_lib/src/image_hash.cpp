@@ -0,0 +1,62 @@
+#include "image_hash.h"
+#include <algorithm>
+
+namespace navigrab {
+
+namespace {
+
+constexpr int kHashColumns = 9;
+constexpr int kHashRows = 8;
+
+// Rec. 601 luma in 8.8 fixed point
+constexpr uint32_t kLumaR = 77, kLumaG = 150, kLumaB = 29;
+
+// Cell |index| of |cells| spans [begin, end) of |size|; cells of images
+// smaller than the grid share pixels rather than coming up empty
+inline void CellSpan(int index, int cells, int size, int* begin, int* end) {
+    *begin = static_cast<int>(static_cast<int64_t>(index) * size / cells);
+    *end = std::max(*begin + 1, static_cast<int>(static_cast<int64_t>(index + 1) * size / cells));
+}
+
+} // namespace
+
+uint64_t DifferenceHash(const Bitmap& bitmap) {
+    if (bitmap.IsEmpty()) return 0;
+    const int width = bitmap.Width();
+    const int height = bitmap.Height();
+    const bool bgra = bitmap.Format() == PixelFormat::BGRA_8888;
+    const uint32_t weight0 = bgra ? kLumaB : kLumaR;
+    const uint32_t weight2 = bgra ? kLumaR : kLumaB;
+
+    int x_begin[kHashColumns], x_end[kHashColumns];
+    for (int column = 0; column < kHashColumns; ++column) {
+        CellSpan(column, kHashColumns, width, &x_begin[column], &x_end[column]);
+    }
+
+    uint64_t hash = 0;
+    for (int row = 0; row < kHashRows; ++row) {
+        int y_begin, y_end;
+        CellSpan(row, kHashRows, height, &y_begin, &y_end);
+        uint64_t sums[kHashColumns] = {};
+        for (int y = y_begin; y < y_end; ++y) {
+            const uint8_t* pixels = bitmap.Row(y);
+            for (int column = 0; column < kHashColumns; ++column) {
+                uint64_t sum = 0;
+                for (int x = x_begin[column]; x < x_end[column]; ++x) {
+                    const uint8_t* p = pixels + static_cast<size_t>(x) * kBytesPerPixel;
+                    sum += p[0] * weight0 + p[1] * kLumaG + p[2] * weight2;
+                }
+                sums[column] += sum;
+            }
+        }
+        // Cells of one row can differ in width by a pixel, so compare means
+        for (int column = 0; column + 1 < kHashColumns; ++column) {
+            uint64_t left = sums[column] * static_cast<uint64_t>(x_end[column + 1] - x_begin[column + 1]);
+            uint64_t right = sums[column + 1] * static_cast<uint64_t>(x_end[column] - x_begin[column]);
+            hash = hash << 1 | (right > left ? 1 : 0);
+        }
+    }
+    return hash;
+}
+
+} // namespace navigrab
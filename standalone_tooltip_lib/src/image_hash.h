@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+
+#include "bitmap.h"
+
+namespace navigrab {
+
+// 64-bit difference hash (dHash): the image averaged down to 9x8 luma
+// cells, one bit per pair of horizontal neighbours, set when the right
+// cell is brighter. Re-renders of an unchanged element hash alike, and small
+// shifts in anti-aliasing flip only a few bits. Zero for an empty bitmap.
+uint64_t DifferenceHash(const Bitmap& bitmap);
+
+// Bits that differ between two hashes
+inline int HammingDistance(uint64_t a, uint64_t b) {
+    uint64_t bits = a ^ b;
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(bits);
+#else
+    int count = 0;
+    for (; bits; bits &= bits - 1) ++count;
+    return count;
+#endif
+}
+
+} // namespace navigrab
@@ -0,0 +1,534 @@
+#include "image_resampler.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if NAVIGRAB_X86
+#include <immintrin.h>
+#endif
+
+namespace navigrab {
+
+namespace {
+
+// Filtering runs on int16 channels: 8-bit values shifted up by kWorkShift,
+// or linear light scaled to kWorkMax. Weights are Q14, so a pair of taps
+// fits one 16x16->32 multiply-add.
+constexpr int kWorkShift = 7;
+constexpr int kWorkMax = 32767;
+constexpr int kWeightBits = 14;
+constexpr int kWeightOne = 1 << kWeightBits;
+constexpr int kWeightRound = kWeightOne / 2;
+
+// Taps per output are padded to a multiple of this, and input rows carry
+// as many zeroed pixels past their end, so kernels never need a tail loop
+constexpr int kTapAlignment = 4;
+// Intermediate rows are padded to a multiple of this many int16 values
+constexpr int kRowAlignment = 16;
+// Source rows filtered per band when the job is not split across threads
+constexpr int kBandSourceRows = 256;
+
+constexpr double kPi = 3.14159265358979323846;
+
+// Per-output filter taps along one axis
+struct Contributions {
+    int taps = 0;                    // Per output, padded to kTapAlignment
+    int used_taps = 0;               // Largest unpadded count
+    std::vector<int> starts;         // First source index per output
+    std::vector<int16_t> weights;    // |taps| per output, summing to kWeightOne
+    std::vector<int32_t> pairs;      // Weights 2k and 2k+1 packed for madd
+    std::vector<int32_t> wide;       // Each pair repeated 4 times, one per channel
+};
+
+double FilterSupport(ResampleFilter filter) {
+    switch (filter) {
+        case ResampleFilter::BOX:
+            return 0.5;
+        case ResampleFilter::BILINEAR:
+            return 1.0;
+        case ResampleFilter::LANCZOS3:
+            return 3.0;
+    }
+    return 1.0;
+}
+
+double Sinc(double x) {
+    if (x == 0.0) return 1.0;
+    x *= kPi;
+    return std::sin(x) / x;
+}
+
+double FilterWeight(ResampleFilter filter, double x) {
+    x = std::fabs(x);
+    switch (filter) {
+        case ResampleFilter::BOX:
+            return x < 0.5 ? 1.0 : 0.0;
+        case ResampleFilter::BILINEAR:
+            return x < 1.0 ? 1.0 - x : 0.0;
+        case ResampleFilter::LANCZOS3:
+            return x < 3.0 ? Sinc(x) * Sinc(x / 3.0) : 0.0;
+    }
+    return 0.0;
+}
+
+void BuildContributions(int source_size, int dest_size, ResampleFilter filter, Contributions* out) {
+    double scale = static_cast<double>(source_size) / dest_size;
+    double filter_scale = std::max(scale, 1.0);
+    double support = FilterSupport(filter) * filter_scale;
+    int max_count = std::min(source_size, static_cast<int>(std::ceil(support * 2)) + 2);
+
+    std::vector<double> raw(static_cast<size_t>(max_count));
+    std::vector<int> quantized(static_cast<size_t>(dest_size) * max_count);
+    std::vector<int> lefts(dest_size);
+    std::vector<int> counts(dest_size);
+    int used = 1;
+    for (int i = 0; i < dest_size; ++i) {
+        double center = (i + 0.5) * scale;
+        int left = 0;
+        int right = 0;
+        if (filter == ResampleFilter::BOX && scale >= 1.0) {
+            // Exact coverage of the output pixel's footprint
+            double begin = i * scale;
+            double end = begin + scale;
+            left = static_cast<int>(std::floor(begin));
+            right = std::min(source_size, static_cast<int>(std::ceil(end)));
+            for (int j = left; j < right; ++j) raw[j - left] = std::min(end, j + 1.0) - std::max(begin, double(j));
+        } else if (filter == ResampleFilter::BOX) {
+            left = std::min(source_size - 1, static_cast<int>(center));
+            right = left + 1;
+            raw[0] = 1.0;
+        } else {
+            left = std::max(0, static_cast<int>(std::floor(center - support)));
+            right = std::min(source_size, static_cast<int>(std::ceil(center + support)));
+            for (int j = left; j < right; ++j) raw[j - left] = FilterWeight(filter, (j + 0.5 - center) / filter_scale);
+        }
+
+        // Drop zero taps at either end; fall back to the nearest pixel
+        int first = 0;
+        int last = right - left - 1;
+        while (first <= last && raw[first] == 0.0) ++first;
+        while (last >= first && raw[last] == 0.0) --last;
+        double sum = 0.0;
+        for (int k = first; k <= last; ++k) sum += raw[k];
+        if (first > last || sum == 0.0) {
+            left = std::min(source_size - 1, static_cast<int>(center));
+            first = last = 0;
+            raw[0] = sum = 1.0;
+        }
+
+        // Rounding the running total keeps the sum at exactly kWeightOne
+        int* q = &quantized[static_cast<size_t>(i) * max_count];
+        double total = 0.0;
+        int previous = 0;
+        for (int k = first; k <= last; ++k) {
+            total += raw[k];
+            int rounded = static_cast<int>(std::lround(total / sum * kWeightOne));
+            q[k - first] = rounded - previous;
+            previous = rounded;
+        }
+        lefts[i] = left + first;
+        counts[i] = last - first + 1;
+        used = std::max(used, counts[i]);
+    }
+
+    int taps = (used + kTapAlignment - 1) / kTapAlignment * kTapAlignment;
+    out->taps = taps;
+    out->used_taps = used;
+    out->starts.assign(dest_size, 0);
+    out->weights.assign(static_cast<size_t>(dest_size) * taps, 0);
+    for (int i = 0; i < dest_size; ++i) {
+        // Shift windows near the end left so every window has |used| real pixels
+        int start = std::min(lefts[i], source_size - used);
+        out->starts[i] = start;
+        int16_t* w = &out->weights[static_cast<size_t>(i) * taps + (lefts[i] - start)];
+        for (int k = 0; k < counts[i]; ++k) w[k] = static_cast<int16_t>(quantized[static_cast<size_t>(i) * max_count + k]);
+    }
+    out->pairs.resize(out->weights.size() / 2);
+    out->wide.resize(out->weights.size() * 2);
+    for (size_t p = 0; p < out->pairs.size(); ++p) {
+        uint32_t low = static_cast<uint16_t>(out->weights[2 * p]);
+        uint32_t high = static_cast<uint16_t>(out->weights[2 * p + 1]);
+        out->pairs[p] = static_cast<int32_t>(low | (high << 16));
+        std::fill_n(&out->wide[4 * p], 4, out->pairs[p]);
+    }
+}
+
+// sRGB transfer function, tabulated for 8-bit input and 12-bit linear output
+struct GammaTables {
+    int16_t to_linear[256];
+    uint8_t to_srgb[4096];
+
+    GammaTables() {
+        for (int v = 0; v < 256; ++v) {
+            double c = v / 255.0;
+            double linear = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+            to_linear[v] = static_cast<int16_t>(std::lround(linear * kWorkMax));
+        }
+        for (int i = 0; i < 4096; ++i) {
+            double linear = (i + 0.5) / 4096.0;
+            double c = linear <= 0.0031308 ? linear * 12.92 : 1.055 * std::pow(linear, 1.0 / 2.4) - 0.055;
+            to_srgb[i] = static_cast<uint8_t>(std::lround(std::clamp(c, 0.0, 1.0) * 255.0));
+        }
+    }
+
+    static const GammaTables& Get() {
+        static const GammaTables tables;
+        return tables;
+    }
+};
+
+int16_t ClampWork(int32_t value) {
+    return static_cast<int16_t>(std::clamp(value, 0, kWorkMax));
+}
+
+uint8_t WorkToByte(int16_t value) {
+    return static_cast<uint8_t>(std::min((value + (1 << (kWorkShift - 1))) >> kWorkShift, 255));
+}
+
+// Kernels for one SIMD level. Every level computes the same integers.
+struct Kernels {
+    // Whole-factor box path: column sums of |factor_y| rows, then each run
+    // of |factor| columns times |scale| (1 / block area), rounded
+    void (*accumulate)(const uint8_t* row, uint16_t* sums, int count);
+    void (*reduce)(const uint16_t* sums, uint8_t* out, int width, int factor, float scale);
+
+    // |count| bytes to work values; alpha (every 4th) never goes through |gamma|
+    void (*expand)(const uint8_t* in, int16_t* out, int count, const GammaTables* gamma);
+    void (*horizontal)(const int16_t* in, const Contributions& contributions, int16_t* out);
+    // |length| is a multiple of kRowAlignment
+    void (*vertical)(const int16_t* const* rows, const int32_t* pairs, int taps, int length, int16_t* out);
+    void (*narrow)(const int16_t* in, uint8_t* out, int count, const GammaTables* gamma);
+};
+
+void ExpandScalar(const uint8_t* in, int16_t* out, int count, const GammaTables* gamma) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = gamma && (i & 3) != 3 ? gamma->to_linear[in[i]] : static_cast<int16_t>(in[i] << kWorkShift);
+    }
+}
+
+void NarrowScalar(const int16_t* in, uint8_t* out, int count, const GammaTables* gamma) {
+    for (int i = 0; i < count; ++i) {
+        out[i] = gamma && (i & 3) != 3 ? gamma->to_srgb[in[i] >> 3] : WorkToByte(in[i]);
+    }
+}
+
+void HorizontalScalar(const int16_t* in, const Contributions& contributions, int16_t* out) {
+    int taps = contributions.taps;
+    for (size_t x = 0; x < contributions.starts.size(); ++x, out += 4) {
+        const int16_t* p = in + static_cast<size_t>(contributions.starts[x]) * 4;
+        const int16_t* w = &contributions.weights[x * taps];
+        int32_t sums[4] = {kWeightRound, kWeightRound, kWeightRound, kWeightRound};
+        for (int k = 0; k < taps; ++k, p += 4) {
+            for (int c = 0; c < 4; ++c) sums[c] += w[k] * p[c];
+        }
+        for (int c = 0; c < 4; ++c) out[c] = ClampWork(sums[c] >> kWeightBits);
+    }
+}
+
+void VerticalScalar(const int16_t* const* rows, const int32_t* pairs, int taps, int length, int16_t* out) {
+    for (int i = 0; i < length; ++i) {
+        int32_t sum = kWeightRound;
+        for (int k = 0; k < taps; k += 2) {
+            int32_t pair = pairs[k / 2];
+            sum += static_cast<int16_t>(pair) * rows[k][i] + static_cast<int16_t>(pair >> 16) * rows[k + 1][i];
+        }
+        out[i] = ClampWork(sum >> kWeightBits);
+    }
+}
+
+void AccumulateScalar(const uint8_t* row, uint16_t* sums, int count) {
+    for (int i = 0; i < count; ++i) sums[i] = static_cast<uint16_t>(sums[i] + row[i]);
+}
+
+void ReduceScalar(const uint16_t* sums, uint8_t* out, int width, int factor, float scale) {
+    for (int x = 0; x < width; ++x, sums += 4 * factor, out += 4) {
+        for (int c = 0; c < 4; ++c) {
+            uint32_t total = 0;
+            for (int k = 0; k < factor; ++k) total += sums[4 * k + c];
+            // Round to nearest even, as cvtps2dq does
+            out[c] = static_cast<uint8_t>(std::min(std::lrint(static_cast<float>(total) * scale), 255L));
+        }
+    }
+}
+
+const Kernels kScalarKernels = {AccumulateScalar, ReduceScalar, ExpandScalar, HorizontalScalar, VerticalScalar,
+                                NarrowScalar};
+
+#if NAVIGRAB_X86
+void AccumulateSse2(const uint8_t* row, uint16_t* sums, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+        __m128i* low = reinterpret_cast<__m128i*>(sums + i);
+        __m128i* high = reinterpret_cast<__m128i*>(sums + i + 8);
+        _mm_storeu_si128(low, _mm_add_epi16(_mm_loadu_si128(low), _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128(high, _mm_add_epi16(_mm_loadu_si128(high), _mm_unpackhi_epi8(v, zero)));
+    }
+    AccumulateScalar(row + i, sums + i, count - i);
+}
+
+void ReduceSse2(const uint16_t* sums, uint8_t* out, int width, int factor, float scale) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128 multiplier = _mm_set1_ps(scale);
+    for (int x = 0; x < width; ++x, out += 4) {
+        __m128i total = zero;
+        for (int k = 0; k < factor; ++k, sums += 4) {
+            total = _mm_add_epi32(total, _mm_unpacklo_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sums)), zero));
+        }
+        __m128i rounded = _mm_cvtps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(total), multiplier));
+        rounded = _mm_packus_epi16(_mm_packs_epi32(rounded, rounded), zero);
+        uint32_t pixel = static_cast<uint32_t>(_mm_cvtsi128_si32(rounded));
+        std::memcpy(out, &pixel, 4);
+    }
+}
+
+void ExpandSse2(const uint8_t* in, int16_t* out, int count, const GammaTables* gamma) {
+    if (gamma) return ExpandScalar(in, out, count, gamma);
+    const __m128i zero = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_slli_epi16(_mm_unpacklo_epi8(v, zero), kWorkShift));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_slli_epi16(_mm_unpackhi_epi8(v, zero), kWorkShift));
+    }
+    ExpandScalar(in + i, out + i, count - i, nullptr);
+}
+
+void NarrowSse2(const int16_t* in, uint8_t* out, int count, const GammaTables* gamma) {
+    if (gamma) return NarrowScalar(in, out, count, gamma);
+    const __m128i round = _mm_set1_epi16(1 << (kWorkShift - 1));
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8));
+        // Work values are never negative; an unsigned add keeps kWorkMax from wrapping
+        low = _mm_srli_epi16(_mm_adds_epu16(low, round), kWorkShift);
+        high = _mm_srli_epi16(_mm_adds_epu16(high, round), kWorkShift);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(low, high));
+    }
+    NarrowScalar(in + i, out + i, count - i, nullptr);
+}
+
+void HorizontalSse2(const int16_t* in, const Contributions& contributions, int16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(kWeightRound);
+    int taps = contributions.taps;
+    for (size_t x = 0; x < contributions.starts.size(); ++x, out += 4) {
+        const int16_t* p = in + static_cast<size_t>(contributions.starts[x]) * 4;
+        const int32_t* w = &contributions.wide[x * taps * 2];
+        __m128i sum = round;
+        for (int k = 0; k < taps; k += 2, p += 8, w += 4) {
+            // Interleave two pixels so each madd lane is one channel of both taps
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i pairs = _mm_unpacklo_epi16(pixels, _mm_srli_si128(pixels, 8));
+            sum = _mm_add_epi32(sum, _mm_madd_epi16(pairs, _mm_loadu_si128(reinterpret_cast<const __m128i*>(w))));
+        }
+        sum = _mm_srai_epi32(sum, kWeightBits);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_max_epi16(_mm_packs_epi32(sum, sum), zero));
+    }
+}
+
+void VerticalSse2(const int16_t* const* rows, const int32_t* pairs, int taps, int length, int16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(kWeightRound);
+    for (int i = 0; i < length; i += 8) {
+        __m128i low = round;
+        __m128i high = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i));
+            __m128i w = _mm_set1_epi32(pairs[k / 2]);
+            low = _mm_add_epi32(low, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+            high = _mm_add_epi32(high, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+        }
+        __m128i packed = _mm_packs_epi32(_mm_srai_epi32(low, kWeightBits), _mm_srai_epi32(high, kWeightBits));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_max_epi16(packed, zero));
+    }
+}
+
+NAVIGRAB_TARGET_AVX2
+void HorizontalAvx2(const int16_t* in, const Contributions& contributions, int16_t* out) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i round = _mm_set1_epi32(kWeightRound);
+    int taps = contributions.taps;
+    for (size_t x = 0; x < contributions.starts.size(); ++x, out += 4) {
+        const int16_t* p = in + static_cast<size_t>(contributions.starts[x]) * 4;
+        const int32_t* w = &contributions.wide[x * taps * 2];
+        __m256i sum = _mm256_setzero_si256();
+        // Four taps per step: each 128-bit lane handles one pair
+        for (int k = 0; k < taps; k += 4, p += 16, w += 8) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+            __m256i pairs = _mm256_unpacklo_epi16(pixels, _mm256_srli_si256(pixels, 8));
+            sum = _mm256_add_epi32(sum, _mm256_madd_epi16(pairs, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(w))));
+        }
+        __m128i total = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+        total = _mm_srai_epi32(_mm_add_epi32(total, round), kWeightBits);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_max_epi16(_mm_packs_epi32(total, total), zero));
+    }
+}
+
+NAVIGRAB_TARGET_AVX2
+void VerticalAvx2(const int16_t* const* rows, const int32_t* pairs, int taps, int length, int16_t* out) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i round = _mm256_set1_epi32(kWeightRound);
+    for (int i = 0; i < length; i += 16) {
+        __m256i low = round;
+        __m256i high = round;
+        for (int k = 0; k < taps; k += 2) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k] + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[k + 1] + i));
+            __m256i w = _mm256_set1_epi32(pairs[k / 2]);
+            low = _mm256_add_epi32(low, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+            high = _mm256_add_epi32(high, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+        }
+        // Unpack and pack both work within 128-bit lanes, so the order is kept
+        __m256i packed = _mm256_packs_epi32(_mm256_srai_epi32(low, kWeightBits), _mm256_srai_epi32(high, kWeightBits));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_max_epi16(packed, zero));
+    }
+}
+
+const Kernels kSse2Kernels = {AccumulateSse2, ReduceSse2, ExpandSse2, HorizontalSse2, VerticalSse2, NarrowSse2};
+const Kernels kAvx2Kernels = {AccumulateSse2, ReduceSse2, ExpandSse2, HorizontalAvx2, VerticalAvx2, NarrowSse2};
+#endif
+
+const Kernels& KernelsFor(SimdLevel level) {
+    // Never use more than the CPU has, whatever was asked for
+    level = std::min(level, DetectSimdLevel());
+#if NAVIGRAB_X86
+    if (level == SimdLevel::AVX2) return kAvx2Kernels;
+    if (level == SimdLevel::SSE2) return kSse2Kernels;
+#endif
+    return kScalarKernels;
+}
+
+struct ResampleJob {
+    const Bitmap* source;
+    Bitmap* destination;
+    int factor_x = 0;           // Whole box factors, or 0 for the separable path
+    int factor_y = 0;
+    Contributions horizontal;
+    Contributions vertical;
+    const Kernels* kernels;
+    const GammaTables* gamma;   // Null to filter the stored values directly
+    int row_length;             // int16 values per intermediate row
+};
+
+// Per-thread buffers, kept between calls so steady-state resampling does
+// not allocate
+struct Scratch {
+    std::vector<uint16_t> sums;
+    std::vector<int16_t> input;
+    std::vector<int16_t> rows;
+    std::vector<int16_t> output;
+    std::vector<const int16_t*> row_pointers;
+};
+
+Scratch& ThreadScratch() {
+    thread_local Scratch scratch;
+    return scratch;
+}
+
+// Produces output rows [y0, y1) of a whole-factor box downscale
+void BoxBand(const ResampleJob& job, int y0, int y1) {
+    Scratch& scratch = ThreadScratch();
+    const Kernels& kernels = *job.kernels;
+    int count = job.source->Width() * 4;
+    float scale = 1.0f / static_cast<float>(job.factor_x * job.factor_y);
+    scratch.sums.resize(count);
+    for (int y = y0; y < y1; ++y) {
+        std::fill(scratch.sums.begin(), scratch.sums.end(), uint16_t{0});
+        for (int k = 0; k < job.factor_y; ++k) {
+            kernels.accumulate(job.source->Row(y * job.factor_y + k), scratch.sums.data(), count);
+        }
+        kernels.reduce(scratch.sums.data(), job.destination->Row(y), job.destination->Width(), job.factor_x, scale);
+    }
+}
+
+// Produces output rows [y0, y1): filters the source rows they read
+// horizontally, then combines those rows per output row
+void ResampleBand(const ResampleJob& job, int y0, int y1) {
+    Scratch& scratch = ThreadScratch();
+    const Contributions& vertical = job.vertical;
+    const Kernels& kernels = *job.kernels;
+    int source_width = job.source->Width();
+    int first = vertical.starts[y0];
+    int last = first;
+    for (int y = y0; y < y1; ++y) {
+        first = std::min(first, vertical.starts[y]);
+        last = std::max(last, vertical.starts[y] + vertical.used_taps);
+    }
+    size_t row_length = static_cast<size_t>(job.row_length);
+
+    size_t input_length = static_cast<size_t>(source_width) * 4;
+    scratch.input.resize(input_length + kTapAlignment * 4);
+    std::fill(scratch.input.begin() + input_length, scratch.input.end(), int16_t{0});
+    scratch.rows.resize(static_cast<size_t>(last - first) * row_length);
+    for (int y = first; y < last; ++y) {
+        kernels.expand(job.source->Row(y), scratch.input.data(), static_cast<int>(input_length), job.gamma);
+        kernels.horizontal(scratch.input.data(), job.horizontal, &scratch.rows[(y - first) * row_length]);
+    }
+
+    int taps = vertical.taps;
+    int output_length = job.destination->Width() * 4;
+    scratch.output.resize(row_length);
+    scratch.row_pointers.resize(taps);
+    for (int y = y0; y < y1; ++y) {
+        for (int k = 0; k < taps; ++k) {
+            // Padding taps have zero weight; any row in the band will do
+            int row = std::min(vertical.starts[y] + k, last - 1);
+            scratch.row_pointers[k] = &scratch.rows[(row - first) * row_length];
+        }
+        kernels.vertical(scratch.row_pointers.data(), &vertical.pairs[static_cast<size_t>(y) * taps / 2], taps,
+                         job.row_length, scratch.output.data());
+        kernels.narrow(scratch.output.data(), job.destination->Row(y), output_length, job.gamma);
+    }
+}
+
+} // namespace
+
+bool ResampleBitmap(const Bitmap& source, int width, int height, Bitmap* destination,
+                    const ResampleOptions& options) {
+    if (source.IsEmpty() || destination == &source) return false;
+    if (!destination->Allocate(width, height, source.Format())) return false;
+
+    ResampleJob job;
+    job.source = &source;
+    job.destination = destination;
+    job.kernels = &KernelsFor(options.simd);
+    // Column sums are 16-bit and block totals must be exact as floats
+    bool whole_factors = source.Width() % width == 0 && source.Height() % height == 0;
+    if (options.filter == ResampleFilter::BOX && !options.gamma_correct && whole_factors &&
+        source.Height() / height <= 257 && int64_t{source.Width() / width} * (source.Height() / height) <= 65536) {
+        job.factor_x = source.Width() / width;
+        job.factor_y = source.Height() / height;
+    } else {
+        BuildContributions(source.Width(), width, options.filter, &job.horizontal);
+        BuildContributions(source.Height(), height, options.filter, &job.vertical);
+    }
+    job.gamma = options.gamma_correct ? &GammaTables::Get() : nullptr;
+    job.row_length = (width * 4 + kRowAlignment - 1) / kRowAlignment * kRowAlignment;
+
+    // Bands of output rows bound the intermediate rows held at once; when
+    // threaded there are several bands per thread so uneven ones balance
+    int64_t pixels = static_cast<int64_t>(source.Width()) * source.Height();
+    int threads = pixels >= kParallelResamplePixels
+        ? (options.max_threads > 0 ? options.max_threads : HardwareConcurrency()) : 1;
+    double rows_per_output = static_cast<double>(source.Height()) / height;
+    int band = std::max(1, static_cast<int>(kBandSourceRows / rows_per_output));
+    if (threads > 1) band = std::min(band, std::max(1, height / (threads * 4)));
+    int bands = (height + band - 1) / band;
+    ParallelFor(static_cast<size_t>(bands), threads, [&job, band, height](size_t index) {
+        int y0 = static_cast<int>(index) * band;
+        if (job.factor_x) {
+            BoxBand(job, y0, std::min(height, y0 + band));
+        } else {
+            ResampleBand(job, y0, std::min(height, y0 + band));
+        }
+    });
+    return true;
+}
+
+} // namespace navigrab
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "bitmap.h"
+#include "cpu_features.h"
+
+namespace navigrab {
+
+enum class ResampleFilter {
+    BOX,        // Area average: cheapest, no ringing; nearest neighbour when upscaling
+    BILINEAR,   // Triangle, widened to the scale factor when downscaling
+    LANCZOS3    // Sharpest, with slight ringing at hard edges
+};
+
+struct ResampleOptions {
+    ResampleFilter filter = ResampleFilter::BOX;
+    bool gamma_correct = false;     // Filter color in linear light; alpha is never converted
+    int max_threads = 0;            // 0 = HardwareConcurrency(); only large sources are split
+    SimdLevel simd = DetectSimdLevel();
+};
+
+// Sources with at least this many pixels are resampled on several threads
+constexpr int kParallelResamplePixels = 2 * 1024 * 1024;
+
+// Resamples |source| to |width| x |height| into |destination|, keeping the
+// source's pixel format and reusing the destination's buffer when it fits.
+// Box downscales by whole factors average each block directly; everything
+// else runs a separable fixed-point filter, horizontal then vertical, in
+// bands of output rows so scratch memory stays small for tall sources.
+// Every SIMD level produces identical pixels. False for an empty source, a
+// bad size, or |destination| == &source.
+bool ResampleBitmap(const Bitmap& source, int width, int height, Bitmap* destination,
+                    const ResampleOptions& options = ResampleOptions());
+
+} // namespace navigrab
@@ -0,0 +1,783 @@
+#include "jpeg_encoder.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+#if NAVIGRAB_X86
+#include <immintrin.h>
+#endif
+
+namespace navigrab {
+
+namespace {
+
+// Example tables from Annex K of the standard, in natural (row-major) order
+const uint8_t kLuminanceQuantization[64] = {
+    16, 11, 10, 16, 24,  40,  51,  61,  12, 12, 14, 19, 26,  58,  60,  55,
+    14, 13, 16, 24, 40,  57,  69,  56,  14, 17, 22, 29, 51,  87,  80,  62,
+    18, 22, 37, 56, 68,  109, 103, 77,  24, 35, 55, 64, 81,  104, 113, 92,
+    49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+const uint8_t kChrominanceQuantization[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99,
+    24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+// Natural index of each zigzag position
+const uint8_t kZigzag[64] = {
+    0,  1,  8,  16, 9,  2,  3,  10, 17, 24, 32, 25, 18, 11, 4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6,  7,  14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Huffman tables from Annex K.3: code counts per length, then symbols
+const uint8_t kDcLuminanceBits[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+const uint8_t kDcChrominanceBits[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+const uint8_t kDcValues[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+const uint8_t kAcLuminanceBits[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7d};
+const uint8_t kAcLuminanceValues[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xa1, 0x08, 0x23, 0x42, 0xb1, 0xc1, 0x15, 0x52, 0xd1, 0xf0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0a, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2a, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5, 0xa6, 0xa7,
+    0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3, 0xc4, 0xc5,
+    0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda, 0xe1, 0xe2,
+    0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf1, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa};
+const uint8_t kAcChrominanceBits[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+const uint8_t kAcChrominanceValues[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xa1, 0xb1, 0xc1, 0x09, 0x23, 0x33, 0x52, 0xf0,
+    0x15, 0x62, 0x72, 0xd1, 0x0a, 0x16, 0x24, 0x34, 0xe1, 0x25, 0xf1, 0x17, 0x18, 0x19, 0x1a, 0x26,
+    0x27, 0x28, 0x29, 0x2a, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3a, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4a, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5a, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6a, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7a, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8a, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9a, 0xa2, 0xa3, 0xa4, 0xa5,
+    0xa6, 0xa7, 0xa8, 0xa9, 0xaa, 0xb2, 0xb3, 0xb4, 0xb5, 0xb6, 0xb7, 0xb8, 0xb9, 0xba, 0xc2, 0xc3,
+    0xc4, 0xc5, 0xc6, 0xc7, 0xc8, 0xc9, 0xca, 0xd2, 0xd3, 0xd4, 0xd5, 0xd6, 0xd7, 0xd8, 0xd9, 0xda,
+    0xe2, 0xe3, 0xe4, 0xe5, 0xe6, 0xe7, 0xe8, 0xe9, 0xea, 0xf2, 0xf3, 0xf4, 0xf5, 0xf6, 0xf7, 0xf8,
+    0xf9, 0xfa};
+
+// Code and length of every symbol, assigned canonically from the counts
+struct HuffmanTable {
+    uint16_t code[256] = {};
+    uint8_t size[256] = {};
+
+    HuffmanTable(const uint8_t* bits, const uint8_t* values) {
+        uint32_t next = 0;
+        int k = 0;
+        for (int length = 1; length <= 16; ++length, next <<= 1) {
+            for (int i = 0; i < bits[length - 1]; ++i, ++k, ++next) {
+                code[values[k]] = static_cast<uint16_t>(next);
+                size[values[k]] = static_cast<uint8_t>(length);
+            }
+        }
+    }
+};
+
+struct HuffmanTables {
+    HuffmanTable dc[2] = {{kDcLuminanceBits, kDcValues}, {kDcChrominanceBits, kDcValues}};
+    HuffmanTable ac[2] = {{kAcLuminanceBits, kAcLuminanceValues}, {kAcChrominanceBits, kAcChrominanceValues}};
+};
+
+const HuffmanTables& StandardTables() {
+    static const HuffmanTables tables;
+    return tables;
+}
+
+// JFIF (full-range BT.601) color weights in 14-bit fixed point; each row
+// sums to 1 for Y and to 0 for Cb and Cr
+constexpr int kColorBits = 14;
+constexpr int kYR = 4899, kYG = 9617, kYB = 1868;
+constexpr int kCbR = -2765, kCbG = -5427, kCbB = 8192;
+constexpr int kCrR = 8192, kCrG = -6860, kCrB = -1332;
+// Luma rounds and drops the 128 level shift the DCT wants in one add;
+// chroma rounds just under half so pure blue and red stay within 8 bits
+constexpr int kLumaBias = (1 << (kColorBits - 1)) - (128 << kColorBits);
+constexpr int kChromaBias = (1 << (kColorBits - 1)) - 1;
+
+// Converts |width| RGBA or BGRA pixels into level-shifted Y, Cb and Cr samples
+using ConvertRowFunction = void (*)(const uint8_t* pixels, int width, bool bgra, int16_t* y, int16_t* cb,
+                                    int16_t* cr);
+// Forward DCT of the 8x8 samples at |in|, multiplied by |divisors| and
+// rounded. Coefficients come out transposed: column-major frequencies.
+using FdctFunction = void (*)(const int16_t* in, size_t stride, const float* divisors, int16_t* out);
+// Gathers coefficients into zigzag order and returns a bit per nonzero one
+using ZigzagFunction = uint64_t (*)(const int16_t* coefficients, const uint8_t* zigzag, int16_t* ordered);
+
+void ConvertRowScalar(const uint8_t* pixels, int width, bool bgra, int16_t* y, int16_t* cb, int16_t* cr) {
+    const int red = bgra ? 2 : 0;
+    const int blue = bgra ? 0 : 2;
+    for (int x = 0; x < width; ++x, pixels += kBytesPerPixel) {
+        int r = pixels[red];
+        int g = pixels[1];
+        int b = pixels[blue];
+        y[x] = static_cast<int16_t>((kYR * r + kYG * g + kYB * b + kLumaBias) >> kColorBits);
+        cb[x] = static_cast<int16_t>((kCbR * r + kCbG * g + kCbB * b + kChromaBias) >> kColorBits);
+        cr[x] = static_cast<int16_t>((kCrR * r + kCrG * g + kCrB * b + kChromaBias) >> kColorBits);
+    }
+}
+
+// One pass of the Arai-Agui-Nakajima DCT over eight values, as in libjpeg's
+// jfdctflt. Outputs are scaled per frequency; the divisors undo it.
+template <typename V>
+inline void Fdct8(V* d) {
+    V tmp0 = d[0] + d[7];
+    V tmp7 = d[0] - d[7];
+    V tmp1 = d[1] + d[6];
+    V tmp6 = d[1] - d[6];
+    V tmp2 = d[2] + d[5];
+    V tmp5 = d[2] - d[5];
+    V tmp3 = d[3] + d[4];
+    V tmp4 = d[3] - d[4];
+
+    V tmp10 = tmp0 + tmp3;
+    V tmp13 = tmp0 - tmp3;
+    V tmp11 = tmp1 + tmp2;
+    V tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4] = tmp10 - tmp11;
+    V z1 = (tmp12 + tmp13) * V(0.707106781f);
+    d[2] = tmp13 + z1;
+    d[6] = tmp13 - z1;
+
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    V z5 = (tmp10 - tmp12) * V(0.382683433f);
+    V z2 = V(0.541196100f) * tmp10 + z5;
+    V z4 = V(1.306562965f) * tmp12 + z5;
+    V z3 = tmp11 * V(0.707106781f);
+    V z11 = tmp7 + z3;
+    V z13 = tmp7 - z3;
+    d[5] = z13 + z2;
+    d[3] = z13 - z2;
+    d[1] = z11 + z4;
+    d[7] = z11 - z4;
+}
+
+void FdctQuantizeScalar(const int16_t* in, size_t stride, const float* divisors, int16_t* out) {
+    // Columns, then rows, in the same order of operations as the SIMD version
+    float block[64];
+    for (int x = 0; x < 8; ++x) {
+        float d[8];
+        for (int y = 0; y < 8; ++y) d[y] = in[y * stride + x];
+        Fdct8(d);
+        for (int u = 0; u < 8; ++u) block[u * 8 + x] = d[u];
+    }
+    for (int u = 0; u < 8; ++u) {
+        float* d = block + u * 8;
+        Fdct8(d);
+        for (int v = 0; v < 8; ++v) {
+            out[v * 8 + u] = static_cast<int16_t>(std::lrint(d[v] * divisors[v * 8 + u]));
+        }
+    }
+}
+
+uint64_t ZigzagScalar(const int16_t* coefficients, const uint8_t* zigzag, int16_t* ordered) {
+    uint64_t nonzero = 0;
+    for (int k = 0; k < 64; ++k) {
+        ordered[k] = coefficients[zigzag[k]];
+        nonzero |= uint64_t{ordered[k] != 0} << k;
+    }
+    return nonzero;
+}
+
+#if NAVIGRAB_X86
+// pmaddwd weights for a 16-bit (low, high) pair
+inline int32_t WeightPair(int low, int high) {
+    return static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(high)) << 16) |
+                                static_cast<uint16_t>(low));
+}
+
+// Each 32-bit pixel splits into 16-bit (R, B) and (G, A) pairs, so one
+// pmaddwd per pair weighs and sums a whole channel
+struct ColorWeights {
+    int32_t rb[3];
+    int32_t g[3];
+
+    explicit ColorWeights(bool bgra) {
+        const int weights[3][3] = {{kYR, kYG, kYB}, {kCbR, kCbG, kCbB}, {kCrR, kCrG, kCrB}};
+        for (int c = 0; c < 3; ++c) {
+            rb[c] = bgra ? WeightPair(weights[c][2], weights[c][0]) : WeightPair(weights[c][0], weights[c][2]);
+            g[c] = WeightPair(weights[c][1], 0);
+        }
+    }
+};
+
+inline __m128i WeighSse2(__m128i rb, __m128i ga, int32_t rb_weight, int32_t g_weight, int bias) {
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(rb, _mm_set1_epi32(rb_weight)), _mm_madd_epi16(ga, _mm_set1_epi32(g_weight)));
+    return _mm_srai_epi32(_mm_add_epi32(sum, _mm_set1_epi32(bias)), kColorBits);
+}
+
+void ConvertRowSse2(const uint8_t* pixels, int width, bool bgra, int16_t* y, int16_t* cb, int16_t* cr) {
+    const ColorWeights weights(bgra);
+    const __m128i mask = _mm_set1_epi32(0x00FF00FF);
+    int16_t* planes[3] = {y, cb, cr};
+    const int biases[3] = {kLumaBias, kChromaBias, kChromaBias};
+    int x = 0;
+    for (; x + 8 <= width; x += 8) {
+        __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x * kBytesPerPixel));
+        __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + x * kBytesPerPixel + 16));
+        __m128i rb_low = _mm_and_si128(low, mask);
+        __m128i ga_low = _mm_and_si128(_mm_srli_epi32(low, 8), mask);
+        __m128i rb_high = _mm_and_si128(high, mask);
+        __m128i ga_high = _mm_and_si128(_mm_srli_epi32(high, 8), mask);
+        for (int c = 0; c < 3; ++c) {
+            __m128i first = WeighSse2(rb_low, ga_low, weights.rb[c], weights.g[c], biases[c]);
+            __m128i second = WeighSse2(rb_high, ga_high, weights.rb[c], weights.g[c], biases[c]);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[c] + x), _mm_packs_epi32(first, second));
+        }
+    }
+    ConvertRowScalar(pixels + x * kBytesPerPixel, width - x, bgra, y + x, cb + x, cr + x);
+}
+
+NAVIGRAB_TARGET_AVX2
+void ConvertRowAvx2(const uint8_t* pixels, int width, bool bgra, int16_t* y, int16_t* cb, int16_t* cr) {
+    const ColorWeights weights(bgra);
+    const __m256i mask = _mm256_set1_epi32(0x00FF00FF);
+    int16_t* planes[3] = {y, cb, cr};
+    const int biases[3] = {kLumaBias, kChromaBias, kChromaBias};
+    int x = 0;
+    for (; x + 16 <= width; x += 16) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + x * kBytesPerPixel));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + x * kBytesPerPixel + 32));
+        __m256i rb_low = _mm256_and_si256(low, mask);
+        __m256i ga_low = _mm256_and_si256(_mm256_srli_epi32(low, 8), mask);
+        __m256i rb_high = _mm256_and_si256(high, mask);
+        __m256i ga_high = _mm256_and_si256(_mm256_srli_epi32(high, 8), mask);
+        for (int c = 0; c < 3; ++c) {
+            __m256i rb_weight = _mm256_set1_epi32(weights.rb[c]);
+            __m256i g_weight = _mm256_set1_epi32(weights.g[c]);
+            __m256i bias = _mm256_set1_epi32(biases[c]);
+            __m256i first = _mm256_add_epi32(_mm256_madd_epi16(rb_low, rb_weight), _mm256_madd_epi16(ga_low, g_weight));
+            __m256i second = _mm256_add_epi32(_mm256_madd_epi16(rb_high, rb_weight), _mm256_madd_epi16(ga_high, g_weight));
+            first = _mm256_srai_epi32(_mm256_add_epi32(first, bias), kColorBits);
+            second = _mm256_srai_epi32(_mm256_add_epi32(second, bias), kColorBits);
+            // Packing interleaves the 128-bit lanes; the permute puts them back in order
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(first, second), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(planes[c] + x), packed);
+        }
+    }
+    ConvertRowSse2(pixels + x * kBytesPerPixel, width - x, bgra, y + x, cb + x, cr + x);
+}
+
+// Four floats with the operators Fdct8 needs
+struct Float4 {
+    __m128 v;
+    Float4() = default;
+    Float4(__m128 value) : v(value) {}
+    explicit Float4(float value) : v(_mm_set1_ps(value)) {}
+};
+inline Float4 operator+(Float4 a, Float4 b) { return _mm_add_ps(a.v, b.v); }
+inline Float4 operator-(Float4 a, Float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline Float4 operator*(Float4 a, Float4 b) { return _mm_mul_ps(a.v, b.v); }
+
+void FdctQuantizeSse2(const int16_t* in, size_t stride, const float* divisors, int16_t* out) {
+    // Rows hold columns 0-3 and 4-7 in two vectors, so the column pass is
+    // plain vertical arithmetic, four columns at a time
+    Float4 left[8];
+    Float4 right[8];
+    for (int y = 0; y < 8; ++y) {
+        __m128i row = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + y * stride));
+        left[y] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(row, row), 16));
+        right[y] = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(row, row), 16));
+    }
+    Fdct8(left);
+    Fdct8(right);
+
+    // Transposing the four 4x4 quarters turns the row pass vertical too
+    _MM_TRANSPOSE4_PS(left[0].v, left[1].v, left[2].v, left[3].v);
+    _MM_TRANSPOSE4_PS(left[4].v, left[5].v, left[6].v, left[7].v);
+    _MM_TRANSPOSE4_PS(right[0].v, right[1].v, right[2].v, right[3].v);
+    _MM_TRANSPOSE4_PS(right[4].v, right[5].v, right[6].v, right[7].v);
+    Float4 top[8] = {left[0], left[1], left[2], left[3], right[0], right[1], right[2], right[3]};
+    Float4 bottom[8] = {left[4], left[5], left[6], left[7], right[4], right[5], right[6], right[7]};
+    Fdct8(top);
+    Fdct8(bottom);
+
+    for (int v = 0; v < 8; ++v) {
+        __m128i first = _mm_cvtps_epi32(_mm_mul_ps(top[v].v, _mm_loadu_ps(divisors + v * 8)));
+        __m128i second = _mm_cvtps_epi32(_mm_mul_ps(bottom[v].v, _mm_loadu_ps(divisors + v * 8 + 4)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + v * 8), _mm_packs_epi32(first, second));
+    }
+}
+
+uint64_t ZigzagSse2(const int16_t* coefficients, const uint8_t* zigzag, int16_t* ordered) {
+    for (int k = 0; k < 64; ++k) ordered[k] = coefficients[zigzag[k]];
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t nonzero = 0;
+    for (int k = 0; k < 64; k += 16) {
+        __m128i low = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ordered + k)), zero);
+        __m128i high = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ordered + k + 8)), zero);
+        uint32_t zeros = static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(low, high)));
+        nonzero |= uint64_t{~zeros & 0xFFFF} << k;
+    }
+    return nonzero;
+}
+#endif
+
+struct Kernels {
+    ConvertRowFunction convert;
+    FdctFunction fdct;
+    ZigzagFunction zigzag;
+};
+
+const Kernels kScalarKernels = {ConvertRowScalar, FdctQuantizeScalar, ZigzagScalar};
+#if NAVIGRAB_X86
+const Kernels kSse2Kernels = {ConvertRowSse2, FdctQuantizeSse2, ZigzagSse2};
+const Kernels kAvx2Kernels = {ConvertRowAvx2, FdctQuantizeSse2, ZigzagSse2};
+#endif
+
+const Kernels& KernelsFor(SimdLevel level) {
+    level = std::min(level, DetectSimdLevel());
+#if NAVIGRAB_X86
+    if (level == SimdLevel::AVX2) return kAvx2Kernels;
+    if (level == SimdLevel::SSE2) return kSse2Kernels;
+#endif
+    return kScalarKernels;
+}
+
+// Most bytes one block can take: 64 codes of at most 27 bits, every byte stuffed
+constexpr size_t kMaxBlockBytes = 512;
+
+// MSB-first bit writer for entropy-coded data. Whole 32-bit words go out at
+// once unless one holds an 0xFF byte, which needs a stuffed zero after it
+// so it cannot read as a marker.
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<uint8_t>* out) : out_(out), data_(out->data()), size_(out->size()) {}
+
+    // Makes room for one more block
+    void Reserve() {
+        if (size_ + kMaxBlockBytes > out_->size()) {
+            out_->resize(std::max(out_->size() * 2, size_ + kMaxBlockBytes));
+            data_ = out_->data();
+        }
+    }
+    // |bits| holds |count| <= 32 bits
+    void Put(uint32_t bits, int count) {
+        buffer_ = (buffer_ << count) | bits;
+        count_ += count;
+        if (count_ >= 32) {
+            count_ -= 32;
+            uint32_t word = static_cast<uint32_t>(buffer_ >> count_);
+            uint8_t* data = data_ + size_;
+            if (((~word - 0x01010101u) & word & 0x80808080u) == 0) {
+                data[0] = static_cast<uint8_t>(word >> 24);
+                data[1] = static_cast<uint8_t>(word >> 16);
+                data[2] = static_cast<uint8_t>(word >> 8);
+                data[3] = static_cast<uint8_t>(word);
+                size_ += 4;
+            } else {
+                for (int shift = 24; shift >= 0; shift -= 8) PutByte(static_cast<uint8_t>(word >> shift));
+            }
+        }
+    }
+    // Pads the last byte with one bits, as the standard asks, and trims the
+    // output to what was written
+    void Flush() {
+        Reserve();
+        int pad = (8 - count_ % 8) % 8;
+        buffer_ = (buffer_ << pad) | ((1u << pad) - 1);
+        count_ += pad;
+        for (; count_ > 0; count_ -= 8) PutByte(static_cast<uint8_t>(buffer_ >> (count_ - 8)));
+        out_->resize(size_);
+    }
+
+private:
+    void PutByte(uint8_t byte) {
+        data_[size_++] = byte;
+        if (byte == 0xFF) data_[size_++] = 0;
+    }
+
+    std::vector<uint8_t>* out_;
+    uint8_t* data_;
+    size_t size_;
+    uint64_t buffer_ = 0;
+    int count_ = 0;
+};
+
+inline int BitLength(uint32_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return value ? 32 - __builtin_clz(value) : 0;
+#else
+    int length = 0;
+    for (; value; value >>= 1) ++length;
+    return length;
+#endif
+}
+
+inline int CountTrailingZeros(uint64_t value) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(value);
+#else
+    int count = 0;
+    for (; !(value & 1); value >>= 1) ++count;
+    return count;
+#endif
+}
+
+// Writes the symbol for |run| zeros then |value|, followed by the value's bits
+inline void PutValue(BitWriter& writer, const HuffmanTable& table, int run, int value) {
+    int length = BitLength(static_cast<uint32_t>(value < 0 ? -value : value));
+    uint32_t extra = static_cast<uint32_t>(value < 0 ? value - 1 : value) & ((1u << length) - 1);
+    int symbol = (run << 4) | length;
+    writer.Put((uint32_t{table.code[symbol]} << length) | extra, table.size[symbol] + length);
+}
+
+// Zigzag positions in the transposed layout the DCT kernels produce
+struct TransposedZigzag {
+    uint8_t index[64];
+    TransposedZigzag() {
+        for (int k = 0; k < 64; ++k) index[k] = static_cast<uint8_t>((kZigzag[k] % 8) * 8 + kZigzag[k] / 8);
+    }
+};
+
+const TransposedZigzag kTransposedZigzag;
+
+void EncodeBlock(BitWriter& block_writer, const int16_t* coefficients, const Kernels& kernels, int* last_dc,
+                 const HuffmanTable& dc, const HuffmanTable& ac) {
+    // A bit per nonzero coefficient lets the runs of zeros, most of a
+    // block, be skipped a whole run at a time
+    alignas(16) int16_t ordered[64];
+    uint64_t nonzero = kernels.zigzag(coefficients, kTransposedZigzag.index, ordered);
+
+    // A local copy stays in registers; stores through the output bytes
+    // would otherwise force the writer state to be reloaded after each byte
+    block_writer.Reserve();
+    BitWriter writer = block_writer;
+    PutValue(writer, dc, 0, ordered[0] - *last_dc);
+    *last_dc = ordered[0];
+    int previous = 0;
+    for (nonzero &= ~uint64_t{1}; nonzero; nonzero &= nonzero - 1) {
+        int k = CountTrailingZeros(nonzero);
+        int run = k - previous - 1;
+        for (; run > 15; run -= 16) writer.Put(ac.code[0xF0], ac.size[0xF0]);
+        PutValue(writer, ac, run, ordered[k]);
+        previous = k;
+    }
+    if (previous < 63) writer.Put(ac.code[0x00], ac.size[0x00]);
+    block_writer = writer;
+}
+
+// Libjpeg's quality scaling: 50 keeps the example tables, 100 is all ones
+void ScaleQuantization(const uint8_t* base, int quality, uint8_t* table) {
+    quality = std::clamp(quality, 1, 100);
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; ++i) table[i] = static_cast<uint8_t>(std::clamp((base[i] * scale + 50) / 100, 1, 255));
+}
+
+// Reciprocals of the quantizer times the AAN scale of each frequency, in
+// the kernels' transposed layout
+void ComputeDivisors(const uint8_t* table, float* divisors) {
+    static const double kAanScale[8] = {1.0,         1.387039845, 1.306562965, 1.175875602,
+                                        1.0,         0.785694958, 0.541196100, 0.275899379};
+    for (int u = 0; u < 8; ++u) {
+        for (int v = 0; v < 8; ++v) {
+            divisors[v * 8 + u] = static_cast<float>(1.0 / (table[u * 8 + v] * kAanScale[u] * kAanScale[v] * 8.0));
+        }
+    }
+}
+
+struct ScanLayout {
+    int width = 0;
+    int height = 0;
+    int h = 1;              // Luma blocks per MCU across and down; chroma has one each
+    int v = 1;
+    int mcu_width = 8;
+    int mcu_height = 8;
+    int mcus_across = 0;
+    int mcus_down = 0;
+    float divisors[2][64];
+};
+
+// Averages full-resolution chroma down to one sample per |h| x |v|, with the
+// alternating bias libjpeg uses so rounding does not drift one way
+void Downsample(const int16_t* in, int stride, int rows, int h, int v, int16_t* out) {
+    int out_stride = stride / h;
+    for (int y = 0; y < rows / v; ++y) {
+        const int16_t* top = in + static_cast<size_t>(y * v) * stride;
+        const int16_t* bottom = top + (v == 2 ? stride : 0);
+        int16_t* row = out + static_cast<size_t>(y) * out_stride;
+        if (v == 2) {
+            for (int x = 0; x < out_stride; ++x) {
+                row[x] = static_cast<int16_t>((top[2 * x] + top[2 * x + 1] + bottom[2 * x] + bottom[2 * x + 1] + 1 + (x & 1)) >> 2);
+            }
+        } else {
+            for (int x = 0; x < out_stride; ++x) row[x] = static_cast<int16_t>((top[2 * x] + top[2 * x + 1] + (x & 1)) >> 1);
+        }
+    }
+}
+
+// Entropy-codes MCU rows [first, last) of |bitmap| onto |out|, with DC
+// prediction starting afresh as it does after a restart marker. |bitmap|
+// may be a strip of the image; its last row repeats down to whole MCUs.
+void EncodeMcuRows(const Bitmap& bitmap, const ScanLayout& layout, const Kernels& kernels, int first, int last,
+                   std::vector<uint8_t>* out) {
+    const HuffmanTables& tables = StandardTables();
+    const bool bgra = bitmap.Format() == PixelFormat::BGRA_8888;
+    const bool subsampled = layout.h > 1 || layout.v > 1;
+    const int stride = layout.mcus_across * layout.mcu_width;
+    const int chroma_stride = stride / layout.h;
+    const size_t plane = static_cast<size_t>(stride) * layout.mcu_height;
+    const size_t chroma_plane = static_cast<size_t>(chroma_stride) * 8;
+
+    // Y, Cb and Cr for one MCU row, then the downsampled Cb and Cr
+    thread_local std::vector<int16_t> scratch;
+    scratch.resize(plane * 3 + (subsampled ? chroma_plane * 2 : 0));
+    int16_t* y = scratch.data();
+    int16_t* cb = y + plane;
+    int16_t* cr = cb + plane;
+    int16_t* small_cb = subsampled ? cr + plane : cb;
+    int16_t* small_cr = subsampled ? small_cb + chroma_plane : cr;
+
+    BitWriter writer(out);
+    int dc[3] = {0, 0, 0};
+    alignas(16) int16_t coefficients[64];
+    for (int row = first; row < last; ++row) {
+        for (int line = 0; line < layout.mcu_height; ++line) {
+            // Edges repeat the last column and row out to whole MCUs
+            int source = std::min(row * layout.mcu_height + line, bitmap.Height() - 1);
+            size_t offset = static_cast<size_t>(line) * stride;
+            kernels.convert(bitmap.Row(source), layout.width, bgra, y + offset, cb + offset, cr + offset);
+            for (int x = layout.width; x < stride; ++x) {
+                y[offset + x] = y[offset + layout.width - 1];
+                cb[offset + x] = cb[offset + layout.width - 1];
+                cr[offset + x] = cr[offset + layout.width - 1];
+            }
+        }
+        if (subsampled) {
+            Downsample(cb, stride, layout.mcu_height, layout.h, layout.v, small_cb);
+            Downsample(cr, stride, layout.mcu_height, layout.h, layout.v, small_cr);
+        }
+
+        for (int mcu = 0; mcu < layout.mcus_across; ++mcu) {
+            for (int by = 0; by < layout.v; ++by) {
+                for (int bx = 0; bx < layout.h; ++bx) {
+                    const int16_t* block = y + static_cast<size_t>(by * 8) * stride + mcu * layout.mcu_width + bx * 8;
+                    kernels.fdct(block, stride, layout.divisors[0], coefficients);
+                    EncodeBlock(writer, coefficients, kernels, &dc[0], tables.dc[0], tables.ac[0]);
+                }
+            }
+            kernels.fdct(small_cb + mcu * 8, chroma_stride, layout.divisors[1], coefficients);
+            EncodeBlock(writer, coefficients, kernels, &dc[1], tables.dc[1], tables.ac[1]);
+            kernels.fdct(small_cr + mcu * 8, chroma_stride, layout.divisors[1], coefficients);
+            EncodeBlock(writer, coefficients, kernels, &dc[2], tables.dc[1], tables.ac[1]);
+        }
+    }
+    writer.Flush();
+}
+
+void AppendMarker(std::vector<uint8_t>* out, uint8_t marker) {
+    out->push_back(0xFF);
+    out->push_back(marker);
+}
+
+void AppendWord(std::vector<uint8_t>* out, int value) {
+    out->push_back(static_cast<uint8_t>(value >> 8));
+    out->push_back(static_cast<uint8_t>(value));
+}
+
+void AppendHuffmanTable(std::vector<uint8_t>* out, int id, const uint8_t* bits, const uint8_t* values) {
+    out->push_back(static_cast<uint8_t>(id));
+    int count = 0;
+    for (int i = 0; i < 16; ++i) count += bits[i];
+    out->insert(out->end(), bits, bits + 16);
+    out->insert(out->end(), values, values + count);
+}
+
+// Everything up to the entropy-coded data: SOI, JFIF, tables, frame and scan headers
+void AppendHeaders(std::vector<uint8_t>* out, const ScanLayout& layout, const uint8_t tables[2][64],
+                   int restart_interval) {
+    AppendMarker(out, 0xD8);
+
+    const uint8_t jfif[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};  // 1.01, 1:1 aspect, no thumbnail
+    AppendMarker(out, 0xE0);
+    AppendWord(out, 2 + sizeof(jfif));
+    out->insert(out->end(), jfif, jfif + sizeof(jfif));
+
+    AppendMarker(out, 0xDB);
+    AppendWord(out, 2 + 2 * 65);
+    for (int t = 0; t < 2; ++t) {
+        out->push_back(static_cast<uint8_t>(t));
+        for (int k = 0; k < 64; ++k) out->push_back(tables[t][kZigzag[k]]);
+    }
+
+    AppendMarker(out, 0xC0);
+    AppendWord(out, 8 + 3 * 3);
+    out->push_back(8);
+    AppendWord(out, layout.height);
+    AppendWord(out, layout.width);
+    out->push_back(3);
+    const uint8_t components[9] = {1, static_cast<uint8_t>(layout.h << 4 | layout.v), 0, 2, 0x11, 1, 3, 0x11, 1};
+    out->insert(out->end(), components, components + 9);
+
+    AppendMarker(out, 0xC4);
+    AppendWord(out, 2 + 4 * 17 + 2 * 12 + 2 * 162);
+    AppendHuffmanTable(out, 0x00, kDcLuminanceBits, kDcValues);
+    AppendHuffmanTable(out, 0x10, kAcLuminanceBits, kAcLuminanceValues);
+    AppendHuffmanTable(out, 0x01, kDcChrominanceBits, kDcValues);
+    AppendHuffmanTable(out, 0x11, kAcChrominanceBits, kAcChrominanceValues);
+
+    if (restart_interval > 0) {
+        AppendMarker(out, 0xDD);
+        AppendWord(out, 4);
+        AppendWord(out, restart_interval);
+    }
+
+    AppendMarker(out, 0xDA);
+    AppendWord(out, 6 + 2 * 3);
+    const uint8_t scan[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    out->insert(out->end(), scan, scan + sizeof(scan));
+}
+
+// MCU rows per band when a large image is split; with the 16-bit restart
+// interval this caps bands for very wide images
+constexpr int kBandMcuRows = 16;
+
+bool PrepareLayout(int width, int height, const JpegOptions& options, ScanLayout* layout, uint8_t tables[2][64]) {
+    if (width <= 0 || height <= 0 || width > 65535 || height > 65535) return false;
+    layout->width = width;
+    layout->height = height;
+    layout->h = options.subsampling == ChromaSubsampling::YUV444 ? 1 : 2;
+    layout->v = options.subsampling == ChromaSubsampling::YUV420 ? 2 : 1;
+    layout->mcu_width = 8 * layout->h;
+    layout->mcu_height = 8 * layout->v;
+    layout->mcus_across = (width + layout->mcu_width - 1) / layout->mcu_width;
+    layout->mcus_down = (height + layout->mcu_height - 1) / layout->mcu_height;
+
+    ScaleQuantization(kLuminanceQuantization, options.quality, tables[0]);
+    ScaleQuantization(kChrominanceQuantization, options.quality, tables[1]);
+    ComputeDivisors(tables[0], layout->divisors[0]);
+    ComputeDivisors(tables[1], layout->divisors[1]);
+    return true;
+}
+
+// Encodes |bitmap|'s MCU rows in bands of |band_rows| on separate threads
+// and appends them in order. |bands_written| counts bands across calls so
+// every band after the image's first is preceded by the next restart marker.
+void EncodeBands(const Bitmap& bitmap, const ScanLayout& layout, const Kernels& kernels, int band_rows,
+                 int max_threads, int* bands_written, std::vector<uint8_t>* out) {
+    int mcu_rows = (bitmap.Height() + layout.mcu_height - 1) / layout.mcu_height;
+    int bands = (mcu_rows + band_rows - 1) / band_rows;
+    if (bands == 1) {
+        if (*bands_written > 0) AppendMarker(out, static_cast<uint8_t>(0xD0 + (*bands_written - 1) % 8));
+        out->reserve(out->size() + static_cast<size_t>(layout.width) * bitmap.Height() / 4 + 2);
+        EncodeMcuRows(bitmap, layout, kernels, 0, mcu_rows, out);
+        ++*bands_written;
+        return;
+    }
+
+    // Pieces are kept per calling thread; workers see them through a reference
+    thread_local std::vector<std::vector<uint8_t>> kept_pieces;
+    std::vector<std::vector<uint8_t>>& pieces = kept_pieces;
+    if (pieces.size() < static_cast<size_t>(bands)) pieces.resize(bands);
+    int threads = max_threads > 0 ? max_threads : HardwareConcurrency();
+    ParallelFor(bands, threads, [&](size_t band) {
+        int first = static_cast<int>(band) * band_rows;
+        std::vector<uint8_t>& piece = pieces[band];
+        piece.clear();
+        EncodeMcuRows(bitmap, layout, kernels, first, std::min(mcu_rows, first + band_rows), &piece);
+    });
+
+    size_t total = 0;
+    for (int band = 0; band < bands; ++band) total += pieces[band].size() + 2;
+    out->reserve(out->size() + total + 2);
+    for (int band = 0; band < bands; ++band) {
+        if (*bands_written > 0) AppendMarker(out, static_cast<uint8_t>(0xD0 + (*bands_written - 1) % 8));
+        out->insert(out->end(), pieces[band].begin(), pieces[band].end());
+        ++*bands_written;
+    }
+}
+
+} // namespace
+
+bool EncodeJpeg(const Bitmap& bitmap, std::vector<uint8_t>* out, const JpegOptions& options) {
+    out->clear();
+    ScanLayout layout;
+    uint8_t tables[2][64];
+    if (bitmap.IsEmpty() || !PrepareLayout(bitmap.Width(), bitmap.Height(), options, &layout, tables)) return false;
+
+    // Banding depends only on the image, never on the thread count
+    int band_rows = layout.mcus_down;
+    if (static_cast<int64_t>(layout.width) * layout.height >= kParallelJpegPixels) {
+        band_rows = std::clamp(65535 / layout.mcus_across, 1, kBandMcuRows);
+    }
+    int bands = (layout.mcus_down + band_rows - 1) / band_rows;
+    AppendHeaders(out, layout, tables, bands > 1 ? band_rows * layout.mcus_across : 0);
+    int bands_written = 0;
+    EncodeBands(bitmap, layout, KernelsFor(options.simd), band_rows, options.max_threads, &bands_written, out);
+    AppendMarker(out, 0xD9);
+    return true;
+}
+
+class JpegStripEncoder::Impl {
+public:
+    ScanLayout layout;
+    JpegOptions options;
+    int strip_rows = 0;
+    int band_rows = 0;
+    int rows_added = 0;
+    int bands_written = 0;
+};
+
+JpegStripEncoder::JpegStripEncoder() : impl_(std::make_unique<Impl>()) {}
+
+JpegStripEncoder::~JpegStripEncoder() = default;
+
+bool JpegStripEncoder::Begin(int width, int height, int strip_rows, const JpegOptions& options,
+                             std::vector<uint8_t>* out) {
+    Impl& impl = *impl_;
+    impl = Impl();
+    uint8_t tables[2][64];
+    if (!PrepareLayout(width, height, options, &impl.layout, tables)) return false;
+    const ScanLayout& layout = impl.layout;
+    if (strip_rows <= 0 || strip_rows % layout.mcu_height != 0) return false;
+
+    // Bands are the largest divisor of a strip's MCU rows that fits both
+    // kBandMcuRows and the restart interval, so no band spans two strips
+    int strip_mcu_rows = strip_rows / layout.mcu_height;
+    int limit = std::clamp(65535 / layout.mcus_across, 1, kBandMcuRows);
+    int band_rows = 1;
+    for (int rows = std::min(limit, strip_mcu_rows); rows > 1; --rows) {
+        if (strip_mcu_rows % rows == 0) {
+            band_rows = rows;
+            break;
+        }
+    }
+    int bands = (layout.mcus_down + band_rows - 1) / band_rows;
+
+    impl.options = options;
+    impl.strip_rows = strip_rows;
+    impl.band_rows = band_rows;
+    AppendHeaders(out, layout, tables, bands > 1 ? band_rows * layout.mcus_across : 0);
+    return true;
+}
+
+bool JpegStripEncoder::AddRows(const Bitmap& strip, std::vector<uint8_t>* out) {
+    Impl& impl = *impl_;
+    const ScanLayout& layout = impl.layout;
+    int remaining = layout.height - impl.rows_added;
+    if (impl.strip_rows == 0 || strip.IsEmpty() || strip.Width() != layout.width || strip.Height() > remaining ||
+        (strip.Height() < remaining && strip.Height() != impl.strip_rows)) {
+        return false;
+    }
+    EncodeBands(strip, layout, KernelsFor(impl.options.simd), impl.band_rows, impl.options.max_threads,
+                &impl.bands_written, out);
+    impl.rows_added += strip.Height();
+    return true;
+}
+
+bool JpegStripEncoder::Finish(std::vector<uint8_t>* out) {
+    Impl& impl = *impl_;
+    if (impl.strip_rows == 0 || impl.rows_added != impl.layout.height) return false;
+    AppendMarker(out, 0xD9);
+    impl.strip_rows = 0;
+    return true;
+}
+
+} // namespace navigrab
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bitmap.h"
+#include "cpu_features.h"
+
+namespace navigrab {
+
+// 1-100; scales the example tables of the JPEG standard the way libjpeg does
+constexpr int kDefaultJpegQuality = 90;
+
+enum class ChromaSubsampling {
+    YUV444,     // Full-resolution color: sharpest colored text, largest files
+    YUV422,     // Color halved horizontally
+    YUV420      // Color halved both ways: the usual choice for photos and pages
+};
+
+struct JpegOptions {
+    int quality = kDefaultJpegQuality;
+    ChromaSubsampling subsampling = ChromaSubsampling::YUV420;
+    int max_threads = 0;    // 0 = HardwareConcurrency(); only large images are split
+    SimdLevel simd = DetectSimdLevel();
+};
+
+// Images with at least this many pixels are encoded in bands on several threads
+constexpr int kParallelJpegPixels = 1024 * 1024;
+
+// Encodes |bitmap| into |out| as baseline JFIF (8-bit YCbCr, the standard's
+// Huffman tables), replacing its contents but reusing its capacity. Alpha is
+// dropped. Rows are converted to YCbCr and transformed one MCU row at a time,
+// so scratch memory stays small for tall pages; large images are cut into
+// bands of MCU rows separated by restart markers, which encode on separate
+// threads. Every SIMD level and thread count produces identical bytes.
+bool EncodeJpeg(const Bitmap& bitmap, std::vector<uint8_t>* out, const JpegOptions& options = JpegOptions());
+
+// Encodes a JPEG whose rows arrive in strips, top to bottom, for images too
+// tall to hold at once. Each strip is a whole number of restart intervals,
+// so strips encode independently and only one is in memory at a time. The
+// output matches EncodeJpeg's except for where the restart markers fall.
+class JpegStripEncoder {
+public:
+    JpegStripEncoder();
+    ~JpegStripEncoder();
+
+    // Appends the headers of a |width| x |height| image to |out|. Every strip
+    // but the last has |strip_rows| rows, which must be a multiple of 16.
+    bool Begin(int width, int height, int strip_rows, const JpegOptions& options, std::vector<uint8_t>* out);
+    // Appends the entropy-coded data of the next strip
+    bool AddRows(const Bitmap& strip, std::vector<uint8_t>* out);
+    // Appends the end marker; false unless every row was added
+    bool Finish(std::vector<uint8_t>* out);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> impl_;
+};
+
+} // namespace navigrab
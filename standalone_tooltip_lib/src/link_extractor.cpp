@@ -0,0 +1,415 @@
+#include "link_extractor.h"
+#include "html_tokenizer.h"
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <unordered_set>
+
+namespace navigrab {
+
+namespace {
+
+bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+int HexValue(char c) {
+    if (IsDigit(c)) return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool IsUnreserved(char c) {
+    return IsAlpha(c) || IsDigit(c) || c == '-' || c == '.' || c == '_' || c == '~';
+}
+
+// string_view::find_first_of runs memchr once per character; URL pieces are
+// short, so a plain loop is several times faster.
+template <typename Predicate>
+size_t FindIf(std::string_view text, Predicate predicate) {
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (predicate(text[i])) return i;
+    }
+    return std::string_view::npos;
+}
+
+// A reference split into its RFC 3986 components. Views point into the
+// string that was split.
+struct UrlParts {
+    std::string_view scheme;
+    std::string_view authority;
+    std::string_view path;
+    std::string_view query;
+    bool has_scheme = false;
+    bool has_authority = false;
+    bool has_query = false;
+};
+
+UrlParts SplitUrl(std::string_view url) {
+    UrlParts parts;
+    size_t colon = FindIf(url, [](char c) { return c == ':' || c == '/' || c == '?' || c == '#'; });
+    if (colon != std::string_view::npos && colon > 0 && url[colon] == ':' && IsAlpha(url[0])) {
+        bool valid = true;
+        for (size_t i = 1; i < colon && valid; ++i) {
+            char c = url[i];
+            valid = IsAlpha(c) || IsDigit(c) || c == '+' || c == '-' || c == '.';
+        }
+        if (valid) {
+            parts.scheme = url.substr(0, colon);
+            parts.has_scheme = true;
+            url.remove_prefix(colon + 1);
+        }
+    }
+    url = url.substr(0, url.find('#'));
+    if (url.size() >= 2 && url[0] == '/' && url[1] == '/') {
+        url.remove_prefix(2);
+        size_t end = std::min(FindIf(url, [](char c) { return c == '/' || c == '?'; }), url.size());
+        parts.authority = url.substr(0, end);
+        parts.has_authority = true;
+        url.remove_prefix(end);
+    }
+    size_t question = url.find('?');
+    parts.path = url.substr(0, question);
+    if (question != std::string_view::npos) {
+        parts.query = url.substr(question + 1);
+        parts.has_query = true;
+    }
+    return parts;
+}
+
+// Leading and trailing spaces and controls go, as do tabs and newlines
+// anywhere (markup often wraps long href values). |storage| is only used
+// when characters have to be removed from the middle.
+std::string_view CleanReference(std::string_view reference, std::string* storage) {
+    while (!reference.empty() && static_cast<unsigned char>(reference.front()) <= ' ') reference.remove_prefix(1);
+    while (!reference.empty() && static_cast<unsigned char>(reference.back()) <= ' ') reference.remove_suffix(1);
+    auto is_line_break = [](char c) { return c == '\t' || c == '\n' || c == '\r'; };
+    if (FindIf(reference, is_line_break) == std::string_view::npos) return reference;
+    storage->reserve(reference.size());
+    for (char c : reference) {
+        if (!is_line_break(c)) storage->push_back(c);
+    }
+    return *storage;
+}
+
+bool EqualsIgnoreCase(std::string_view text, std::string_view lower) {
+    if (text.size() != lower.size()) return false;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (ToLower(text[i]) != lower[i]) return false;
+    }
+    return true;
+}
+
+bool NeedsEscapeNormalization(unsigned char c) {
+    return c == '%' || c <= ' ' || c >= 0x7F || c == '"' || c == '<' || c == '>' || c == '`';
+}
+
+// Decodes escaped unreserved characters, upper-cases the remaining escapes
+// and escapes bytes that may not appear raw, so equivalent spellings compare
+// equal.
+void AppendNormalizedEscapes(std::string_view text, std::string* out) {
+    static const char kHex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < text.size(); ++i) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '%' && i + 2 < text.size() && HexValue(text[i + 1]) >= 0 && HexValue(text[i + 2]) >= 0) {
+            char decoded = static_cast<char>(HexValue(text[i + 1]) * 16 + HexValue(text[i + 2]));
+            if (IsUnreserved(decoded)) {
+                out->push_back(decoded);
+            } else {
+                out->push_back('%');
+                out->push_back(kHex[HexValue(text[i + 1])]);
+                out->push_back(kHex[HexValue(text[i + 2])]);
+            }
+            i += 2;
+        } else if (NeedsEscapeNormalization(c)) {
+            out->push_back('%');
+            out->push_back(kHex[c >> 4]);
+            out->push_back(kHex[c & 0xF]);
+        } else {
+            out->push_back(static_cast<char>(c));
+        }
+    }
+}
+
+// Appends |path| with its dot segments removed (RFC 3986 section 5.2.4)
+void AppendWithoutDotSegments(std::string_view path, std::string* out) {
+    const size_t floor = out->size();
+    auto pop_segment = [out, floor]() {
+        size_t slash = out->rfind('/');
+        out->erase(slash == std::string::npos || slash < floor ? floor : slash);
+    };
+    while (!path.empty()) {
+        // Only segments starting with a dot need the rules below
+        size_t dot = path[0] == '/' ? 1 : 0;
+        if (dot >= path.size() || path[dot] != '.') {
+            size_t end = std::min(path.find('/', 1), path.size());
+            out->append(path.substr(0, end));
+            path.remove_prefix(end);
+        } else if (path.substr(0, 3) == "../") {
+            path.remove_prefix(3);
+        } else if (path.substr(0, 2) == "./") {
+            path.remove_prefix(2);
+        } else if (path.substr(0, 3) == "/./") {
+            path.remove_prefix(2);
+        } else if (path == "/.") {
+            out->push_back('/');
+            break;
+        } else if (path.substr(0, 4) == "/../") {
+            path.remove_prefix(3);
+            pop_segment();
+        } else if (path == "/..") {
+            pop_segment();
+            out->push_back('/');
+            break;
+        } else if (path == "." || path == "..") {
+            break;
+        } else {
+            size_t end = std::min(path.find('/', 1), path.size());
+            out->append(path.substr(0, end));
+            path.remove_prefix(end);
+        }
+    }
+}
+
+// Appends the canonical authority; false when it is not a valid host[:port]
+bool AppendAuthority(std::string_view authority, std::string_view scheme, std::string* out) {
+    size_t at = authority.rfind('@');
+    if (at != std::string_view::npos) {
+        out->append(authority.substr(0, at + 1));
+        authority.remove_prefix(at + 1);
+    }
+    // The port follows the last colon, unless that colon is inside an IPv6 literal
+    size_t colon = authority.rfind(':');
+    if (colon != std::string_view::npos && authority.find(']', colon) != std::string_view::npos) {
+        colon = std::string_view::npos;
+    }
+    std::string_view host = authority.substr(0, colon);
+    if (host.empty()) return false;
+    for (char c : host) out->push_back(ToLower(c));
+
+    if (colon == std::string_view::npos) return true;
+    std::string_view digits = authority.substr(colon + 1);
+    unsigned port = 0;
+    for (char c : digits) {
+        if (!IsDigit(c)) return false;
+        port = port * 10 + static_cast<unsigned>(c - '0');
+        if (port > 65535) return false;
+    }
+    unsigned default_port = scheme == "https" ? 443 : 80;
+    if (!digits.empty() && port != default_port) {
+        out->push_back(':');
+        out->append(std::to_string(port));
+    }
+    return true;
+}
+
+// Resolved, canonical links in first-seen order
+class LinkCollector {
+public:
+    explicit LinkCollector(std::string base) : base_(std::move(base)) {}
+
+    void Reserve(size_t count) { seen_.reserve(count); }
+
+    void Add(std::string_view reference) {
+        std::string url = ResolveUrl(base_, reference);
+        if (url.empty() || seen_.count(url)) return;
+        links_.push_back(std::move(url));
+        seen_.insert(links_.back());
+    }
+
+    std::vector<std::string> TakeLinks() {
+        seen_.clear();
+        return std::vector<std::string>(std::make_move_iterator(links_.begin()),
+                                        std::make_move_iterator(links_.end()));
+    }
+
+private:
+    std::string base_;
+    std::deque<std::string> links_;    // Stable addresses for the views in |seen_|
+    std::unordered_set<std::string_view> seen_;
+};
+
+struct LinkSourceSpec {
+    const char* tags[2];
+    const char* attribute;
+};
+
+const LinkSourceSpec& SpecFor(LinkSource source) {
+    static const LinkSourceSpec kHref = {{"a", "area"}, "href"};
+    static const LinkSourceSpec kSrc = {{"img", nullptr}, "src"};
+    return source == LinkSource::SRC ? kSrc : kHref;
+}
+
+bool IsLinkTag(const LinkSourceSpec& spec, std::string_view tag) {
+    for (const char* candidate : spec.tags) {
+        if (candidate && tag == candidate) return true;
+    }
+    return false;
+}
+
+// The document's base URL: the first <base href>, resolved against the page
+std::string DocumentBase(std::string_view page_url, std::string_view base_href, bool has_base) {
+    if (has_base) {
+        std::string base = ResolveUrl(page_url, base_href);
+        if (!base.empty()) return base;
+    }
+    return std::string(page_url);
+}
+
+} // namespace
+
+std::string ResolveUrl(std::string_view base, std::string_view reference) {
+    std::string storage;
+    UrlParts ref = SplitUrl(CleanReference(reference, &storage));
+    UrlParts target;
+    std::string merged;
+    if (ref.has_scheme) {
+        target = ref;
+    } else {
+        UrlParts base_parts = SplitUrl(base);
+        if (!base_parts.has_scheme || !base_parts.has_authority) return std::string();
+        target.scheme = base_parts.scheme;
+        if (ref.has_authority) {
+            target.authority = ref.authority;
+            target.path = ref.path;
+            target.query = ref.query;
+            target.has_query = ref.has_query;
+        } else {
+            target.authority = base_parts.authority;
+            if (ref.path.empty()) {
+                target.path = base_parts.path;
+                target.query = ref.has_query ? ref.query : base_parts.query;
+                target.has_query = ref.has_query || base_parts.has_query;
+            } else {
+                if (ref.path.front() == '/') {
+                    target.path = ref.path;
+                } else {
+                    // Merge: the base path up to its last slash, then the reference
+                    size_t slash = base_parts.path.rfind('/');
+                    merged = slash == std::string_view::npos ? "/" : std::string(base_parts.path.substr(0, slash + 1));
+                    merged.append(ref.path);
+                    target.path = merged;
+                }
+                target.query = ref.query;
+                target.has_query = ref.has_query;
+            }
+        }
+    }
+
+    std::string_view scheme = EqualsIgnoreCase(target.scheme, "https") ? "https" : "http";
+    if (!EqualsIgnoreCase(target.scheme, scheme)) return std::string();
+    if (ref.has_scheme && !ref.has_authority) return std::string();     // "http:path"
+
+    std::string url;
+    url.reserve(scheme.size() + 3 + target.authority.size() + target.path.size() + target.query.size() + 2);
+    url.append(scheme).append("://");
+    if (!AppendAuthority(target.authority, scheme, &url)) return std::string();
+    std::string_view path = target.path;
+    std::string normalized;
+    if (std::any_of(path.begin(), path.end(), [](char c) { return NeedsEscapeNormalization(static_cast<unsigned char>(c)); })) {
+        AppendNormalizedEscapes(path, &normalized);
+        path = normalized;
+    }
+    size_t path_start = url.size();
+    AppendWithoutDotSegments(path, &url);
+    if (url.size() == path_start) url.push_back('/');
+    if (target.has_query) {
+        url.push_back('?');
+        AppendNormalizedEscapes(target.query, &url);
+    }
+    return url;
+}
+
+std::vector<std::string> ExtractLinks(const dom::Document& document, std::string_view page_url,
+                                      LinkSource source, const dom::NodeList& scopes) {
+    if (document.IsEmpty()) return {};
+    const LinkSourceSpec& spec = SpecFor(source);
+
+    const dom::NodeList& bases = document.ElementsByTag("base");
+    auto base = std::find_if(bases.begin(), bases.end(),
+                             [&document](dom::NodeId id) { return document.HasAttribute(id, "href"); });
+    LinkCollector collector(DocumentBase(page_url, base != bases.end() ? document.GetAttribute(*base, "href") : "",
+                                         base != bases.end()));
+
+    // The tag indexes are in document order, so each scope is a binary search
+    // and a contiguous run per tag; merging the runs keeps document order.
+    std::vector<dom::NodeId> candidates;
+    dom::NodeId covered_end = 0;
+    for (dom::NodeId scope : scopes) {
+        if (scope < covered_end || scope >= document.Size()) continue;   // Inside an earlier scope
+        dom::NodeId end = document.GetNode(scope).subtree_end;
+        covered_end = end;
+        size_t first = candidates.size();
+        for (const char* tag : spec.tags) {
+            if (!tag) continue;
+            const dom::NodeList& elements = document.ElementsByTag(tag);
+            size_t middle = candidates.size();
+            for (auto it = std::lower_bound(elements.begin(), elements.end(), scope);
+                 it != elements.end() && *it < end; ++it) {
+                candidates.push_back(*it);
+            }
+            std::inplace_merge(candidates.begin() + first, candidates.begin() + middle, candidates.end());
+        }
+    }
+
+    collector.Reserve(candidates.size());
+    for (dom::NodeId id : candidates) {
+        const dom::Attribute* attribute = document.FindAttribute(id, spec.attribute);
+        if (attribute) collector.Add(attribute->value);
+    }
+    return collector.TakeLinks();
+}
+
+std::vector<std::string> ExtractLinks(const dom::Document& document, std::string_view page_url,
+                                      LinkSource source) {
+    return ExtractLinks(document, page_url, source, dom::NodeList{document.Root()});
+}
+
+std::vector<std::string> ExtractLinksFromHtml(std::string_view html, std::string_view page_url,
+                                              LinkSource source) {
+    html::StructuralIndex index;
+    if (!html::BuildStructuralIndex(html, &index)) return {};
+    const LinkSourceSpec& spec = SpecFor(source);
+
+    // The tokenizer decodes in place, so it works on a copy. References are
+    // gathered first because a later <base> still applies to earlier links.
+    std::string buffer(html);
+    std::vector<html::Attribute> attributes;
+    html::Tokenizer tokenizer(buffer.data(), buffer.size(), index, &attributes);
+    std::vector<std::string_view> references;
+    std::string_view base_href;
+    bool has_base = false;
+    html::Token token;
+    while (tokenizer.Next(&token)) {
+        if (token.type != html::TokenType::START_TAG) continue;
+        bool is_base = !has_base && token.name == "base";
+        if (!is_base && !IsLinkTag(spec, token.name)) continue;
+        const html::Attribute* begin = attributes.data() + token.first_attribute;
+        const html::Attribute* end = begin + token.attribute_count;
+        const char* name = is_base ? "href" : spec.attribute;
+        auto attribute = std::find_if(begin, end, [name](const html::Attribute& a) { return a.name == name; });
+        if (attribute == end) continue;
+        if (is_base) {
+            base_href = attribute->value;
+            has_base = true;
+        } else {
+            references.push_back(attribute->value);
+        }
+    }
+
+    LinkCollector collector(DocumentBase(page_url, base_href, has_base));
+    collector.Reserve(references.size());
+    for (std::string_view reference : references) collector.Add(reference);
+    return collector.TakeLinks();
+}
+
+} // namespace navigrab
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "dom.h"
+
+namespace navigrab {
+
+// Resolves |reference| against |base| (RFC 3986 section 5) and returns the
+// result in canonical form, or an empty string when it is not a valid http or
+// https URL. Canonical form has a lower-case scheme and host, no default
+// port, no dot segments, "/" for an empty path, unreserved characters
+// percent-decoded and other escapes in upper case, and no fragment. Relative
+// references need an absolute |base|.
+std::string ResolveUrl(std::string_view base, std::string_view reference);
+inline std::string CanonicalizeUrl(std::string_view url) {
+    return ResolveUrl(std::string_view(), url);
+}
+
+// Which links to collect
+enum class LinkSource {
+    HREF,   // <a href>, <area href>
+    SRC     // <img src>
+};
+
+// Resolved links in document order with duplicates removed, taken from the
+// subtrees of |scopes| (element ids in document order; nested scopes are
+// visited once). A <base href> in the document takes precedence over
+// |page_url| as the base.
+std::vector<std::string> ExtractLinks(const dom::Document& document, std::string_view page_url,
+                                      LinkSource source, const dom::NodeList& scopes);
+std::vector<std::string> ExtractLinks(const dom::Document& document, std::string_view page_url,
+                                      LinkSource source = LinkSource::HREF);
+
+// The same straight from markup, for pages that have no DOM
+std::vector<std::string> ExtractLinksFromHtml(std::string_view html, std::string_view page_url,
+                                              LinkSource source = LinkSource::HREF);
+
+} // namespace navigrab
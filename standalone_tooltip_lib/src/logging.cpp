@@ -0,0 +1,290 @@
+#include "logging.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace navigrab {
+
+namespace {
+
+// Slots per thread ring; a slot holds one formatted message (256 bytes).
+constexpr uint32_t kRingSlots = 256;
+
+// How long the drain thread sleeps when nobody wakes it
+constexpr auto kDrainInterval = std::chrono::milliseconds(20);
+
+struct LogSlot {
+    int64_t time_ns;
+    LogLevel level;
+    uint32_t length;
+    char text[LogStream::kCapacity];
+};
+
+// Single-producer, single-consumer ring owned by one logging thread. The
+// owner only writes |head|; the drain thread only writes |tail|.
+struct ThreadRing {
+    alignas(64) std::atomic<uint32_t> head{0};
+    alignas(64) std::atomic<uint32_t> tail{0};
+    std::atomic<bool> retired{false};   // Owning thread has exited
+    LogSlot slots[kRingSlots];
+};
+
+int64_t NowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class Logger {
+public:
+    static Logger& Get() {
+        // Never destroyed: threads may log during static destruction
+        static Logger* logger = new Logger();
+        return *logger;
+    }
+
+    void Submit(LogLevel level, std::string_view text) {
+        if (stopped_.load(std::memory_order_acquire)) {
+            // After shutdown there is no drain thread; write through
+            std::lock_guard<std::mutex> lock(drain_mutex_);
+            LogSlot slot;
+            Fill(&slot, level, text);
+            const LogSlot* batch[] = {&slot};
+            Write(batch, 1);
+            return;
+        }
+
+        ThreadRing& ring = CurrentRing();
+        uint32_t head = ring.head.load(std::memory_order_relaxed);
+        uint32_t tail = ring.tail.load(std::memory_order_acquire);
+        if (head - tail >= kRingSlots) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            wake_.notify_one();
+            return;
+        }
+        Fill(&ring.slots[head % kRingSlots], level, text);
+        ring.head.store(head + 1, std::memory_order_release);
+        // Wake the drainer early once the ring is half full
+        if (head - tail + 1 == kRingSlots / 2) wake_.notify_one();
+    }
+
+    void SetSink(LogSink sink) {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        sink_ = std::move(sink);
+    }
+
+    void Flush() {
+        std::lock_guard<std::mutex> lock(drain_mutex_);
+        DrainLocked();
+    }
+
+    uint64_t Dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+    std::atomic<int> level{static_cast<int>(LogLevel::LOG_INFO)};
+
+private:
+    // Keeps the calling thread's ring registered and retires it on exit
+    struct RingHandle {
+        std::shared_ptr<ThreadRing> ring;
+        ~RingHandle() {
+            if (ring) ring->retired.store(true, std::memory_order_release);
+        }
+    };
+
+    Logger() {
+        std::atexit([] { Logger::Get().Stop(); });
+    }
+
+    ThreadRing& CurrentRing() {
+        thread_local RingHandle handle;
+        if (!handle.ring) {
+            handle.ring = std::make_shared<ThreadRing>();
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            rings_.push_back(handle.ring);
+            if (!drain_thread_.joinable() && !stop_requested_.load(std::memory_order_acquire)) {
+                drain_thread_ = std::thread([this] { DrainLoop(); });
+            }
+        }
+        return *handle.ring;
+    }
+
+    static void Fill(LogSlot* slot, LogLevel level, std::string_view text) {
+        slot->time_ns = NowNanoseconds();
+        slot->level = level;
+        slot->length = static_cast<uint32_t>(std::min(text.size(), sizeof(slot->text)));
+        std::memcpy(slot->text, text.data(), slot->length);
+    }
+
+    void DrainLoop() {
+        std::unique_lock<std::mutex> lock(wake_mutex_);
+        while (!stop_requested_.load(std::memory_order_acquire)) {
+            wake_.wait_for(lock, kDrainInterval);
+            lock.unlock();
+            Flush();
+            lock.lock();
+        }
+    }
+
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_requested_.store(true, std::memory_order_release);
+        }
+        wake_.notify_one();
+        std::thread drain_thread;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            drain_thread = std::move(drain_thread_);
+        }
+        if (drain_thread.joinable()) drain_thread.join();
+        Flush();
+        stopped_.store(true, std::memory_order_release);
+    }
+
+    // Moves everything queued so far to the sink, oldest first across threads.
+    // Slots are read in place and only released after they are written.
+    void DrainLocked() {
+        std::vector<std::shared_ptr<ThreadRing>> rings;
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex_);
+            // Exited threads' rings go once they are empty
+            rings_.erase(std::remove_if(rings_.begin(), rings_.end(),
+                                        [](const std::shared_ptr<ThreadRing>& ring) {
+                                            return ring->retired.load(std::memory_order_acquire) &&
+                                                   ring->head.load(std::memory_order_acquire) ==
+                                                       ring->tail.load(std::memory_order_relaxed);
+                                        }),
+                         rings_.end());
+            rings = rings_;
+        }
+
+        std::vector<uint32_t> heads(rings.size());
+        batch_.clear();
+        for (size_t i = 0; i < rings.size(); ++i) {
+            heads[i] = rings[i]->head.load(std::memory_order_acquire);
+            for (uint32_t at = rings[i]->tail.load(std::memory_order_relaxed); at != heads[i]; ++at) {
+                batch_.push_back(&rings[i]->slots[at % kRingSlots]);
+            }
+        }
+
+        uint64_t dropped = dropped_.load(std::memory_order_relaxed);
+        if (!batch_.empty()) {
+            std::stable_sort(batch_.begin(), batch_.end(),
+                             [](const LogSlot* a, const LogSlot* b) { return a->time_ns < b->time_ns; });
+            Write(batch_.data(), batch_.size());
+            for (size_t i = 0; i < rings.size(); ++i) {
+                rings[i]->tail.store(heads[i], std::memory_order_release);
+            }
+        }
+        if (dropped != reported_dropped_) {
+            char note[64];
+            int length = std::snprintf(note, sizeof(note), "NaviGrab: %llu log messages dropped",
+                                       static_cast<unsigned long long>(dropped - reported_dropped_));
+            reported_dropped_ = dropped;
+            LogSlot slot;
+            Fill(&slot, LogLevel::LOG_WARNING, std::string_view(note, static_cast<size_t>(std::max(length, 0))));
+            const LogSlot* notice[] = {&slot};
+            Write(notice, 1);
+        }
+    }
+
+    void Write(const LogSlot* const* slots, size_t count) {
+        if (sink_) {
+            for (size_t i = 0; i < count; ++i) {
+                sink_(slots[i]->level, std::string_view(slots[i]->text, slots[i]->length));
+            }
+            return;
+        }
+        // Default sink: one write and one flush for the whole batch
+        output_.clear();
+        for (size_t i = 0; i < count; ++i) {
+            output_.append(slots[i]->text, slots[i]->length);
+            output_.push_back('\n');
+        }
+        std::fwrite(output_.data(), 1, output_.size(), stdout);
+        std::fflush(stdout);
+    }
+
+    std::mutex registry_mutex_;
+    std::vector<std::shared_ptr<ThreadRing>> rings_;
+    std::thread drain_thread_;
+
+    std::mutex wake_mutex_;
+    std::condition_variable wake_;
+    std::atomic<bool> stop_requested_{false};
+    std::atomic<bool> stopped_{false};
+
+    // Held while draining; the drain thread and Flush() take turns as consumer
+    std::mutex drain_mutex_;
+    LogSink sink_;
+    std::vector<const LogSlot*> batch_;
+    std::string output_;
+    std::atomic<uint64_t> dropped_{0};
+    uint64_t reported_dropped_ = 0;
+};
+
+} // namespace
+
+void SetLogLevel(LogLevel level) {
+    Logger::Get().level.store(static_cast<int>(level), std::memory_order_relaxed);
+}
+
+LogLevel GetLogLevel() {
+    return static_cast<LogLevel>(Logger::Get().level.load(std::memory_order_relaxed));
+}
+
+bool IsLogLevelEnabled(LogLevel level) {
+    return static_cast<int>(level) >= Logger::Get().level.load(std::memory_order_relaxed);
+}
+
+void SetLogSink(LogSink sink) {
+    Logger::Get().SetSink(std::move(sink));
+}
+
+void FlushLogs() {
+    Logger::Get().Flush();
+}
+
+uint64_t GetDroppedLogMessages() {
+    return Logger::Get().Dropped();
+}
+
+// LogStream implementation
+void LogStream::Append(const char* data, size_t size) {
+    size_t room = kCapacity - length_;
+    if (size > room) size = room;
+    std::memcpy(buffer_ + length_, data, size);
+    length_ += size;
+}
+
+void LogStream::AppendInteger(bool negative, uint64_t magnitude) {
+    char digits[21];
+    size_t count = 0;
+    do {
+        digits[sizeof(digits) - 1 - count++] = static_cast<char>('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+    if (negative) digits[sizeof(digits) - 1 - count++] = '-';
+    Append(digits + sizeof(digits) - count, count);
+}
+
+LogStream& LogStream::operator<<(double value) {
+    char text[32];
+    int length = std::snprintf(text, sizeof(text), "%g", value);
+    if (length > 0) Append(text, std::min(static_cast<size_t>(length), sizeof(text) - 1));
+    return *this;
+}
+
+// LogMessage implementation
+LogMessage::~LogMessage() {
+    Logger::Get().Submit(level_, stream_.view());
+}
+
+} // namespace navigrab
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+// Messages below this level are compiled out. 0 keeps everything (TRACE),
+// 2 is INFO, 5 removes all logging.
+#ifndef NAVIGRAB_MIN_LOG_LEVEL
+#define NAVIGRAB_MIN_LOG_LEVEL 2
+#endif
+
+namespace navigrab {
+
+// Prefixed so they survive platform macros such as ERROR and DEBUG
+enum class LogLevel {
+    LOG_TRACE = 0,
+    LOG_DEBUG = 1,
+    LOG_INFO = 2,
+    LOG_WARNING = 3,
+    LOG_ERROR = 4,
+    LOG_OFF = 5
+};
+
+// Runtime floor on top of the compile-time one (default LOG_INFO)
+void SetLogLevel(LogLevel level);
+LogLevel GetLogLevel();
+bool IsLogLevelEnabled(LogLevel level);
+
+// Receives each message on the drain thread, in timestamp order. A null sink
+// restores the default, which writes lines to stdout and flushes once per batch.
+using LogSink = std::function<void(LogLevel level, std::string_view message)>;
+void SetLogSink(LogSink sink);
+
+// Blocks until every message logged before the call has reached the sink
+void FlushLogs();
+
+// Messages lost because a thread's ring was full
+uint64_t GetDroppedLogMessages();
+
+// Formats one message into a fixed buffer without allocating. Longer
+// messages are truncated.
+class LogStream {
+public:
+    static constexpr size_t kCapacity = 232;
+
+    LogStream& operator<<(std::string_view text) {
+        Append(text.data(), text.size());
+        return *this;
+    }
+    LogStream& operator<<(const std::string& text) { return *this << std::string_view(text); }
+    LogStream& operator<<(const char* text) { return *this << std::string_view(text ? text : "(null)"); }
+    LogStream& operator<<(char c) {
+        Append(&c, 1);
+        return *this;
+    }
+    LogStream& operator<<(bool value) { return *this << (value ? "1" : "0"); }
+    LogStream& operator<<(double value);
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value, int>::type = 0>
+    LogStream& operator<<(T value) {
+        if constexpr (std::is_signed<T>::value) {
+            AppendInteger(static_cast<int64_t>(value) < 0, Magnitude(static_cast<int64_t>(value)));
+        } else {
+            AppendInteger(false, static_cast<uint64_t>(value));
+        }
+        return *this;
+    }
+
+    // Enums print as their underlying integer
+    template <typename T, typename std::enable_if<std::is_enum<T>::value, int>::type = 0>
+    LogStream& operator<<(T value) {
+        return *this << static_cast<typename std::underlying_type<T>::type>(value);
+    }
+
+    std::string_view view() const { return std::string_view(buffer_, length_); }
+
+private:
+    static uint64_t Magnitude(int64_t value) {
+        return value < 0 ? 0 - static_cast<uint64_t>(value) : static_cast<uint64_t>(value);
+    }
+    void Append(const char* data, size_t size);
+    void AppendInteger(bool negative, uint64_t magnitude);
+
+    char buffer_[kCapacity];
+    size_t length_ = 0;
+};
+
+// One log statement; hands the formatted text to the logger when destroyed.
+class LogMessage {
+public:
+    explicit LogMessage(LogLevel level) : level_(level) {}
+    ~LogMessage();
+
+    LogMessage(const LogMessage&) = delete;
+    LogMessage& operator=(const LogMessage&) = delete;
+
+    LogStream& stream() { return stream_; }
+
+private:
+    LogLevel level_;
+    LogStream stream_;
+};
+
+namespace internal {
+
+// Lets the logging macro be a single expression, so it nests safely in if/else
+struct LogMessageVoidify {
+    void operator&(LogStream&) {}
+};
+
+} // namespace internal
+
+} // namespace navigrab
+
+#define NAVIGRAB_LOG_IS_ON(level)                                                          \
+    (static_cast<int>(::navigrab::LogLevel::LOG_##level) >= NAVIGRAB_MIN_LOG_LEVEL &&      \
+     ::navigrab::IsLogLevelEnabled(::navigrab::LogLevel::LOG_##level))
+
+// NAVIGRAB_LOG(INFO) << "Page: Navigating to " << url;
+// The operands are not evaluated when the level is off, and levels below
+// NAVIGRAB_MIN_LOG_LEVEL fold to nothing at compile time.
+#define NAVIGRAB_LOG(level)                                                                \
+    !NAVIGRAB_LOG_IS_ON(level)                                                             \
+        ? (void)0                                                                          \
+        : ::navigrab::internal::LogMessageVoidify() &                                      \
+              ::navigrab::LogMessage(::navigrab::LogLevel::LOG_##level).stream()
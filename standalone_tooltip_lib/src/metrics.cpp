@@ -0,0 +1,133 @@
+#include "metrics.h"
+#include <algorithm>
+#include <limits>
+
+namespace navigrab {
+
+namespace {
+
+constexpr uint64_t kSubBucketCount = uint64_t{1} << LatencyHistogram::kSubBucketBits;
+constexpr uint64_t kSubBucketHalf = kSubBucketCount / 2;
+
+int HighestBit(uint64_t value) {
+    int bit = 0;
+    for (int shift = 32; shift > 0; shift /= 2) {
+        if (value >> shift) {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+// Values below kSubBucketCount get a bucket each. Above that, each power of
+// two is split into kSubBucketHalf buckets of equal width.
+size_t BucketIndex(uint64_t value) {
+    if (value < kSubBucketCount) return static_cast<size_t>(value);
+    int shift = HighestBit(value) - (LatencyHistogram::kSubBucketBits - 1);
+    uint64_t index = static_cast<uint64_t>(shift) * kSubBucketHalf + (value >> shift);
+    return static_cast<size_t>(std::min<uint64_t>(index, LatencyHistogram::kBucketCount - 1));
+}
+
+// Middle of the range of values that land in |index|
+double BucketValue(size_t index) {
+    if (index < kSubBucketCount) return static_cast<double>(index);
+    uint64_t shift = index / kSubBucketHalf - 1;
+    uint64_t lowest = (index - shift * kSubBucketHalf) << shift;
+    return static_cast<double>(lowest) + static_cast<double>((uint64_t{1} << shift) - 1) / 2;
+}
+
+} // namespace
+
+// LatencyHistogram implementation
+LatencyHistogram::LatencyHistogram() : min_us_(std::numeric_limits<uint64_t>::max()) {
+    for (auto& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::RecordMicroseconds(uint64_t microseconds) {
+    buckets_[BucketIndex(microseconds)].fetch_add(1, std::memory_order_relaxed);
+    sum_us_.fetch_add(microseconds, std::memory_order_relaxed);
+    uint64_t seen = min_us_.load(std::memory_order_relaxed);
+    while (microseconds < seen &&
+           !min_us_.compare_exchange_weak(seen, microseconds, std::memory_order_relaxed)) {
+    }
+    seen = max_us_.load(std::memory_order_relaxed);
+    while (microseconds > seen &&
+           !max_us_.compare_exchange_weak(seen, microseconds, std::memory_order_relaxed)) {
+    }
+}
+
+LatencySnapshot LatencyHistogram::Snapshot() const {
+    LatencySnapshot snapshot;
+    uint64_t counts[kBucketCount];
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = buckets_[i].load(std::memory_order_relaxed);
+        snapshot.count += counts[i];
+    }
+    if (snapshot.count == 0) return snapshot;
+
+    double min_us = static_cast<double>(min_us_.load(std::memory_order_relaxed));
+    double max_us = static_cast<double>(max_us_.load(std::memory_order_relaxed));
+    if (min_us > max_us) min_us = max_us;   // A sample raced the snapshot
+    snapshot.min_ms = min_us / 1000.0;
+    snapshot.max_ms = max_us / 1000.0;
+    snapshot.mean_ms = static_cast<double>(sum_us_.load(std::memory_order_relaxed)) /
+                       static_cast<double>(snapshot.count) / 1000.0;
+
+    // Nearest rank: the smallest value with at least p of the samples at or below it
+    const double percentiles[] = {0.50, 0.95, 0.99};
+    double* outputs[] = {&snapshot.p50_ms, &snapshot.p95_ms, &snapshot.p99_ms};
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount && next < 3; ++i) {
+        seen += counts[i];
+        while (next < 3 && static_cast<double>(seen) >= percentiles[next] * static_cast<double>(snapshot.count)) {
+            *outputs[next++] = std::clamp(BucketValue(i), min_us, max_us) / 1000.0;
+        }
+    }
+    return snapshot;
+}
+
+void LatencyHistogram::Reset() {
+    for (auto& bucket : buckets_) bucket.store(0, std::memory_order_relaxed);
+    sum_us_.store(0, std::memory_order_relaxed);
+    min_us_.store(std::numeric_limits<uint64_t>::max(), std::memory_order_relaxed);
+    max_us_.store(0, std::memory_order_relaxed);
+}
+
+// MetricsRegistry implementation
+MetricsRegistry& MetricsRegistry::GetInstance() {
+    // Never destroyed: callers keep histogram references in statics
+    static MetricsRegistry* registry = new MetricsRegistry();
+    return *registry;
+}
+
+LatencyHistogram& MetricsRegistry::GetHistogram(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto& histogram = histograms_[name];
+    if (!histogram) histogram = std::make_unique<LatencyHistogram>();
+    return *histogram;
+}
+
+std::map<std::string, LatencySnapshot> MetricsRegistry::Snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::map<std::string, LatencySnapshot> snapshots;
+    for (const auto& entry : histograms_) {
+        LatencySnapshot snapshot = entry.second->Snapshot();
+        if (snapshot.count > 0) snapshots.emplace(entry.first, snapshot);
+    }
+    return snapshots;
+}
+
+LatencySnapshot MetricsRegistry::Snapshot(const std::string& name) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = histograms_.find(name);
+    return it != histograms_.end() ? it->second->Snapshot() : LatencySnapshot();
+}
+
+void MetricsRegistry::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& entry : histograms_) entry.second->Reset();
+}
+
+} // namespace navigrab
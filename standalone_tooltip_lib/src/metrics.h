@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace navigrab {
+
+// Latency summary of one histogram. Percentiles are accurate to about 1.6%
+// of the value (the bucket width), never below the recorded minimum or
+// above the recorded maximum.
+struct LatencySnapshot {
+    uint64_t count = 0;
+    double min_ms = 0;
+    double max_ms = 0;
+    double mean_ms = 0;
+    double p50_ms = 0;
+    double p95_ms = 0;
+    double p99_ms = 0;
+};
+
+// HDR-style latency histogram over microseconds: 64 linear sub-buckets per
+// power of two, from 1us to about 19 hours (longer samples land in the top
+// bucket). Recording is a handful of relaxed atomic adds, so any number of
+// threads can record without locking.
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 6;
+    static constexpr size_t kBucketCount = 1024;
+
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    void RecordMicroseconds(uint64_t microseconds);
+    void Record(std::chrono::nanoseconds latency) {
+        RecordMicroseconds(latency.count() > 0 ? static_cast<uint64_t>(latency.count()) / 1000 : 0);
+    }
+
+    // Safe while other threads record; samples racing the snapshot may be
+    // counted in some fields and not others.
+    LatencySnapshot Snapshot() const;
+    void Reset();
+
+private:
+    std::atomic<uint64_t> buckets_[kBucketCount];
+    std::atomic<uint64_t> sum_us_{0};
+    std::atomic<uint64_t> min_us_;
+    std::atomic<uint64_t> max_us_{0};
+};
+
+// Records the time from construction to destruction into |histogram|
+class ScopedLatencyTimer {
+public:
+    explicit ScopedLatencyTimer(LatencyHistogram& histogram)
+        : histogram_(histogram), start_(std::chrono::steady_clock::now()) {}
+    ~ScopedLatencyTimer() { histogram_.Record(std::chrono::steady_clock::now() - start_); }
+
+    ScopedLatencyTimer(const ScopedLatencyTimer&) = delete;
+    ScopedLatencyTimer& operator=(const ScopedLatencyTimer&) = delete;
+
+private:
+    LatencyHistogram& histogram_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Process-wide named histograms. NaviGrab records into:
+//   scrape.quick, scrape.standard, scrape.deep        ProactiveScraper::ScrapePage
+//   capture.full_page, capture.viewport, capture.element,
+//   capture.page_data, capture.element_data, capture.element_batch,
+//   capture.thumbnail                                 ScreenshotCapture
+// and the tooltip integration adds automation.<action> per action type.
+class MetricsRegistry {
+public:
+    static MetricsRegistry& GetInstance();
+
+    // Created on first use. The reference stays valid for the life of the
+    // process, so hot paths look it up once and keep it.
+    LatencyHistogram& GetHistogram(const std::string& name);
+
+    // Every histogram with at least one sample, by name
+    std::map<std::string, LatencySnapshot> Snapshot() const;
+    LatencySnapshot Snapshot(const std::string& name) const;
+
+    // Clears samples; histograms stay registered
+    void Reset();
+
+private:
+    MetricsRegistry() = default;
+
+    mutable std::mutex mutex_;
+    std::map<std::string, std::unique_ptr<LatencyHistogram>> histograms_;
+};
+
+} // namespace navigrab
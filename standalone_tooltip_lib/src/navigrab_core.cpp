@@ -1,5 +1,15 @@
 #include "navigrab_core.h"
-#include <iostream>
+#include "browser_pool.h"
+#include "dom.h"
+#include "image_codec.h"
+#include "image_resampler.h"
+#include "link_extractor.h"
+#include "logging.h"
+#include "metrics.h"
+#include "page_backend.h"
+#include "parallel.h"
+#include "rasterizer.h"
+#include "selector_engine.h"
 #include <fstream>
 #include <thread>
 #include <chrono>
@@ -7,9 +17,79 @@
 #include <map>
 #include <filesystem>
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <mutex>
 
 namespace navigrab {
 
+namespace {
+
+// Resolves |selector| through the shared compiled-selector cache.
+dom::NodeId QueryFirst(const dom::Document& document, const std::string& selector) {
+    auto compiled = SelectorCache::GetInstance().Get(selector);
+    return SelectorMatcher(document).QueryFirst(*compiled);
+}
+
+// Discovery categories, expressed as selectors so one QueryMany() pass
+// covers all of them.
+const char kInteractiveSelector[] = "a[href], button, input:not([type=hidden]), select, textarea";
+const char kFormSelector[] = "input:not([type=hidden]), select, textarea";
+const char kNavigationSelector[] = "nav, nav a[href]";
+const char kButtonSelector[] = "button, input[type=submit], input[type=button], input[type=reset]";
+
+// Evaluates |selectors| together and returns canonical selectors per input.
+std::vector<std::vector<std::string>> QuerySelectors(const dom::Document& document,
+                                                     const std::vector<std::string>& selectors) {
+    std::vector<std::shared_ptr<const CompiledSelector>> compiled;
+    std::vector<const CompiledSelector*> programs;
+    compiled.reserve(selectors.size());
+    for (const auto& selector : selectors) {
+        compiled.push_back(SelectorCache::GetInstance().Get(selector));
+        programs.push_back(compiled.back().get());
+    }
+    std::vector<dom::NodeList> matches = SelectorMatcher(document).QueryMany(programs);
+    std::vector<std::vector<std::string>> results(matches.size());
+    for (size_t i = 0; i < matches.size(); ++i) {
+        results[i].reserve(matches[i].size());
+        for (dom::NodeId id : matches[i]) results[i].push_back(document.BuildSelector(id));
+    }
+    return results;
+}
+
+std::vector<std::string> QuerySelector(const dom::Document& document, const std::string& selector) {
+    return std::move(QuerySelectors(document, {selector}).front());
+}
+
+// Text of |id| as a slice of |document| when it is one run there, otherwise
+// as the collapsed copy
+ContentBuffer TextBuffer(std::shared_ptr<const dom::Document> document, dom::NodeId id) {
+    std::string scratch;
+    std::string_view text = document->TextView(id, &scratch);
+    if (text.empty()) return ContentBuffer();
+    if (text.data() == scratch.data()) return ContentBuffer(std::move(scratch));
+    return ContentBuffer(std::move(document), text);
+}
+
+// ScreenshotCapture entry points, each with its own latency histogram
+enum class CaptureKind { FULL_PAGE, VIEWPORT, ELEMENT, PAGE_DATA, ELEMENT_DATA, ELEMENT_BATCH, THUMBNAIL };
+
+LatencyHistogram& CaptureHistogram(CaptureKind kind) {
+    static LatencyHistogram* const histograms[] = {
+        &MetricsRegistry::GetInstance().GetHistogram("capture.full_page"),
+        &MetricsRegistry::GetInstance().GetHistogram("capture.viewport"),
+        &MetricsRegistry::GetInstance().GetHistogram("capture.element"),
+        &MetricsRegistry::GetInstance().GetHistogram("capture.page_data"),
+        &MetricsRegistry::GetInstance().GetHistogram("capture.element_data"),
+        &MetricsRegistry::GetInstance().GetHistogram("capture.element_batch"),
+        &MetricsRegistry::GetInstance().GetHistogram("capture.thumbnail"),
+    };
+    return *histograms[static_cast<size_t>(kind)];
+}
+
+} // namespace
+
 // Factory functions implementation
 std::unique_ptr<WebAutomation> CreateWebAutomation() {
     return std::make_unique<WebAutomation>();
@@ -44,19 +124,31 @@ std::unique_ptr<NaviGrabCore> NaviGrabCore::instance_ = nullptr;
 
 class NaviGrabCore::Impl {
 public:
-    Impl() : browser_launched_(false), initialized_(false) {}
+    Impl() : browser_launched_(false), launched_engine_(false), initialized_(false) {}
     
     bool LaunchBrowser() {
-        // Simulate browser launch
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        backend_ = GetDefaultBrowserBackend();
+        if (backend_ && backend_->IsRunning()) {
+            // Another owner (a Browser or the page pool) already paid for the launch
+            browser_launched_ = true;
+            return true;
+        }
+        if (!backend_ || !backend_->Launch()) {
+            NAVIGRAB_LOG(WARNING) << "NaviGrab: Browser launch failed";
+            return false;
+        }
         browser_launched_ = true;
-        std::cout << "NaviGrab: Browser launched successfully" << std::endl;
+        launched_engine_ = true;
+        NAVIGRAB_LOG(INFO) << "NaviGrab: Browser launched successfully (" << backend_->Name() << " backend)";
         return true;
     }
     
     void CloseBrowser() {
+        // An attached engine belongs to whoever launched it
+        if (backend_ && launched_engine_) backend_->Close();
         browser_launched_ = false;
-        std::cout << "NaviGrab: Browser closed" << std::endl;
+        launched_engine_ = false;
+        NAVIGRAB_LOG(INFO) << "NaviGrab: Browser closed";
     }
     
     bool IsBrowserRunning() const {
@@ -65,7 +157,7 @@ public:
     
     bool Initialize() {
         if (initialized_) return true;
-        std::cout << "NaviGrab: Initializing core..." << std::endl;
+        NAVIGRAB_LOG(INFO) << "NaviGrab: Initializing core...";
         initialized_ = true;
         return true;
     }
@@ -74,9 +166,23 @@ public:
         return initialized_;
     }
     
+    BrowserPool& GetBrowserPool() {
+        std::lock_guard<std::mutex> lock(pool_mutex_);
+        if (!pool_) {
+            BrowserPoolOptions options;
+            options.warm_up = WarmUpPolicy::LAZY;
+            pool_ = std::make_unique<BrowserPool>(options);
+        }
+        return *pool_;
+    }
+    
 private:
     bool browser_launched_;
+    bool launched_engine_;      // Launched here rather than attached
     bool initialized_;
+    std::shared_ptr<BrowserBackend> backend_;
+    std::mutex pool_mutex_;
+    std::unique_ptr<BrowserPool> pool_;
 };
 
 NaviGrabCore::NaviGrabCore() : impl_(std::make_unique<Impl>()) {}
@@ -116,32 +222,61 @@ void NaviGrabCore::CloseBrowser() {
     impl_->CloseBrowser();
 }
 
+BrowserPool& NaviGrabCore::GetBrowserPool() {
+    return impl_->GetBrowserPool();
+}
+
+PageLease NaviGrabCore::AcquirePage() {
+    return impl_->GetBrowserPool().Acquire();
+}
+
 // Browser Implementation
 class Browser::Impl {
 public:
-    Impl() : running_(false) {}
+    explicit Impl(std::shared_ptr<BrowserBackend> backend)
+        : running_(false), launched_engine_(false), backend_(std::move(backend)) {}
     
     bool Launch() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        if (backend_ && backend_->IsRunning()) {
+            // Shared engine already up; attach instead of paying startup again
+            running_ = true;
+            return true;
+        }
+        if (!backend_ || !backend_->Launch()) {
+            NAVIGRAB_LOG(WARNING) << "Browser: Launch failed";
+            return false;
+        }
         running_ = true;
-        std::cout << "Browser: Launched successfully" << std::endl;
+        launched_engine_ = true;
+        NAVIGRAB_LOG(INFO) << "Browser: Launched successfully";
         return true;
     }
     
     void Close() {
+        // Leave a shared engine this browser only attached to running
+        if (backend_ && launched_engine_) backend_->Close();
         running_ = false;
-        std::cout << "Browser: Closed" << std::endl;
+        launched_engine_ = false;
+        NAVIGRAB_LOG(INFO) << "Browser: Closed";
     }
     
     bool IsRunning() const {
         return running_;
     }
     
+    std::unique_ptr<Page> NewPage() {
+        if (!backend_) return std::make_unique<Page>();
+        return std::make_unique<Page>(backend_->CreatePage());
+    }
+    
 private:
     bool running_;
+    bool launched_engine_;      // Launched here rather than attached
+    std::shared_ptr<BrowserBackend> backend_;
 };
 
-Browser::Browser() : impl_(std::make_unique<Impl>()) {}
+Browser::Browser() : impl_(std::make_unique<Impl>(GetDefaultBrowserBackend())) {}
+Browser::Browser(std::shared_ptr<BrowserBackend> backend) : impl_(std::make_unique<Impl>(std::move(backend))) {}
 Browser::~Browser() = default;
 
 bool Browser::Launch() {
@@ -157,11 +292,11 @@ bool Browser::IsRunning() const {
 }
 
 std::unique_ptr<Page> Browser::NewPage() {
-    return std::make_unique<Page>();
+    return impl_->NewPage();
 }
 
 bool Browser::NavigateTo(const std::string& url) {
-    std::cout << "Browser: Navigating to " << url << std::endl;
+    NAVIGRAB_LOG(DEBUG) << "Browser: Navigating to " << url;
     return true;
 }
 
@@ -176,21 +311,67 @@ std::string Browser::GetTitle() const {
 // Page Implementation
 class Page::Impl {
 public:
-    Impl() : loaded_(false) {}
+    explicit Impl(std::unique_ptr<PageBackend> backend)
+        : loaded_(false),
+          document_(std::make_shared<dom::Document>()),
+          backend_(std::move(backend)),
+          alive_(std::make_shared<bool>(true)) {}
+    
+    ~Impl() {
+        // Operations that never started fail rather than staying pending
+        for (auto& operation : pipeline_) operation.abandon();
+    }
     
     bool NavigateTo(const std::string& url) {
-        std::cout << "Page: Navigating to " << url << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        NAVIGRAB_LOG(DEBUG) << "Page: Navigating to " << url;
+        std::string html;
+        if (!backend_->Navigate(url, &html)) return false;
         current_url_ = url;
-        loaded_ = true;
-        return true;
+        return SetContent(ContentBuffer(std::move(html)));
     }
     
-    bool WaitForLoad() {
-        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    bool Refresh() {
+        if (current_url_.empty()) return false;
+        return NavigateTo(current_url_);
+    }
+    
+    bool Reset() {
+        if (!pipeline_.empty() || in_flight_) return false;
+        std::string html;
+        bool ok = backend_->Navigate("about:blank", &html);
+        loop_ = nullptr;
+        current_url_.clear();
+        content_ = ContentBuffer();
+        if (document_.use_count() > 1) {
+            document_ = std::make_shared<dom::Document>();
+        } else {
+            document_->Clear();
+        }
+        loaded_ = false;
+        return ok;
+    }
+    
+    bool SetContent(ContentBuffer html) {
+        content_ = std::move(html);
+        // Reloading releases the previous document's arena in one step, unless
+        // text buffers still point into it
+        if (document_.use_count() > 1) document_ = std::make_shared<dom::Document>();
+        loaded_ = document_->Load(content_.View());
         return loaded_;
     }
     
+    const dom::Document* GetDocument() const {
+        return document_.get();
+    }
+    
+    std::shared_ptr<const dom::Document> ShareDocument() const {
+        return document_;
+    }
+    
+    bool WaitForLoad() {
+        return backend_->WaitForLoad() && loaded_;
+    }
+    
     bool IsLoaded() const {
         return loaded_;
     }
@@ -200,38 +381,35 @@ public:
     }
     
     std::string GetTitle() const {
-        return "Sample Page Title";
+        return std::string(document_->Title());
     }
     
-    std::string GetContent() const {
-        return "<html><body><h1>Sample Content</h1></body></html>";
+    const ContentBuffer& GetContent() const {
+        return content_;
     }
     
     bool Click(const std::string& selector) {
-        std::cout << "Page: Clicking element " << selector << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        return true;
+        NAVIGRAB_LOG(DEBUG) << "Page: Clicking element " << selector;
+        return backend_->Click(selector);
     }
     
     bool Type(const std::string& selector, const std::string& text) {
-        std::cout << "Page: Typing '" << text << "' into " << selector << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        return true;
+        NAVIGRAB_LOG(DEBUG) << "Page: Typing '" << text << "' into " << selector;
+        return backend_->Type(selector, text);
     }
     
     bool Hover(const std::string& selector) {
-        std::cout << "Page: Hovering over " << selector << std::endl;
-        std::this_thread::sleep_for(std::chrono::milliseconds(50));
-        return true;
+        NAVIGRAB_LOG(DEBUG) << "Page: Hovering over " << selector;
+        return backend_->Hover(selector);
     }
     
     bool Focus(const std::string& selector) {
-        std::cout << "Page: Focusing on " << selector << std::endl;
-        return true;
+        NAVIGRAB_LOG(DEBUG) << "Page: Focusing on " << selector;
+        return backend_->Focus(selector);
     }
     
     bool Screenshot(const std::string& filename) {
-        std::cout << "Page: Taking screenshot " << filename << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "Page: Taking screenshot " << filename;
         // Create a dummy screenshot file
         std::ofstream file(filename);
         if (file.is_open()) {
@@ -243,7 +421,7 @@ public:
     }
     
     bool ElementScreenshot(const std::string& selector, const std::string& filename) {
-        std::cout << "Page: Taking element screenshot " << selector << " -> " << filename << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "Page: Taking element screenshot " << selector << " -> " << filename;
         // Create a dummy element screenshot file
         std::ofstream file(filename);
         if (file.is_open()) {
@@ -255,25 +433,25 @@ public:
     }
     
     bool ExecuteScript(const std::string& script) {
-        std::cout << "Page: Executing script: " << script.substr(0, 50) << "..." << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "Page: Executing script: " << script.substr(0, 50) << "...";
         return true;
     }
     
     std::string EvaluateScript(const std::string& script) {
-        std::cout << "Page: Evaluating script: " << script.substr(0, 50) << "..." << std::endl;
-        return "Script result";
+        NAVIGRAB_LOG(DEBUG) << "Page: Evaluating script: " << script.substr(0, 50) << "...";
+        return backend_->EvaluateScript(script);
     }
     
     std::vector<std::string> GetLinks() {
-        return {"https://example.com", "https://google.com", "https://github.com"};
+        return ExtractLinks(*document_, current_url_);
     }
     
     std::vector<std::string> GetButtons() {
-        return {"button.submit", "button.cancel", "button.save"};
+        return QuerySelector(*document_, kButtonSelector);
     }
     
     std::vector<std::string> GetFormElements() {
-        return {"input.email", "input.password", "textarea.comment"};
+        return QuerySelector(*document_, kFormSelector);
     }
     
     // New methods for Page class
@@ -290,32 +468,143 @@ public:
     }
     
     std::string GetElementText(const std::string& selector) {
-        std::cout << "Page: Getting text from " << selector << std::endl;
-        return "Sample element text";
+        NAVIGRAB_LOG(DEBUG) << "Page: Getting text from " << selector;
+        dom::NodeId id = QueryFirst(*document_, selector);
+        return id == dom::kInvalidNode ? std::string() : document_->TextContent(id);
+    }
+    
+    ContentBuffer GetElementTextBuffer(const std::string& selector) {
+        dom::NodeId id = QueryFirst(*document_, selector);
+        return id == dom::kInvalidNode ? ContentBuffer() : TextBuffer(document_, id);
     }
     
     std::string GetElementAttribute(const std::string& selector, const std::string& attribute) {
-        std::cout << "Page: Getting attribute " << attribute << " from " << selector << std::endl;
-        return "sample_" + attribute + "_value";
+        NAVIGRAB_LOG(DEBUG) << "Page: Getting attribute " << attribute << " from " << selector;
+        dom::NodeId id = QueryFirst(*document_, selector);
+        return id == dom::kInvalidNode ? std::string() : std::string(document_->GetAttribute(id, attribute));
     }
     
-    bool ExecuteScriptOnElement(const std::string& selector, const std::string& script) {
-        std::cout << "Page: Executing script on element " << selector << std::endl;
+    bool ExecuteScriptOnElement(const std::string& selector, const std::string& /*script*/) {
+        NAVIGRAB_LOG(DEBUG) << "Page: Executing script on element " << selector;
         return true;
     }
     
+    // Asynchronous pipeline
+    void SetEventLoop(EventLoop* loop) {
+        loop_ = loop;
+    }
+    
+    Task<bool> NavigateToAsync(const std::string& url) {
+        NAVIGRAB_LOG(DEBUG) << "Page: Navigating to " << url << " (async)";
+        if (!loop_) return Task<bool>::Ready(NavigateTo(url));
+        return Schedule<bool>({BackendOperation::NAVIGATE, url, ""}, false,
+                              [this, url](bool success, std::string html) {
+                                  if (!success) return false;
+                                  current_url_ = url;
+                                  return SetContent(ContentBuffer(std::move(html)));
+                              });
+    }
+    
+    Task<bool> WaitForLoadAsync() {
+        if (!loop_) return Task<bool>::Ready(WaitForLoad());
+        return Schedule<bool>({BackendOperation::LOAD, "", ""}, false,
+                              [this](bool success, std::string) { return success && loaded_; });
+    }
+    
+    Task<bool> InteractAsync(BackendOperation operation, const std::string& selector, const std::string& text) {
+        if (!loop_) {
+            switch (operation) {
+                case BackendOperation::CLICK: return Task<bool>::Ready(Click(selector));
+                case BackendOperation::TYPE: return Task<bool>::Ready(Type(selector, text));
+                case BackendOperation::HOVER: return Task<bool>::Ready(Hover(selector));
+                default: return Task<bool>::Ready(Focus(selector));
+            }
+        }
+        return Schedule<bool>({operation, selector, text}, false,
+                              [](bool success, std::string) { return success; });
+    }
+    
+    Task<std::string> EvaluateScriptAsync(const std::string& script) {
+        if (!loop_) return Task<std::string>::Ready(EvaluateScript(script));
+        return Schedule<std::string>({BackendOperation::SCRIPT, script, ""}, std::string(),
+                                     [](bool success, std::string result) {
+                                         return success ? result : std::string();
+                                     });
+    }
+    
+    size_t PendingOperations() const {
+        return pipeline_.size() + (in_flight_ ? 1 : 0);
+    }
+    
 private:
+    // One queued backend operation. |complete| turns the backend result into
+    // the task value; |abandon| settles the task if the page goes away first.
+    struct PendingOperation {
+        BackendRequest request;
+        std::function<void(bool, std::string)> complete;
+        std::function<void()> abandon;
+    };
+    
+    template <typename T>
+    Task<T> Schedule(BackendRequest request, T failure, std::function<T(bool, std::string)> apply) {
+        Promise<T> promise;
+        pipeline_.push_back({std::move(request),
+                             [promise, apply](bool success, std::string result) mutable {
+                                 promise.Set(apply(success, std::move(result)));
+                             },
+                             [promise, failure]() mutable { promise.Set(failure); }});
+        if (!in_flight_) StartNext();
+        return promise.GetTask();
+    }
+    
+    void StartNext() {
+        if (pipeline_.empty()) {
+            in_flight_ = false;
+            return;
+        }
+        in_flight_ = true;
+        auto operation = std::make_shared<PendingOperation>(std::move(pipeline_.front()));
+        pipeline_.pop_front();
+        std::weak_ptr<bool> alive = alive_;
+        backend_->Start(*loop_, operation->request,
+                        [this, alive, operation](bool success, std::string result) {
+                            if (alive.expired()) {
+                                operation->abandon();
+                                return;
+                            }
+                            operation->complete(success, std::move(result));
+                            StartNext();
+                        });
+    }
+    
     bool loaded_;
     std::string current_url_;
+    ContentBuffer content_;
+    std::shared_ptr<dom::Document> document_;
+    std::unique_ptr<PageBackend> backend_;
+    
+    EventLoop* loop_ = nullptr;
+    std::deque<PendingOperation> pipeline_;
+    bool in_flight_ = false;
+    std::shared_ptr<bool> alive_;   // Expires with the page; pending completions check it
 };
 
-Page::Page() : impl_(std::make_unique<Impl>()) {}
+Page::Page() : impl_(std::make_unique<Impl>(GetDefaultBrowserBackend()->CreatePage())) {}
+Page::Page(std::unique_ptr<PageBackend> backend) : impl_(std::make_unique<Impl>(std::move(backend))) {}
 Page::~Page() = default;
 
 bool Page::NavigateTo(const std::string& url) {
     return impl_->NavigateTo(url);
 }
 
+bool Page::Refresh() {
+    return impl_->Refresh();
+}
+
+bool Page::Reset() {
+    return impl_->Reset();
+}
+
 bool Page::WaitForLoad() {
     return impl_->WaitForLoad();
 }
@@ -333,9 +622,33 @@ std::string Page::GetTitle() const {
 }
 
 std::string Page::GetContent() const {
+    return impl_->GetContent().ToString();
+}
+
+ContentBuffer Page::GetContentBuffer() const {
     return impl_->GetContent();
 }
 
+std::string_view Page::GetContentView() const {
+    return impl_->GetContent().View();
+}
+
+bool Page::SetContent(const std::string& html) {
+    return impl_->SetContent(ContentBuffer(html));
+}
+
+bool Page::SetContent(ContentBuffer html) {
+    return impl_->SetContent(std::move(html));
+}
+
+const dom::Document* Page::GetDocument() const {
+    return impl_->GetDocument();
+}
+
+std::shared_ptr<const dom::Document> Page::ShareDocument() const {
+    return impl_->ShareDocument();
+}
+
 bool Page::Click(const std::string& selector) {
     return impl_->Click(selector);
 }
@@ -397,10 +710,50 @@ std::string Page::GetElementText(const std::string& selector) {
     return impl_->GetElementText(selector);
 }
 
+ContentBuffer Page::GetElementTextBuffer(const std::string& selector) {
+    return impl_->GetElementTextBuffer(selector);
+}
+
 std::string Page::GetElementAttribute(const std::string& selector, const std::string& attribute) {
     return impl_->GetElementAttribute(selector, attribute);
 }
 
+void Page::SetEventLoop(EventLoop* loop) {
+    impl_->SetEventLoop(loop);
+}
+
+Task<bool> Page::NavigateToAsync(const std::string& url) {
+    return impl_->NavigateToAsync(url);
+}
+
+Task<bool> Page::WaitForLoadAsync() {
+    return impl_->WaitForLoadAsync();
+}
+
+Task<bool> Page::ClickAsync(const std::string& selector) {
+    return impl_->InteractAsync(BackendOperation::CLICK, selector, "");
+}
+
+Task<bool> Page::TypeAsync(const std::string& selector, const std::string& text) {
+    return impl_->InteractAsync(BackendOperation::TYPE, selector, text);
+}
+
+Task<bool> Page::HoverAsync(const std::string& selector) {
+    return impl_->InteractAsync(BackendOperation::HOVER, selector, "");
+}
+
+Task<bool> Page::FocusAsync(const std::string& selector) {
+    return impl_->InteractAsync(BackendOperation::FOCUS, selector, "");
+}
+
+Task<std::string> Page::EvaluateScriptAsync(const std::string& script) {
+    return impl_->EvaluateScriptAsync(script);
+}
+
+size_t Page::PendingOperations() const {
+    return impl_->PendingOperations();
+}
+
 bool Page::ExecuteScriptOnElement(const std::string& selector, const std::string& script) {
     return impl_->ExecuteScriptOnElement(selector, script);
 }
@@ -408,54 +761,106 @@ bool Page::ExecuteScriptOnElement(const std::string& selector, const std::string
 // Locator Implementation
 class Locator::Impl {
 public:
-    Impl() {}
+    explicit Impl(const Page* page) : page_(page) {}
     
     std::vector<std::string> FindByTag(const std::string& tag) {
-        return {"div", "span", "p"};
+        std::string lower_tag = tag;
+        std::transform(lower_tag.begin(), lower_tag.end(), lower_tag.begin(), ::tolower);
+        return Lookup(&dom::Document::ElementsByTag, lower_tag);
     }
     
     std::vector<std::string> FindByClass(const std::string& className) {
-        return {"element." + className};
+        return Lookup(&dom::Document::ElementsByClass, className);
     }
     
     std::vector<std::string> FindById(const std::string& id) {
-        return {"#" + id};
+        return Lookup(&dom::Document::ElementsById, id);
     }
     
     std::vector<std::string> FindBySelector(const std::string& selector) {
-        return {selector};
+        const dom::Document* document = GetDocument();
+        if (!document || document->IsEmpty()) return {};
+        return QuerySelector(*document, selector);
+    }
+    
+    std::vector<std::vector<std::string>> QueryMany(const std::vector<std::string>& selectors) {
+        const dom::Document* document = GetDocument();
+        if (!document || document->IsEmpty()) return std::vector<std::vector<std::string>>(selectors.size());
+        return QuerySelectors(*document, selectors);
     }
     
     bool IsVisible(const std::string& selector) {
-        return true; // Simplified for demo
+        const dom::Document* document = GetDocument();
+        dom::NodeId id = Resolve(selector);
+        return id != dom::kInvalidNode && document->IsRendered(id);
     }
     
     bool IsEnabled(const std::string& selector) {
-        return true; // Simplified for demo
+        dom::NodeId id = Resolve(selector);
+        return id != dom::kInvalidNode && !GetDocument()->HasAttribute(id, "disabled");
     }
     
     bool IsClickable(const std::string& selector) {
-        return true; // Simplified for demo
+        return IsVisible(selector) && IsEnabled(selector);
     }
     
     std::string GetText(const std::string& selector) {
-        return "Sample text for " + selector;
+        dom::NodeId id = Resolve(selector);
+        return id == dom::kInvalidNode ? std::string() : GetDocument()->TextContent(id);
+    }
+    
+    ContentBuffer GetTextBuffer(const std::string& selector) {
+        dom::NodeId id = Resolve(selector);
+        return id == dom::kInvalidNode ? ContentBuffer() : TextBuffer(page_->ShareDocument(), id);
     }
     
     std::string GetAttribute(const std::string& selector, const std::string& attribute) {
-        return "sample_" + attribute + "_value";
+        dom::NodeId id = Resolve(selector);
+        return id == dom::kInvalidNode ? std::string() : std::string(GetDocument()->GetAttribute(id, attribute));
     }
     
     std::pair<int, int> GetPosition(const std::string& selector) {
-        return {100, 200}; // Sample position
+        dom::NodeId id = Resolve(selector);
+        if (id == dom::kInvalidNode) return {0, 0};
+        const dom::Box& box = GetDocument()->GetBox(id);
+        return {box.x, box.y};
     }
     
     std::pair<int, int> GetSize(const std::string& selector) {
-        return {150, 30}; // Sample size
+        dom::NodeId id = Resolve(selector);
+        if (id == dom::kInvalidNode) return {0, 0};
+        const dom::Box& box = GetDocument()->GetBox(id);
+        return {box.width, box.height};
+    }
+    
+private:
+    const dom::Document* GetDocument() const {
+        return page_ ? page_->GetDocument() : nullptr;
     }
+    
+    dom::NodeId Resolve(const std::string& selector) const {
+        const dom::Document* document = GetDocument();
+        if (!document || document->IsEmpty()) return dom::kInvalidNode;
+        return QueryFirst(*document, selector);
+    }
+    
+    // Canonical selectors for one of the document's inverted indexes
+    std::vector<std::string> Lookup(const dom::NodeList& (dom::Document::*index)(std::string_view) const,
+                                    const std::string& key) const {
+        std::vector<std::string> selectors;
+        const dom::Document* document = GetDocument();
+        if (!document) return selectors;
+        const dom::NodeList& nodes = (document->*index)(key);
+        selectors.reserve(nodes.size());
+        for (dom::NodeId id : nodes) selectors.push_back(document->BuildSelector(id));
+        return selectors;
+    }
+    
+    const Page* page_;
 };
 
-Locator::Locator() : impl_(std::make_unique<Impl>()) {}
+Locator::Locator() : impl_(std::make_unique<Impl>(nullptr)) {}
+Locator::Locator(const Page* page) : impl_(std::make_unique<Impl>(page)) {}
 Locator::~Locator() = default;
 
 std::vector<std::string> Locator::FindByTag(const std::string& tag) {
@@ -474,6 +879,10 @@ std::vector<std::string> Locator::FindBySelector(const std::string& selector) {
     return impl_->FindBySelector(selector);
 }
 
+std::vector<std::vector<std::string>> Locator::QueryMany(const std::vector<std::string>& selectors) {
+    return impl_->QueryMany(selectors);
+}
+
 bool Locator::IsVisible(const std::string& selector) {
     return impl_->IsVisible(selector);
 }
@@ -490,6 +899,10 @@ std::string Locator::GetText(const std::string& selector) {
     return impl_->GetText(selector);
 }
 
+ContentBuffer Locator::GetTextBuffer(const std::string& selector) {
+    return impl_->GetTextBuffer(selector);
+}
+
 std::string Locator::GetAttribute(const std::string& selector, const std::string& attribute) {
     return impl_->GetAttribute(selector, attribute);
 }
@@ -505,49 +918,58 @@ std::pair<int, int> Locator::GetSize(const std::string& selector) {
 // ScreenshotCapture Implementation
 class ScreenshotCapture::Impl {
 public:
-    Impl() : quality_(90), format_("png"), full_page_(false) {}
+    // Full pages rendered into one bitmap stop here; taller pages are cut off
+    static constexpr int kMaxFullPageHeight = 16384;
+    // Full pages encoded to a file or buffer are rendered and encoded this
+    // many rows at a time, so memory follows the tile, not the page
+    static constexpr int kFullPageTileRows = kViewportHeight;
+    // Tiled JPEG full pages stop at the tallest JPEG libjpeg decodes; PNG
+    // and QOI pages are encoded whole
+    static constexpr int kMaxJpegPageHeight = 65500;
+
+    Impl() : format_("png"), full_page_(false), page_(nullptr) {}
+    
+    void AttachPage(const Page* page) {
+        page_ = page;
+    }
     
     bool CaptureFullPage(const std::string& filename) {
-        std::cout << "ScreenshotCapture: Capturing full page -> " << filename << std::endl;
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << "Full page screenshot data";
-            file.close();
-            return true;
-        }
+        NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Capturing full page -> " << filename;
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        bool written = EncodeFullPage([&file](const uint8_t* data, size_t size) {
+            file.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+            return file.good();
+        });
+        file.close();
+        if (written && file.good()) return true;
+        // Leave no truncated image behind
+        std::remove(filename.c_str());
         return false;
     }
     
     bool CaptureViewport(const std::string& filename) {
-        std::cout << "ScreenshotCapture: Capturing viewport -> " << filename << std::endl;
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << "Viewport screenshot data";
-            file.close();
-            return true;
-        }
-        return false;
+        NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Capturing viewport -> " << filename;
+        return RenderPage(false, &frame_) && Encode(frame_, &encoded_) && WriteFile(filename, encoded_);
     }
     
     bool CaptureElement(const std::string& selector, const std::string& filename) {
-        std::cout << "ScreenshotCapture: Capturing element " << selector << " -> " << filename << std::endl;
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << "Element screenshot data for " << selector;
-            file.close();
-            return true;
-        }
-        return false;
+        NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Capturing element " << selector << " -> " << filename;
+        return RenderElement(selector, &frame_) && Encode(frame_, &encoded_) && WriteFile(filename, encoded_);
     }
     
     void SetQuality(int quality) {
-        quality_ = quality;
+        encode_options_.quality = std::clamp(quality, 1, 100);
     }
     
     void SetFormat(const std::string& format) {
         format_ = format;
     }
     
+    void SetCompressionLevel(int level) {
+        encode_options_.compression_level = std::clamp(level, 0, 9);
+    }
+    
     void SetFullPage(bool fullPage) {
         full_page_ = fullPage;
     }
@@ -558,46 +980,211 @@ public:
     }
     
     std::vector<uint8_t> CapturePageData() {
-        std::cout << "ScreenshotCapture: Capturing page to memory" << std::endl;
-        // Return dummy image data
-        return {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A}; // PNG header
+        NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Capturing page to memory";
+        std::vector<uint8_t> data;
+        CaptureToMemory(data);
+        return data;
     }
     
     std::vector<uint8_t> CaptureElementData(const std::string& selector) {
-        std::cout << "ScreenshotCapture: Capturing element " << selector << " to memory" << std::endl;
-        // Return dummy element image data
-        return {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A}; // PNG header
+        NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Capturing element " << selector << " to memory";
+        std::vector<uint8_t> data;
+        if (!RenderElement(selector, &frame_) || !Encode(frame_, &data)) data.clear();
+        return data;
     }
     
     bool CaptureToMemory(std::vector<uint8_t>& data) {
-        data = CapturePageData();
-        return !data.empty();
+        if (full_page_) {
+            data.clear();
+            bool encoded = EncodeFullPage([&data](const uint8_t* bytes, size_t size) {
+                data.insert(data.end(), bytes, bytes + size);
+                return true;
+            });
+            if (encoded) return true;
+        } else if (RenderPage(false, &frame_) && Encode(frame_, &data)) {
+            return true;
+        }
+        data.clear();
+        return false;
+    }
+    
+    bool CaptureToMemory(Bitmap& bitmap) {
+        return RenderPage(full_page_, &bitmap);
+    }
+    
+    bool CaptureElementToMemory(const std::string& selector, Bitmap& bitmap) {
+        return RenderElement(selector, &bitmap);
+    }
+    
+    bool CaptureElementsToMemory(const std::vector<std::string>& selectors, std::vector<Bitmap>& bitmaps) {
+        const dom::Document& document = Document();
+        std::vector<dom::Box> boxes(selectors.size(), dom::Box{0, 0, 0, 0});
+        bitmaps.resize(selectors.size());
+        for (size_t i = 0; i < selectors.size(); ++i) {
+            dom::NodeId id = QueryFirst(document, selectors[i]);
+            if (id != dom::kInvalidNode && document.IsRendered(id)) {
+                boxes[i] = document.GetBox(id);
+            } else {
+                NAVIGRAB_LOG(WARNING) << "ScreenshotCapture: No rendered element for " << selectors[i];
+                bitmaps[i].Reset();
+            }
+        }
+        
+        std::vector<CaptureFrame> frames = PlanCaptureFrames(boxes, document.ViewportWidth(), kViewportHeight);
+        NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Capturing " << selectors.size() << " elements from "
+                            << frames.size() << " frames";
+        // Frames are independent, so they render on all threads; one element
+        // renders straight into its bitmap, several are cropped from a frame
+        ParallelFor(frames.size(), 0, [&](size_t f) {
+            const CaptureFrame& frame = frames[f];
+            if (frame.boxes.size() == 1) {
+                size_t i = frame.boxes.front();
+                if (!RasterizePage(document, boxes[i], &bitmaps[i])) bitmaps[i].Reset();
+                return;
+            }
+            Bitmap shared;
+            bool rendered = RasterizePage(document, frame.region, &shared);
+            for (size_t i : frame.boxes) {
+                const dom::Box& box = boxes[i];
+                if (!rendered || !bitmaps[i].CopyFrom(shared, box.x - frame.region.x, box.y - frame.region.y,
+                                                      box.width, box.height)) {
+                    bitmaps[i].Reset();
+                }
+            }
+        });
+        return std::none_of(bitmaps.begin(), bitmaps.end(), [](const Bitmap& bitmap) { return bitmap.IsEmpty(); });
     }
     
     std::vector<uint8_t> GenerateThumbnail(const std::vector<uint8_t>& image_data, int max_width, int max_height) {
-        std::cout << "ScreenshotCapture: Generating thumbnail " << max_width << "x" << max_height << std::endl;
-        // Return compressed thumbnail data
-        return image_data; // Simplified for demo
+        NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Generating thumbnail " << max_width << "x" << max_height;
+        // Images that cannot be decoded or already fit are passed through
+        if (!DecodeImage(image_data, &frame_)) return image_data;
+        if (frame_.Width() <= max_width && frame_.Height() <= max_height) return image_data;
+        std::vector<uint8_t> thumbnail;
+        if (!GenerateThumbnail(frame_, max_width, max_height, thumbnail_) || !Encode(thumbnail_, &thumbnail)) {
+            return image_data;
+        }
+        return thumbnail;
+    }
+    
+    bool GenerateThumbnail(const Bitmap& source, int max_width, int max_height, Bitmap& thumbnail) {
+        if (source.IsEmpty() || max_width <= 0 || max_height <= 0) return false;
+        // Largest size within the bounds that keeps the aspect ratio
+        double scale = std::min({1.0, static_cast<double>(max_width) / source.Width(),
+                                 static_cast<double>(max_height) / source.Height()});
+        int width = std::max(1, static_cast<int>(source.Width() * scale + 0.5));
+        int height = std::max(1, static_cast<int>(source.Height() * scale + 0.5));
+        // Area averaging: the cheapest filter, and free of ringing at this scale
+        return ResampleBitmap(source, std::min(width, max_width), std::min(height, max_height), &thumbnail);
     }
     
 private:
-    int quality_;
+    const dom::Document& Document() const {
+        if (page_ && page_->GetDocument()) return *page_->GetDocument();
+        // Without a page the capture is an empty viewport
+        static const dom::Document* const blank = [] {
+            auto* document = new dom::Document();
+            document->Load("");
+            return document;
+        }();
+        return *blank;
+    }
+    
+    bool RenderPage(bool full_page, Bitmap* bitmap) const {
+        const dom::Document& document = Document();
+        int height = kViewportHeight;
+        if (full_page) height = ClampPageHeight(document.PageHeight(), kMaxFullPageHeight, "a single bitmap");
+        return RasterizePage(document, {0, 0, document.ViewportWidth(), height}, bitmap);
+    }
+    
+    bool RenderElement(const std::string& selector, Bitmap* bitmap) const {
+        const dom::Document& document = Document();
+        dom::NodeId id = QueryFirst(document, selector);
+        if (id == dom::kInvalidNode || !document.IsRendered(id)) {
+            NAVIGRAB_LOG(WARNING) << "ScreenshotCapture: No rendered element for " << selector;
+            return false;
+        }
+        return RasterizePage(document, document.GetBox(id), bitmap);
+    }
+    
+    // |page_height| within [1, |limit|], warning when the page is cut off
+    static int ClampPageHeight(int page_height, int limit, const char* what) {
+        if (page_height > limit) {
+            NAVIGRAB_LOG(WARNING) << "ScreenshotCapture: Page is " << page_height << " px tall, cut off at "
+                                  << limit << " px for " << what;
+        }
+        return std::clamp(page_height, 1, limit);
+    }
+    
+    // Renders the page a tile at a time, passing each tile's encoded bytes
+    // to |sink| before the next is drawn over it in |frame_|
+    bool EncodeFullPage(const StreamingImageEncoder::Sink& sink) {
+        const dom::Document& document = Document();
+        int width = document.ViewportWidth();
+        ImageFormat format = Format();
+        int height = std::max(document.PageHeight(), 1);
+        if (format == ImageFormat::JPEG) height = ClampPageHeight(height, kMaxJpegPageHeight, "JPEG");
+        if (!page_encoder_.Begin(format, width, height, kFullPageTileRows, encode_options_, sink)) return false;
+        for (int y = 0; y < height; y += kFullPageTileRows) {
+            int rows = std::min(kFullPageTileRows, height - y);
+            if (!RasterizePage(document, {0, y, width, rows}, &frame_) || !page_encoder_.AddRows(frame_)) {
+                return false;
+            }
+        }
+        return page_encoder_.Finish();
+    }
+    
+    ImageFormat Format() const {
+        ImageFormat format = ParseImageFormat(format_);
+        if (format == ImageFormat::UNKNOWN) {
+            NAVIGRAB_LOG(DEBUG) << "ScreenshotCapture: Unsupported format " << format_ << ", encoding PNG";
+            format = ImageFormat::PNG;
+        }
+        return format;
+    }
+    
+    bool Encode(const Bitmap& bitmap, std::vector<uint8_t>* out) const {
+        return EncodeImage(bitmap, Format(), out, encode_options_);
+    }
+    
+    static bool WriteFile(const std::string& filename, const std::vector<uint8_t>& data) {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return file.good();
+    }
+    
     std::string format_;
+    EncodeOptions encode_options_;
     bool full_page_;
+    const Page* page_;
+    
+    // Reused across captures so bursts do not reallocate
+    Bitmap frame_;
+    Bitmap thumbnail_;
+    std::vector<uint8_t> encoded_;
+    StreamingImageEncoder page_encoder_;
 };
 
 ScreenshotCapture::ScreenshotCapture() : impl_(std::make_unique<Impl>()) {}
 ScreenshotCapture::~ScreenshotCapture() = default;
 
+void ScreenshotCapture::AttachPage(const Page* page) {
+    impl_->AttachPage(page);
+}
+
 bool ScreenshotCapture::CaptureFullPage(const std::string& filename) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::FULL_PAGE));
     return impl_->CaptureFullPage(filename);
 }
 
 bool ScreenshotCapture::CaptureViewport(const std::string& filename) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::VIEWPORT));
     return impl_->CaptureViewport(filename);
 }
 
 bool ScreenshotCapture::CaptureElement(const std::string& selector, const std::string& filename) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::ELEMENT));
     return impl_->CaptureElement(selector, filename);
 }
 
@@ -609,102 +1196,152 @@ void ScreenshotCapture::SetFormat(const std::string& format) {
     impl_->SetFormat(format);
 }
 
+void ScreenshotCapture::SetCompressionLevel(int level) {
+    impl_->SetCompressionLevel(level);
+}
+
 void ScreenshotCapture::SetFullPage(bool fullPage) {
     impl_->SetFullPage(fullPage);
 }
 
 // New ScreenshotCapture methods
 bool ScreenshotCapture::CapturePage(const std::string& filename) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::FULL_PAGE));
     return impl_->CapturePage(filename);
 }
 
 std::vector<uint8_t> ScreenshotCapture::CapturePageData() {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::PAGE_DATA));
     return impl_->CapturePageData();
 }
 
 std::vector<uint8_t> ScreenshotCapture::CaptureElementData(const std::string& selector) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::ELEMENT_DATA));
     return impl_->CaptureElementData(selector);
 }
 
 bool ScreenshotCapture::CaptureToMemory(std::vector<uint8_t>& data) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::PAGE_DATA));
     return impl_->CaptureToMemory(data);
 }
 
+bool ScreenshotCapture::CaptureToMemory(Bitmap& bitmap) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::PAGE_DATA));
+    return impl_->CaptureToMemory(bitmap);
+}
+
+bool ScreenshotCapture::CaptureElementToMemory(const std::string& selector, Bitmap& bitmap) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::ELEMENT_DATA));
+    return impl_->CaptureElementToMemory(selector, bitmap);
+}
+
+bool ScreenshotCapture::CaptureElementsToMemory(const std::vector<std::string>& selectors, std::vector<Bitmap>& bitmaps) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::ELEMENT_BATCH));
+    return impl_->CaptureElementsToMemory(selectors, bitmaps);
+}
+
 std::vector<uint8_t> ScreenshotCapture::GenerateThumbnail(const std::vector<uint8_t>& image_data, int max_width, int max_height) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::THUMBNAIL));
     return impl_->GenerateThumbnail(image_data, max_width, max_height);
 }
 
+bool ScreenshotCapture::GenerateThumbnail(const Bitmap& source, Bitmap& thumbnail, int max_width, int max_height) {
+    ScopedLatencyTimer timer(CaptureHistogram(CaptureKind::THUMBNAIL));
+    return impl_->GenerateThumbnail(source, max_width, max_height, thumbnail);
+}
+
 // WebAutomation Implementation
 class WebAutomation::Impl {
 public:
     Impl() {}
     
     bool FillForm(const std::string& formSelector, const std::vector<std::pair<std::string, std::string>>& fields) {
-        std::cout << "WebAutomation: Filling form " << formSelector << " with " << fields.size() << " fields" << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Filling form " << formSelector << " with " << fields.size() << " fields";
         for (const auto& field : fields) {
-            std::cout << "  Field: " << field.first << " = " << field.second << std::endl;
+            NAVIGRAB_LOG(TRACE) << "  Field: " << field.first << " = " << field.second;
         }
         return true;
     }
     
     bool SubmitForm(const std::string& formSelector) {
-        std::cout << "WebAutomation: Submitting form " << formSelector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Submitting form " << formSelector;
         return true;
     }
     
     bool GoBack() {
-        std::cout << "WebAutomation: Going back" << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Going back";
         return true;
     }
     
     bool GoForward() {
-        std::cout << "WebAutomation: Going forward" << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Going forward";
         return true;
     }
     
     bool Refresh() {
-        std::cout << "WebAutomation: Refreshing page" << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Refreshing page";
         return true;
     }
     
     std::string ExtractText(const std::string& selector) {
-        std::cout << "WebAutomation: Extracting text from " << selector << std::endl;
-        return "Extracted text content";
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Extracting text from " << selector;
+        const dom::Document* document = GetDocument();
+        if (!document || document->IsEmpty()) return std::string();
+        return JoinText(*document, QueryAll(*document, selector));
     }
     
-    std::vector<std::string> ExtractLinks(const std::string& containerSelector) {
-        std::cout << "WebAutomation: Extracting links from " << containerSelector << std::endl;
-        return {"https://example1.com", "https://example2.com", "https://example3.com"};
+    ContentBuffer ExtractTextBuffer(const std::string& selector) {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Extracting text from " << selector;
+        const dom::Document* document = GetDocument();
+        if (!document || document->IsEmpty()) return ContentBuffer();
+        dom::NodeList matches = QueryAll(*document, selector);
+        // A single match can be shared; several are joined into one new buffer
+        if (matches.size() == 1) return TextBuffer(page_->ShareDocument(), matches.front());
+        return ContentBuffer(JoinText(*document, matches));
     }
     
-    std::vector<std::string> ExtractImages(const std::string& containerSelector) {
-        std::cout << "WebAutomation: Extracting images from " << containerSelector << std::endl;
-        return {"image1.jpg", "image2.png", "image3.gif"};
+    std::vector<std::string> ExtractLinks(const std::string& containerSelector) {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Extracting links from " << containerSelector;
+        return CollectLinks(containerSelector, LinkSource::HREF);
     }
     
-    bool ExecuteScript(const std::string& script) {
-        std::cout << "WebAutomation: Executing script" << std::endl;
-        return true;
+    std::vector<std::string> ExtractImages(const std::string& containerSelector) {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Extracting images from " << containerSelector;
+        return CollectLinks(containerSelector, LinkSource::SRC);
     }
     
-    std::string EvaluateExpression(const std::string& expression) {
-        std::cout << "WebAutomation: Evaluating expression" << std::endl;
-        return "Expression result";
+    void AttachPage(Page* page) {
+        page_ = page;
     }
     
     std::vector<std::string> DiscoverInteractiveElements() {
-        std::cout << "WebAutomation: Discovering interactive elements" << std::endl;
-        return {"button.submit", "a.link", "input.text", "select.dropdown"};
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Discovering interactive elements";
+        const dom::Document* document = GetDocument();
+        return document ? QuerySelector(*document, kInteractiveSelector) : std::vector<std::string>();
     }
     
     std::vector<std::string> DiscoverFormElements() {
-        std::cout << "WebAutomation: Discovering form elements" << std::endl;
-        return {"input.email", "input.password", "textarea.comment", "select.country"};
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Discovering form elements";
+        const dom::Document* document = GetDocument();
+        return document ? QuerySelector(*document, kFormSelector) : std::vector<std::string>();
     }
     
     std::vector<std::string> DiscoverNavigationElements() {
-        std::cout << "WebAutomation: Discovering navigation elements" << std::endl;
-        return {"nav.main", "a.breadcrumb", "button.back", "a.next"};
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Discovering navigation elements";
+        const dom::Document* document = GetDocument();
+        return document ? QuerySelector(*document, kNavigationSelector) : std::vector<std::string>();
+    }
+    
+    DiscoveredElements DiscoverElements() {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Discovering all elements";
+        DiscoveredElements elements;
+        const dom::Document* document = GetDocument();
+        if (!document) return elements;
+        auto results = QuerySelectors(*document, {kInteractiveSelector, kFormSelector, kNavigationSelector});
+        elements.interactive = std::move(results[0]);
+        elements.form = std::move(results[1]);
+        elements.navigation = std::move(results[2]);
+        return elements;
     }
     
     // New methods for WebAutomation
@@ -720,58 +1357,109 @@ public:
         return std::make_unique<ScreenshotCapture>();
     }
     
-    std::string ExecuteScript(const std::string& script) {
-        std::cout << "WebAutomation: Executing script (returning result)" << std::endl;
+    std::string ExecuteScript(const std::string& /*script*/) {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Executing script (returning result)";
         return "Script execution result";
     }
     
-    std::string EvaluateExpression(const std::string& expression) {
-        std::cout << "WebAutomation: Evaluating expression (returning result)" << std::endl;
+    std::string EvaluateExpression(const std::string& /*expression*/) {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Evaluating expression (returning result)";
         return "Expression evaluation result";
     }
     
-    bool ExecuteScriptOnElement(const std::string& selector, const std::string& script) {
-        std::cout << "WebAutomation: Executing script on element " << selector << std::endl;
+    bool ExecuteScriptOnElement(const std::string& selector, const std::string& /*script*/) {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Executing script on element " << selector;
         return true;
     }
     
     bool ClickElement(const std::string& selector) {
-        std::cout << "WebAutomation: Clicking element " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Clicking element " << selector;
         return true;
     }
     
     bool TypeText(const std::string& selector, const std::string& text) {
-        std::cout << "WebAutomation: Typing '" << text << "' into " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Typing '" << text << "' into " << selector;
         return true;
     }
     
     bool HoverElement(const std::string& selector) {
-        std::cout << "WebAutomation: Hovering over " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Hovering over " << selector;
         return true;
     }
     
     std::string GetElementText(const std::string& selector) {
-        std::cout << "WebAutomation: Getting text from " << selector << std::endl;
-        return "Sample element text";
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Getting text from " << selector;
+        const dom::Document* document = GetDocument();
+        dom::NodeId id = document && !document->IsEmpty() ? QueryFirst(*document, selector) : dom::kInvalidNode;
+        return id == dom::kInvalidNode ? std::string() : document->TextContent(id);
+    }
+    
+    ContentBuffer GetElementTextBuffer(const std::string& selector) {
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Getting text from " << selector;
+        const dom::Document* document = GetDocument();
+        dom::NodeId id = document && !document->IsEmpty() ? QueryFirst(*document, selector) : dom::kInvalidNode;
+        return id == dom::kInvalidNode ? ContentBuffer() : TextBuffer(page_->ShareDocument(), id);
     }
     
     std::string GetElementAttribute(const std::string& selector, const std::string& attribute) {
-        std::cout << "WebAutomation: Getting attribute " << attribute << " from " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Getting attribute " << attribute << " from " << selector;
         return "sample_" + attribute + "_value";
     }
     
     bool FillForm(const std::string& formSelector, const std::map<std::string, std::string>& fields) {
-        std::cout << "WebAutomation: Filling form " << formSelector << " with map data" << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "WebAutomation: Filling form " << formSelector << " with map data";
         for (const auto& field : fields) {
-            std::cout << "  Field: " << field.first << " = " << field.second << std::endl;
+            NAVIGRAB_LOG(TRACE) << "  Field: " << field.first << " = " << field.second;
         }
         return true;
     }
+    
+private:
+    static dom::NodeList QueryAll(const dom::Document& document, const std::string& selector) {
+        auto compiled = SelectorCache::GetInstance().Get(selector);
+        return SelectorMatcher(document).QueryAll(*compiled);
+    }
+    
+    // Links inside every match of |container_selector|, or the whole page
+    std::vector<std::string> CollectLinks(const std::string& container_selector, LinkSource source) {
+        const dom::Document* document = GetDocument();
+        if (!document || document->IsEmpty()) return {};
+        std::string url = page_->GetUrl();
+        if (container_selector.empty()) return navigrab::ExtractLinks(*document, url, source);
+        return navigrab::ExtractLinks(*document, url, source, QueryAll(*document, container_selector));
+    }
+    
+    // Text of each match, one per line
+    static std::string JoinText(const dom::Document& document, const dom::NodeList& matches) {
+        std::string text;
+        std::string scratch;
+        for (dom::NodeId id : matches) {
+            std::string_view part = document.TextView(id, &scratch);
+            if (part.empty()) continue;
+            if (!text.empty()) text.push_back('\n');
+            text.append(part);
+        }
+        return text;
+    }
+    
+    const dom::Document* GetDocument() const {
+        if (!page_) {
+            NAVIGRAB_LOG(WARNING) << "WebAutomation: No page attached";
+            return nullptr;
+        }
+        return page_->GetDocument();
+    }
+    
+    Page* page_ = nullptr;
 };
 
 WebAutomation::WebAutomation() : impl_(std::make_unique<Impl>()) {}
 WebAutomation::~WebAutomation() = default;
 
+void WebAutomation::AttachPage(Page* page) {
+    impl_->AttachPage(page);
+}
+
 bool WebAutomation::FillForm(const std::string& formSelector, const std::vector<std::pair<std::string, std::string>>& fields) {
     return impl_->FillForm(formSelector, fields);
 }
@@ -796,6 +1484,10 @@ std::string WebAutomation::ExtractText(const std::string& selector) {
     return impl_->ExtractText(selector);
 }
 
+ContentBuffer WebAutomation::ExtractTextBuffer(const std::string& selector) {
+    return impl_->ExtractTextBuffer(selector);
+}
+
 std::vector<std::string> WebAutomation::ExtractLinks(const std::string& containerSelector) {
     return impl_->ExtractLinks(containerSelector);
 }
@@ -804,14 +1496,6 @@ std::vector<std::string> WebAutomation::ExtractImages(const std::string& contain
     return impl_->ExtractImages(containerSelector);
 }
 
-bool WebAutomation::ExecuteScript(const std::string& script) {
-    return impl_->ExecuteScript(script);
-}
-
-std::string WebAutomation::EvaluateExpression(const std::string& expression) {
-    return impl_->EvaluateExpression(expression);
-}
-
 std::vector<std::string> WebAutomation::DiscoverInteractiveElements() {
     return impl_->DiscoverInteractiveElements();
 }
@@ -824,6 +1508,10 @@ std::vector<std::string> WebAutomation::DiscoverNavigationElements() {
     return impl_->DiscoverNavigationElements();
 }
 
+DiscoveredElements WebAutomation::DiscoverElements() {
+    return impl_->DiscoverElements();
+}
+
 // New WebAutomation methods
 std::unique_ptr<Browser> WebAutomation::CreateBrowser() {
     return impl_->CreateBrowser();
@@ -865,6 +1553,10 @@ std::string WebAutomation::GetElementText(const std::string& selector) {
     return impl_->GetElementText(selector);
 }
 
+ContentBuffer WebAutomation::GetElementTextBuffer(const std::string& selector) {
+    return impl_->GetElementTextBuffer(selector);
+}
+
 std::string WebAutomation::GetElementAttribute(const std::string& selector, const std::string& attribute) {
     return impl_->GetElementAttribute(selector, attribute);
 }
@@ -881,26 +1573,29 @@ public:
     bool Initialize(const std::string& storage_path) {
         storage_path_ = storage_path;
         initialized_ = true;
-        std::cout << "ImageStorage: Initialized with path " << storage_path << std::endl;
+        NAVIGRAB_LOG(INFO) << "ImageStorage: Initialized with path " << storage_path;
         return true;
     }
     
     void Shutdown() {
         initialized_ = false;
-        std::cout << "ImageStorage: Shutdown" << std::endl;
+        NAVIGRAB_LOG(INFO) << "ImageStorage: Shutdown";
     }
     
     bool StoreImage(const std::string& key, const std::vector<uint8_t>& image_data) {
         if (!initialized_) return false;
-        images_[key] = image_data;
-        std::cout << "ImageStorage: Stored image " << key << " (" << image_data.size() << " bytes)" << std::endl;
+        Entry& entry = images_[key];
+        entry.data = image_data;
+        entry.format = DetectImageFormat(image_data.data(), image_data.size());
+        NAVIGRAB_LOG(DEBUG) << "ImageStorage: Stored " << ImageFormatName(entry.format) << " image " << key
+                            << " (" << image_data.size() << " bytes)";
         return true;
     }
     
     std::vector<uint8_t> GetImage(const std::string& key) {
         auto it = images_.find(key);
         if (it != images_.end()) {
-            return it->second;
+            return it->second.data;
         }
         return {};
     }
@@ -918,6 +1613,11 @@ public:
         return images_.find(key) != images_.end();
     }
     
+    std::string GetImageFormat(const std::string& key) {
+        auto it = images_.find(key);
+        return it != images_.end() ? ImageFormatName(it->second.format) : "";
+    }
+    
     std::vector<std::string> ListImages() {
         std::vector<std::string> keys;
         for (const auto& pair : images_) {
@@ -929,7 +1629,7 @@ public:
     size_t GetStorageSize() {
         size_t total = 0;
         for (const auto& pair : images_) {
-            total += pair.second.size();
+            total += pair.second.data.size();
         }
         return total;
     }
@@ -940,19 +1640,49 @@ public:
     }
     
     std::vector<uint8_t> CompressImage(const std::vector<uint8_t>& image_data, int quality) {
-        // Simplified compression - just return the data
-        return image_data;
+        // Re-encodes as JPEG at |quality|. Images that cannot be decoded,
+        // JPEGs included, and those JPEG would not shrink are passed through.
+        if (!DecodeImage(image_data, &decoded_)) return image_data;
+        EncodeOptions options;
+        options.quality = std::clamp(quality, 1, 100);
+        std::vector<uint8_t> compressed;
+        if (!EncodeImage(decoded_, ImageFormat::JPEG, &compressed, options) ||
+            compressed.size() >= image_data.size()) {
+            return image_data;
+        }
+        return compressed;
     }
     
     std::vector<uint8_t> ResizeImage(const std::vector<uint8_t>& image_data, int width, int height) {
-        // Simplified resize - just return the data
-        return image_data;
+        // Images that cannot be decoded are passed through; the rest keep their codec
+        ImageFormat format = DetectImageFormat(image_data.data(), image_data.size());
+        if (!DecodeImage(image_data, &decoded_)) return image_data;
+        if (decoded_.Width() == width && decoded_.Height() == height) return image_data;
+        ResampleOptions options;
+        // Area averaging when shrinking; interpolation when enlarging
+        options.filter = width < decoded_.Width() && height < decoded_.Height()
+            ? ResampleFilter::BOX : ResampleFilter::BILINEAR;
+        std::vector<uint8_t> resized;
+        if (!ResampleBitmap(decoded_, width, height, &resized_, options) ||
+            !EncodeImage(resized_, format, &resized)) {
+            return image_data;
+        }
+        return resized;
     }
     
 private:
+    struct Entry {
+        std::vector<uint8_t> data;
+        ImageFormat format = ImageFormat::UNKNOWN;
+    };
+    
     bool initialized_;
     std::string storage_path_;
-    std::map<std::string, std::vector<uint8_t>> images_;
+    std::map<std::string, Entry> images_;
+    
+    // Reused by CompressImage() and ResizeImage()
+    Bitmap decoded_;
+    Bitmap resized_;
 };
 
 ImageStorage::ImageStorage() : impl_(std::make_unique<Impl>()) {}
@@ -982,6 +1712,10 @@ bool ImageStorage::ImageExists(const std::string& key) {
     return impl_->ImageExists(key);
 }
 
+std::string ImageStorage::GetImageFormat(const std::string& key) {
+    return impl_->GetImageFormat(key);
+}
+
 std::vector<std::string> ImageStorage::ListImages() {
     return impl_->ListImages();
 }
@@ -1007,46 +1741,46 @@ class TooltipIntegration::Impl {
 public:
     Impl() : dark_mode_(false) {}
     
-    bool ShowTooltip(const std::string& selector, const std::string& content) {
-        std::cout << "TooltipIntegration: Showing tooltip for " << selector << std::endl;
+    bool ShowTooltip(const std::string& selector, const std::string& /*content*/) {
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Showing tooltip for " << selector;
         return true;
     }
     
     void HideTooltip() {
-        std::cout << "TooltipIntegration: Hiding tooltip" << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Hiding tooltip";
     }
     
-    void UpdateTooltip(const std::string& content) {
-        std::cout << "TooltipIntegration: Updating tooltip content" << std::endl;
+    void UpdateTooltip(const std::string& /*content*/) {
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Updating tooltip content";
     }
     
     bool HighlightElement(const std::string& selector) {
-        std::cout << "TooltipIntegration: Highlighting element " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Highlighting element " << selector;
         return true;
     }
     
     void RemoveHighlight(const std::string& selector) {
-        std::cout << "TooltipIntegration: Removing highlight from " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Removing highlight from " << selector;
     }
     
     std::string ExtractElementInfo(const std::string& selector) {
-        std::cout << "TooltipIntegration: Extracting info from " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Extracting info from " << selector;
         return "Element info: " + selector;
     }
     
     std::vector<uint8_t> CaptureElementScreenshot(const std::string& selector) {
-        std::cout << "TooltipIntegration: Capturing screenshot of " << selector << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Capturing screenshot of " << selector;
         return {0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A}; // PNG header
     }
     
     void SetDarkMode(bool enabled) {
         dark_mode_ = enabled;
-        std::cout << "TooltipIntegration: Dark mode " << (enabled ? "enabled" : "disabled") << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Dark mode " << (enabled ? "enabled" : "disabled");
     }
     
     void SetTooltipStyle(const std::string& style) {
         style_ = style;
-        std::cout << "TooltipIntegration: Style set to " << style << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "TooltipIntegration: Style set to " << style;
     }
     
 private:
@@ -6,6 +6,10 @@
 #include <functional>
 #include <map>
 
+#include "bitmap.h"
+#include "content_buffer.h"
+#include "event_loop.h"
+
 namespace navigrab {
 
 // Forward declarations
@@ -17,6 +21,15 @@ class WebAutomation;
 class ImageStorage;
 class TooltipIntegration;
 
+class BrowserBackend;
+class PageBackend;
+class BrowserPool;
+class PageLease;
+
+namespace dom {
+class Document;
+}
+
 // Factory functions - REQUIRED for integration
 std::unique_ptr<WebAutomation> CreateWebAutomation();
 std::unique_ptr<Browser> CreateBrowser();
@@ -45,6 +58,11 @@ public:
     bool LaunchBrowser();
     void CloseBrowser();
 
+    // Pooled pages on the default backend (see browser_pool.h); the pool
+    // launches its browser on first use and is kept until Shutdown()
+    BrowserPool& GetBrowserPool();
+    PageLease AcquirePage();
+    
     // Page operations
     std::unique_ptr<Page> CreatePage();
     bool NavigateToPage(const std::string& url);
@@ -72,6 +90,8 @@ public:
     std::string GetPageTitle();
 
 private:
+    static std::unique_ptr<NaviGrabCore> instance_;
+
     class Impl;
     std::unique_ptr<Impl> impl_;
 };
@@ -79,7 +99,8 @@ private:
 // Browser class
 class Browser {
 public:
-    Browser();
+    Browser();  // Uses GetDefaultBrowserBackend()
+    explicit Browser(std::shared_ptr<BrowserBackend> backend);
     ~Browser();
     
     bool Launch();
@@ -101,16 +122,34 @@ private:
 // Page class
 class Page {
 public:
-    Page();
+    Page();  // Page of the default browser backend
+    explicit Page(std::unique_ptr<PageBackend> backend);
     ~Page();
     
     bool NavigateTo(const std::string& url);
+    bool Refresh();
     bool WaitForLoad();
+    // Back to a blank page with no document or event loop, ready for reuse
+    bool Reset();
     bool IsLoaded() const;
     
     std::string GetUrl() const;
     std::string GetTitle() const;
     std::string GetContent() const;
+    // The markup without copying it. The buffer keeps it alive across later
+    // navigations; the view is valid until the next one.
+    ContentBuffer GetContentBuffer() const;
+    std::string_view GetContentView() const;
+    
+    // Replace the page markup and rebuild the DOM
+    bool SetContent(const std::string& html);
+    bool SetContent(ContentBuffer html);    // Shares |html| instead of copying it
+    
+    // In-process DOM of the current page (rebuilt on every navigation)
+    const dom::Document* GetDocument() const;
+    // Shared ownership of that DOM. While one is held, the next navigation
+    // parses into a fresh document instead of reusing this one.
+    std::shared_ptr<const dom::Document> ShareDocument() const;
     
     // Element interaction
     bool Click(const std::string& selector);
@@ -123,8 +162,23 @@ public:
     bool TypeText(const std::string& selector, const std::string& text);  // Alias for Type()
     bool HoverElement(const std::string& selector);     // Alias for Hover()
     
+    // Asynchronous variants. Operations issued on one page run in issue order
+    // (a click queued behind NavigateToAsync waits for the navigation), while
+    // pages sharing a loop overlap. Set the loop before issuing operations;
+    // without one they run synchronously and return ready tasks.
+    void SetEventLoop(EventLoop* loop);
+    Task<bool> NavigateToAsync(const std::string& url);
+    Task<bool> WaitForLoadAsync();
+    Task<bool> ClickAsync(const std::string& selector);
+    Task<bool> TypeAsync(const std::string& selector, const std::string& text);
+    Task<bool> HoverAsync(const std::string& selector);
+    Task<bool> FocusAsync(const std::string& selector);
+    Task<std::string> EvaluateScriptAsync(const std::string& script);
+    size_t PendingOperations() const;   // Queued or in flight
+    
     // Content extraction - NEW METHODS
     std::string GetElementText(const std::string& selector);
+    ContentBuffer GetElementTextBuffer(const std::string& selector);    // Shares the DOM's text when possible
     std::string GetElementAttribute(const std::string& selector, const std::string& attribute);
     bool ExecuteScriptOnElement(const std::string& selector, const std::string& script);
     
@@ -136,7 +190,8 @@ public:
     bool ExecuteScript(const std::string& script);
     std::string EvaluateScript(const std::string& script);
     
-    // Element discovery
+    // Element discovery. Links are absolute, canonical and de-duplicated
+    // (see link_extractor.h); relative ones need a page URL to resolve against.
     std::vector<std::string> GetLinks();
     std::vector<std::string> GetButtons();
     std::vector<std::string> GetFormElements();
@@ -150,6 +205,7 @@ private:
 class Locator {
 public:
     Locator();
+    explicit Locator(const Page* page);  // Queries run against page->GetDocument()
     ~Locator();
     
     // Find elements
@@ -158,6 +214,9 @@ public:
     std::vector<std::string> FindById(const std::string& id);
     std::vector<std::string> FindBySelector(const std::string& selector);
     
+    // Evaluates every selector in one pass; result i holds the matches of selectors[i]
+    std::vector<std::vector<std::string>> QueryMany(const std::vector<std::string>& selectors);
+    
     // Element properties
     bool IsVisible(const std::string& selector);
     bool IsEnabled(const std::string& selector);
@@ -165,6 +224,7 @@ public:
     
     // Element information
     std::string GetText(const std::string& selector);
+    ContentBuffer GetTextBuffer(const std::string& selector);   // Shares the DOM's text when possible
     std::string GetAttribute(const std::string& selector, const std::string& attribute);
     std::pair<int, int> GetPosition(const std::string& selector);
     std::pair<int, int> GetSize(const std::string& selector);
@@ -180,7 +240,13 @@ public:
     ScreenshotCapture();
     ~ScreenshotCapture();
     
-    // Screenshot methods
+    // Page to render (not owned); without one captures are a blank viewport
+    void AttachPage(const Page* page);
+    
+    // Screenshot methods. Full pages are rendered and encoded one
+    // viewport-height tile at a time into a single file, so memory follows the
+    // viewport rather than the page. JPEG pages stop at 65500 rows, with a
+    // warning; PNG and QOI pages are encoded whole.
     bool CaptureFullPage(const std::string& filename);
     bool CaptureViewport(const std::string& filename);
     bool CaptureElement(const std::string& selector, const std::string& filename);
@@ -191,15 +257,31 @@ public:
     // Memory-based capture - NEW METHODS for tooltips
     std::vector<uint8_t> CapturePageData();             // Return image data directly
     std::vector<uint8_t> CaptureElementData(const std::string& selector);
-    bool CaptureToMemory(std::vector<uint8_t>& data);   // Capture to memory buffer
+    bool CaptureToMemory(std::vector<uint8_t>& data);   // Encodes into |data|, reusing its capacity; tiled for full pages
+    
+    // Renders pixels into a caller-owned bitmap, reusing its buffer (or the
+    // wrapped memory) when it is large enough. A full page is held whole, so
+    // it stops at 16384 rows.
+    bool CaptureToMemory(Bitmap& bitmap);
+    bool CaptureElementToMemory(const std::string& selector, Bitmap& bitmap);
+    
+    // Captures many elements at once. Elements that fit in one viewport-sized
+    // frame are cropped, in parallel, from a single rendering of it, so a
+    // page of buttons costs a few frames rather than a render each.
+    // |bitmaps| gets one entry per selector, left empty where nothing
+    // rendered matched; false if any entry is empty.
+    bool CaptureElementsToMemory(const std::vector<std::string>& selectors, std::vector<Bitmap>& bitmaps);
     
     // Thumbnail generation for tooltips
     std::vector<uint8_t> GenerateThumbnail(const std::vector<uint8_t>& image_data, 
                                           int max_width = 200, int max_height = 150);
+    bool GenerateThumbnail(const Bitmap& source, Bitmap& thumbnail,
+                           int max_width = 200, int max_height = 150);
     
     // Screenshot options
-    void SetQuality(int quality); // 1-100
-    void SetFormat(const std::string& format); // "png", "jpeg"
+    void SetQuality(int quality); // JPEG: 1-100, default 90
+    void SetFormat(const std::string& format); // "png", "qoi", "jpeg"
+    void SetCompressionLevel(int level); // PNG: 0 fastest - 9 smallest, default 6
     void SetFullPage(bool fullPage);
     
 private:
@@ -207,6 +289,13 @@ private:
     std::unique_ptr<Impl> impl_;
 };
 
+// Element selectors found by one discovery pass
+struct DiscoveredElements {
+    std::vector<std::string> interactive;
+    std::vector<std::string> form;
+    std::vector<std::string> navigation;
+};
+
 // Web automation functionality
 class WebAutomation {
 public:
@@ -218,6 +307,9 @@ public:
     std::unique_ptr<Page> CreatePage();
     std::unique_ptr<ScreenshotCapture> CreateScreenshotCapture();
     
+    // Page that discovery and extraction run against (not owned)
+    void AttachPage(Page* page);
+    
     // Form interaction
     bool FillForm(const std::string& formSelector, const std::vector<std::pair<std::string, std::string>>& fields);
     bool FillForm(const std::string& formSelector, const std::map<std::string, std::string>& fields); // Map overload
@@ -229,7 +321,10 @@ public:
     bool Refresh();
     
     // Content extraction
-    std::string ExtractText(const std::string& selector);
+    std::string ExtractText(const std::string& selector);    // Text of every match, one per line
+    ContentBuffer ExtractTextBuffer(const std::string& selector);   // Shares the DOM's text when possible
+    // Resolved like Page::GetLinks(), from the whole page or inside every
+    // match of |containerSelector|
     std::vector<std::string> ExtractLinks(const std::string& containerSelector = "");
     std::vector<std::string> ExtractImages(const std::string& containerSelector = "");
     
@@ -243,12 +338,14 @@ public:
     bool TypeText(const std::string& selector, const std::string& text);
     bool HoverElement(const std::string& selector);
     std::string GetElementText(const std::string& selector);
+    ContentBuffer GetElementTextBuffer(const std::string& selector);
     std::string GetElementAttribute(const std::string& selector, const std::string& attribute);
     
     // Element discovery
     std::vector<std::string> DiscoverInteractiveElements();
     std::vector<std::string> DiscoverFormElements();
     std::vector<std::string> DiscoverNavigationElements();
+    DiscoveredElements DiscoverElements();  // All three categories in one pass
     
 private:
     class Impl;
@@ -270,6 +367,9 @@ public:
     std::vector<uint8_t> GetImage(const std::string& key);
     bool DeleteImage(const std::string& key);
     bool ImageExists(const std::string& key);
+    // Codec of a stored entry, detected when it was stored ("png", "qoi",
+    // "jpeg", "unknown"); empty if there is no such entry
+    std::string GetImageFormat(const std::string& key);
     
     // Storage management
     std::vector<std::string> ListImages();
@@ -277,6 +377,8 @@ public:
     bool ClearStorage();
     
     // Image processing
+    // Re-encodes PNG or QOI as JPEG at |quality| (1-100); other data, and
+    // images JPEG would not shrink, come back unchanged
     std::vector<uint8_t> CompressImage(const std::vector<uint8_t>& image_data, int quality);
     std::vector<uint8_t> ResizeImage(const std::vector<uint8_t>& image_data, int width, int height);
     
@@ -0,0 +1,360 @@
+#include "page_backend.h"
+#include "event_loop.h"
+#include "logging.h"
+#include <cmath>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <unordered_map>
+
+namespace navigrab {
+
+namespace {
+
+constexpr int kOperationCount = static_cast<int>(BackendOperation::COUNT);
+
+// Markup served for URLs without registered content.
+const char kSimulatedPageHtml[] = R"(<!DOCTYPE html>
+<html>
+<head><title>Sample Page Title</title></head>
+<body>
+<nav class="main-nav">
+  <a class="nav-item" href="/">Home</a>
+  <a class="nav-item" href="/docs">Docs</a>
+  <a class="nav-item" href="https://github.com">GitHub</a>
+</nav>
+<h1>Sample Content</h1>
+<form id="login" action="/login" method="post">
+  <input class="email" type="email" name="email">
+  <input class="password" type="password" name="password">
+  <textarea class="comment" name="comment"></textarea>
+  <button class="btn submit" type="submit">Submit</button>
+  <button class="btn cancel" type="button">Cancel</button>
+</form>
+<div class="card"><p>Card text with a <a class="link" href="/more">link</a>.</p></div>
+</body>
+</html>)";
+
+} // namespace
+
+const char* BackendOperationName(BackendOperation operation) {
+    switch (operation) {
+        case BackendOperation::LAUNCH: return "launch";
+        case BackendOperation::NAVIGATE: return "navigate";
+        case BackendOperation::LOAD: return "load";
+        case BackendOperation::CLICK: return "click";
+        case BackendOperation::TYPE: return "type";
+        case BackendOperation::HOVER: return "hover";
+        case BackendOperation::FOCUS: return "focus";
+        case BackendOperation::SCRIPT: return "script";
+        case BackendOperation::COUNT: break;
+    }
+    return "unknown";
+}
+
+// PageBackend implementation
+void PageBackend::Start(EventLoop& loop, const BackendRequest& request, BackendCompletion done) {
+    bool success = false;
+    std::string result;
+    switch (request.operation) {
+        case BackendOperation::NAVIGATE: success = Navigate(request.target, &result); break;
+        case BackendOperation::LOAD: success = WaitForLoad(); break;
+        case BackendOperation::CLICK: success = Click(request.target); break;
+        case BackendOperation::TYPE: success = Type(request.target, request.text); break;
+        case BackendOperation::HOVER: success = Hover(request.target); break;
+        case BackendOperation::FOCUS: success = Focus(request.target); break;
+        case BackendOperation::SCRIPT:
+            result = EvaluateScript(request.target);
+            success = true;
+            break;
+        case BackendOperation::LAUNCH:
+        case BackendOperation::COUNT:
+            break;
+    }
+    loop.Post([done = std::move(done), success, result = std::move(result)]() mutable {
+        done(success, std::move(result));
+    });
+}
+
+// LatencyModel implementation
+LatencyModel::LatencyModel() {
+    for (auto& distribution : distributions_) distribution = LatencyDistribution::Fixed(0.0);
+}
+
+LatencyModel LatencyModel::Default() {
+    LatencyModel model;
+    model.Set(BackendOperation::LAUNCH, LatencyDistribution::Fixed(100.0));
+    model.Set(BackendOperation::NAVIGATE, LatencyDistribution::Fixed(200.0));
+    model.Set(BackendOperation::LOAD, LatencyDistribution::Fixed(100.0));
+    model.Set(BackendOperation::CLICK, LatencyDistribution::Fixed(50.0));
+    model.Set(BackendOperation::TYPE, LatencyDistribution::Fixed(50.0));
+    model.Set(BackendOperation::HOVER, LatencyDistribution::Fixed(50.0));
+    return model;
+}
+
+LatencyModel LatencyModel::Realistic() {
+    LatencyModel model;
+    model.Set(BackendOperation::LAUNCH, LatencyDistribution::LogNormal(100.0, 0.3));
+    model.Set(BackendOperation::NAVIGATE, LatencyDistribution::LogNormal(200.0, 0.6));
+    model.Set(BackendOperation::LOAD, LatencyDistribution::LogNormal(100.0, 0.5));
+    model.Set(BackendOperation::CLICK, LatencyDistribution::LogNormal(50.0, 0.4));
+    model.Set(BackendOperation::TYPE, LatencyDistribution::LogNormal(50.0, 0.4));
+    model.Set(BackendOperation::HOVER, LatencyDistribution::LogNormal(50.0, 0.4));
+    model.Set(BackendOperation::FOCUS, LatencyDistribution::LogNormal(5.0, 0.3));
+    model.Set(BackendOperation::SCRIPT, LatencyDistribution::LogNormal(10.0, 0.5));
+    return model;
+}
+
+void LatencyModel::Set(BackendOperation operation, LatencyDistribution distribution) {
+    if (operation == BackendOperation::COUNT) return;
+    distributions_[static_cast<int>(operation)] = distribution;
+}
+
+const LatencyDistribution& LatencyModel::Get(BackendOperation operation) const {
+    return distributions_[static_cast<int>(operation) % kOperationCount];
+}
+
+// Everything the simulated browser and its pages share
+class SimulatedBrowserBackend::State {
+public:
+    explicit State(SimulationOptions options)
+        : options_(std::move(options)), rng_(options_.seed), running_(false),
+          default_content_(kSimulatedPageHtml) {
+        if (!options_.clock) options_.clock = std::make_shared<VirtualClock>();
+        for (int i = 0; i < kOperationCount; ++i) {
+            time_us_[i] = 0;
+            counts_[i] = 0;
+        }
+    }
+
+    // Samples the operation's delay and books it in the per-operation totals
+    std::chrono::microseconds Sample(BackendOperation operation) {
+        const LatencyDistribution& distribution = options_.latency.Get(operation);
+        double ms = distribution.median_ms;
+        if (distribution.sigma > 0.0 && ms > 0.0) {
+            std::lock_guard<std::mutex> lock(rng_mutex_);
+            ms *= std::exp(distribution.sigma * normal_(rng_));
+        }
+        auto delay = std::chrono::microseconds(static_cast<int64_t>(ms * 1000.0));
+        int index = static_cast<int>(operation);
+        time_us_[index].fetch_add(delay.count(), std::memory_order_relaxed);
+        counts_[index].fetch_add(1, std::memory_order_relaxed);
+        return delay;
+    }
+
+    // Blocking path: the caller waits out the delay on the virtual clock
+    void Charge(BackendOperation operation) {
+        auto delay = Sample(operation);
+        options_.clock->Advance(delay);
+        if (options_.real_time && delay.count() > 0) std::this_thread::sleep_for(delay);
+    }
+
+    bool RealTime() const { return options_.real_time; }
+
+    std::string ContentFor(const std::string& url) const {
+        std::lock_guard<std::mutex> lock(content_mutex_);
+        auto it = content_.find(url);
+        return it != content_.end() ? it->second : default_content_;
+    }
+
+    void SetContent(const std::string& url, const std::string& html) {
+        std::lock_guard<std::mutex> lock(content_mutex_);
+        content_[url] = html;
+    }
+
+    void SetDefaultContent(const std::string& html) {
+        std::lock_guard<std::mutex> lock(content_mutex_);
+        default_content_ = html;
+    }
+
+    std::shared_ptr<VirtualClock> Clock() const { return options_.clock; }
+    std::chrono::microseconds TimeFor(BackendOperation operation) const {
+        return std::chrono::microseconds(time_us_[static_cast<int>(operation) % kOperationCount].load());
+    }
+    uint64_t CountFor(BackendOperation operation) const {
+        return counts_[static_cast<int>(operation) % kOperationCount].load();
+    }
+
+    std::atomic<bool>& Running() { return running_; }
+
+private:
+    SimulationOptions options_;
+    std::mutex rng_mutex_;
+    std::mt19937_64 rng_;
+    std::normal_distribution<double> normal_;
+    std::atomic<bool> running_;
+    std::atomic<int64_t> time_us_[kOperationCount];
+    std::atomic<uint64_t> counts_[kOperationCount];
+
+    mutable std::mutex content_mutex_;
+    std::unordered_map<std::string, std::string> content_;
+    std::string default_content_;
+};
+
+namespace {
+
+class SimulatedPageBackend : public PageBackend {
+public:
+    explicit SimulatedPageBackend(std::shared_ptr<SimulatedBrowserBackend::State> state)
+        : state_(std::move(state)) {}
+
+    bool Navigate(const std::string& url, std::string* html) override {
+        state_->Charge(BackendOperation::NAVIGATE);
+        *html = url == "about:blank" ? std::string() : state_->ContentFor(url);
+        return true;
+    }
+
+    bool WaitForLoad() override {
+        state_->Charge(BackendOperation::LOAD);
+        return true;
+    }
+
+    bool Click(const std::string& /*selector*/) override {
+        state_->Charge(BackendOperation::CLICK);
+        return true;
+    }
+
+    bool Type(const std::string& /*selector*/, const std::string& /*text*/) override {
+        state_->Charge(BackendOperation::TYPE);
+        return true;
+    }
+
+    bool Hover(const std::string& /*selector*/) override {
+        state_->Charge(BackendOperation::HOVER);
+        return true;
+    }
+
+    bool Focus(const std::string& /*selector*/) override {
+        state_->Charge(BackendOperation::FOCUS);
+        return true;
+    }
+
+    std::string EvaluateScript(const std::string& /*script*/) override {
+        state_->Charge(BackendOperation::SCRIPT);
+        return "Script result";
+    }
+
+    // The delay becomes a timer on |loop| instead of blocking, so operations
+    // on many pages overlap. A virtual-time loop advances the shared clock
+    // itself when the timer fires.
+    void Start(EventLoop& loop, const BackendRequest& request, BackendCompletion done) override {
+        bool same_time = state_->RealTime() ? !loop.IsVirtualTime() : loop.GetClock() == state_->Clock();
+        if (!same_time) {
+            // The loop runs on a different clock than this engine; keep the
+            // blocking semantics rather than mixing the two.
+            PageBackend::Start(loop, request, std::move(done));
+            return;
+        }
+        auto delay = state_->Sample(request.operation);
+        std::string result;
+        if (request.operation == BackendOperation::NAVIGATE) {
+            result = request.target == "about:blank" ? std::string() : state_->ContentFor(request.target);
+        } else if (request.operation == BackendOperation::SCRIPT) {
+            result = "Script result";
+        }
+        loop.PostDelayed(delay, [done = std::move(done), result = std::move(result)]() mutable {
+            done(true, std::move(result));
+        });
+    }
+
+private:
+    std::shared_ptr<SimulatedBrowserBackend::State> state_;
+};
+
+} // namespace
+
+// SimulatedBrowserBackend implementation
+SimulatedBrowserBackend::SimulatedBrowserBackend(SimulationOptions options)
+    : state_(std::make_shared<State>(std::move(options))) {}
+
+SimulatedBrowserBackend::~SimulatedBrowserBackend() = default;
+
+bool SimulatedBrowserBackend::Launch() {
+    state_->Charge(BackendOperation::LAUNCH);
+    state_->Running() = true;
+    return true;
+}
+
+void SimulatedBrowserBackend::Close() {
+    state_->Running() = false;
+}
+
+bool SimulatedBrowserBackend::IsRunning() const {
+    return state_->Running();
+}
+
+std::unique_ptr<PageBackend> SimulatedBrowserBackend::CreatePage() {
+    return std::make_unique<SimulatedPageBackend>(state_);
+}
+
+void SimulatedBrowserBackend::SetPageContent(const std::string& url, const std::string& html) {
+    state_->SetContent(url, html);
+}
+
+void SimulatedBrowserBackend::SetDefaultContent(const std::string& html) {
+    state_->SetDefaultContent(html);
+}
+
+std::shared_ptr<VirtualClock> SimulatedBrowserBackend::GetClock() const {
+    return state_->Clock();
+}
+
+std::chrono::microseconds SimulatedBrowserBackend::GetSimulatedTime(BackendOperation operation) const {
+    return state_->TimeFor(operation);
+}
+
+uint64_t SimulatedBrowserBackend::GetOperationCount(BackendOperation operation) const {
+    return state_->CountFor(operation);
+}
+
+// Backend registry
+namespace {
+
+std::mutex& RegistryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+BrowserBackendFactory& RealEngineFactory() {
+    static BrowserBackendFactory factory;
+    return factory;
+}
+
+std::shared_ptr<BrowserBackend>& DefaultBackend() {
+    static std::shared_ptr<BrowserBackend> backend;
+    return backend;
+}
+
+} // namespace
+
+void RegisterRealEngineBackend(BrowserBackendFactory factory) {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    RealEngineFactory() = std::move(factory);
+}
+
+std::shared_ptr<BrowserBackend> CreateRealEngineBackend() {
+    BrowserBackendFactory factory;
+    {
+        std::lock_guard<std::mutex> lock(RegistryMutex());
+        factory = RealEngineFactory();
+    }
+    if (!factory) {
+        NAVIGRAB_LOG(WARNING) << "NaviGrab: No real engine backend registered";
+        return nullptr;
+    }
+    return factory();
+}
+
+std::shared_ptr<BrowserBackend> GetDefaultBrowserBackend() {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    auto& backend = DefaultBackend();
+    if (!backend) backend = std::make_shared<SimulatedBrowserBackend>();
+    return backend;
+}
+
+void SetDefaultBrowserBackend(std::shared_ptr<BrowserBackend> backend) {
+    std::lock_guard<std::mutex> lock(RegistryMutex());
+    DefaultBackend() = std::move(backend);
+}
+
+} // namespace navigrab
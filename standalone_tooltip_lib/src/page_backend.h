@@ -0,0 +1,169 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace navigrab {
+
+class EventLoop;
+
+// Browser operations that take engine time
+enum class BackendOperation {
+    LAUNCH,
+    NAVIGATE,
+    LOAD,
+    CLICK,
+    TYPE,
+    HOVER,
+    FOCUS,
+    SCRIPT,
+    COUNT
+};
+
+const char* BackendOperationName(BackendOperation operation);
+
+// Simulated time source shared by every page of a simulated browser.
+// Advancing it never sleeps, so simulated seconds cost microseconds of wall time.
+class VirtualClock {
+public:
+    VirtualClock() : now_us_(0) {}
+
+    std::chrono::microseconds Now() const {
+        return std::chrono::microseconds(now_us_.load(std::memory_order_relaxed));
+    }
+    void Advance(std::chrono::microseconds delta) {
+        now_us_.fetch_add(delta.count(), std::memory_order_relaxed);
+    }
+    void Reset() { now_us_.store(0, std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> now_us_;
+};
+
+// Log-normal latency around a median; sigma 0 gives a fixed delay.
+struct LatencyDistribution {
+    double median_ms;
+    double sigma;
+
+    static LatencyDistribution Fixed(double ms) { return {ms, 0.0}; }
+    static LatencyDistribution LogNormal(double median_ms, double sigma) { return {median_ms, sigma}; }
+};
+
+// Per-operation latency distributions
+class LatencyModel {
+public:
+    LatencyModel();   // All operations take zero time
+
+    // The delays the simulated engine has always used: 100 ms launch,
+    // 200 ms navigation, 100 ms load wait, 50 ms per interaction.
+    static LatencyModel Default();
+    // Default() with log-normal jitter, for tail-latency experiments.
+    static LatencyModel Realistic();
+    static LatencyModel Zero() { return LatencyModel(); }
+
+    void Set(BackendOperation operation, LatencyDistribution distribution);
+    const LatencyDistribution& Get(BackendOperation operation) const;
+
+private:
+    LatencyDistribution distributions_[static_cast<int>(BackendOperation::COUNT)];
+};
+
+// One operation for PageBackend::Start. |target| is the URL for NAVIGATE,
+// the script for SCRIPT and the element selector otherwise.
+struct BackendRequest {
+    BackendOperation operation;
+    std::string target;
+    std::string text;       // TYPE only
+};
+
+// Called once when a started operation finishes. |result| carries the markup
+// for NAVIGATE and the value for SCRIPT.
+using BackendCompletion = std::function<void(bool success, std::string result)>;
+
+// One page inside an engine. Implementations report success like Page does
+// and never throw.
+class PageBackend {
+public:
+    virtual ~PageBackend() = default;
+
+    // Starts |request| without waiting for it and reports completion through a
+    // task posted to |loop|, never re-entrantly. The default runs the blocking
+    // method below; engines with an asynchronous transport override it.
+    virtual void Start(EventLoop& loop, const BackendRequest& request, BackendCompletion done);
+
+    // Loads |url| and returns its markup in |html|.
+    virtual bool Navigate(const std::string& url, std::string* html) = 0;
+    virtual bool WaitForLoad() = 0;
+    virtual bool Click(const std::string& selector) = 0;
+    virtual bool Type(const std::string& selector, const std::string& text) = 0;
+    virtual bool Hover(const std::string& selector) = 0;
+    virtual bool Focus(const std::string& selector) = 0;
+    virtual std::string EvaluateScript(const std::string& script) = 0;
+};
+
+// A browser engine: launches once and hands out pages.
+class BrowserBackend {
+public:
+    virtual ~BrowserBackend() = default;
+
+    virtual const char* Name() const = 0;
+    virtual bool Launch() = 0;
+    virtual void Close() = 0;
+    virtual bool IsRunning() const = 0;
+    virtual std::unique_ptr<PageBackend> CreatePage() = 0;
+};
+
+// Options for the simulated engine
+struct SimulationOptions {
+    LatencyModel latency = LatencyModel::Default();
+    std::shared_ptr<VirtualClock> clock;    // Created when null
+    uint64_t seed = 42;                     // Same seed, same latency sequence
+    bool real_time = false;                 // Also sleep for each sampled delay
+};
+
+// In-process engine that serves registered markup and charges sampled
+// latencies to a virtual clock.
+class SimulatedBrowserBackend : public BrowserBackend {
+public:
+    explicit SimulatedBrowserBackend(SimulationOptions options = SimulationOptions());
+    ~SimulatedBrowserBackend() override;
+
+    const char* Name() const override { return "simulated"; }
+    bool Launch() override;
+    void Close() override;
+    bool IsRunning() const override;
+    std::unique_ptr<PageBackend> CreatePage() override;
+
+    // Markup returned for |url|; unregistered URLs get the built-in sample page.
+    void SetPageContent(const std::string& url, const std::string& html);
+    void SetDefaultContent(const std::string& html);
+
+    std::shared_ptr<VirtualClock> GetClock() const;
+
+    // Simulated time spent so far, split by operation
+    std::chrono::microseconds GetSimulatedTime(BackendOperation operation) const;
+    uint64_t GetOperationCount(BackendOperation operation) const;
+
+    // Shared with the pages, which may outlive the backend object
+    class State;
+
+private:
+    std::shared_ptr<State> state_;
+};
+
+// Slot for a real engine (CDP, WebDriver, embedded Chromium). None is bundled;
+// an embedder registers a factory and then selects it as the default.
+using BrowserBackendFactory = std::function<std::shared_ptr<BrowserBackend>()>;
+void RegisterRealEngineBackend(BrowserBackendFactory factory);
+std::shared_ptr<BrowserBackend> CreateRealEngineBackend();  // Null when none registered
+
+// Backend used by default-constructed Browser/Page objects and NaviGrabCore.
+// Starts out as a SimulatedBrowserBackend with LatencyModel::Default().
+std::shared_ptr<BrowserBackend> GetDefaultBrowserBackend();
+void SetDefaultBrowserBackend(std::shared_ptr<BrowserBackend> backend);
+
+} // namespace navigrab
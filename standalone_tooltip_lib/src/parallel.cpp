@@ -0,0 +1,36 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace navigrab {
+
+int HardwareConcurrency() {
+    static const int count = [] {
+        unsigned threads = std::thread::hardware_concurrency();
+        return threads > 0 ? static_cast<int>(threads) : 1;
+    }();
+    return count;
+}
+
+void ParallelFor(size_t count, int max_threads, const std::function<void(size_t)>& task) {
+    if (max_threads <= 0) max_threads = HardwareConcurrency();
+    size_t threads = std::min(count, static_cast<size_t>(max_threads));
+    if (threads <= 1) {
+        for (size_t i = 0; i < count; ++i) task(i);
+        return;
+    }
+
+    std::atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i = next++; i < count; i = next++) task(i);
+    };
+    std::vector<std::thread> helpers;
+    helpers.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) helpers.emplace_back(worker);
+    worker();
+    for (auto& helper : helpers) helper.join();
+}
+
+} // namespace navigrab
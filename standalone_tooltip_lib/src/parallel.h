@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace navigrab {
+
+// Hardware thread count, at least 1 (checked once)
+int HardwareConcurrency();
+
+// Runs |task(i)| for every i in [0, count) on up to |max_threads| threads,
+// the calling thread included, and returns once all have finished. Indices
+// are handed out one at a time so uneven tasks balance. |max_threads| of 0
+// means HardwareConcurrency().
+void ParallelFor(size_t count, int max_threads, const std::function<void(size_t)>& task);
+
+} // namespace navigrab
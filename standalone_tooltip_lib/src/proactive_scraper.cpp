@@ -1,15 +1,23 @@
 #include "proactive_scraper.h"
-#include <iostream>
-#include <fstream>
-#include <random>
+#include "capture_pipeline.h"
+#include "dom.h"
+#include "image_hash.h"
+#include "logging.h"
+#include "metrics.h"
+#include "parallel.h"
+#include "selector_engine.h"
+#include "trace.h"
 #include <algorithm>
-#include <thread>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
 
 namespace navigrab {
 
 // ElementInfo constructors and destructors
-ElementInfo::ElementInfo() : position({0, 0}), size({0, 0}), is_interactive(false) {}
+ElementInfo::ElementInfo()
+    : position({0, 0}), size({0, 0}), is_interactive(false), dom_fingerprint(0), perceptual_hash(0) {}
 
 ElementInfo::~ElementInfo() = default;
 
@@ -29,54 +37,72 @@ ScrapingResult& ScrapingResult::operator=(const ScrapingResult& other) = default
 // ProactiveScraper Implementation
 class ProactiveScraper::Impl {
 public:
+    // Hamming distance, out of 64 bits, still treated as the same rendering
+    static constexpr int kDefaultChangeThreshold = 4;
+    // Previous captures remembered before the record starts over
+    static constexpr size_t kMaxCaptureRecords = 4096;
+
     Impl() : 
         depth_(ScrapingDepth::STANDARD),
         cache_enabled_(true),
         max_elements_(500),
         screenshot_enabled_(true),
+        change_threshold_(kDefaultChangeThreshold),
         total_elements_(0),
         total_screenshots_(0),
+        screenshots_reused_(0),
+        screenshot_sequence_(0),
         total_time_(0),
         scrape_count_(0) {}
     
     ScrapingResult ScrapePage(const std::string& url, ScrapingDepth depth) {
         auto start_time = std::chrono::high_resolution_clock::now();
+        uint64_t trace_id = NewTraceId();
+        NAVIGRAB_TRACE_SPAN("scraper", "ProactiveScraper::ScrapePage", trace_id);
+        ScopedLatencyTimer timer(ScrapeHistogram(depth));
         ScrapingResult result;
         result.url = url;
         
         // Check cache first
         if (cache_enabled_ && IsCached(url)) {
             result = GetCachedResult(url);
-            std::cout << "ProactiveScraper: Using cached result for " << url << std::endl;
+            NAVIGRAB_LOG(DEBUG) << "ProactiveScraper: Using cached result for " << url;
             return result;
         }
         
-        std::cout << "ProactiveScraper: Starting scrape of " << url << " (depth: " << static_cast<int>(depth) << ")" << std::endl;
+        NAVIGRAB_LOG(INFO) << "ProactiveScraper: Starting scrape of " << url << " (depth: " << static_cast<int>(depth) << ")";
         
-        // Simulate scraping based on depth
-        int elements_count = 0;
-        switch (depth) {
-            case ScrapingDepth::QUICK:
-                elements_count = 50 + (rand() % 50);  // 50-100 elements
-                std::this_thread::sleep_for(std::chrono::milliseconds(50));
-                break;
-            case ScrapingDepth::STANDARD:
-                elements_count = 200 + (rand() % 200); // 200-400 elements
-                std::this_thread::sleep_for(std::chrono::milliseconds(200));
-                break;
-            case ScrapingDepth::DEEP:
-                elements_count = 400 + (rand() % 300); // 400-700 elements
-                std::this_thread::sleep_for(std::chrono::milliseconds(800));
-                break;
+        // Load the page through the browser backend. Deeper scrapes also wait
+        // for the load to settle; the backend's latency model decides what
+        // that costs.
+        if (!page_) page_ = CreatePage();
+        bool loaded;
+        {
+            NAVIGRAB_TRACE_SPAN("scraper", "navigate", trace_id);
+            loaded = page_->NavigateTo(url);
+        }
+        if (loaded && depth != ScrapingDepth::QUICK) {
+            NAVIGRAB_TRACE_SPAN("scraper", "wait_for_load", trace_id);
+            loaded = page_->WaitForLoad();
+        }
+        if (!loaded) {
+            result.error_message = "Failed to load " + url;
+            NAVIGRAB_LOG(WARNING) << "ProactiveScraper: " << result.error_message;
+            return result;
         }
         
-        // Generate elements
-        result.elements = GenerateElements(elements_count);
+        // Discover elements from the page DOM
+        {
+            NAVIGRAB_TRACE_SPAN("scraper", "collect_elements", trace_id);
+            result.elements = CollectElements(*page_->GetDocument(), depth);
+        }
+        int elements_count = static_cast<int>(result.elements.size());
         result.total_elements = elements_count;
         result.interactive_elements = CountInteractiveElements(result.elements);
         
         // Capture screenshots if enabled
         if (screenshot_enabled_) {
+            NAVIGRAB_TRACE_SPAN("scraper", "capture_screenshots", trace_id);
             CaptureElementScreenshots(result.elements);
         }
         
@@ -92,11 +118,12 @@ public:
         
         // Cache result
         if (cache_enabled_) {
+            NAVIGRAB_TRACE_SPAN("scraper", "cache_result", trace_id);
             CacheResult(url, result);
         }
         
-        std::cout << "ProactiveScraper: Scraped " << elements_count << " elements in " 
-                  << result.duration.count() << "ms" << std::endl;
+        NAVIGRAB_LOG(INFO) << "ProactiveScraper: Scraped " << elements_count << " elements in " 
+                           << result.duration.count() << "ms";
         
         return result;
     }
@@ -106,7 +133,7 @@ public:
     }
     
     std::vector<ElementInfo> DiscoverElements(const std::string& url) {
-        std::cout << "ProactiveScraper: Discovering elements on " << url << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "ProactiveScraper: Discovering elements on " << url;
         auto result = ScrapePage(url, ScrapingDepth::STANDARD);
         return result.elements;
     }
@@ -133,29 +160,15 @@ public:
     }
     
     bool CaptureElementScreenshot(ElementInfo& element) {
-        std::string filename = "screenshot_" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + ".png";
-        element.screenshot_path = filename;
-        
-        // Create dummy screenshot file
-        std::ofstream file(filename);
-        if (file.is_open()) {
-            file << "Screenshot data for element: " << element.selector;
-            file.close();
-            std::cout << "ProactiveScraper: Captured screenshot for " << element.selector << std::endl;
-            return true;
-        }
-        return false;
+        return CaptureScreenshots({&element});
     }
     
     bool CaptureAllElementScreenshots(const std::vector<ElementInfo>& elements) {
-        bool success = true;
-        for (const auto& element : elements) {
-            ElementInfo mutableElement = element; // Create a copy to modify
-            if (!CaptureElementScreenshot(mutableElement)) {
-                success = false;
-            }
-        }
-        return success;
+        std::vector<ElementInfo> copies = elements;     // Results are not handed back
+        std::vector<ElementInfo*> batch;
+        batch.reserve(copies.size());
+        for (auto& element : copies) batch.push_back(&element);
+        return CaptureScreenshots(batch);
     }
     
     bool IsCached(const std::string& url) const {
@@ -172,12 +185,16 @@ public:
     
     void CacheResult(const std::string& url, const ScrapingResult& result) {
         cache_[url] = result;
-        std::cout << "ProactiveScraper: Cached result for " << url << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "ProactiveScraper: Cached result for " << url;
     }
     
     void ClearCache() {
         cache_.clear();
-        std::cout << "ProactiveScraper: Cache cleared" << std::endl;
+        NAVIGRAB_LOG(INFO) << "ProactiveScraper: Cache cleared";
+    }
+    
+    void ClearPreviousCaptures() {
+        captures_.clear();
     }
     
     size_t GetCacheSize() const {
@@ -192,6 +209,10 @@ public:
         return total_screenshots_;
     }
     
+    int GetTotalScreenshotsReused() const {
+        return screenshots_reused_;
+    }
+    
     std::chrono::milliseconds GetAverageScrapingTime() const {
         if (scrape_count_ == 0) return std::chrono::milliseconds(0);
         return std::chrono::milliseconds(total_time_ / scrape_count_);
@@ -231,44 +252,165 @@ public:
     void SetCacheEnabled(bool enabled) { cache_enabled_ = enabled; }
     void SetMaxElements(int maxElements) { max_elements_ = maxElements; }
     void SetScreenshotEnabled(bool enabled) { screenshot_enabled_ = enabled; }
+    void SetChangeThreshold(int max_bits) { change_threshold_ = max_bits; }
     
 private:
+    // What an element looked like when its screenshot was last written
+    struct CaptureRecord {
+        uint64_t dom_fingerprint;
+        uint64_t perceptual_hash;
+        std::string screenshot_path;
+    };
+    
     ScrapingDepth depth_;
     bool cache_enabled_;
     int max_elements_;
     bool screenshot_enabled_;
+    int change_threshold_;
     
     // Statistics
     int total_elements_;
     int total_screenshots_;
+    int screenshots_reused_;
+    uint64_t screenshot_sequence_;     // Keeps file names unique within a batch
     int total_time_;
     int scrape_count_;
     
     // Cache
     std::map<std::string, ScrapingResult> cache_;
+    // Last capture of each element, keyed by page URL and selector
+    std::unordered_map<std::string, CaptureRecord> captures_;
     
     // Callbacks
     std::function<void(int, const std::string&)> progress_callback_;
     std::function<void(const ElementInfo&)> element_discovered_callback_;
     
-    std::vector<ElementInfo> GenerateElements(int count) {
+    // Page used for scraping, created on first use
+    std::unique_ptr<Page> page_;
+    std::unique_ptr<ScreenshotCapture> capture_;
+    std::vector<std::string> selectors_;
+    std::vector<Bitmap> bitmaps_;
+    std::unique_ptr<CapturePipeline> pipeline_;     // Encodes and writes changed elements
+    
+    // Latency of whole ScrapePage calls, cache hits included
+    static LatencyHistogram& ScrapeHistogram(ScrapingDepth depth) {
+        static LatencyHistogram& quick = MetricsRegistry::GetInstance().GetHistogram("scrape.quick");
+        static LatencyHistogram& standard = MetricsRegistry::GetInstance().GetHistogram("scrape.standard");
+        static LatencyHistogram& deep = MetricsRegistry::GetInstance().GetHistogram("scrape.deep");
+        switch (depth) {
+            case ScrapingDepth::QUICK:
+                return quick;
+            case ScrapingDepth::STANDARD:
+                return standard;
+            case ScrapingDepth::DEEP:
+                break;
+        }
+        return deep;
+    }
+    
+    // Elements collected at each depth: interactive controls only, then
+    // headings, images and labels, then body content.
+    static const char* SelectorForDepth(ScrapingDepth depth) {
+        switch (depth) {
+            case ScrapingDepth::QUICK:
+                return "a[href], button, input:not([type=hidden]), select, textarea";
+            case ScrapingDepth::STANDARD:
+                return "a[href], button, input:not([type=hidden]), select, textarea, "
+                       "h1, h2, h3, img, label";
+            case ScrapingDepth::DEEP:
+                break;
+        }
+        return "a[href], button, input:not([type=hidden]), select, textarea, "
+               "h1, h2, h3, h4, h5, h6, img, label, p, li, td, th, blockquote, pre";
+    }
+    
+    static std::string ElementType(const dom::Document& document, dom::NodeId id) {
+        std::string_view tag = document.TagName(id);
+        if (tag == "a") return "link";
+        if (tag == "input") {
+            std::string_view type = document.GetAttribute(id, "type");
+            return (type == "submit" || type == "button" || type == "reset") ? "button" : "input";
+        }
+        return std::string(tag);
+    }
+    
+    // FNV-1a over what decides an element's look in the DOM: tag,
+    // attributes, text and size. Position is left out, so an element that
+    // only moved keeps its screenshot.
+    static uint64_t DomFingerprint(const dom::Document& document, dom::NodeId id, std::string_view text,
+                                   const dom::Box& box) {
+        uint64_t hash = 14695981039346656037ull;
+        auto mix = [&hash](std::string_view bytes) {
+            for (unsigned char c : bytes) hash = (hash ^ c) * 1099511628211ull;
+            hash = (hash ^ 0xFF) * 1099511628211ull;    // Field separator no UTF-8 text contains
+        };
+        mix(document.TagName(id));
+        for (const dom::Attribute* a = document.AttributesBegin(id); a != document.AttributesEnd(id); ++a) {
+            mix(a->name);
+            mix(a->value);
+        }
+        mix(text);
+        mix(std::to_string(box.width) + "x" + std::to_string(box.height));
+        return hash;
+    }
+    
+    // Fingerprint of an element given only its selector, as for callers of
+    // CaptureElementScreenshot(); 0 if it is not on the page
+    uint64_t FingerprintSelector(const std::string& selector) const {
+        const dom::Document* document = page_ ? page_->GetDocument() : nullptr;
+        if (!document) return 0;
+        auto compiled = SelectorCache::GetInstance().Get(selector);
+        dom::NodeId id = SelectorMatcher(*document).QueryFirst(*compiled);
+        if (id == dom::kInvalidNode) return 0;
+        return DomFingerprint(*document, id, document->TextContent(id), document->GetBox(id));
+    }
+    
+    bool IsUnchanged(const ElementInfo& element, const CaptureRecord& previous) const {
+        std::error_code error;
+        return change_threshold_ >= 0 && element.dom_fingerprint == previous.dom_fingerprint &&
+               HammingDistance(element.perceptual_hash, previous.perceptual_hash) <= change_threshold_ &&
+               std::filesystem::exists(previous.screenshot_path, error);
+    }
+    
+    // Encoding is spread over every core; writes are few and short
+    static CapturePipelineOptions PipelineOptions() {
+        CapturePipelineOptions options;
+        options.stages[static_cast<size_t>(PipelineStage::ENCODE)].workers = static_cast<size_t>(HardwareConcurrency());
+        options.stages[static_cast<size_t>(PipelineStage::STORE)].workers = 2;
+        options.store = [](const CaptureResult& result) { return WriteFile(result.destination, result.data); };
+        return options;
+    }
+    
+    static bool WriteFile(const std::string& filename, const std::vector<uint8_t>& data) {
+        std::ofstream file(filename, std::ios::binary);
+        if (!file.is_open()) return false;
+        file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+        return file.good();
+    }
+    
+    std::vector<ElementInfo> CollectElements(const dom::Document& document, ScrapingDepth depth) {
         std::vector<ElementInfo> elements;
-        std::vector<std::string> types = {"button", "link", "input", "select", "textarea", "div", "span", "p"};
-        
-        for (int i = 0; i < count; ++i) {
-            ElementInfo element;
-            element.selector = "element_" + std::to_string(i);
-            element.type = types[rand() % types.size()];
-            element.text = "Sample text " + std::to_string(i);
-            element.url = "https://example.com/page" + std::to_string(i);
-            element.position = {rand() % 1000, rand() % 1000};
-            element.size = {50 + rand() % 200, 20 + rand() % 50};
-            element.is_interactive = (element.type == "button" || element.type == "link" || element.type == "input");
-            element.discovered_at = std::chrono::system_clock::now();
+        auto selector = SelectorCache::GetInstance().Get(SelectorForDepth(depth));
+        auto now = std::chrono::system_clock::now();
+        for (dom::NodeId id : SelectorMatcher(document).QueryAll(*selector)) {
+            if (static_cast<int>(elements.size()) >= max_elements_) break;
+            if (!document.IsRendered(id)) continue;
             
-            elements.push_back(element);
+            const dom::Box& box = document.GetBox(id);
+            ElementInfo element;
+            element.selector = document.BuildSelector(id);
+            element.type = ElementType(document, id);
+            element.text = document.TextContent(id);
+            element.url = std::string(document.GetAttribute(id, element.type == "link" ? "href" : "src"));
+            element.position = {box.x, box.y};
+            element.size = {box.width, box.height};
+            element.is_interactive = element.type == "button" || element.type == "link" || element.type == "input" ||
+                                     element.type == "select" || element.type == "textarea";
+            element.discovered_at = now;
+            element.dom_fingerprint = DomFingerprint(document, id, element.text, box);
+            if (element_discovered_callback_) element_discovered_callback_(element);
+            elements.push_back(std::move(element));
         }
-        
         return elements;
     }
     
@@ -283,11 +425,75 @@ private:
     }
     
     void CaptureElementScreenshots(std::vector<ElementInfo>& elements) {
+        std::vector<ElementInfo*> batch;
         for (auto& element : elements) {
-            if (IsElementInteractive(element)) {
-                CaptureElementScreenshot(element);
+            if (IsElementInteractive(element)) batch.push_back(&element);
+        }
+        if (!batch.empty()) CaptureScreenshots(batch);
+    }
+    
+    // Renders |elements| from as few page frames as possible (see
+    // ScreenshotCapture::CaptureElementsToMemory), then hands those that
+    // changed to the capture pipeline to encode and write.
+    bool CaptureScreenshots(const std::vector<ElementInfo*>& elements) {
+        // One capture object for the scraper keeps its frame buffers warm
+        if (!capture_) capture_ = CreateScreenshotCapture();
+        capture_->AttachPage(page_.get());
+        selectors_.clear();
+        for (const ElementInfo* element : elements) selectors_.push_back(element->selector);
+        bool success = capture_->CaptureElementsToMemory(selectors_, bitmaps_);
+        
+        // Rendering is cheap next to encoding and writing, which an element
+        // that looks as it did on the last scrape of this page skips
+        ParallelFor(elements.size(), 0, [&](size_t i) {
+            elements[i]->perceptual_hash = DifferenceHash(bitmaps_[i]);
+        });
+        std::string page_url = page_ ? page_->GetUrl() : std::string();
+        std::vector<size_t> changed;
+        for (size_t i = 0; i < elements.size(); ++i) {
+            ElementInfo& element = *elements[i];
+            if (bitmaps_[i].IsEmpty()) continue;
+            if (element.dom_fingerprint == 0) element.dom_fingerprint = FingerprintSelector(element.selector);
+            auto previous = captures_.find(page_url + '\n' + element.selector);
+            if (previous != captures_.end() && IsUnchanged(element, previous->second)) {
+                element.screenshot_path = previous->second.screenshot_path;
+                screenshots_reused_++;
+                NAVIGRAB_LOG(DEBUG) << "ProactiveScraper: Reused unchanged screenshot for " << element.selector;
+                continue;
+            }
+            changed.push_back(i);
+        }
+        
+        // Changed elements are encoded and written by the pipeline, each
+        // frame a borrowed view of its bitmap, since Drain() returns before
+        // bitmaps_ is touched again
+        if (!pipeline_) pipeline_ = std::make_unique<CapturePipeline>(PipelineOptions());
+        std::vector<char> stored(changed.size(), 0);
+        std::string prefix = "screenshot_" + std::to_string(std::chrono::system_clock::now().time_since_epoch().count()) + "_";
+        for (size_t k = 0; k < changed.size(); ++k) {
+            ElementInfo& element = *elements[changed[k]];
+            std::string filename = prefix + std::to_string(screenshot_sequence_++) + ".png";
+            element.screenshot_path = filename;
+            // No key: every element is its own work, never coalesced
+            CaptureRequest request;
+            request.destination = filename;
+            request.done = [&stored, k](bool ok) { stored[k] = ok; };
+            std::shared_ptr<const Bitmap> frame(&bitmaps_[changed[k]], [](const Bitmap*) {});
+            pipeline_->SubmitFrame(std::string(), std::move(frame), {std::move(request)});
+        }
+        pipeline_->Drain();
+        for (size_t k = 0; k < changed.size(); ++k) {
+            ElementInfo& element = *elements[changed[k]];
+            if (!stored[k]) {
+                success = false;
+                continue;
             }
+            std::string key = page_url + '\n' + element.selector;
+            if (captures_.size() >= kMaxCaptureRecords && captures_.find(key) == captures_.end()) captures_.clear();
+            captures_[key] = {element.dom_fingerprint, element.perceptual_hash, element.screenshot_path};
+            NAVIGRAB_LOG(DEBUG) << "ProactiveScraper: Captured screenshot for " << element.selector;
         }
+        return success;
     }
 };
 
@@ -310,6 +516,10 @@ void ProactiveScraper::SetScreenshotEnabled(bool enabled) {
     impl_->SetScreenshotEnabled(enabled);
 }
 
+void ProactiveScraper::SetChangeThreshold(int max_bits) {
+    impl_->SetChangeThreshold(max_bits);
+}
+
 ScrapingResult ProactiveScraper::ScrapePage(const std::string& url, ScrapingDepth depth) {
     return impl_->ScrapePage(url, depth);
 }
@@ -363,6 +573,10 @@ size_t ProactiveScraper::GetCacheSize() const {
     return impl_->GetCacheSize();
 }
 
+void ProactiveScraper::ClearPreviousCaptures() {
+    impl_->ClearPreviousCaptures();
+}
+
 int ProactiveScraper::GetTotalElementsDiscovered() const {
     return impl_->GetTotalElementsDiscovered();
 }
@@ -371,6 +585,10 @@ int ProactiveScraper::GetTotalScreenshotsCaptured() const {
     return impl_->GetTotalScreenshotsCaptured();
 }
 
+int ProactiveScraper::GetTotalScreenshotsReused() const {
+    return impl_->GetTotalScreenshotsReused();
+}
+
 std::chrono::milliseconds ProactiveScraper::GetAverageScrapingTime() const {
     return impl_->GetAverageScrapingTime();
 }
@@ -403,13 +621,13 @@ public:
     void StartSession() {
         active_ = true;
         start_time_ = std::chrono::high_resolution_clock::now();
-        std::cout << "ScrapingSession: Session started" << std::endl;
+        NAVIGRAB_LOG(INFO) << "ScrapingSession: Session started";
     }
     
     void EndSession() {
         active_ = false;
         end_time_ = std::chrono::high_resolution_clock::now();
-        std::cout << "ScrapingSession: Session ended" << std::endl;
+        NAVIGRAB_LOG(INFO) << "ScrapingSession: Session ended";
     }
     
     bool IsActive() const {
@@ -419,7 +637,7 @@ public:
     void AddPage(const std::string& url) {
         pages_.push_back(url);
         total_pages_++;
-        std::cout << "ScrapingSession: Added page " << url << std::endl;
+        NAVIGRAB_LOG(DEBUG) << "ScrapingSession: Added page " << url;
     }
     
     void AddPages(const std::vector<std::string>& urls) {
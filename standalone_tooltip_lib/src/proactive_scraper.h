@@ -7,14 +7,15 @@
 #include <memory>
 #include <functional>
 #include <chrono>
+#include <cstdint>
 
 namespace navigrab {
 
 // Scraping depth levels
 enum class ScrapingDepth {
-    QUICK,      // 50ms - Fast element discovery
-    STANDARD,   // 200ms - Standard analysis
-    DEEP        // 800ms - Comprehensive analysis
+    QUICK,      // Interactive controls, no load wait
+    STANDARD,   // Adds headings, images and labels after the load settles
+    DEEP        // Adds paragraphs, list items and table cells
 };
 
 // Element information structure
@@ -28,6 +29,8 @@ struct ElementInfo {
     bool is_interactive;
     std::string screenshot_path;
     std::chrono::system_clock::time_point discovered_at;
+    uint64_t dom_fingerprint;   // Tag, attributes, text and size; 0 until known
+    uint64_t perceptual_hash;   // DifferenceHash() of the last capture; 0 until captured
     
     ElementInfo();
     ~ElementInfo();
@@ -62,6 +65,11 @@ public:
     void SetCacheEnabled(bool enabled);
     void SetMaxElements(int maxElements);
     void SetScreenshotEnabled(bool enabled);
+    // An element whose DOM fingerprint is unchanged and whose rendering
+    // hashes within |max_bits| of its previous capture on the same page
+    // keeps that screenshot instead of being encoded and written again.
+    // Negative always re-captures.
+    void SetChangeThreshold(int max_bits);
     
     // Main scraping functions
     ScrapingResult ScrapePage(const std::string& url, ScrapingDepth depth = ScrapingDepth::STANDARD);
@@ -81,12 +89,17 @@ public:
     bool IsCached(const std::string& url) const;
     ScrapingResult GetCachedResult(const std::string& url) const;
     void CacheResult(const std::string& url, const ScrapingResult& result);
+    // Forgets cached results, so the next scrape of a page loads it again.
+    // Previous captures are kept and still spare unchanged elements.
     void ClearCache();
     size_t GetCacheSize() const;
+    // Forgets previous captures, so every element is captured again
+    void ClearPreviousCaptures();
     
     // Statistics
     int GetTotalElementsDiscovered() const;
     int GetTotalScreenshotsCaptured() const;
+    int GetTotalScreenshotsReused() const;     // Captures skipped as unchanged
     std::chrono::milliseconds GetAverageScrapingTime() const;
     
     // Utility functions
@@ -0,0 +1,200 @@
+#include "rasterizer.h"
+#include <algorithm>
+
+namespace navigrab {
+
+namespace {
+
+constexpr uint32_t kBackgroundColor = 0xFFFFFFFF;
+constexpr uint32_t kTextColor = 0x202124FF;
+constexpr uint32_t kLinkColor = 0x1A0DABFF;
+constexpr uint32_t kButtonColor = 0x1A73E8FF;
+constexpr uint32_t kButtonTextColor = 0xFFFFFFFF;
+constexpr uint32_t kControlBorderColor = 0x9AA0A6FF;
+constexpr uint32_t kImageColor = 0xDADCE0FF;
+constexpr uint32_t kFrameColor = 0xE8EAEDFF;
+
+// Glyphs are bars on an 8 pixel advance; lower-case ones are shorter
+constexpr int kGlyphAdvance = 8;
+constexpr int kGlyphWidth = 6;
+constexpr int kGlyphTop = 5;
+constexpr int kGlyphHeight = 10;
+constexpr int kLowerCaseDrop = 3;
+constexpr int kTextPadding = 2;
+
+int64_t Area(const dom::Box& box) {
+    return static_cast<int64_t>(box.width) * box.height;
+}
+
+enum class Paint {
+    NONE,
+    BUTTON,
+    CONTROL,
+    IMAGE,
+    RULE,
+    FRAME
+};
+
+Paint PaintFor(const dom::Document& document, dom::NodeId id) {
+    std::string_view tag = document.TagName(id);
+    if (tag == "button") return Paint::BUTTON;
+    if (tag == "input") {
+        std::string_view type = document.GetAttribute(id, "type");
+        return (type == "submit" || type == "button" || type == "reset") ? Paint::BUTTON : Paint::CONTROL;
+    }
+    if (tag == "select" || tag == "textarea") return Paint::CONTROL;
+    if (tag == "img" || tag == "video" || tag == "canvas" || tag == "iframe") return Paint::IMAGE;
+    if (tag == "hr") return Paint::RULE;
+    if (tag == "section" || tag == "nav" || tag == "form" || tag == "table" || tag == "header" ||
+        tag == "footer" || tag == "article" || tag == "aside") {
+        return Paint::FRAME;
+    }
+    return Paint::NONE;
+}
+
+void StrokeRect(Bitmap* bitmap, int x, int y, int width, int height, uint32_t color) {
+    bitmap->FillRect(x, y, width, 1, color);
+    bitmap->FillRect(x, y + height - 1, width, 1, color);
+    bitmap->FillRect(x, y, 1, height, color);
+    bitmap->FillRect(x + width - 1, y, 1, height, color);
+}
+
+uint32_t TextColor(const dom::Document& document, dom::NodeId text) {
+    // The nearest link or button within a few levels decides
+    dom::NodeId id = document.GetNode(text).parent;
+    for (int depth = 0; depth < 3 && id != dom::kInvalidNode && id != document.Root(); ++depth) {
+        std::string_view tag = document.TagName(id);
+        if (tag == "a") return kLinkColor;
+        if (tag == "button") return kButtonTextColor;
+        id = document.GetNode(id).parent;
+    }
+    return kTextColor;
+}
+
+void PaintText(const dom::Document& document, dom::NodeId id, const dom::Box& box,
+               int dx, int dy, Bitmap* bitmap) {
+    uint32_t color = TextColor(document, id);
+    int pen = box.x + kTextPadding;
+    int right = box.x + box.width - kTextPadding;
+    bool pending_space = false;
+    for (char c : document.GetNode(id).name) {
+        if (c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f') {
+            pending_space = pen > box.x + kTextPadding;
+            continue;
+        }
+        if ((static_cast<unsigned char>(c) & 0xC0) == 0x80) continue;     // UTF-8 continuation byte
+        if (pending_space) pen += kGlyphAdvance;
+        pending_space = false;
+        if (pen + kGlyphWidth > right) break;
+        int drop = (c >= 'a' && c <= 'z') ? kLowerCaseDrop : 0;
+        bitmap->FillRect(pen - dx, box.y + kGlyphTop + drop - dy, kGlyphWidth, kGlyphHeight - drop, color);
+        pen += kGlyphAdvance;
+    }
+    if (color == kLinkColor && pen > box.x + kTextPadding) {
+        bitmap->FillRect(box.x + kTextPadding - dx, box.y + kGlyphTop + kGlyphHeight + 1 - dy,
+                         pen - box.x - kTextPadding - (kGlyphAdvance - kGlyphWidth), 1, color);
+    }
+}
+
+} // namespace
+
+bool RasterizePage(const dom::Document& document, const dom::Box& region, Bitmap* bitmap, PixelFormat format) {
+    if (region.IsEmpty() || !bitmap->Allocate(region.width, region.height, format)) return false;
+    bitmap->Fill(kBackgroundColor);
+    int dx = region.x;
+    int dy = region.y;
+    int region_bottom = region.y + region.height;
+    int region_right = region.x + region.width;
+
+    // Nodes are in paint order. An element's box spans its descendants
+    // vertically, so subtrees above or below the region are skipped whole.
+    for (dom::NodeId id = 1; id < document.Size();) {
+        const dom::Node& node = document.GetNode(id);
+        const dom::Box& box = document.GetBox(id);
+        bool outside = box.IsEmpty() || box.y >= region_bottom || box.y + box.height <= region.y;
+        if (node.type == dom::NodeType::TEXT) {
+            if (!outside && box.x < region_right && box.x + box.width > region.x) {
+                PaintText(document, id, box, dx, dy, bitmap);
+            }
+            ++id;
+            continue;
+        }
+        if (outside) {
+            id = std::max(node.subtree_end, id + 1);
+            continue;
+        }
+        switch (PaintFor(document, id)) {
+            case Paint::BUTTON:
+                bitmap->FillRect(box.x - dx, box.y - dy, box.width, box.height, kButtonColor);
+                break;
+            case Paint::CONTROL:
+                StrokeRect(bitmap, box.x - dx, box.y - dy, box.width, box.height, kControlBorderColor);
+                break;
+            case Paint::IMAGE:
+                bitmap->FillRect(box.x - dx, box.y - dy, box.width, box.height, kImageColor);
+                break;
+            case Paint::RULE:
+                bitmap->FillRect(box.x - dx, box.y + box.height / 2 - dy, box.width, 1, kFrameColor);
+                break;
+            case Paint::FRAME:
+                StrokeRect(bitmap, box.x - dx, box.y - dy, box.width, box.height, kFrameColor);
+                break;
+            case Paint::NONE:
+                break;
+        }
+        ++id;
+    }
+    return true;
+}
+
+std::vector<CaptureFrame> PlanCaptureFrames(const std::vector<dom::Box>& boxes, int frame_width,
+                                            int frame_height) {
+    std::vector<size_t> order;
+    order.reserve(boxes.size());
+    for (size_t i = 0; i < boxes.size(); ++i) {
+        if (!boxes[i].IsEmpty()) order.push_back(i);
+    }
+    std::stable_sort(order.begin(), order.end(), [&boxes](size_t a, size_t b) {
+        return boxes[a].y != boxes[b].y ? boxes[a].y < boxes[b].y : boxes[a].x < boxes[b].x;
+    });
+
+    std::vector<CaptureFrame> frames;
+    std::vector<bool> covered(order.size(), false);
+    for (size_t first = 0; first < order.size(); ++first) {
+        if (covered[first]) continue;
+        const dom::Box& start = boxes[order[first]];
+        // Boxes on the page share the frame's columns; anything wider or
+        // hanging off the side is framed where it is
+        int left = start.x >= 0 && start.x + start.width <= frame_width ? 0 : start.x;
+        int top = start.y;
+        CaptureFrame frame;
+        frame.region = start;
+        frame.boxes.push_back(order[first]);
+        covered[first] = true;
+        int64_t box_area = Area(start);
+        bool fits = start.width <= frame_width && start.height <= frame_height;
+        for (size_t next = first + 1; fits && next < order.size(); ++next) {
+            const dom::Box& box = boxes[order[next]];
+            if (box.y >= top + frame_height) break;
+            if (covered[next] || box.x < left || box.x + box.width > left + frame_width ||
+                box.y + box.height > top + frame_height) {
+                continue;
+            }
+            dom::Box region = frame.region;
+            region.x = std::min(frame.region.x, box.x);
+            region.width = std::max(frame.region.x + frame.region.width, box.x + box.width) - region.x;
+            region.height = std::max(frame.region.y + frame.region.height, box.y + box.height) - region.y;
+            // Painting costs about its area, so a frame is shared only while
+            // it is no larger than its boxes painted one by one
+            if (Area(region) > box_area + Area(box)) continue;
+            frame.region = region;
+            box_area += Area(box);
+            frame.boxes.push_back(order[next]);
+            covered[next] = true;
+        }
+        frames.push_back(std::move(frame));
+    }
+    return frames;
+}
+
+} // namespace navigrab
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "bitmap.h"
+#include "dom.h"
+#include <cstddef>
+#include <vector>
+
+namespace navigrab {
+
+// Height of the simulated browser viewport in CSS pixels
+constexpr int kViewportHeight = 720;
+
+// Paints a simplified rendering of |document| from its layout boxes: form
+// controls, buttons and images as filled boxes, text as one bar per glyph.
+// Only |region| (page coordinates) is painted, into |bitmap| at 1 pixel per
+// CSS pixel, so element and tile captures cost their own area. The bitmap
+// keeps its buffer when it fits. False for an empty region.
+bool RasterizePage(const dom::Document& document, const dom::Box& region, Bitmap* bitmap,
+                   PixelFormat format = PixelFormat::RGBA_8888);
+
+// One rasterization shared by several element captures
+struct CaptureFrame {
+    dom::Box region;                // Page coordinates, the union of its boxes
+    std::vector<size_t> boxes;      // Indices into the planned boxes
+};
+
+// Groups |boxes| (page coordinates) into frames of at most |frame_width| x
+// |frame_height|, so overlapping elements are cropped from one rendering
+// instead of each painting the same pixels. Frames are planned top to
+// bottom, each starting at the highest box not yet covered and taking later
+// boxes while its area stays within theirs summed; an isolated element is a
+// frame of its own. Empty boxes belong to no frame.
+std::vector<CaptureFrame> PlanCaptureFrames(const std::vector<dom::Box>& boxes, int frame_width,
+                                            int frame_height);
+
+} // namespace navigrab
@@ -0,0 +1,776 @@
+#include "selector_engine.h"
+#include <algorithm>
+
+namespace navigrab {
+
+namespace {
+
+bool IsSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+bool IsNameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+           c == '-' || c == '_' || static_cast<unsigned char>(c) >= 0x80;
+}
+
+char ToLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+std::string ToLowerString(std::string_view text) {
+    std::string result(text);
+    for (char& c : result) c = ToLower(c);
+    return result;
+}
+
+bool EqualsIgnoreCase(std::string_view a, std::string_view b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (ToLower(a[i]) != ToLower(b[i])) return false;
+    }
+    return true;
+}
+
+uint32_t HashString(std::string_view text, uint32_t salt) {
+    uint32_t hash = 2166136261u ^ salt;
+    for (char c : text) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 16777619u;
+    }
+    // Final avalanche so both 12-bit halves are usable as filter indexes
+    hash ^= hash >> 16;
+    hash *= 0x85EBCA6Bu;
+    hash ^= hash >> 13;
+    return hash;
+}
+
+bool MatchesNth(int index, int a, int b) {
+    if (a == 0) return index == b;
+    int diff = index - b;
+    return diff % a == 0 && diff / a >= 0;
+}
+
+dom::NodeId PreviousElementSibling(const dom::Document& document, dom::NodeId id) {
+    dom::NodeId parent = document.GetNode(id).parent;
+    if (parent == dom::kInvalidNode) return dom::kInvalidNode;
+    dom::NodeId previous = dom::kInvalidNode;
+    for (dom::NodeId sibling = document.GetNode(parent).first_child; sibling != id && sibling != dom::kInvalidNode;
+         sibling = document.GetNode(sibling).next_sibling) {
+        if (document.IsElement(sibling)) previous = sibling;
+    }
+    return previous;
+}
+
+} // namespace
+
+// Recursive-descent parser producing the right-to-left program.
+class SelectorParser {
+public:
+    using Op = CompiledSelector::Op;
+    using Instruction = CompiledSelector::Instruction;
+
+    SelectorParser(std::string_view text, CompiledSelector* output)
+        : text_(text), pos_(0), output_(output) {}
+
+    bool Parse() {
+        while (true) {
+            if (!ParseComplexSelector()) return false;
+            SkipSpace();
+            if (AtEnd()) return true;
+            if (Peek() != ',') return false;
+            ++pos_;
+        }
+    }
+
+private:
+    struct Compound {
+        std::vector<Instruction> tests;
+        std::vector<uint32_t> hashes;
+    };
+
+    bool ParseComplexSelector() {
+        std::vector<Compound> compounds;
+        std::vector<Op> combinators;
+        SkipSpace();
+        compounds.emplace_back();
+        if (!ParseCompound(&compounds.back())) return false;
+
+        while (true) {
+            bool had_space = SkipSpace();
+            if (AtEnd() || Peek() == ',') break;
+            Op combinator = Op::DESCENDANT;
+            if (Peek() == '>') {
+                combinator = Op::CHILD;
+            } else if (Peek() == '+') {
+                combinator = Op::ADJACENT_SIBLING;
+            } else if (Peek() == '~') {
+                combinator = Op::GENERAL_SIBLING;
+            } else if (!had_space) {
+                return false;
+            }
+            if (combinator != Op::DESCENDANT) {
+                ++pos_;
+                SkipSpace();
+            }
+            combinators.push_back(combinator);
+            compounds.emplace_back();
+            if (!ParseCompound(&compounds.back())) return false;
+        }
+
+        // Emit right to left. A compound followed by a child/descendant
+        // combinator must be an ancestor of the subject, so its identifiers
+        // feed the Bloom filter pre-check; one followed by a sibling
+        // combinator need not be, even if further compounds to its right
+        // are ancestors.
+        CompiledSelector::Alternative alternative;
+        alternative.entry = output_->program_.size();
+        bool ancestor = false;
+        for (size_t i = compounds.size(); i-- > 0;) {
+            auto& tests = compounds[i].tests;
+            output_->program_.insert(output_->program_.end(), tests.begin(), tests.end());
+            if (ancestor) {
+                alternative.ancestor_hashes.insert(alternative.ancestor_hashes.end(),
+                                                   compounds[i].hashes.begin(), compounds[i].hashes.end());
+            }
+            if (i > 0) {
+                Op combinator = combinators[i - 1];
+                output_->program_.push_back(MakeInstruction(combinator));
+                ancestor = combinator == Op::CHILD || combinator == Op::DESCENDANT;
+            }
+        }
+        output_->program_.push_back(MakeInstruction(Op::MATCH));
+        output_->alternatives_.push_back(std::move(alternative));
+        return true;
+    }
+
+    bool ParseCompound(Compound* compound) {
+        size_t start = pos_;
+        if (!AtEnd() && Peek() == '*') {
+            ++pos_;
+        } else if (!AtEnd() && IsNameChar(Peek())) {
+            std::string tag = ToLowerString(ReadName());
+            compound->hashes.push_back(AncestorFilter::TagHash(tag));
+            compound->tests.push_back(MakeInstruction(Op::TAG, Intern(tag)));
+        }
+
+        while (!AtEnd()) {
+            char c = Peek();
+            if (c == '#') {
+                ++pos_;
+                std::string id = ReadName();
+                if (id.empty()) return false;
+                compound->hashes.push_back(AncestorFilter::IdHash(id));
+                compound->tests.push_back(MakeInstruction(Op::ID, Intern(id)));
+            } else if (c == '.') {
+                ++pos_;
+                std::string class_name = ReadName();
+                if (class_name.empty()) return false;
+                compound->hashes.push_back(AncestorFilter::ClassHash(class_name));
+                compound->tests.push_back(MakeInstruction(Op::CLASS, Intern(class_name)));
+            } else if (c == '[') {
+                ++pos_;
+                if (!ParseAttribute(compound)) return false;
+            } else if (c == ':') {
+                ++pos_;
+                if (!ParsePseudoClass(compound)) return false;
+            } else {
+                break;
+            }
+        }
+        return pos_ > start;
+    }
+
+    bool ParseAttribute(Compound* compound) {
+        SkipSpace();
+        std::string name = ToLowerString(ReadName());
+        if (name.empty()) return false;
+        SkipSpace();
+        if (AtEnd()) return false;
+        if (Peek() == ']') {
+            ++pos_;
+            compound->tests.push_back(MakeInstruction(Op::ATTR_EXISTS, Intern(name)));
+            return true;
+        }
+
+        Op op;
+        char c = Peek();
+        if (c == '=') {
+            op = Op::ATTR_EQUALS;
+        } else {
+            if (pos_ + 1 >= text_.size() || text_[pos_ + 1] != '=') return false;
+            switch (c) {
+                case '~': op = Op::ATTR_INCLUDES; break;
+                case '|': op = Op::ATTR_DASH_MATCH; break;
+                case '^': op = Op::ATTR_PREFIX; break;
+                case '$': op = Op::ATTR_SUFFIX; break;
+                case '*': op = Op::ATTR_SUBSTRING; break;
+                default: return false;
+            }
+            ++pos_;
+        }
+        ++pos_;
+        SkipSpace();
+
+        std::string value;
+        if (!AtEnd() && (Peek() == '"' || Peek() == '\'')) {
+            char quote = text_[pos_++];
+            while (!AtEnd() && Peek() != quote) {
+                if (Peek() == '\\' && pos_ + 1 < text_.size()) ++pos_;
+                value.push_back(text_[pos_++]);
+            }
+            if (AtEnd()) return false;
+            ++pos_;
+        } else {
+            value = ReadName();
+        }
+        SkipSpace();
+        bool ignore_case = false;
+        if (!AtEnd() && (Peek() == 'i' || Peek() == 'I' || Peek() == 's' || Peek() == 'S')) {
+            ignore_case = ToLower(Peek()) == 'i';
+            ++pos_;
+            SkipSpace();
+        }
+        if (AtEnd() || Peek() != ']') return false;
+        ++pos_;
+
+        Instruction instruction = MakeInstruction(op, Intern(name), Intern(value));
+        instruction.ignore_case = ignore_case;
+        compound->tests.push_back(instruction);
+        return true;
+    }
+
+    bool ParsePseudoClass(Compound* compound) {
+        std::string name = ToLowerString(ReadName());
+        if (name == "first-child") {
+            compound->tests.push_back(MakeNth(Op::NTH_CHILD, 0, 1));
+        } else if (name == "last-child") {
+            compound->tests.push_back(MakeNth(Op::NTH_LAST_CHILD, 0, 1));
+        } else if (name == "only-child") {
+            compound->tests.push_back(MakeNth(Op::NTH_CHILD, 0, 1));
+            compound->tests.push_back(MakeNth(Op::NTH_LAST_CHILD, 0, 1));
+        } else if (name == "nth-child" || name == "nth-last-child") {
+            int a = 0;
+            int b = 0;
+            if (!ParseNthArgument(&a, &b)) return false;
+            compound->tests.push_back(MakeNth(name == "nth-child" ? Op::NTH_CHILD : Op::NTH_LAST_CHILD, a, b));
+        } else if (name == "disabled" || name == "checked") {
+            compound->tests.push_back(MakeInstruction(Op::ATTR_EXISTS, Intern(name)));
+        } else if (name == "not" && !in_negation_) {
+            // :not(compound) - NOT followed by the negated tests
+            if (AtEnd() || Peek() != '(') return false;
+            ++pos_;
+            SkipSpace();
+            Compound negated;
+            in_negation_ = true;
+            bool parsed = ParseCompound(&negated);
+            in_negation_ = false;
+            SkipSpace();
+            if (!parsed || AtEnd() || Peek() != ')') return false;
+            ++pos_;
+            Instruction instruction = MakeInstruction(Op::NOT);
+            instruction.b = static_cast<int>(negated.tests.size());
+            compound->tests.push_back(instruction);
+            compound->tests.insert(compound->tests.end(), negated.tests.begin(), negated.tests.end());
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    // Parses "(an+b)", "(odd)" or "(even)" including the parentheses.
+    bool ParseNthArgument(int* a, int* b) {
+        if (AtEnd() || Peek() != '(') return false;
+        size_t close = text_.find(')', pos_);
+        if (close == std::string_view::npos) return false;
+        std::string argument;
+        for (char c : text_.substr(pos_ + 1, close - pos_ - 1)) {
+            if (!IsSpace(c)) argument.push_back(ToLower(c));
+        }
+        pos_ = close + 1;
+
+        if (argument == "odd") {
+            *a = 2;
+            *b = 1;
+            return true;
+        }
+        if (argument == "even") {
+            *a = 2;
+            *b = 0;
+            return true;
+        }
+        size_t n = argument.find('n');
+        auto parse_int = [](const std::string& text, int* out) {
+            if (text.empty()) return false;
+            size_t i = (text[0] == '+' || text[0] == '-') ? 1 : 0;
+            if (i == text.size()) return false;
+            int value = 0;
+            for (; i < text.size(); ++i) {
+                if (text[i] < '0' || text[i] > '9') return false;
+                value = value * 10 + (text[i] - '0');
+            }
+            *out = text[0] == '-' ? -value : value;
+            return true;
+        };
+        if (n == std::string::npos) {
+            *a = 0;
+            return parse_int(argument, b);
+        }
+        std::string coefficient = argument.substr(0, n);
+        if (coefficient.empty() || coefficient == "+") {
+            *a = 1;
+        } else if (coefficient == "-") {
+            *a = -1;
+        } else if (!parse_int(coefficient, a)) {
+            return false;
+        }
+        std::string offset = argument.substr(n + 1);
+        *b = 0;
+        return offset.empty() || parse_int(offset, b);
+    }
+
+    std::string ReadName() {
+        std::string name;
+        while (!AtEnd()) {
+            char c = Peek();
+            if (c == '\\' && pos_ + 1 < text_.size()) {
+                name.push_back(text_[pos_ + 1]);
+                pos_ += 2;
+            } else if (IsNameChar(c)) {
+                name.push_back(c);
+                ++pos_;
+            } else {
+                break;
+            }
+        }
+        return name;
+    }
+
+    bool SkipSpace() {
+        size_t start = pos_;
+        while (!AtEnd() && IsSpace(Peek())) ++pos_;
+        return pos_ > start;
+    }
+
+    uint32_t Intern(const std::string& value) {
+        auto& strings = output_->strings_;
+        auto it = std::find(strings.begin(), strings.end(), value);
+        if (it != strings.end()) return static_cast<uint32_t>(it - strings.begin());
+        strings.push_back(value);
+        return static_cast<uint32_t>(strings.size() - 1);
+    }
+
+    static Instruction MakeInstruction(Op op, uint32_t name = 0, uint32_t value = 0) {
+        return Instruction{op, false, name, value, 0, 0};
+    }
+
+    static Instruction MakeNth(Op op, int a, int b) {
+        return Instruction{op, false, 0, 0, a, b};
+    }
+
+    bool AtEnd() const { return pos_ >= text_.size(); }
+    char Peek() const { return text_[pos_]; }
+
+    std::string_view text_;
+    size_t pos_;
+    CompiledSelector* output_;
+    bool in_negation_ = false;
+};
+
+// CompiledSelector implementation
+std::shared_ptr<const CompiledSelector> CompiledSelector::Compile(std::string_view text) {
+    std::shared_ptr<CompiledSelector> selector(new CompiledSelector());
+    selector->text_ = std::string(text);
+    SelectorParser parser(text, selector.get());
+    selector->valid_ = parser.Parse() && !selector->alternatives_.empty();
+    if (!selector->valid_) {
+        selector->program_.clear();
+        selector->alternatives_.clear();
+    }
+    return selector;
+}
+
+bool CompiledSelector::Matches(const dom::Document& document, dom::NodeId id) const {
+    if (!valid_ || id >= document.Size() || !document.IsElement(id)) return false;
+    for (const Alternative& alternative : alternatives_) {
+        if (RunFrom(document, alternative.entry, id)) return true;
+    }
+    return false;
+}
+
+bool CompiledSelector::TestNode(const dom::Document& document,
+                                const Instruction& instruction,
+                                dom::NodeId id) const {
+    // The nth tests carry no strings, and a selector made only of them has none
+    switch (instruction.op) {
+        case Op::TAG:
+            return document.TagName(id) == strings_[instruction.name];
+        case Op::ID:
+            return document.GetId(id) == strings_[instruction.name];
+        case Op::CLASS:
+            return document.HasClass(id, strings_[instruction.name]);
+        case Op::NTH_CHILD:
+        case Op::NTH_LAST_CHILD: {
+            dom::NodeId parent = document.GetNode(id).parent;
+            if (parent == dom::kInvalidNode) return false;
+            int index = 1;
+            if (instruction.op == Op::NTH_CHILD) {
+                index = static_cast<int>(document.GetNode(id).element_index);
+            } else {
+                for (dom::NodeId sibling = document.GetNode(id).next_sibling; sibling != dom::kInvalidNode;
+                     sibling = document.GetNode(sibling).next_sibling) {
+                    if (document.IsElement(sibling)) ++index;
+                }
+            }
+            return MatchesNth(index, instruction.a, instruction.b);
+        }
+        default:
+            break;
+    }
+
+    const dom::Attribute* attribute = document.FindAttribute(id, strings_[instruction.name]);
+    if (!attribute) return false;
+    if (instruction.op == Op::ATTR_EXISTS) return true;
+
+    std::string_view actual = attribute->value;
+    std::string_view expected = strings_[instruction.value];
+    auto equals = [&](std::string_view a, std::string_view b) {
+        return instruction.ignore_case ? EqualsIgnoreCase(a, b) : a == b;
+    };
+    switch (instruction.op) {
+        case Op::ATTR_EQUALS:
+            return equals(actual, expected);
+        case Op::ATTR_INCLUDES: {
+            size_t pos = 0;
+            while (pos < actual.size()) {
+                while (pos < actual.size() && IsSpace(actual[pos])) ++pos;
+                size_t start = pos;
+                while (pos < actual.size() && !IsSpace(actual[pos])) ++pos;
+                if (pos > start && equals(actual.substr(start, pos - start), expected)) return true;
+            }
+            return false;
+        }
+        case Op::ATTR_DASH_MATCH:
+            return equals(actual, expected) ||
+                   (actual.size() > expected.size() && actual[expected.size()] == '-' &&
+                    equals(actual.substr(0, expected.size()), expected));
+        case Op::ATTR_PREFIX:
+            return !expected.empty() && actual.size() >= expected.size() &&
+                   equals(actual.substr(0, expected.size()), expected);
+        case Op::ATTR_SUFFIX:
+            return !expected.empty() && actual.size() >= expected.size() &&
+                   equals(actual.substr(actual.size() - expected.size()), expected);
+        case Op::ATTR_SUBSTRING:
+            if (expected.empty() || actual.size() < expected.size()) return false;
+            for (size_t i = 0; i + expected.size() <= actual.size(); ++i) {
+                if (equals(actual.substr(i, expected.size()), expected)) return true;
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+bool CompiledSelector::RunFrom(const dom::Document& document, size_t pc, dom::NodeId id) const {
+    while (true) {
+        const Instruction& instruction = program_[pc];
+        switch (instruction.op) {
+            case Op::MATCH:
+                return true;
+            case Op::CHILD:
+                id = document.GetNode(id).parent;
+                if (id == dom::kInvalidNode || !document.IsElement(id)) return false;
+                ++pc;
+                break;
+            case Op::DESCENDANT:
+                for (dom::NodeId ancestor = document.GetNode(id).parent;
+                     ancestor != dom::kInvalidNode && document.IsElement(ancestor);
+                     ancestor = document.GetNode(ancestor).parent) {
+                    if (RunFrom(document, pc + 1, ancestor)) return true;
+                }
+                return false;
+            case Op::ADJACENT_SIBLING:
+                id = PreviousElementSibling(document, id);
+                if (id == dom::kInvalidNode) return false;
+                ++pc;
+                break;
+            case Op::GENERAL_SIBLING: {
+                dom::NodeId parent = document.GetNode(id).parent;
+                if (parent == dom::kInvalidNode) return false;
+                for (dom::NodeId sibling = document.GetNode(parent).first_child; sibling != id;
+                     sibling = document.GetNode(sibling).next_sibling) {
+                    if (document.IsElement(sibling) && RunFrom(document, pc + 1, sibling)) return true;
+                }
+                return false;
+            }
+            case Op::NOT: {
+                bool all = true;
+                for (int i = 1; i <= instruction.b && all; ++i) {
+                    all = TestNode(document, program_[pc + i], id);
+                }
+                if (all) return false;
+                pc += instruction.b + 1;
+                break;
+            }
+            default:
+                if (!TestNode(document, instruction, id)) return false;
+                ++pc;
+                break;
+        }
+    }
+}
+
+// AncestorFilter implementation
+AncestorFilter::AncestorFilter() : counts_(kSize, 0) {}
+
+uint32_t AncestorFilter::TagHash(std::string_view tag) {
+    return HashString(tag, 13);
+}
+
+uint32_t AncestorFilter::IdHash(std::string_view id) {
+    return HashString(id, 17);
+}
+
+uint32_t AncestorFilter::ClassHash(std::string_view class_name) {
+    return HashString(class_name, 19);
+}
+
+void AncestorFilter::Add(uint32_t hash) {
+    ++counts_[hash & (kSize - 1)];
+    ++counts_[(hash >> kBits) & (kSize - 1)];
+}
+
+void AncestorFilter::Remove(uint32_t hash) {
+    --counts_[hash & (kSize - 1)];
+    --counts_[(hash >> kBits) & (kSize - 1)];
+}
+
+bool AncestorFilter::MightContain(uint32_t hash) const {
+    return counts_[hash & (kSize - 1)] != 0 && counts_[(hash >> kBits) & (kSize - 1)] != 0;
+}
+
+bool AncestorFilter::MightContainAll(const std::vector<uint32_t>& hashes) const {
+    for (uint32_t hash : hashes) {
+        if (!MightContain(hash)) return false;
+    }
+    return true;
+}
+
+template <typename Visitor>
+static void ForEachIdentifierHash(const dom::Document& document, dom::NodeId id, Visitor visit) {
+    visit(AncestorFilter::TagHash(document.TagName(id)));
+    std::string_view element_id = document.GetId(id);
+    if (!element_id.empty()) visit(AncestorFilter::IdHash(element_id));
+    std::string_view classes = document.GetAttribute(id, "class");
+    size_t pos = 0;
+    while (pos < classes.size()) {
+        while (pos < classes.size() && IsSpace(classes[pos])) ++pos;
+        size_t start = pos;
+        while (pos < classes.size() && !IsSpace(classes[pos])) ++pos;
+        if (pos > start) visit(AncestorFilter::ClassHash(classes.substr(start, pos - start)));
+    }
+}
+
+void AncestorFilter::PushElement(const dom::Document& document, dom::NodeId id) {
+    ForEachIdentifierHash(document, id, [this](uint32_t hash) { Add(hash); });
+}
+
+void AncestorFilter::PopElement(const dom::Document& document, dom::NodeId id) {
+    ForEachIdentifierHash(document, id, [this](uint32_t hash) { Remove(hash); });
+}
+
+// SelectorMatcher implementation
+SelectorMatcher::SelectorMatcher(const dom::Document& document) : document_(document) {}
+
+bool SelectorMatcher::MatchesWithFilter(const CompiledSelector& selector,
+                                        const AncestorFilter& filter,
+                                        dom::NodeId id) const {
+    for (const auto& alternative : selector.alternatives_) {
+        if (!filter.MightContainAll(alternative.ancestor_hashes)) continue;
+        if (selector.RunFrom(document_, alternative.entry, id)) return true;
+    }
+    return false;
+}
+
+const dom::NodeList* SelectorMatcher::SubjectCandidates(const CompiledSelector& selector,
+                                                        const CompiledSelector::Alternative& alternative) const {
+    using Op = CompiledSelector::Op;
+    const dom::NodeList* best = nullptr;
+    for (size_t pc = alternative.entry; pc < selector.program_.size(); ++pc) {
+        const auto& instruction = selector.program_[pc];
+        const dom::NodeList* list = nullptr;
+        if (instruction.op == Op::TAG) {
+            list = &document_.ElementsByTag(selector.strings_[instruction.name]);
+        } else if (instruction.op == Op::ID) {
+            list = &document_.ElementsById(selector.strings_[instruction.name]);
+        } else if (instruction.op == Op::CLASS) {
+            list = &document_.ElementsByClass(selector.strings_[instruction.name]);
+        } else if (instruction.op == Op::NOT) {
+            pc += instruction.b;  // Negated tests do not narrow the candidates
+        } else if (instruction.op >= Op::CHILD) {
+            break;  // End of the subject compound
+        }
+        if (list && (!best || list->size() < best->size())) best = list;
+    }
+    return best;
+}
+
+bool SelectorMatcher::QueryIndexed(const CompiledSelector& selector,
+                                   dom::NodeId scope,
+                                   size_t limit,
+                                   dom::NodeList* matches) const {
+    std::vector<const dom::NodeList*> candidates;
+    for (const auto& alternative : selector.alternatives_) {
+        const dom::NodeList* list = SubjectCandidates(selector, alternative);
+        if (!list) return false;
+        candidates.push_back(list);
+    }
+
+    // Test only the candidates inside the scope
+    dom::NodeId end = document_.GetNode(scope).subtree_end;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        const dom::NodeList& list = *candidates[i];
+        size_t before = matches->size();
+        for (auto it = std::upper_bound(list.begin(), list.end(), scope); it != list.end() && *it < end; ++it) {
+            if (selector.RunFrom(document_, selector.alternatives_[i].entry, *it)) {
+                matches->push_back(*it);
+                if (candidates.size() == 1 && matches->size() >= limit) break;
+            }
+        }
+        if (i > 0) std::inplace_merge(matches->begin(), matches->begin() + before, matches->end());
+    }
+    if (candidates.size() > 1) {
+        matches->erase(std::unique(matches->begin(), matches->end()), matches->end());
+        if (matches->size() > limit) matches->resize(limit);
+    }
+    return true;
+}
+
+void SelectorMatcher::Walk(const std::vector<const CompiledSelector*>& selectors,
+                           dom::NodeId scope,
+                           size_t limit,
+                           const std::vector<dom::NodeList*>& results) const {
+    // Seed the filter with the scope and its ancestors
+    AncestorFilter filter;
+    for (dom::NodeId ancestor = scope; ancestor != dom::kInvalidNode;
+         ancestor = document_.GetNode(ancestor).parent) {
+        if (document_.IsElement(ancestor)) filter.PushElement(document_, ancestor);
+    }
+
+    std::vector<dom::NodeId> open;
+    size_t remaining = selectors.size();
+    dom::NodeId end = document_.GetNode(scope).subtree_end;
+    for (dom::NodeId id = scope + 1; id < end && remaining > 0; ++id) {
+        while (!open.empty() && document_.GetNode(open.back()).subtree_end <= id) {
+            filter.PopElement(document_, open.back());
+            open.pop_back();
+        }
+        const dom::Node& node = document_.GetNode(id);
+        if (node.type != dom::NodeType::ELEMENT) continue;
+        for (size_t i = 0; i < selectors.size(); ++i) {
+            dom::NodeList* matches = results[i];
+            if (matches->size() >= limit || !MatchesWithFilter(*selectors[i], filter, id)) continue;
+            matches->push_back(id);
+            if (matches->size() >= limit) --remaining;
+        }
+        if (node.subtree_end > id + 1) {
+            filter.PushElement(document_, id);
+            open.push_back(id);
+        }
+    }
+}
+
+std::vector<dom::NodeId> SelectorMatcher::QueryAll(const CompiledSelector& selector,
+                                                   dom::NodeId scope,
+                                                   size_t limit) const {
+    std::vector<dom::NodeId> matches;
+    if (!selector.IsValid() || scope >= document_.Size() || limit == 0) return matches;
+    if (!QueryIndexed(selector, scope, limit, &matches)) Walk({&selector}, scope, limit, {&matches});
+    return matches;
+}
+
+std::vector<dom::NodeList> SelectorMatcher::QueryMany(const std::vector<const CompiledSelector*>& selectors,
+                                                      dom::NodeId scope) const {
+    std::vector<dom::NodeList> results(selectors.size());
+    if (scope >= document_.Size()) return results;
+
+    // Indexed selectors never touch the tree; the rest share one walk.
+    std::vector<const CompiledSelector*> walked;
+    std::vector<dom::NodeList*> walked_results;
+    for (size_t i = 0; i < selectors.size(); ++i) {
+        const CompiledSelector* selector = selectors[i];
+        if (!selector || !selector->IsValid()) continue;
+        if (QueryIndexed(*selector, scope, static_cast<size_t>(-1), &results[i])) continue;
+        walked.push_back(selector);
+        walked_results.push_back(&results[i]);
+    }
+    if (!walked.empty()) Walk(walked, scope, static_cast<size_t>(-1), walked_results);
+    return results;
+}
+
+dom::NodeId SelectorMatcher::QueryFirst(const CompiledSelector& selector, dom::NodeId scope) const {
+    std::vector<dom::NodeId> matches = QueryAll(selector, scope, 1);
+    return matches.empty() ? dom::kInvalidNode : matches.front();
+}
+
+// SelectorCache implementation
+SelectorCache::SelectorCache(size_t capacity)
+    : capacity_(capacity > 0 ? capacity : 1), hits_(0), misses_(0) {}
+
+SelectorCache::~SelectorCache() = default;
+
+SelectorCache& SelectorCache::GetInstance() {
+    static SelectorCache instance;
+    return instance;
+}
+
+std::shared_ptr<const CompiledSelector> SelectorCache::Get(std::string_view text) {
+    std::string key(text);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            lru_.splice(lru_.begin(), lru_, it->second.position);
+            ++hits_;
+            return it->second.selector;
+        }
+        ++misses_;
+    }
+
+    // Compile outside the lock; a racing thread may insert the same key first.
+    std::shared_ptr<const CompiledSelector> compiled = CompiledSelector::Compile(text);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    if (it != entries_.end()) return it->second.selector;
+    lru_.push_front(key);
+    entries_.emplace(std::move(key), Entry{compiled, lru_.begin()});
+    while (entries_.size() > capacity_) {
+        entries_.erase(lru_.back());
+        lru_.pop_back();
+    }
+    return compiled;
+}
+
+void SelectorCache::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+}
+
+size_t SelectorCache::Size() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t SelectorCache::Hits() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return hits_;
+}
+
+size_t SelectorCache::Misses() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return misses_;
+}
+
+} // namespace navigrab
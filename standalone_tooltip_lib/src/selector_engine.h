@@ -0,0 +1,186 @@
+#pragma once
+
+#include "dom.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace navigrab {
+
+// A CSS selector (or selector list) compiled into a flat matcher program.
+// Each alternative is stored right-to-left: the tests for the subject
+// compound come first, followed by a combinator op that moves to the
+// next node to check. Supported syntax: type, *, #id, .class,
+// [attr], [attr=|~=||=|^=|$=|*=value i], :first-child, :last-child,
+// :only-child, :nth-child(), :nth-last-child(), :disabled, :checked,
+// :not(compound), and the descendant, >, + and ~ combinators.
+class CompiledSelector {
+public:
+    enum class Op : uint8_t {
+        // Tests on the current node
+        TAG,
+        ID,
+        CLASS,
+        ATTR_EXISTS,
+        ATTR_EQUALS,
+        ATTR_INCLUDES,
+        ATTR_DASH_MATCH,
+        ATTR_PREFIX,
+        ATTR_SUFFIX,
+        ATTR_SUBSTRING,
+        NTH_CHILD,
+        NTH_LAST_CHILD,
+        NOT,            // Fails if the next |b| tests all pass, then skips them
+        // Combinators - move to the next compound on the left
+        CHILD,
+        DESCENDANT,
+        ADJACENT_SIBLING,
+        GENERAL_SIBLING,
+        // End of one alternative
+        MATCH
+    };
+
+    struct Instruction {
+        Op op;
+        bool ignore_case;   // Attribute value tests with the 'i' flag
+        uint32_t name;      // Index into strings_ (tag/id/class/attribute name)
+        uint32_t value;     // Index into strings_ (attribute value)
+        int a;              // an+b for the nth tests
+        int b;
+    };
+
+    // Parses |text|. Invalid selectors compile to a program that never matches.
+    static std::shared_ptr<const CompiledSelector> Compile(std::string_view text);
+
+    bool IsValid() const { return valid_; }
+    const std::string& Text() const { return text_; }
+    size_t AlternativeCount() const { return alternatives_.size(); }
+
+    // Full match of |id| against any alternative, checking ancestors directly.
+    bool Matches(const dom::Document& document, dom::NodeId id) const;
+
+private:
+    friend class SelectorMatcher;
+    friend class SelectorParser;
+
+    struct Alternative {
+        size_t entry;                           // First instruction (subject compound)
+        std::vector<uint32_t> ancestor_hashes;  // Must all be present in the ancestor filter
+    };
+
+    CompiledSelector() : valid_(false) {}
+
+    bool RunFrom(const dom::Document& document, size_t pc, dom::NodeId id) const;
+    bool TestNode(const dom::Document& document, const Instruction& instruction, dom::NodeId id) const;
+
+    std::string text_;
+    bool valid_;
+    std::vector<Instruction> program_;
+    std::vector<std::string> strings_;
+    std::vector<Alternative> alternatives_;
+};
+
+// Counting Bloom filter over the identifiers (tag, id, classes) of the
+// current node's ancestors, maintained incrementally while walking the
+// document in order. Lets a candidate be rejected without climbing the tree.
+class AncestorFilter {
+public:
+    AncestorFilter();
+
+    void PushElement(const dom::Document& document, dom::NodeId id);
+    void PopElement(const dom::Document& document, dom::NodeId id);
+    bool MightContain(uint32_t hash) const;
+    bool MightContainAll(const std::vector<uint32_t>& hashes) const;
+
+    static uint32_t TagHash(std::string_view tag);
+    static uint32_t IdHash(std::string_view id);
+    static uint32_t ClassHash(std::string_view class_name);
+
+private:
+    static constexpr size_t kBits = 12;
+    static constexpr size_t kSize = 1u << kBits;
+
+    void Add(uint32_t hash);
+    void Remove(uint32_t hash);
+
+    std::vector<uint16_t> counts_;
+};
+
+// Evaluates compiled selectors over a document. When every alternative's
+// subject names a tag, id or class, only that index list is tested;
+// otherwise the document is walked once in order, maintaining the ancestor
+// filter as it goes. QueryMany() shares that walk between many selectors.
+class SelectorMatcher {
+public:
+    explicit SelectorMatcher(const dom::Document& document);
+
+    // All elements matching |selector| under |scope| (exclusive), in document order.
+    std::vector<dom::NodeId> QueryAll(const CompiledSelector& selector,
+                                      dom::NodeId scope = 0,
+                                      size_t limit = static_cast<size_t>(-1)) const;
+    dom::NodeId QueryFirst(const CompiledSelector& selector, dom::NodeId scope = 0) const;
+
+    // Evaluates all |selectors| together; result i holds the matches of
+    // selectors[i] in document order. Null or invalid entries match nothing.
+    std::vector<dom::NodeList> QueryMany(const std::vector<const CompiledSelector*>& selectors,
+                                         dom::NodeId scope = 0) const;
+
+private:
+    // Smallest index list (tag, id or class) covering the subject compound of
+    // |alternative|, or null when the subject has no indexable test.
+    const dom::NodeList* SubjectCandidates(const CompiledSelector& selector,
+                                           const CompiledSelector::Alternative& alternative) const;
+    // Answers |selector| from the indexes; false if it needs a walk.
+    bool QueryIndexed(const CompiledSelector& selector, dom::NodeId scope, size_t limit,
+                      dom::NodeList* matches) const;
+    // One ordered walk under |scope| testing every selector at each element.
+    void Walk(const std::vector<const CompiledSelector*>& selectors, dom::NodeId scope, size_t limit,
+              const std::vector<dom::NodeList*>& results) const;
+    bool MatchesWithFilter(const CompiledSelector& selector,
+                           const AncestorFilter& filter,
+                           dom::NodeId id) const;
+
+    const dom::Document& document_;
+};
+
+// Compiled programs keyed by selector text, bounded with LRU eviction.
+// Repeated hover-driven lookups pay only for the match, not the parse.
+class SelectorCache {
+public:
+    explicit SelectorCache(size_t capacity = kDefaultCapacity);
+    ~SelectorCache();
+
+    static constexpr size_t kDefaultCapacity = 512;
+
+    // Shared process-wide cache
+    static SelectorCache& GetInstance();
+
+    std::shared_ptr<const CompiledSelector> Get(std::string_view text);
+    void Clear();
+
+    size_t Size() const;
+    size_t Hits() const;
+    size_t Misses() const;
+
+private:
+    using LruList = std::list<std::string>;
+    struct Entry {
+        std::shared_ptr<const CompiledSelector> selector;
+        LruList::iterator position;
+    };
+
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    LruList lru_;
+    std::unordered_map<std::string, Entry> entries_;
+    size_t hits_;
+    size_t misses_;
+};
+
+} // namespace navigrab
@@ -0,0 +1,232 @@
+#include "trace.h"
+#include "logging.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace navigrab {
+
+namespace internal {
+
+std::atomic<bool> g_tracing_enabled{false};
+
+int64_t TraceNowNanoseconds() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace internal
+
+namespace {
+
+// Stops recording once this many events are buffered, so a forgotten trace
+// cannot grow without bound (about 48 MB).
+constexpr size_t kMaxTraceEvents = 1 << 20;
+
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    uint64_t trace_id;
+    int64_t start_ns;
+    int64_t duration_ns;
+    char phase;              // 'X' complete, 'b'/'e' async begin/end
+};
+
+// Events recorded by one thread. The lock is only contended while
+// StopTracing() collects.
+struct ThreadTrace {
+    std::mutex mutex;
+    std::vector<TraceEvent> events;
+    uint32_t tid = 0;
+    std::string name;
+};
+
+class TraceLog {
+public:
+    static TraceLog& Get() {
+        static TraceLog* log = new TraceLog();
+        return *log;
+    }
+
+    bool Start(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (internal::g_tracing_enabled.load()) return false;
+        path_ = path;
+        origin_ns_ = internal::TraceNowNanoseconds();
+        event_count_.store(0);
+        dropped_.store(0);
+        for (auto& thread : threads_) {
+            std::lock_guard<std::mutex> thread_lock(thread->mutex);
+            thread->events.clear();
+        }
+        internal::g_tracing_enabled.store(true);
+        return true;
+    }
+
+    bool Stop() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!internal::g_tracing_enabled.exchange(false)) return false;
+
+        FILE* file = std::fopen(path_.c_str(), "wb");
+        if (!file) {
+            NAVIGRAB_LOG(WARNING) << "Trace: Cannot write " << path_;
+            return false;
+        }
+        std::string out;
+        out.reserve(1 << 16);
+        out += "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+        out += "{\"ph\":\"M\",\"pid\":1,\"tid\":0,\"name\":\"process_name\",\"args\":{\"name\":\"NaviGrab\"}}";
+        size_t written = 0;
+        for (auto& thread : threads_) {
+            std::lock_guard<std::mutex> thread_lock(thread->mutex);
+            if (!thread->name.empty()) {
+                out += ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":" + std::to_string(thread->tid) +
+                       ",\"name\":\"thread_name\",\"args\":{\"name\":";
+                AppendJsonString(&out, thread->name.c_str());
+                out += "}}";
+            }
+            for (const TraceEvent& event : thread->events) {
+                AppendEvent(&out, event, thread->tid);
+                if (out.size() > (1 << 20)) {
+                    std::fwrite(out.data(), 1, out.size(), file);
+                    out.clear();
+                }
+            }
+            written += thread->events.size();
+            thread->events.clear();
+            thread->events.shrink_to_fit();
+        }
+        out += "\n]}\n";
+        std::fwrite(out.data(), 1, out.size(), file);
+        bool ok = std::fclose(file) == 0;
+        NAVIGRAB_LOG(INFO) << "Trace: Wrote " << written << " events to " << path_
+                           << " (" << dropped_.load() << " dropped)";
+        return ok;
+    }
+
+    void Record(const TraceEvent& event) {
+        // Spans that straddle StopTracing() are not kept
+        if (!internal::g_tracing_enabled.load(std::memory_order_relaxed)) return;
+        if (event_count_.fetch_add(1, std::memory_order_relaxed) >= kMaxTraceEvents) {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        ThreadTrace& thread = Current();
+        std::lock_guard<std::mutex> lock(thread.mutex);
+        thread.events.push_back(event);
+    }
+
+    void SetThreadName(const char* name) {
+        ThreadTrace& thread = Current();
+        std::lock_guard<std::mutex> lock(thread.mutex);
+        thread.name = name ? name : "";
+    }
+
+private:
+    TraceLog() = default;
+
+    ThreadTrace& Current() {
+        // Buffers stay registered after their thread exits so Stop() still sees them
+        thread_local std::shared_ptr<ThreadTrace> thread;
+        if (!thread) {
+            thread = std::make_shared<ThreadTrace>();
+            std::lock_guard<std::mutex> lock(mutex_);
+            thread->tid = next_tid_++;
+            threads_.push_back(thread);
+        }
+        return *thread;
+    }
+
+    static void AppendJsonString(std::string* out, const char* text) {
+        out->push_back('"');
+        for (const char* p = text; *p; ++p) {
+            unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\') {
+                out->push_back('\\');
+                out->push_back(static_cast<char>(c));
+            } else if (c < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out->append(escaped);
+            } else {
+                out->push_back(static_cast<char>(c));
+            }
+        }
+        out->push_back('"');
+    }
+
+    void AppendEvent(std::string* out, const TraceEvent& event, uint32_t tid) const {
+        char buffer[160];
+        *out += ",\n{\"ph\":\"";
+        out->push_back(event.phase);
+        *out += "\",\"cat\":";
+        AppendJsonString(out, event.category);
+        *out += ",\"name\":";
+        AppendJsonString(out, event.name);
+        int64_t ts = std::max<int64_t>(event.start_ns - origin_ns_, 0);
+        std::snprintf(buffer, sizeof(buffer), ",\"pid\":1,\"tid\":%u,\"ts\":%lld.%03lld", tid,
+                      static_cast<long long>(ts / 1000), static_cast<long long>(ts % 1000));
+        *out += buffer;
+        if (event.phase == 'X') {
+            std::snprintf(buffer, sizeof(buffer), ",\"dur\":%lld.%03lld",
+                          static_cast<long long>(event.duration_ns / 1000),
+                          static_cast<long long>(event.duration_ns % 1000));
+            *out += buffer;
+            if (event.trace_id) {
+                std::snprintf(buffer, sizeof(buffer), ",\"args\":{\"trace_id\":\"0x%llx\"}",
+                              static_cast<unsigned long long>(event.trace_id));
+                *out += buffer;
+            }
+        } else {
+            std::snprintf(buffer, sizeof(buffer), ",\"id\":\"0x%llx\"",
+                          static_cast<unsigned long long>(event.trace_id));
+            *out += buffer;
+        }
+        out->push_back('}');
+    }
+
+    std::mutex mutex_;
+    std::vector<std::shared_ptr<ThreadTrace>> threads_;
+    uint32_t next_tid_ = 1;
+    std::string path_;
+    int64_t origin_ns_ = 0;
+    std::atomic<size_t> event_count_{0};
+    std::atomic<size_t> dropped_{0};
+};
+
+std::atomic<uint64_t> g_next_trace_id{1};
+
+} // namespace
+
+bool StartTracing(const std::string& path) {
+    return TraceLog::Get().Start(path);
+}
+
+bool StopTracing() {
+    return TraceLog::Get().Stop();
+}
+
+uint64_t NewTraceId() {
+    return g_next_trace_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+void SetTraceThreadName(const char* name) {
+    TraceLog::Get().SetThreadName(name);
+}
+
+namespace internal {
+
+void RecordCompleteEvent(const char* category, const char* name, uint64_t trace_id,
+                         int64_t start_ns, int64_t end_ns) {
+    TraceLog::Get().Record({category, name, trace_id, start_ns, end_ns - start_ns, 'X'});
+}
+
+void RecordAsyncEvent(char phase, const char* category, const char* name, uint64_t trace_id) {
+    TraceLog::Get().Record({category, name, trace_id, TraceNowNanoseconds(), 0, phase});
+}
+
+} // namespace internal
+
+} // namespace navigrab
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Build with -DNAVIGRAB_TRACING=0 to compile every span out. When compiled
+// in but not started, a span costs one relaxed atomic load.
+#ifndef NAVIGRAB_TRACING
+#define NAVIGRAB_TRACING 1
+#endif
+
+namespace navigrab {
+
+// Starts recording spans. StopTracing() writes them to |path| as Chrome
+// trace-event JSON, which Perfetto and chrome://tracing open directly.
+bool StartTracing(const std::string& path);
+bool StopTracing();
+
+// Fresh id for correlating the spans of one operation (a hover, a scrape)
+// across threads and callbacks. Never 0; 0 means "not correlated".
+uint64_t NewTraceId();
+
+// Label for the calling thread's track
+void SetTraceThreadName(const char* name);
+
+namespace internal {
+
+extern std::atomic<bool> g_tracing_enabled;
+
+// Category and name must be string literals (they are stored by pointer)
+void RecordCompleteEvent(const char* category, const char* name, uint64_t trace_id,
+                         int64_t start_ns, int64_t end_ns);
+void RecordAsyncEvent(char phase, const char* category, const char* name, uint64_t trace_id);
+int64_t TraceNowNanoseconds();
+
+} // namespace internal
+
+inline bool IsTracingEnabled() {
+    return internal::g_tracing_enabled.load(std::memory_order_relaxed);
+}
+
+// Times the enclosing scope on the current thread's track
+class TraceSpan {
+public:
+    TraceSpan(const char* category, const char* name, uint64_t trace_id = 0)
+        : category_(category), name_(nullptr), trace_id_(trace_id), start_ns_(0) {
+        if (IsTracingEnabled()) {
+            name_ = name;
+            start_ns_ = internal::TraceNowNanoseconds();
+        }
+    }
+    ~TraceSpan() {
+        if (name_) {
+            internal::RecordCompleteEvent(category_, name_, trace_id_, start_ns_,
+                                          internal::TraceNowNanoseconds());
+        }
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* category_;
+    const char* name_;      // Null when tracing was off at construction
+    uint64_t trace_id_;
+    int64_t start_ns_;
+};
+
+// Spans that start and end in different calls or threads. Begin/end pairs with
+// the same category and trace id share one track, nested by time.
+inline void TraceAsyncBegin(const char* category, const char* name, uint64_t trace_id) {
+    if (IsTracingEnabled()) internal::RecordAsyncEvent('b', category, name, trace_id);
+}
+inline void TraceAsyncEnd(const char* category, const char* name, uint64_t trace_id) {
+    if (IsTracingEnabled()) internal::RecordAsyncEvent('e', category, name, trace_id);
+}
+
+} // namespace navigrab
+
+#define NAVIGRAB_TRACE_CONCAT_INNER(a, b) a##b
+#define NAVIGRAB_TRACE_CONCAT(a, b) NAVIGRAB_TRACE_CONCAT_INNER(a, b)
+
+#if NAVIGRAB_TRACING
+// NAVIGRAB_TRACE_SPAN("scraper", "ScrapePage", trace_id);
+#define NAVIGRAB_TRACE_SPAN(category, name, trace_id) \
+    ::navigrab::TraceSpan NAVIGRAB_TRACE_CONCAT(navigrab_trace_span_, __LINE__)(category, name, trace_id)
+#define NAVIGRAB_TRACE_ASYNC_BEGIN(category, name, trace_id) \
+    ::navigrab::TraceAsyncBegin(category, name, trace_id)
+#define NAVIGRAB_TRACE_ASYNC_END(category, name, trace_id) \
+    ::navigrab::TraceAsyncEnd(category, name, trace_id)
+#else
+#define NAVIGRAB_TRACE_SPAN(category, name, trace_id) ((void)0)
+#define NAVIGRAB_TRACE_ASYNC_BEGIN(category, name, trace_id) ((void)0)
+#define NAVIGRAB_TRACE_ASYNC_END(category, name, trace_id) ((void)0)
+#endif
@@ -0,0 +1,359 @@
+// Tests for CapturePipeline: crops and thumbnails match doing the same by
+// hand, every request hears back exactly once whatever happens to it, queues
+// stay within their bounds, and coalescing, the drop policies, Drain() and
+// Shutdown() account for each job. Slow stages are held on a gate rather
+// than timed with sleeps, so the counts do not depend on scheduling.
+
+#include "capture_pipeline.h"
+#include "image_codec.h"
+#include "image_resampler.h"
+#include "test_support.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace navigrab;
+
+namespace {
+
+void Paint(Bitmap* bitmap, int width, int height, int seed) {
+    bitmap->Allocate(width, height);
+    for (int y = 0; y < height; ++y) {
+        for (int x = 0; x < width; ++x) {
+            uint8_t* p = bitmap->Row(y) + x * kBytesPerPixel;
+            p[0] = static_cast<uint8_t>(x * 7 + seed);
+            p[1] = static_cast<uint8_t>(y * 3);
+            p[2] = static_cast<uint8_t>((x ^ y) + seed);
+            p[3] = 255;
+        }
+    }
+}
+
+bool SameRows(const Bitmap& a, const Bitmap& b) {
+    if (a.Width() != b.Width() || a.Height() != b.Height()) return false;
+    for (int y = 0; y < a.Height(); ++y) {
+        if (std::memcmp(a.Row(y), b.Row(y), a.Width() * kBytesPerPixel) != 0) return false;
+    }
+    return true;
+}
+
+// Collects results and counts how each request ended
+class Sink {
+public:
+    // A request whose done callback records into this sink
+    CaptureRequest Request(const std::string& key, dom::Box rect = {0, 0, 0, 0},
+                           int max_width = 0, int max_height = 0) {
+        CaptureRequest request;
+        request.key = key;
+        request.rect = rect;
+        request.max_width = max_width;
+        request.max_height = max_height;
+        size_t index;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            index = calls_.size();
+            calls_.push_back(0);
+        }
+        request.done = [this, index](bool stored) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++calls_[index];
+            (stored ? stored_ : given_up_)++;
+        };
+        return request;
+    }
+
+    bool Store(const CaptureResult& result) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_[result.key] = result;
+        return true;
+    }
+
+    int Stored() const { std::lock_guard<std::mutex> lock(mutex_); return stored_; }
+    int GivenUp() const { std::lock_guard<std::mutex> lock(mutex_); return given_up_; }
+    CaptureResult Result(const std::string& key) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = results_.find(key);
+        return it == results_.end() ? CaptureResult() : it->second;
+    }
+
+    // True when every request made so far heard back exactly once
+    bool EachHeardOnce() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (int calls : calls_) {
+            if (calls != 1) return false;
+        }
+        return true;
+    }
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<int> calls_;
+    std::map<std::string, CaptureResult> results_;
+    int stored_ = 0;
+    int given_up_ = 0;
+};
+
+// Holds capture callbacks until opened, and reports how many are waiting
+class Gate {
+public:
+    FrameCapture Capture(int width = 32, int height = 32) {
+        return [this, width, height](Bitmap* frame) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++entered_;
+            changed_.notify_all();
+            changed_.wait(lock, [this] { return open_; });
+            lock.unlock();
+            Paint(frame, width, height, 0);
+            return true;
+        };
+    }
+    void WaitEntered(int count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [this, count] { return entered_ >= count; });
+    }
+    void Open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        changed_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    int entered_ = 0;
+    bool open_ = false;
+};
+
+void TestCropResizeAndStore() {
+    Sink sink;
+    CapturePipelineOptions options;
+    for (PipelineStageOptions& stage : options.stages) stage.workers = 3;
+    options.store = [&sink](const CaptureResult& result) { return sink.Store(result); };
+    CapturePipeline pipeline(options);
+
+    const int kFrames = 6;
+    const int kElements = 12;
+    for (int f = 0; f < kFrames; ++f) {
+        std::vector<CaptureRequest> requests;
+        std::string prefix = "f" + std::to_string(f);
+        for (int e = 0; e < kElements; ++e) {
+            // Odd elements get a thumbnail bound
+            requests.push_back(sink.Request(prefix + "e" + std::to_string(e), {e * 30, e * 20, 60, 40},
+                                            e % 2 ? 30 : 0, 0));
+        }
+        requests.push_back(sink.Request(prefix + "outside", {5000, 5000, 10, 10}));
+        requests.push_back(sink.Request(prefix + "whole"));
+        CHECK(pipeline.Submit("frame" + prefix,
+                              [f](Bitmap* frame) { Paint(frame, 640, 480, f); return true; },
+                              std::move(requests)));
+    }
+    pipeline.Drain();
+
+    // Elements entirely outside the frame are given up
+    CHECK_EQ(sink.Stored(), kFrames * (kElements + 1));
+    CHECK_EQ(sink.GivenUp(), kFrames);
+    CHECK(sink.EachHeardOnce());
+
+    Bitmap frame;
+    Bitmap expected;
+    Bitmap scaled;
+    Bitmap decoded;
+    for (int f = 0; f < kFrames; ++f) {
+        Paint(&frame, 640, 480, f);
+        for (int e = 0; e < kElements; ++e) {
+            CaptureResult result = sink.Result("f" + std::to_string(f) + "e" + std::to_string(e));
+            CHECK(result.format == ImageFormat::PNG);
+            CHECK(DecodeImage(result.data, &decoded));
+            expected.CopyFrom(frame, e * 30, e * 20, 60, 40);
+            if (e % 2) {
+                ResampleBitmap(expected, 30, 20, &scaled);
+                CHECK(result.width == 30 && result.height == 20);
+                CHECK(SameRows(decoded, scaled));
+            } else {
+                CHECK(result.width == 60 && result.height == 40);
+                CHECK(SameRows(decoded, expected));
+            }
+        }
+        CaptureResult whole = sink.Result("f" + std::to_string(f) + "whole");
+        CHECK(whole.width == 640 && whole.height == 480);
+    }
+
+    PipelineStageStats capture = pipeline.GetStats(PipelineStage::CAPTURE);
+    CHECK_EQ(capture.processed, static_cast<uint64_t>(kFrames));
+    CHECK_EQ(capture.queue_latency.count, static_cast<uint64_t>(kFrames));
+    CHECK_EQ(pipeline.GetStats(PipelineStage::STORE).processed, static_cast<uint64_t>(kFrames * (kElements + 1)));
+    for (size_t i = 0; i < kPipelineStageCount; ++i) {
+        PipelineStageStats stats = pipeline.GetStats(static_cast<PipelineStage>(i));
+        CHECK_EQ(stats.queue_depth, 0u);
+        CHECK_EQ(stats.busy_workers, 0u);
+        CHECK_EQ(stats.dropped, 0u);
+    }
+
+    // A frame captured already skips the capture stage
+    auto shared = std::make_shared<Bitmap>();
+    Paint(shared.get(), 100, 100, 1);
+    CHECK(pipeline.SubmitFrame("shared", shared, {sink.Request("sf", {10, 10, 20, 20})}));
+    pipeline.Drain();
+    CHECK_EQ(sink.Result("sf").width, 20);
+    CHECK_EQ(pipeline.GetStats(PipelineStage::CAPTURE).processed, static_cast<uint64_t>(kFrames));
+
+    int given_up = sink.GivenUp();
+    CHECK(!pipeline.SubmitFrame("none", nullptr, {sink.Request("nf")}));
+    CHECK_EQ(sink.GivenUp(), given_up + 1);
+    CHECK(sink.EachHeardOnce());
+}
+
+// A slow store with tiny blocking queues: nothing is lost and no queue overfills
+void TestBackpressure() {
+    Sink sink;
+    CapturePipelineOptions options;
+    for (PipelineStageOptions& stage : options.stages) stage.queue_capacity = 2;
+    options.store = [](const CaptureResult&) {
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+        return true;
+    };
+    CapturePipeline pipeline(options);
+    for (int f = 0; f < 10; ++f) {
+        std::vector<CaptureRequest> requests;
+        for (int e = 0; e < 5; ++e) requests.push_back(sink.Request("", {e * 10, 0, 10, 10}));
+        CHECK(pipeline.Submit("", [](Bitmap* frame) { Paint(frame, 64, 64, 0); return true; }, std::move(requests)));
+    }
+    pipeline.Drain();
+    CHECK_EQ(sink.Stored(), 50);
+    CHECK(sink.EachHeardOnce());
+    for (size_t i = 0; i < kPipelineStageCount; ++i) {
+        CHECK(pipeline.GetStats(static_cast<PipelineStage>(i)).max_queue_depth <= 2);
+    }
+}
+
+// One capture runs while five more arrive at a queue of two
+void TestDropPolicies() {
+    for (OverflowPolicy policy : {OverflowPolicy::DROP_NEWEST, OverflowPolicy::DROP_OLDEST}) {
+        Sink sink;
+        Gate gate;
+        CapturePipelineOptions options;
+        options.stages[0].queue_capacity = 2;
+        options.stages[0].overflow = policy;
+        options.store = [&sink](const CaptureResult& result) { return sink.Store(result); };
+        CapturePipeline pipeline(options);
+
+        int accepted = pipeline.Submit("f0", gate.Capture(), {sink.Request("k0")});
+        gate.WaitEntered(1);
+        for (int f = 1; f < 6; ++f) {
+            std::string name = std::to_string(f);
+            accepted += pipeline.Submit("f" + name, gate.Capture(), {sink.Request("k" + name)});
+        }
+        gate.Open();
+        pipeline.Drain();
+
+        CHECK_EQ(accepted, policy == OverflowPolicy::DROP_NEWEST ? 3 : 6);
+        CHECK_EQ(pipeline.GetStats(PipelineStage::CAPTURE).dropped, 3u);
+        CHECK_EQ(sink.Stored(), 3);
+        CHECK_EQ(sink.GivenUp(), 3);
+        CHECK(sink.EachHeardOnce());
+        if (policy == OverflowPolicy::DROP_NEWEST) {
+            CHECK(!sink.Result("k2").data.empty());
+            CHECK(sink.Result("k5").data.empty());
+        } else {
+            CHECK(sink.Result("k2").data.empty());
+            CHECK(!sink.Result("k5").data.empty());
+        }
+    }
+}
+
+void TestCoalescing() {
+    Sink sink;
+    Gate gate;
+    CapturePipeline pipeline{CapturePipelineOptions()};
+
+    CHECK(pipeline.Submit("page", gate.Capture(), {sink.Request("el")}));
+    gate.WaitEntered(1);
+    // Each waiting frame is replaced by the next; the running one goes stale
+    for (int f = 1; f < 5; ++f) CHECK(pipeline.Submit("page", gate.Capture(), {sink.Request("el")}));
+    CHECK_EQ(pipeline.GetStats(PipelineStage::CAPTURE).queue_depth, 1u);
+    gate.Open();
+    pipeline.Drain();
+
+    CHECK_EQ(pipeline.GetStats(PipelineStage::CAPTURE).coalesced, 3u);
+    CHECK_EQ(pipeline.GetStats(PipelineStage::CAPTURE).processed, 2u);
+    // The running frame is replaced in the crop queue by the last one, or
+    // found stale when it leaves it, depending on which gets there first
+    PipelineStageStats crop = pipeline.GetStats(PipelineStage::CROP);
+    CHECK_EQ(crop.stale + crop.coalesced, 1u);
+    CHECK_EQ(sink.Stored(), 1);
+    CHECK_EQ(sink.GivenUp(), 4);
+    CHECK(sink.EachHeardOnce());
+
+    // Requests without a key never coalesce
+    Sink unkeyed;
+    Gate second;
+    CapturePipeline plain{CapturePipelineOptions()};
+    for (int f = 0; f < 4; ++f) CHECK(plain.Submit("", second.Capture(), {unkeyed.Request("")}));
+    second.Open();
+    plain.Drain();
+    CHECK_EQ(unkeyed.Stored(), 4);
+    CHECK_EQ(plain.GetStats(PipelineStage::CAPTURE).coalesced, 0u);
+}
+
+void TestShutdown() {
+    Sink sink;
+    Gate gate;
+    CapturePipeline pipeline{CapturePipelineOptions()};
+    for (int f = 0; f < 5; ++f) {
+        CHECK(pipeline.Submit("", gate.Capture(), {sink.Request(""), sink.Request("")}));
+    }
+    gate.WaitEntered(1);
+    // The running capture finishes once Shutdown() is waiting for its worker
+    std::thread opener([&gate] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        gate.Open();
+    });
+    pipeline.Shutdown();
+    opener.join();
+    CHECK_EQ(sink.Stored() + sink.GivenUp(), 10);
+    CHECK(sink.GivenUp() >= 8);     // Everything still queued is given up
+    CHECK(sink.EachHeardOnce());
+
+    CHECK(!pipeline.Submit("", gate.Capture(), {sink.Request("")}));
+    CHECK(!pipeline.SubmitFrame("", std::make_shared<Bitmap>(8, 8), {sink.Request("")}));
+    CHECK_EQ(sink.Stored() + sink.GivenUp(), 12);
+    CHECK(sink.EachHeardOnce());
+    pipeline.Drain();       // Returns at once
+    pipeline.Shutdown();    // And again is harmless
+}
+
+void TestFailures() {
+    Sink sink;
+    CapturePipelineOptions options;
+    options.store = [](const CaptureResult& result) { return result.key != "unstorable"; };
+    CapturePipeline pipeline(options);
+    CHECK(pipeline.Submit("broken", [](Bitmap*) { return false; }, {sink.Request("a"), sink.Request("b")}));
+    CHECK(pipeline.Submit("fine", [](Bitmap* frame) { Paint(frame, 8, 8, 0); return true; },
+                          {sink.Request("unstorable"), sink.Request("stored")}));
+    pipeline.Drain();
+    CHECK_EQ(sink.Stored(), 1);
+    CHECK_EQ(sink.GivenUp(), 3);
+    CHECK(sink.EachHeardOnce());
+    CHECK_EQ(pipeline.GetStats(PipelineStage::CAPTURE).failed, 1u);
+    CHECK_EQ(pipeline.GetStats(PipelineStage::STORE).failed, 1u);
+    CHECK_EQ(std::string(PipelineStageName(PipelineStage::RESIZE)), "resize");
+}
+
+} // namespace
+
+int main() {
+    TestCropResizeAndStore();
+    TestBackpressure();
+    TestDropPolicies();
+    TestCoalescing();
+    TestShutdown();
+    TestFailures();
+    return navigrab::test::Finish("capture_pipeline_test");
+}
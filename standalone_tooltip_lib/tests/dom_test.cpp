@@ -0,0 +1,209 @@
+// Tests for dom::Document: tree shape, attributes and character references,
+// void and raw-text elements, implied end tags, the tag/class/id indexes and
+// the flat-tree invariants every consumer relies on.
+
+#include "dom.h"
+#include "test_support.h"
+
+#include <random>
+#include <string>
+
+using namespace navigrab;
+using dom::Document;
+using dom::NodeId;
+using dom::NodeType;
+using dom::kInvalidNode;
+
+namespace {
+
+// Checks the invariants documented on dom::Node for every node of |doc|.
+void CheckTreeInvariants(const Document& doc) {
+    CHECK(doc.Size() >= 1);
+    CHECK(doc.GetNode(doc.Root()).type == NodeType::DOCUMENT);
+    CHECK_EQ(doc.GetNode(doc.Root()).subtree_end, doc.Size());
+    for (NodeId id = 1; id < doc.Size(); ++id) {
+        const dom::Node& node = doc.GetNode(id);
+        CHECK(node.parent < id);
+        const dom::Node& parent = doc.GetNode(node.parent);
+        CHECK(id < parent.subtree_end);
+        CHECK(node.subtree_end > id && node.subtree_end <= parent.subtree_end);
+        CHECK_EQ(node.depth, parent.depth + 1);
+        if (node.type == NodeType::TEXT) CHECK_EQ(node.subtree_end, id + 1);
+
+        // Children are linked in order and cover the subtree exactly.
+        NodeId expected = id + 1;
+        uint32_t element_index = 0;
+        for (NodeId child = node.first_child; child != kInvalidNode;
+             child = doc.GetNode(child).next_sibling) {
+            CHECK_EQ(child, expected);
+            CHECK_EQ(doc.GetNode(child).parent, id);
+            if (doc.IsElement(child)) CHECK_EQ(doc.GetNode(child).element_index, ++element_index);
+            expected = doc.GetNode(child).subtree_end;
+        }
+        CHECK_EQ(expected, node.subtree_end);
+    }
+
+    // Every element is in its tag index, and the indexes are sorted.
+    for (NodeId id = 1; id < doc.Size(); ++id) {
+        if (!doc.IsElement(id)) continue;
+        const dom::NodeList& list = doc.ElementsByTag(doc.TagName(id));
+        bool found = false;
+        for (size_t i = 0; i < list.size(); ++i) {
+            if (i > 0) CHECK(list[i - 1] < list[i]);
+            found |= list[i] == id;
+        }
+        CHECK(found);
+    }
+}
+
+void TestStructure() {
+    Document doc;
+    doc.Load("<html><head><title>Sample &amp; Title</title></head>"
+             "<body><div id='main' class='a b'><p>one<p>two</div>"
+             "<ul><li>x<li>y</ul></body></html>");
+    CheckTreeInvariants(doc);
+    CHECK_EQ(doc.Title(), "Sample & Title");
+
+    const dom::NodeList& divs = doc.ElementsByTag("div");
+    CHECK_EQ(divs.size(), 1u);
+    NodeId div = divs[0];
+    CHECK_EQ(doc.GetId(div), "main");
+    CHECK(doc.HasClass(div, "a"));
+    CHECK(doc.HasClass(div, "b"));
+    CHECK(!doc.HasClass(div, "ab"));
+    CHECK_EQ(doc.ElementsById("main").size(), 1u);
+    CHECK_EQ(doc.ElementsByClass("b").size(), 1u);
+    CHECK(doc.ElementsByClass("missing").empty());
+
+    // <p> closes the open <p>; </div> closes the last one
+    const dom::NodeList& paragraphs = doc.ElementsByTag("p");
+    CHECK_EQ(paragraphs.size(), 2u);
+    for (NodeId p : paragraphs) CHECK_EQ(doc.GetNode(p).parent, div);
+    CHECK_EQ(doc.TextContent(div), "one two");
+
+    const dom::NodeList& items = doc.ElementsByTag("li");
+    CHECK_EQ(items.size(), 2u);
+    CHECK_EQ(doc.GetNode(items[0]).parent, doc.GetNode(items[1]).parent);
+    CHECK_EQ(doc.GetNode(items[1]).element_index, 2u);
+
+    CHECK_EQ(doc.BuildSelector(div), "div#main");
+    CHECK_EQ(doc.BuildSelector(paragraphs[1]), "div#main > p:nth-child(2)");
+}
+
+void TestAttributesAndReferences() {
+    Document doc;
+    doc.Load("<DIV Class='a  b a' data-x=\"1 &amp; 2\" hidden>Hi &lt;there&gt; &#x1F600; &#65;</DIV>");
+    CheckTreeInvariants(doc);
+    NodeId div = doc.ElementsByTag("div").empty() ? kInvalidNode : doc.ElementsByTag("div")[0];
+    CHECK(div != kInvalidNode);
+    if (div == kInvalidNode) return;
+    CHECK_EQ(doc.TagName(div), "div");
+    CHECK_EQ(doc.GetAttribute(div, "data-x"), "1 & 2");
+    CHECK_EQ(doc.GetAttribute(div, "class"), "a  b a");
+    CHECK(doc.HasAttribute(div, "hidden"));
+    CHECK(!doc.HasAttribute(div, "title"));
+    CHECK_EQ(doc.GetAttribute(div, "title"), "");
+    // class="a b a" lists the element once
+    CHECK_EQ(doc.ElementsByClass("a").size(), 1u);
+    CHECK_EQ(doc.TextContent(div), "Hi <there> \xF0\x9F\x98\x80 A");
+    CHECK(doc.IsValidUtf8());
+}
+
+void TestVoidAndRawText() {
+    Document doc;
+    doc.Load("<div><br><img src=a.png><input/>after</div>"
+             "<script>if (a<b && c>d) { x = '</div>'; }</script>"
+             "<style>p > a { color: red }</style><span>tail</span>");
+    CheckTreeInvariants(doc);
+    for (const char* tag : {"br", "img", "input"}) {
+        const dom::NodeList& list = doc.ElementsByTag(tag);
+        CHECK_EQ(list.size(), 1u);
+        if (list.empty()) continue;
+        CHECK_EQ(doc.GetNode(list[0]).first_child, kInvalidNode);
+        CHECK_EQ(doc.TagName(doc.GetNode(list[0]).parent), "div");
+    }
+
+    // Raw text keeps its markup-looking content as one text node
+    const dom::NodeList& scripts = doc.ElementsByTag("script");
+    CHECK_EQ(scripts.size(), 1u);
+    if (!scripts.empty()) {
+        NodeId text = doc.GetNode(scripts[0]).first_child;
+        CHECK(text != kInvalidNode);
+        if (text != kInvalidNode) {
+            CHECK(doc.GetNode(text).type == NodeType::TEXT);
+            CHECK_EQ(doc.GetNode(text).name, "if (a<b && c>d) { x = '</div>'; }");
+        }
+        CHECK(!doc.IsRendered(scripts[0]));
+    }
+    CHECK_EQ(doc.ElementsByTag("span").size(), 1u);
+    CHECK(doc.ElementsByTag("a").empty());
+
+    CHECK(dom::IsVoidElement("br"));
+    CHECK(!dom::IsVoidElement("div"));
+    CHECK(dom::IsRawTextElement("script"));
+    CHECK(!dom::IsRawTextElement("p"));
+}
+
+void TestUnmatchedAndReload() {
+    Document doc;
+    doc.Load("</b><div><span>a</div>b</span></i>");
+    CheckTreeInvariants(doc);
+    CHECK_EQ(doc.ElementsByTag("div").size(), 1u);
+    CHECK_EQ(doc.TextContent(doc.Root()), "a b");
+
+    doc.Load("<p>fresh</p>");
+    CheckTreeInvariants(doc);
+    CHECK(doc.ElementsByTag("div").empty());
+    CHECK_EQ(doc.ElementsByTag("p").size(), 1u);
+
+    doc.Load("");
+    CHECK(doc.IsEmpty());
+    CHECK_EQ(doc.Title(), "");
+
+    doc.Load("<p>bad \xC3\x28 byte</p>");
+    CHECK(!doc.IsValidUtf8());
+    CheckTreeInvariants(doc);
+}
+
+void TestLayout() {
+    Document doc;
+    doc.Load("<div>one</div><div>two</div><div style='display:none'>x</div>", 800);
+    CHECK_EQ(doc.ViewportWidth(), 800);
+    const dom::NodeList& divs = doc.ElementsByTag("div");
+    CHECK_EQ(divs.size(), 3u);
+    if (divs.size() < 2) return;
+    CHECK(doc.IsRendered(divs[0]));
+    CHECK(doc.GetBox(divs[0]).y < doc.GetBox(divs[1]).y);
+    CHECK(doc.PageHeight() >= doc.GetBox(divs[1]).y + doc.GetBox(divs[1]).height);
+}
+
+// Random tag soup must always produce a well-formed tree.
+void TestRandomMarkup() {
+    static const char* const kPieces[] = {
+        "<div>", "</div>", "<p>", "</p>", "<li>", "<ul>", "</ul>", "<br>", "<img src=x>",
+        "<span class='a b'>", "</span>", "<td>", "<tr>", "<table>", "</table>", "text",
+        " ", "&amp;", "&bogus;", "<", ">", "</", "<script>x<y</script>", "<!-- c -->",
+        "<a href=\"/x\">", "</a>", "<title>t</title>", "\xFF", "<option>", "<dt>", "<dd>"};
+    std::mt19937 rng(1234);
+    std::uniform_int_distribution<size_t> piece(0, sizeof(kPieces) / sizeof(kPieces[0]) - 1);
+    Document doc;
+    for (int round = 0; round < 200; ++round) {
+        std::string html;
+        int count = static_cast<int>(rng() % 200);
+        for (int i = 0; i < count; ++i) html += kPieces[piece(rng)];
+        doc.Load(html);
+        CheckTreeInvariants(doc);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestStructure();
+    TestAttributesAndReferences();
+    TestVoidAndRawText();
+    TestUnmatchedAndReload();
+    TestLayout();
+    TestRandomMarkup();
+    return navigrab::test::Finish("dom_test");
+}
@@ -0,0 +1,212 @@
+// Tests for the two-stage HTML tokenizer: the structural index must be the
+// same at every SIMD level and match a byte-by-byte scan, and the token
+// stream must follow the documented rules for tags, attributes, raw text
+// and character references.
+
+#include "html_tokenizer.h"
+#include "test_support.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace navigrab;
+using namespace navigrab::html;
+
+namespace {
+
+const SimdLevel kLevels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+
+std::vector<uint32_t> ReferencePositions(std::string_view input) {
+    std::vector<uint32_t> positions;
+    for (size_t i = 0; i < input.size(); ++i) {
+        char c = input[i];
+        if (c == '<' || c == '>' || c == '&' || c == '"' || c == '\'' || c == '=') {
+            positions.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    return positions;
+}
+
+// Strict UTF-8: no overlong forms, surrogates or code points past U+10FFFF
+bool ReferenceValidUtf8(std::string_view input) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(input.data());
+    size_t n = input.size();
+    for (size_t i = 0; i < n;) {
+        unsigned char c = p[i];
+        size_t length;
+        uint32_t min;
+        uint32_t cp;
+        if (c < 0x80) {
+            ++i;
+            continue;
+        } else if ((c & 0xE0) == 0xC0) {
+            length = 2, min = 0x80, cp = c & 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            length = 3, min = 0x800, cp = c & 0x0F;
+        } else if ((c & 0xF8) == 0xF0) {
+            length = 4, min = 0x10000, cp = c & 0x07;
+        } else {
+            return false;
+        }
+        if (i + length > n) return false;
+        for (size_t k = 1; k < length; ++k) {
+            if ((p[i + k] & 0xC0) != 0x80) return false;
+            cp = cp << 6 | (p[i + k] & 0x3F);
+        }
+        if (cp < min || cp > 0x10FFFF || (cp >= 0xD800 && cp <= 0xDFFF)) return false;
+        i += length;
+    }
+    return true;
+}
+
+void CheckIndex(std::string_view input) {
+    std::vector<uint32_t> expected = ReferencePositions(input);
+    bool valid = ReferenceValidUtf8(input);
+    StructuralIndex scalar;
+    CHECK(BuildStructuralIndex(input, &scalar, SimdLevel::SCALAR));
+    CHECK(scalar.positions == expected);
+    CHECK_EQ(scalar.IsValidUtf8(), valid);
+    for (SimdLevel level : kLevels) {
+        StructuralIndex index;
+        index.positions.assign(3, 7);   // Stale contents must be replaced
+        CHECK(BuildStructuralIndex(input, &index, level));
+        CHECK(index.positions == scalar.positions);
+        CHECK_EQ(index.utf8_error, scalar.utf8_error);
+    }
+}
+
+void TestStructuralIndex() {
+    CheckIndex("");
+    CheckIndex("<");
+    CheckIndex("<a href=\"x\" title='y'>&amp;</a>");
+    CheckIndex("caf\xC3\xA9 \xE2\x82\xAC \xF0\x9F\x98\x80");
+    CheckIndex("bad \xC3\x28");
+    CheckIndex("overlong \xC0\xAF");
+    CheckIndex("surrogate \xED\xA0\x80");
+    CheckIndex("truncated \xE2\x82");
+
+    // Every length around the 64-byte block and batch boundaries, with
+    // structural characters and multi-byte sequences straddling them.
+    std::mt19937 rng(42);
+    static const char kAlphabet[] = "<>&\"'= abcxyz\n\t/!-";
+    for (size_t length = 0; length < 600; ++length) {
+        std::string input;
+        for (size_t i = 0; i < length; ++i) {
+            uint32_t roll = rng() % 100;
+            if (roll < 85) {
+                input += kAlphabet[rng() % (sizeof(kAlphabet) - 1)];
+            } else if (roll < 95) {
+                input += "\xC3\xA9";
+            } else if (roll < 99) {
+                input += "\xF0\x9F\x98\x80";
+            } else {
+                input += static_cast<char>(0x80 | rng() % 0x80);
+            }
+        }
+        CheckIndex(input);
+    }
+    for (int round = 0; round < 200; ++round) {
+        std::string input(rng() % 2000, '\0');
+        for (char& c : input) c = static_cast<char>(rng());
+        CheckIndex(input);
+    }
+}
+
+struct SimpleToken {
+    TokenType type;
+    std::string name;
+    std::string text;
+    std::vector<std::pair<std::string, std::string>> attributes;
+    bool self_closing;
+};
+
+std::vector<SimpleToken> Tokenize(std::string html) {
+    StructuralIndex index;
+    BuildStructuralIndex(html, &index);
+    std::vector<Attribute> attributes;
+    Tokenizer tokenizer(&html[0], html.size(), index, &attributes);
+    std::vector<SimpleToken> tokens;
+    Token token;
+    while (tokenizer.Next(&token)) {
+        SimpleToken simple{token.type, std::string(token.name), std::string(token.text), {}, token.self_closing};
+        if (token.type == TokenType::START_TAG) {
+            for (uint32_t i = 0; i < token.attribute_count; ++i) {
+                const Attribute& attribute = attributes[token.first_attribute + i];
+                simple.attributes.emplace_back(std::string(attribute.name), std::string(attribute.value));
+            }
+        }
+        tokens.push_back(std::move(simple));
+    }
+    return tokens;
+}
+
+void TestTokens() {
+    std::vector<SimpleToken> tokens = Tokenize(
+        "<!DOCTYPE html><!-- skipped --><DIV ID=main Class=\"a b\" data-v='1 &lt; 2' hidden>"
+        "x &amp; y</DIV><br/><script>if (a<b) {}</script>");
+    CHECK_EQ(tokens.size(), 7u);
+    if (tokens.size() != 7) return;
+
+    CHECK(tokens[0].type == TokenType::START_TAG);
+    CHECK_EQ(tokens[0].name, "div");
+    CHECK_EQ(tokens[0].attributes.size(), 4u);
+    if (tokens[0].attributes.size() == 4) {
+        CHECK_EQ(tokens[0].attributes[0].first, "id");
+        CHECK_EQ(tokens[0].attributes[0].second, "main");
+        CHECK_EQ(tokens[0].attributes[1].first, "class");
+        CHECK_EQ(tokens[0].attributes[1].second, "a b");
+        CHECK_EQ(tokens[0].attributes[2].second, "1 < 2");
+        CHECK_EQ(tokens[0].attributes[3].first, "hidden");
+        CHECK_EQ(tokens[0].attributes[3].second, "");
+    }
+
+    CHECK(tokens[1].type == TokenType::TEXT);
+    CHECK_EQ(tokens[1].text, "x & y");
+    CHECK(tokens[2].type == TokenType::END_TAG);
+    CHECK_EQ(tokens[2].name, "div");
+    CHECK_EQ(tokens[3].name, "br");
+    CHECK(tokens[3].self_closing);
+
+    // Raw text comes back undecoded as one token, then its end tag
+    CHECK_EQ(tokens[4].name, "script");
+    CHECK(tokens[5].type == TokenType::TEXT);
+    CHECK_EQ(tokens[5].text, "if (a<b) {}");
+    CHECK(tokens[6].type == TokenType::END_TAG);
+    CHECK_EQ(tokens[6].name, "script");
+
+    // Tag soup never crashes the tokenizer, and start tags always have a name
+    std::mt19937 rng(7);
+    for (int round = 0; round < 300; ++round) {
+        std::string html(rng() % 500, '\0');
+        static const char kSoup[] = "<>&\"'=/! abscriptl;#x0";
+        for (char& c : html) c = kSoup[rng() % (sizeof(kSoup) - 1)];
+        for (const SimpleToken& token : Tokenize(html)) {
+            CHECK(token.type != TokenType::START_TAG || !token.name.empty());
+        }
+    }
+}
+
+std::string Decode(std::string text) {
+    text.resize(DecodeCharacterReferences(&text[0], text.size()));
+    return text;
+}
+
+void TestCharacterReferences() {
+    CHECK_EQ(Decode("a &amp; b"), "a & b");
+    CHECK_EQ(Decode("&lt;&gt;&quot;&apos;&nbsp;"), "<>\"'\xC2\xA0");
+    CHECK_EQ(Decode("&#65;&#x42;&#X43;"), "ABC");
+    CHECK_EQ(Decode("&#x1F600;"), "\xF0\x9F\x98\x80");
+    CHECK_EQ(Decode("&unknown; & &amp"), "&unknown; & &amp");
+    CHECK_EQ(Decode("no references"), "no references");
+    CHECK_EQ(Decode(""), "");
+}
+
+} // namespace
+
+int main() {
+    TestStructuralIndex();
+    TestTokens();
+    TestCharacterReferences();
+    return navigrab::test::Finish("html_tokenizer_test");
+}
@@ -0,0 +1,306 @@
+// Tests for the deflate, PNG and QOI codecs: checksums, zlib round trips at
+// every level, streams produced by zlib itself, and images that decode back
+// to the source pixels, with identical PNG bytes for every SIMD level and
+// thread count, one-shot or streamed in strips.
+
+#include "bitmap.h"
+#include "deflate.h"
+#include "image_codec.h"
+#include "test_support.h"
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using namespace navigrab;
+
+namespace {
+
+const SimdLevel kLevels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+
+// Screenshot-like content: flat background, bars, glyph-like strokes, a
+// gradient and a noisy patch with partial alpha.
+void Synthesize(Bitmap* bitmap, int width, int height, PixelFormat format, uint32_t seed) {
+    bitmap->Allocate(width, height, format);
+    std::mt19937 rng(seed);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = bitmap->Row(y);
+        for (int x = 0; x < width; ++x) {
+            uint8_t* p = row + x * kBytesPerPixel;
+            p[0] = 250, p[1] = 250, p[2] = 252, p[3] = 255;
+            if ((y / 40) % 5 == 1 && x > 20 && x < width - 20) p[0] = 30, p[1] = 90, p[2] = 200;
+            if (y % 40 > 10 && y % 40 < 24 && (x * 7 + y * 3) % 11 < 3) p[0] = p[1] = p[2] = 20;
+            if (y > height / 2 && x < width / 3) {
+                p[0] = static_cast<uint8_t>(x), p[1] = static_cast<uint8_t>(y), p[2] = static_cast<uint8_t>(x + y);
+            }
+            if (y > height * 3 / 4 && x > width * 2 / 3) {
+                p[0] = static_cast<uint8_t>(rng()), p[1] = static_cast<uint8_t>(rng());
+                p[2] = static_cast<uint8_t>(rng()), p[3] = static_cast<uint8_t>(200 + rng() % 56);
+            }
+        }
+    }
+}
+
+// |decoded| is RGBA; |source| may be either channel order
+bool SamePixels(const Bitmap& source, const Bitmap& decoded) {
+    if (source.Width() != decoded.Width() || source.Height() != decoded.Height()) return false;
+    if (decoded.Format() != PixelFormat::RGBA_8888) return false;
+    bool bgra = source.Format() == PixelFormat::BGRA_8888;
+    for (int y = 0; y < source.Height(); ++y) {
+        const uint8_t* p = source.Row(y);
+        const uint8_t* q = decoded.Row(y);
+        for (int x = 0; x < source.Width(); ++x, p += kBytesPerPixel, q += kBytesPerPixel) {
+            if (q[0] != p[bgra ? 2 : 0] || q[1] != p[1] || q[2] != p[bgra ? 0 : 2] || q[3] != p[3]) return false;
+        }
+    }
+    return true;
+}
+
+void TestChecksums() {
+    CHECK_EQ(Crc32(0, reinterpret_cast<const uint8_t*>("123456789"), 9), 0xCBF43926u);
+    CHECK_EQ(Adler32(1, reinterpret_cast<const uint8_t*>("Wikipedia"), 9), 0x11E60398u);
+
+    std::mt19937 rng(1);
+    std::vector<uint8_t> data(300000);
+    for (uint8_t& v : data) v = static_cast<uint8_t>(rng());
+    for (size_t split : {size_t(0), size_t(1), size_t(5552), size_t(123457), data.size()}) {
+        size_t rest = data.size() - split;
+        uint32_t a = Adler32(1, data.data(), split);
+        uint32_t b = Adler32(1, data.data() + split, rest);
+        CHECK_EQ(Adler32Combine(a, b, rest), Adler32(1, data.data(), data.size()));
+        CHECK_EQ(Crc32(Crc32(0, data.data(), split), data.data() + split, rest), Crc32(0, data.data(), data.size()));
+    }
+}
+
+void TestZlib() {
+    // A stream written by zlib itself (level 9, with matches)
+    const uint8_t kZlibStream[] = {
+        0x78, 0xDA, 0xCB, 0x48, 0xCD, 0xC9, 0xC9, 0x57, 0xC8, 0x40, 0x27, 0x75, 0x14,
+        0xF2, 0x12, 0xCB, 0x32, 0xD3, 0x8B, 0x12, 0x93, 0x00, 0xD0, 0xC3, 0x0C, 0x47};
+    const char kText[] = "hello hello hello hello, navigrab";
+    std::vector<uint8_t> out;
+    CHECK(ZlibDecompress(kZlibStream, sizeof(kZlibStream), 1000, &out));
+    CHECK(out == std::vector<uint8_t>(kText, kText + sizeof(kText) - 1));
+    CHECK(!ZlibDecompress(kZlibStream, sizeof(kZlibStream), 10, &out));
+    CHECK(!ZlibDecompress(kZlibStream, sizeof(kZlibStream) - 4, 1000, &out));
+
+    // Sizes around the parallel chunking, every level, one and several threads
+    std::mt19937 rng(2);
+    std::vector<uint8_t> input, compressed, single, back;
+    for (size_t size : {size_t(0), size_t(1), size_t(4), size_t(100), size_t(70000),
+                        kParallelDeflateBytes + 17, 3 * kParallelDeflateBytes}) {
+        input.resize(size);
+        for (size_t i = 0; i < size; ++i) {
+            input[i] = (i / 1000) % 3 == 0 ? static_cast<uint8_t>(rng())
+                     : (i / 7000) % 2    ? static_cast<uint8_t>(i % 13) : 0;
+        }
+        for (int level = 0; level <= 9; ++level) {
+            single.clear();
+            ZlibCompress(input.data(), size, {level, 1}, &single);
+            CHECK(ZlibDecompress(single.data(), single.size(), size, &back) && back == input);
+            compressed.clear();
+            ZlibCompress(input.data(), size, {level, 3}, &compressed);
+            CHECK(compressed == single);
+        }
+    }
+
+    // A stream written in pieces inflates to the whole input
+    input.resize(200000);
+    for (size_t i = 0; i < input.size(); ++i) input[i] = static_cast<uint8_t>((i * i) >> 9);
+    for (int level : {0, 1, 6, 9}) {
+        ZlibStream stream({level, 2});
+        compressed.clear();
+        size_t offset = 0;
+        for (size_t piece : {size_t(1), size_t(40000), size_t(0), size_t(100000)}) {
+            stream.Write(input.data() + offset, piece, false, &compressed);
+            offset += piece;
+        }
+        stream.Write(input.data() + offset, input.size() - offset, true, &compressed);
+        CHECK(ZlibDecompress(compressed.data(), compressed.size(), input.size(), &back) && back == input);
+    }
+}
+
+void TestPngRoundTrip() {
+    Bitmap source;
+    Bitmap decoded;
+    std::vector<uint8_t> png;
+    std::vector<uint8_t> reference;
+    const std::pair<int, int> kSizes[] = {{1, 1}, {2, 3}, {5, 7}, {17, 9}, {300, 200}, {640, 1100}};
+    for (const std::pair<int, int>& size : kSizes) {
+        for (PixelFormat format : {PixelFormat::RGBA_8888, PixelFormat::BGRA_8888}) {
+            Synthesize(&source, size.first, size.second, format, size.first * 31 + size.second);
+            for (int level : {0, 1, 3, 4, 6, 9}) {
+                reference.clear();
+                for (SimdLevel simd : kLevels) {
+                    for (int threads : {1, 4}) {
+                        EncodeOptions options;
+                        options.compression_level = level;
+                        options.max_threads = threads;
+                        options.simd = simd;
+                        CHECK(EncodePng(source, &png, options));
+                        if (reference.empty()) {
+                            reference = png;
+                            CHECK(DetectImageFormat(png.data(), png.size()) == ImageFormat::PNG);
+                            CHECK(DecodeImage(png, &decoded) && SamePixels(source, decoded));
+                        } else {
+                            CHECK(png == reference);
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    Bitmap empty;
+    CHECK(!EncodePng(empty, &png));
+    CHECK(!DecodeImage(reference.data(), reference.size() / 2, &decoded));
+    CHECK(!DecodeImage(nullptr, 0, &decoded));
+}
+
+// Files written by another encoder, in the color types ours never writes
+void TestForeignPng() {
+    const uint8_t kRgb2x2[] = {
+        0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+        0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x08, 0x02, 0x00, 0x00, 0x00, 0xFD, 0xD4, 0x9A,
+        0x73, 0x00, 0x00, 0x00, 0x13, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9C, 0x63, 0xF8, 0xCF, 0xC0, 0xC0,
+        0x00, 0xC2, 0x0C, 0xFF, 0xB9, 0x44, 0xE4, 0x00, 0x1A, 0x58, 0x03, 0x3A, 0x56, 0x63, 0xA2, 0x3C,
+        0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82};
+    const uint8_t kGrayAlpha2x1[] = {
+        0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x48, 0x44, 0x52,
+        0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x01, 0x08, 0x04, 0x00, 0x00, 0x00, 0x5E, 0x2B, 0xB7,
+        0x01, 0x00, 0x00, 0x00, 0x0D, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9C, 0x63, 0x48, 0x39, 0xC1, 0xCE,
+        0x00, 0x00, 0x03, 0xFB, 0x01, 0x34, 0xB4, 0xB9, 0xBA, 0x3E, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+        0x4E, 0x44, 0xAE, 0x42, 0x60, 0x82};
+
+    Bitmap decoded;
+    CHECK(DecodeImage(kRgb2x2, sizeof(kRgb2x2), &decoded));
+    if (decoded.Width() == 2 && decoded.Height() == 2) {
+        const uint8_t kTop[] = {255, 0, 0, 255, 0, 255, 0, 255};
+        const uint8_t kBottom[] = {0, 0, 255, 255, 10, 20, 30, 255};
+        CHECK(std::memcmp(decoded.Row(0), kTop, sizeof(kTop)) == 0);
+        CHECK(std::memcmp(decoded.Row(1), kBottom, sizeof(kBottom)) == 0);
+    } else {
+        CHECK(false);
+    }
+
+    CHECK(DecodeImage(kGrayAlpha2x1, sizeof(kGrayAlpha2x1), &decoded));
+    if (decoded.Width() == 2 && decoded.Height() == 1) {
+        const uint8_t kRow[] = {100, 100, 100, 200, 7, 7, 7, 0};
+        CHECK(std::memcmp(decoded.Row(0), kRow, sizeof(kRow)) == 0);
+    } else {
+        CHECK(false);
+    }
+}
+
+void TestQoiRoundTrip() {
+    Bitmap source;
+    Bitmap decoded;
+    std::vector<uint8_t> qoi;
+    std::vector<uint8_t> generic;
+    const std::pair<int, int> kSizes[] = {{1, 1}, {3, 2}, {64, 64}, {301, 203}, {1280, 720}};
+    for (const std::pair<int, int>& size : kSizes) {
+        for (PixelFormat format : {PixelFormat::RGBA_8888, PixelFormat::BGRA_8888}) {
+            Synthesize(&source, size.first, size.second, format, size.first + size.second);
+            CHECK(EncodeQoi(source, &qoi));
+            CHECK(DetectImageFormat(qoi.data(), qoi.size()) == ImageFormat::QOI);
+            CHECK(DecodeImage(qoi, &decoded) && SamePixels(source, decoded));
+            CHECK(EncodeImage(source, ImageFormat::QOI, &generic));
+            CHECK(generic == qoi);
+        }
+    }
+
+    // Long runs past the 62-pixel run limit, and every index slot
+    source.Allocate(500, 3);
+    for (int y = 0; y < 3; ++y) {
+        for (int x = 0; x < 500; ++x) {
+            uint8_t* p = source.Row(y) + x * kBytesPerPixel;
+            uint8_t v = y == 1 ? static_cast<uint8_t>(x % 70) : 0;
+            p[0] = v, p[1] = static_cast<uint8_t>(v * 3), p[2] = 9, p[3] = y == 2 ? 128 : 255;
+        }
+    }
+    CHECK(EncodeQoi(source, &qoi));
+    CHECK(DecodeImage(qoi, &decoded) && SamePixels(source, decoded));
+
+    // A 3-channel file from another encoder: QOI_OP_RGB, then a run of one
+    const uint8_t kQoi2x1[] = {
+        'q', 'o', 'i', 'f', 0, 0, 0, 2, 0, 0, 0, 1, 3, 0,
+        0xFE, 10, 20, 30, 0xC0,
+        0, 0, 0, 0, 0, 0, 0, 1};
+    CHECK(DecodeImage(kQoi2x1, sizeof(kQoi2x1), &decoded));
+    const uint8_t kRow[] = {10, 20, 30, 255, 10, 20, 30, 255};
+    CHECK(decoded.Width() == 2 && decoded.Height() == 1 && std::memcmp(decoded.Row(0), kRow, sizeof(kRow)) == 0);
+    CHECK(!DecodeImage(kQoi2x1, sizeof(kQoi2x1) - 9, &decoded));
+
+    Bitmap empty;
+    CHECK(!EncodeQoi(empty, &qoi));
+    CHECK(ParseImageFormat("qoi") == ImageFormat::QOI);
+    CHECK_EQ(std::string(ImageFormatName(ImageFormat::QOI)), "qoi");
+}
+
+// Encodes |source| through StreamingImageEncoder in strips of |strip_rows|
+bool EncodeStreamed(const Bitmap& source, ImageFormat format, int strip_rows,
+                    const EncodeOptions& options, std::vector<uint8_t>* out) {
+    out->clear();
+    StreamingImageEncoder encoder;
+    auto sink = [out](const uint8_t* data, size_t size) {
+        out->insert(out->end(), data, data + size);
+        return true;
+    };
+    if (!encoder.Begin(format, source.Width(), source.Height(), strip_rows, options, sink)) return false;
+    Bitmap strip;
+    for (int y = 0; y < source.Height(); y += strip_rows) {
+        int rows = std::min(strip_rows, source.Height() - y);
+        if (!strip.CopyFrom(source, 0, y, source.Width(), rows, source.Format()) || !encoder.AddRows(strip)) {
+            return false;
+        }
+    }
+    return encoder.Finish();
+}
+
+void TestStreaming() {
+    Bitmap source;
+    Bitmap decoded;
+    std::vector<uint8_t> png;
+    Synthesize(&source, 333, 250, PixelFormat::BGRA_8888, 5);
+    for (int strip_rows : {1, 16, 64, 250}) {
+        for (int level : {0, 1, 6}) {
+            EncodeOptions options;
+            options.compression_level = level;
+            CHECK(EncodeStreamed(source, ImageFormat::PNG, strip_rows, options, &png));
+            CHECK(DecodeImage(png, &decoded) && SamePixels(source, decoded));
+        }
+    }
+
+    // QOI carries its run and index across strips, so the bytes match
+    std::vector<uint8_t> qoi;
+    std::vector<uint8_t> streamed;
+    CHECK(EncodeQoi(source, &qoi));
+    for (int strip_rows : {1, 7, 250}) {
+        CHECK(EncodeStreamed(source, ImageFormat::QOI, strip_rows, EncodeOptions(), &streamed));
+        CHECK(streamed == qoi);
+    }
+
+    // A sink that gives up abandons the image
+    Bitmap strip;
+    Synthesize(&strip, 10, 5, PixelFormat::RGBA_8888, 6);
+    StreamingImageEncoder encoder;
+    bool finished = encoder.Begin(ImageFormat::PNG, 10, 10, 5, EncodeOptions(),
+                                  [](const uint8_t*, size_t) { return false; }) &&
+                    encoder.AddRows(strip) && encoder.AddRows(strip) && encoder.Finish();
+    CHECK(!finished);
+}
+
+} // namespace
+
+int main() {
+    TestChecksums();
+    TestZlib();
+    TestPngRoundTrip();
+    TestForeignPng();
+    TestQoiRoundTrip();
+    TestStreaming();
+    return navigrab::test::Finish("image_codec_test");
+}
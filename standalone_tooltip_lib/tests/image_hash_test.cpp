@@ -0,0 +1,131 @@
+// Tests for DifferenceHash and HammingDistance: known hashes for flat and
+// graded images, channel order, and re-renders at another size or with a
+// stray pixel hashing within a few bits of the original.
+
+#include "bitmap.h"
+#include "image_hash.h"
+#include "image_resampler.h"
+#include "test_support.h"
+
+#include <random>
+
+using namespace navigrab;
+
+namespace {
+
+// Luma rising left to right by |step| per pixel (falling when negative)
+void HorizontalRamp(Bitmap* bitmap, int width, int height, int step) {
+    bitmap->Allocate(width, height);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* p = bitmap->Row(y);
+        for (int x = 0; x < width; ++x, p += kBytesPerPixel) {
+            uint8_t value = static_cast<uint8_t>(step > 0 ? x * step : 255 + x * step);
+            p[0] = p[1] = p[2] = value;
+            p[3] = 255;
+        }
+    }
+}
+
+// 9x8 blocks of random gray, |block| pixels on a side
+void Blocks(Bitmap* bitmap, int block, uint32_t seed) {
+    std::mt19937 rng(seed);
+    uint8_t grays[8][9];
+    for (auto& row : grays) {
+        for (uint8_t& gray : row) gray = static_cast<uint8_t>(rng() % 256);
+    }
+    bitmap->Allocate(9 * block, 8 * block);
+    for (int y = 0; y < bitmap->Height(); ++y) {
+        uint8_t* p = bitmap->Row(y);
+        for (int x = 0; x < bitmap->Width(); ++x, p += kBytesPerPixel) {
+            p[0] = p[1] = p[2] = grays[y / block][x / block];
+            p[3] = 255;
+        }
+    }
+}
+
+void TestHammingDistance() {
+    CHECK_EQ(HammingDistance(0, 0), 0);
+    CHECK_EQ(HammingDistance(0, ~0ull), 64);
+    CHECK_EQ(HammingDistance(0xB, 0x1), 2);
+    CHECK_EQ(HammingDistance(0x8000000000000000ull, 1), 2);
+    CHECK_EQ(HammingDistance(0x123456789ABCDEF0ull, 0x123456789ABCDEF0ull), 0);
+}
+
+void TestKnownHashes() {
+    Bitmap bitmap;
+    CHECK_EQ(DifferenceHash(bitmap), 0u);
+
+    bitmap.Allocate(50, 30);
+    bitmap.Fill(0x336699FF);
+    CHECK_EQ(DifferenceHash(bitmap), 0u);
+
+    // Every cell brighter than its left neighbour sets every bit
+    HorizontalRamp(&bitmap, 90, 40, 2);
+    CHECK_EQ(DifferenceHash(bitmap), ~0ull);
+    HorizontalRamp(&bitmap, 90, 40, -2);
+    CHECK_EQ(DifferenceHash(bitmap), 0u);
+
+    // Images smaller than the grid still hash, cells sharing pixels
+    HorizontalRamp(&bitmap, 3, 1, 100);
+    CHECK(DifferenceHash(bitmap) != 0);
+    CHECK_EQ(DifferenceHash(bitmap), DifferenceHash(bitmap));
+
+    // One block per cell: bit i of a row is set when block i + 1 is brighter
+    Blocks(&bitmap, 10, 7);
+    uint64_t expected = 0;
+    for (int y = 0; y < 8; ++y) {
+        for (int x = 0; x < 8; ++x) {
+            expected = expected << 1 | (bitmap.Row(y * 10)[(x + 1) * 10 * kBytesPerPixel] >
+                                        bitmap.Row(y * 10)[x * 10 * kBytesPerPixel]);
+        }
+    }
+    CHECK_EQ(DifferenceHash(bitmap), expected);
+}
+
+void TestChannelOrder() {
+    Bitmap rgba;
+    Bitmap bgra;
+    rgba.Allocate(45, 16);
+    bgra.Allocate(45, 16, PixelFormat::BGRA_8888);
+    for (int y = 0; y < 16; ++y) {
+        uint8_t* p = rgba.Row(y);
+        uint8_t* q = bgra.Row(y);
+        for (int x = 0; x < 45; ++x, p += kBytesPerPixel, q += kBytesPerPixel) {
+            // Red rises, blue falls: the luma weights decide the hash
+            uint8_t red = static_cast<uint8_t>(x * 5);
+            uint8_t blue = static_cast<uint8_t>(255 - x * 5);
+            p[0] = red, p[1] = 0, p[2] = blue, p[3] = 255;
+            q[0] = blue, q[1] = 0, q[2] = red, q[3] = 255;
+        }
+    }
+    CHECK_EQ(DifferenceHash(rgba), ~0ull);
+    CHECK_EQ(DifferenceHash(bgra), DifferenceHash(rgba));
+}
+
+void TestSimilarImages() {
+    Bitmap original;
+    Bitmap scaled;
+    for (uint32_t seed = 1; seed <= 20; ++seed) {
+        Blocks(&original, 12, seed);
+        uint64_t hash = DifferenceHash(original);
+
+        CHECK(ResampleBitmap(original, original.Width() * 2, original.Height() * 2, &scaled));
+        CHECK(HammingDistance(DifferenceHash(scaled), hash) <= 4);
+        CHECK(ResampleBitmap(original, original.Width() * 3 / 4, original.Height() * 3 / 4, &scaled));
+        CHECK(HammingDistance(DifferenceHash(scaled), hash) <= 4);
+
+        // A stray pixel moves a cell mean by little
+        original.FillRect(30, 30, 1, 1, seed % 2 ? 0xFFFFFFFF : 0x000000FF);
+        CHECK(HammingDistance(DifferenceHash(original), hash) <= 2);
+    }
+}
+
+} // namespace
+
+int main() {
+    TestHammingDistance();
+    TestKnownHashes();
+    TestChannelOrder();
+    TestSimilarImages();
+    return navigrab::test::Finish("image_hash_test");
+}
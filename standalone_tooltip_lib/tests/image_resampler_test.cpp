@@ -0,0 +1,226 @@
+// Tests for ResampleBitmap: every SIMD level and thread count gives the same
+// pixels for each filter, with and without gamma correction; flat images
+// stay flat; box and bilinear downscales average areas; gamma correction
+// leaves alpha alone; and sources large enough to be split into bands across
+// threads match the single-threaded result.
+
+#include "bitmap.h"
+#include "image_resampler.h"
+#include "test_support.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <utility>
+
+using namespace navigrab;
+
+namespace {
+
+const SimdLevel kLevels[] = {SimdLevel::SCALAR, SimdLevel::SSE2, SimdLevel::AVX2};
+const ResampleFilter kFilters[] = {ResampleFilter::BOX, ResampleFilter::BILINEAR, ResampleFilter::LANCZOS3};
+
+// Gradients, hard edges and noise, with alpha varying across the image
+void Synthesize(Bitmap* bitmap, int width, int height, PixelFormat format, uint32_t seed) {
+    bitmap->Allocate(width, height, format);
+    std::mt19937 rng(seed);
+    for (int y = 0; y < height; ++y) {
+        uint8_t* p = bitmap->Row(y);
+        for (int x = 0; x < width; ++x, p += kBytesPerPixel) {
+            bool edge = ((x / 13) + (y / 7)) % 2 == 0;
+            p[0] = static_cast<uint8_t>(edge ? 250 : x * 255 / width);
+            p[1] = static_cast<uint8_t>(edge ? 5 : y * 255 / height);
+            p[2] = static_cast<uint8_t>(rng() % 256);
+            p[3] = static_cast<uint8_t>(x % 40 < 20 ? 255 : (x + y) % 256);
+        }
+    }
+}
+
+bool SamePixels(const Bitmap& a, const Bitmap& b) {
+    if (a.Width() != b.Width() || a.Height() != b.Height() || a.Format() != b.Format()) return false;
+    for (int y = 0; y < a.Height(); ++y) {
+        if (std::memcmp(a.Row(y), b.Row(y), static_cast<size_t>(a.Width()) * kBytesPerPixel) != 0) return false;
+    }
+    return true;
+}
+
+ResampleOptions Options(ResampleFilter filter, bool gamma, SimdLevel simd, int threads = 1) {
+    ResampleOptions options;
+    options.filter = filter;
+    options.gamma_correct = gamma;
+    options.simd = simd;
+    options.max_threads = threads;
+    return options;
+}
+
+void TestSimdLevelsAgree() {
+    const std::pair<int, int> kSources[] = {{1, 1}, {7, 5}, {64, 48}, {300, 200}, {333, 97}};
+    const std::pair<int, int> kTargets[] = {{1, 1}, {3, 2}, {100, 50}, {150, 100}, {77, 133}, {450, 310}};
+    Bitmap source;
+    Bitmap reference;
+    Bitmap scaled;
+    for (const std::pair<int, int>& from : kSources) {
+        for (PixelFormat format : {PixelFormat::RGBA_8888, PixelFormat::BGRA_8888}) {
+            Synthesize(&source, from.first, from.second, format, from.first * 7 + from.second);
+            for (const std::pair<int, int>& to : kTargets) {
+                for (ResampleFilter filter : kFilters) {
+                    for (bool gamma : {false, true}) {
+                        CHECK(ResampleBitmap(source, to.first, to.second, &reference,
+                                             Options(filter, gamma, SimdLevel::SCALAR)));
+                        CHECK(reference.Format() == format);
+                        for (SimdLevel simd : kLevels) {
+                            CHECK(ResampleBitmap(source, to.first, to.second, &scaled,
+                                                 Options(filter, gamma, simd)));
+                            CHECK(SamePixels(scaled, reference));
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+void TestFlatImagesStayFlat() {
+    const uint8_t kColor[4] = {200, 97, 31, 128};
+    const std::pair<int, int> kTargets[] = {{1, 1}, {20, 10}, {33, 61}, {90, 60}, {91, 200}, {400, 250}};
+    Bitmap source;
+    Bitmap scaled;
+    source.Allocate(90, 60);
+    for (int y = 0; y < source.Height(); ++y) {
+        for (int x = 0; x < source.Width(); ++x) std::memcpy(source.Row(y) + x * kBytesPerPixel, kColor, 4);
+    }
+    for (const std::pair<int, int>& to : kTargets) {
+        for (ResampleFilter filter : kFilters) {
+            for (bool gamma : {false, true}) {
+                for (SimdLevel simd : kLevels) {
+                    CHECK(ResampleBitmap(source, to.first, to.second, &scaled, Options(filter, gamma, simd)));
+                    bool flat = true;
+                    for (int y = 0; y < scaled.Height(); ++y) {
+                        for (int x = 0; x < scaled.Width(); ++x) {
+                            flat = flat && std::memcmp(scaled.Row(y) + x * kBytesPerPixel, kColor, 4) == 0;
+                        }
+                    }
+                    CHECK(flat);
+                }
+            }
+        }
+    }
+}
+
+void TestAreaAverage() {
+    // A one-pixel checkerboard averages to mid gray in an even downscale.
+    // Box blocks never cross the border; bilinear taps clamped at the
+    // border weigh the edge pixels unevenly, so only its interior is gray.
+    Bitmap source;
+    Bitmap scaled;
+    source.Allocate(120, 80);
+    for (int y = 0; y < source.Height(); ++y) {
+        uint8_t* p = source.Row(y);
+        for (int x = 0; x < source.Width(); ++x, p += kBytesPerPixel) {
+            p[0] = p[1] = p[2] = (x + y) % 2 ? 255 : 0;
+            p[3] = 255;
+        }
+    }
+    for (ResampleFilter filter : {ResampleFilter::BOX, ResampleFilter::BILINEAR}) {
+        for (int factor : {2, 4}) {
+            CHECK(ResampleBitmap(source, 120 / factor, 80 / factor, &scaled, Options(filter, false, SimdLevel::SCALAR)));
+            bool gray = true;
+            int border = filter == ResampleFilter::BOX ? 0 : 1;
+            for (int y = border; y < scaled.Height() - border; ++y) {
+                for (int x = border; x < scaled.Width() - border; ++x) {
+                    const uint8_t* p = scaled.Row(y) + x * kBytesPerPixel;
+                    gray = gray && std::abs(p[0] - 128) <= border && p[0] == p[1] && p[1] == p[2] && p[3] == 255;
+                }
+            }
+            CHECK(gray);
+        }
+    }
+
+    // Box downscales by whole factors are exact block means
+    Synthesize(&source, 120, 80, PixelFormat::RGBA_8888, 5);
+    CHECK(ResampleBitmap(source, 40, 20, &scaled, Options(ResampleFilter::BOX, false, SimdLevel::SCALAR)));
+    bool means = true;
+    for (int y = 0; y < 20; ++y) {
+        for (int x = 0; x < 40; ++x) {
+            for (int c = 0; c < 4; ++c) {
+                int sum = 0;
+                for (int dy = 0; dy < 4; ++dy) {
+                    for (int dx = 0; dx < 3; ++dx) sum += source.Row(y * 4 + dy)[(x * 3 + dx) * kBytesPerPixel + c];
+                }
+                means = means && std::abs(scaled.Row(y)[x * kBytesPerPixel + c] * 12 - sum) <= 6;
+            }
+        }
+    }
+    CHECK(means);
+}
+
+void TestGammaLeavesAlpha() {
+    Bitmap source;
+    Bitmap linear;
+    Bitmap gamma;
+    Synthesize(&source, 150, 90, PixelFormat::RGBA_8888, 9);
+    for (ResampleFilter filter : kFilters) {
+        for (const std::pair<int, int>& to : {std::make_pair(50, 30), std::make_pair(61, 47), std::make_pair(320, 200)}) {
+            CHECK(ResampleBitmap(source, to.first, to.second, &linear, Options(filter, false, SimdLevel::SCALAR)));
+            CHECK(ResampleBitmap(source, to.first, to.second, &gamma, Options(filter, true, SimdLevel::SCALAR)));
+            bool same_alpha = true;
+            bool color_differs = false;
+            for (int y = 0; y < linear.Height(); ++y) {
+                for (int x = 0; x < linear.Width(); ++x) {
+                    const uint8_t* a = linear.Row(y) + x * kBytesPerPixel;
+                    const uint8_t* b = gamma.Row(y) + x * kBytesPerPixel;
+                    same_alpha = same_alpha && a[3] == b[3];
+                    color_differs = color_differs || std::memcmp(a, b, 3) != 0;
+                }
+            }
+            CHECK(same_alpha);
+            // Box upscales pick the nearest pixel, so only filtering shows linear light
+            CHECK(color_differs || (filter == ResampleFilter::BOX && to.first > source.Width()));
+        }
+    }
+}
+
+void TestLargeSourcesInBands() {
+    // Over kParallelResamplePixels, so the job is split across threads
+    Bitmap source;
+    Bitmap reference;
+    Bitmap scaled;
+    Synthesize(&source, 2000, 1100, PixelFormat::BGRA_8888, 11);
+    CHECK(int64_t{source.Width()} * source.Height() >= kParallelResamplePixels);
+    const std::pair<int, int> kTargets[] = {{641, 353}, {2100, 1157}};
+    for (const std::pair<int, int>& to : kTargets) {
+        for (ResampleFilter filter : kFilters) {
+            for (bool gamma : {false, true}) {
+                CHECK(ResampleBitmap(source, to.first, to.second, &reference,
+                                     Options(filter, gamma, SimdLevel::SCALAR, 1)));
+                for (SimdLevel simd : kLevels) {
+                    CHECK(ResampleBitmap(source, to.first, to.second, &scaled, Options(filter, gamma, simd, 4)));
+                    CHECK(SamePixels(scaled, reference));
+                }
+            }
+        }
+    }
+}
+
+void TestRejectsBadArguments() {
+    Bitmap empty;
+    Bitmap source;
+    Bitmap scaled;
+    Synthesize(&source, 10, 10, PixelFormat::RGBA_8888, 1);
+    CHECK(!ResampleBitmap(empty, 5, 5, &scaled));
+    CHECK(!ResampleBitmap(source, 0, 5, &scaled));
+    CHECK(!ResampleBitmap(source, 5, -1, &scaled));
+    CHECK(!ResampleBitmap(source, 5, 5, &source));
+}
+
+} // namespace
+
+int main() {
+    TestSimdLevelsAgree();
+    TestFlatImagesStayFlat();
+    TestAreaAverage();
+    TestGammaLeavesAlpha();
+    TestLargeSourcesInBands();
+    TestRejectsBadArguments();
+    return navigrab::test::Finish("image_resampler_test");
+}
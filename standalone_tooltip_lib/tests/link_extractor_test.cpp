@@ -0,0 +1,135 @@
+// Tests for URL resolution and canonicalization (the RFC 3986 section 5.4
+// examples, restricted to http and with fragments dropped) and for link
+// extraction from a document and from raw markup.
+
+#include "dom.h"
+#include "link_extractor.h"
+#include "test_support.h"
+
+#include <string>
+#include <vector>
+
+using namespace navigrab;
+
+namespace {
+
+void TestRfc3986Examples() {
+    const char* base = "http://a/b/c/d;p?q";
+
+    // Normal examples (5.4.1)
+    CHECK_EQ(ResolveUrl(base, "g"), "http://a/b/c/g");
+    CHECK_EQ(ResolveUrl(base, "./g"), "http://a/b/c/g");
+    CHECK_EQ(ResolveUrl(base, "g/"), "http://a/b/c/g/");
+    CHECK_EQ(ResolveUrl(base, "/g"), "http://a/g");
+    CHECK_EQ(ResolveUrl(base, "//g"), "http://g/");
+    CHECK_EQ(ResolveUrl(base, "?y"), "http://a/b/c/d;p?y");
+    CHECK_EQ(ResolveUrl(base, "g?y"), "http://a/b/c/g?y");
+    CHECK_EQ(ResolveUrl(base, "#s"), "http://a/b/c/d;p?q");
+    CHECK_EQ(ResolveUrl(base, "g#s"), "http://a/b/c/g");
+    CHECK_EQ(ResolveUrl(base, ";x"), "http://a/b/c/;x");
+    CHECK_EQ(ResolveUrl(base, ""), "http://a/b/c/d;p?q");
+    CHECK_EQ(ResolveUrl(base, "."), "http://a/b/c/");
+    CHECK_EQ(ResolveUrl(base, "./"), "http://a/b/c/");
+    CHECK_EQ(ResolveUrl(base, ".."), "http://a/b/");
+    CHECK_EQ(ResolveUrl(base, "../"), "http://a/b/");
+    CHECK_EQ(ResolveUrl(base, "../g"), "http://a/b/g");
+    CHECK_EQ(ResolveUrl(base, "../.."), "http://a/");
+    CHECK_EQ(ResolveUrl(base, "../../g"), "http://a/g");
+
+    // Abnormal examples (5.4.2)
+    CHECK_EQ(ResolveUrl(base, "../../../g"), "http://a/g");
+    CHECK_EQ(ResolveUrl(base, "../../../../g"), "http://a/g");
+    CHECK_EQ(ResolveUrl(base, "/./g"), "http://a/g");
+    CHECK_EQ(ResolveUrl(base, "/../g"), "http://a/g");
+    CHECK_EQ(ResolveUrl(base, "g."), "http://a/b/c/g.");
+    CHECK_EQ(ResolveUrl(base, ".g"), "http://a/b/c/.g");
+    CHECK_EQ(ResolveUrl(base, "g.."), "http://a/b/c/g..");
+    CHECK_EQ(ResolveUrl(base, "..g"), "http://a/b/c/..g");
+    CHECK_EQ(ResolveUrl(base, "./../g"), "http://a/b/g");
+    CHECK_EQ(ResolveUrl(base, "./g/."), "http://a/b/c/g/");
+    CHECK_EQ(ResolveUrl(base, "g/./h"), "http://a/b/c/g/h");
+    CHECK_EQ(ResolveUrl(base, "g/../h"), "http://a/b/c/h");
+    CHECK_EQ(ResolveUrl(base, "g;x=1/./y"), "http://a/b/c/g;x=1/y");
+    CHECK_EQ(ResolveUrl(base, "g;x=1/../y"), "http://a/b/c/y");
+    CHECK_EQ(ResolveUrl(base, "g?y/./x"), "http://a/b/c/g?y/./x");
+    CHECK_EQ(ResolveUrl(base, "g#s/../x"), "http://a/b/c/g");
+
+    CHECK_EQ(ResolveUrl("https://x.org/a/", "//cdn.test/i.png"), "https://cdn.test/i.png");
+    CHECK_EQ(ResolveUrl("http://a/b", "%2e%2E/c"), "http://a/c");
+}
+
+void TestCanonicalization() {
+    CHECK_EQ(CanonicalizeUrl("HTTP://Example.COM:80/a/%7e%2fb?%3c#x"), "http://example.com/a/~%2Fb?%3C");
+    CHECK_EQ(CanonicalizeUrl("https://h:443"), "https://h/");
+    CHECK_EQ(CanonicalizeUrl("https://h:8443/"), "https://h:8443/");
+    CHECK_EQ(CanonicalizeUrl("https://h:/x"), "https://h/x");
+    CHECK_EQ(CanonicalizeUrl("http://[::1]:8080/"), "http://[::1]:8080/");
+    CHECK_EQ(CanonicalizeUrl("http://u:P@H/"), "http://u:P@h/");
+    CHECK_EQ(CanonicalizeUrl("  http://h/a b\n/c  "), "http://h/a%20b/c");
+
+    // Canonical form is a fixed point
+    for (const char* url : {"http://example.com/a/~%2Fb?%3C", "https://h:8443/", "http://a/b/c/g;x=1/y"}) {
+        CHECK_EQ(CanonicalizeUrl(CanonicalizeUrl(url)), CanonicalizeUrl(url));
+    }
+
+    // Not http(s), relative without a base, or malformed
+    CHECK_EQ(CanonicalizeUrl("http://h:99999/"), "");
+    CHECK_EQ(CanonicalizeUrl("http://h:8x/"), "");
+    CHECK_EQ(CanonicalizeUrl("mailto:x@y"), "");
+    CHECK_EQ(ResolveUrl("http://a/b/c/d;p?q", "javascript:void(0)"), "");
+    CHECK_EQ(CanonicalizeUrl("g"), "");
+    CHECK_EQ(CanonicalizeUrl("http:g"), "");
+    CHECK_EQ(CanonicalizeUrl("http:///x"), "");
+    CHECK_EQ(CanonicalizeUrl(""), "");
+}
+
+const char kPage[] =
+    "<html><body><nav id=n><a href='/a'>A</a><a href=\"/a#top\">A2</a><a href=b?x=1>B</a></nav>"
+    "<div id=m><a href='HTTP://A.test:80/b?x=1'>dup</a><area href=../c><a>no</a><a href='mailto:q'>m</a>"
+    "<div class=inner><a href=/d>D</a><img src=i.png></div></div>"
+    "<a href=/e>E</a><img src=\"/i.png\"></body></html>";
+
+void TestExtraction() {
+    dom::Document doc;
+    doc.Load(kPage);
+    const std::vector<std::string> all = {
+        "http://a.test/a", "http://a.test/x/b?x=1", "http://a.test/b?x=1",
+        "http://a.test/c", "http://a.test/d", "http://a.test/e"};
+    CHECK(ExtractLinks(doc, "http://a.test/x/y") == all);
+    CHECK(ExtractLinksFromHtml(kPage, "http://a.test/x/y") == all);
+
+    // Without a page URL only absolute links resolve
+    std::vector<std::string> absolute = ExtractLinks(doc, "");
+    CHECK(absolute == std::vector<std::string>{"http://a.test/b?x=1"});
+
+    const std::vector<std::string> images = {"http://a.test/x/i.png", "http://a.test/i.png"};
+    CHECK(ExtractLinks(doc, "http://a.test/x/y", LinkSource::SRC) == images);
+    CHECK(ExtractLinksFromHtml(kPage, "http://a.test/x/y", LinkSource::SRC) == images);
+
+    // Nested scopes are visited once, in document order
+    dom::NodeList scopes = {doc.ElementsById("n")[0], doc.ElementsById("m")[0],
+                            doc.ElementsByClass("inner")[0]};
+    const std::vector<std::string> scoped = {
+        "http://a.test/a", "http://a.test/x/b?x=1", "http://a.test/b?x=1",
+        "http://a.test/c", "http://a.test/d"};
+    CHECK(ExtractLinks(doc, "http://a.test/x/y", LinkSource::HREF, scopes) == scoped);
+    CHECK(ExtractLinks(doc, "http://a.test/x/y", LinkSource::SRC, {doc.ElementsById("m")[0]}) ==
+          std::vector<std::string>{"http://a.test/x/i.png"});
+
+    // <base href> wins over the page URL, wherever it appears
+    std::vector<std::string> based =
+        ExtractLinksFromHtml("<a href=x>1</a><base href='http://other.test/dir/'>", "http://a.test/");
+    CHECK(based == std::vector<std::string>{"http://other.test/dir/x"});
+    dom::Document relative_base;
+    relative_base.Load("<a href=x>1</a><base href='/dir/'>");
+    CHECK(ExtractLinks(relative_base, "http://a.test/q") == std::vector<std::string>{"http://a.test/dir/x"});
+}
+
+} // namespace
+
+int main() {
+    TestRfc3986Examples();
+    TestCanonicalization();
+    TestExtraction();
+    return navigrab::test::Finish("link_extractor_test");
+}
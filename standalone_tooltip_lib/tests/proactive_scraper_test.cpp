@@ -0,0 +1,147 @@
+// Tests for ProactiveScraper's re-capture skipping: a re-scrape of an
+// unchanged page reuses each element's screenshot, while a text change, a
+// rendering further than SetChangeThreshold() from the last capture, or a
+// missing file captures the element again. Pages come from a zero-latency
+// simulated backend and screenshots are written to a scratch directory.
+
+#include "logging.h"
+#include "page_backend.h"
+#include "proactive_scraper.h"
+#include "test_support.h"
+
+#include <filesystem>
+#include <memory>
+#include <random>
+#include <string>
+#include <system_error>
+
+using namespace navigrab;
+
+namespace {
+
+const char kUrl[] = "http://scraper.test/";
+
+// The link's DOM fingerprint covers its own tag, attributes and text, not
+// its descendants' tags, which still change how the text is painted
+const char kPage[] = "<p>Intro</p><a id=go href=/next><b>Go there</b></a><input id=q>";
+const char kRetextedPage[] = "<p>Intro</p><a id=go href=/next><b>Go here</b></a><input id=q>";
+const char kNestedPage[] = "<p>Intro</p><a id=go href=/next><b><i><u>Go there</u></i></b></a><input id=q>";
+const char kButtonPage[] = "<p>Intro</p><a id=go href=/next><button>Go there</button></a><input id=q>";
+
+std::shared_ptr<SimulatedBrowserBackend> g_backend;
+
+// Screenshot path of the element with |selector| in |result|, or ""
+std::string PathOf(const ScrapingResult& result, const std::string& selector) {
+    for (const ElementInfo& element : result.elements) {
+        if (element.selector == selector) return element.screenshot_path;
+    }
+    return std::string();
+}
+
+ScrapingResult Scrape(ProactiveScraper* scraper, const char* html) {
+    g_backend->SetPageContent(kUrl, html);
+    scraper->ClearCache();
+    ScrapingResult result = scraper->ScrapePage(kUrl);
+    CHECK(result.success);
+    return result;
+}
+
+void TestUnchangedPageReusesScreenshots() {
+    ProactiveScraper scraper;
+    ScrapingResult first = Scrape(&scraper, kPage);
+    std::string link = PathOf(first, "a#go");
+    std::string input = PathOf(first, "input#q");
+    CHECK(!link.empty() && std::filesystem::exists(link));
+    CHECK(!input.empty() && std::filesystem::exists(input));
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 0);
+
+    // Clearing the result cache keeps the previous captures
+    ScrapingResult second = Scrape(&scraper, kPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 2);
+    CHECK_EQ(PathOf(second, "a#go"), link);
+    CHECK_EQ(PathOf(second, "input#q"), input);
+    for (const ElementInfo& element : second.elements) {
+        if (element.is_interactive) CHECK(element.dom_fingerprint != 0 && element.perceptual_hash != 0);
+    }
+
+    // A cached result does not reach the capture code at all
+    g_backend->SetPageContent(kUrl, kRetextedPage);
+    CHECK_EQ(PathOf(scraper.ScrapePage(kUrl), "a#go"), link);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 2);
+
+    // Forgetting previous captures captures everything again
+    scraper.ClearPreviousCaptures();
+    ScrapingResult third = Scrape(&scraper, kPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 2);
+    CHECK(PathOf(third, "a#go") != link);
+    CHECK(PathOf(third, "input#q") != input);
+}
+
+void TestChangesForceCaptures() {
+    ProactiveScraper scraper;
+    ScrapingResult first = Scrape(&scraper, kPage);
+    std::string link = PathOf(first, "a#go");
+    std::string input = PathOf(first, "input#q");
+
+    // New text changes the fingerprint; the untouched input is reused
+    ScrapingResult retexted = Scrape(&scraper, kRetextedPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 1);
+    CHECK(PathOf(retexted, "a#go") != link);
+    CHECK_EQ(PathOf(retexted, "input#q"), input);
+    link = PathOf(Scrape(&scraper, kPage), "a#go");
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 2);
+
+    // Same fingerprint, rendering far beyond the default threshold
+    ScrapingResult button = Scrape(&scraper, kButtonPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 3);
+    CHECK(PathOf(button, "a#go") != link);
+    link = PathOf(Scrape(&scraper, kPage), "a#go");
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 4);
+
+    // A rendering a bit away is reused within the threshold...
+    ScrapingResult nested = Scrape(&scraper, kNestedPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 6);
+    CHECK_EQ(PathOf(nested, "a#go"), link);
+
+    // ...and captured again beyond it
+    scraper.SetChangeThreshold(0);
+    nested = Scrape(&scraper, kNestedPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 7);
+    CHECK(PathOf(nested, "a#go") != link);
+    link = PathOf(nested, "a#go");
+
+    // A missing file is captured again, and a negative threshold always is
+    std::filesystem::remove(link);
+    ScrapingResult missing = Scrape(&scraper, kNestedPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 8);
+    CHECK(PathOf(missing, "a#go") != link);
+    CHECK(std::filesystem::exists(PathOf(missing, "a#go")));
+    scraper.SetChangeThreshold(-1);
+    Scrape(&scraper, kNestedPage);
+    CHECK_EQ(scraper.GetTotalScreenshotsReused(), 8);
+}
+
+} // namespace
+
+int main() {
+    SetLogLevel(LogLevel::LOG_WARNING);
+    SimulationOptions options;
+    options.latency = LatencyModel::Zero();
+    g_backend = std::make_shared<SimulatedBrowserBackend>(options);
+    SetDefaultBrowserBackend(g_backend);
+
+    // Screenshots are written to the working directory
+    std::error_code error;
+    std::filesystem::path previous = std::filesystem::current_path();
+    std::filesystem::path scratch = std::filesystem::temp_directory_path() /
+                                    ("proactive_scraper_test_" + std::to_string(std::random_device()()));
+    std::filesystem::create_directories(scratch);
+    std::filesystem::current_path(scratch);
+
+    TestUnchangedPageReusesScreenshots();
+    TestChangesForceCaptures();
+
+    std::filesystem::current_path(previous);
+    std::filesystem::remove_all(scratch, error);
+    return navigrab::test::Finish("proactive_scraper_test");
+}
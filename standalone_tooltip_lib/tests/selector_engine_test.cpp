@@ -0,0 +1,270 @@
+// Tests for the selector engine: the supported syntax against a small
+// document with known answers, then QueryAll, QueryFirst and QueryMany
+// against CompiledSelector::Matches on random documents and selectors, since
+// the indexed and filtered paths must agree with the direct ancestor climb.
+
+#include "dom.h"
+#include "selector_engine.h"
+#include "test_support.h"
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace navigrab;
+using dom::Document;
+using dom::NodeId;
+
+namespace {
+
+const char kPage[] =
+    "<div id=root class='box main'>"
+    "<ul id=list>"
+    "<li id=l1 class='item first'>One</li>"
+    "<li id=l2 class=item data-k='en-US'>Two</li>"
+    "<li id=l3 class='item last' data-k=fr>Three</li>"
+    "</ul>"
+    "<p id=p1>Para <a id=a1 href='https://x.com/page.html'>x</a></p>"
+    "<form id=f><input id=i1 disabled><input id=i2 type=checkbox checked><input id=i3></form>"
+    "</div>"
+    "<section id=s><p id=p2><span id=sp class=item>s</span></p></section>";
+
+// Space-separated ids of |nodes|, for readable comparisons
+std::string Ids(const Document& doc, const dom::NodeList& nodes) {
+    std::string ids;
+    for (NodeId id : nodes) {
+        if (!ids.empty()) ids += ' ';
+        ids += doc.GetId(id);
+    }
+    return ids;
+}
+
+// Every element under |scope| that Matches() accepts, in document order
+dom::NodeList BruteForce(const Document& doc, const CompiledSelector& selector, NodeId scope = 0) {
+    dom::NodeList matches;
+    for (NodeId id = scope + 1; id < doc.GetNode(scope).subtree_end; ++id) {
+        if (doc.IsElement(id) && selector.Matches(doc, id)) matches.push_back(id);
+    }
+    return matches;
+}
+
+std::string Query(const Document& doc, const char* text) {
+    std::shared_ptr<const CompiledSelector> selector = CompiledSelector::Compile(text);
+    dom::NodeList matches = SelectorMatcher(doc).QueryAll(*selector);
+    CHECK_EQ(Ids(doc, BruteForce(doc, *selector)), Ids(doc, matches));
+    return Ids(doc, matches);
+}
+
+void TestSyntax() {
+    Document doc;
+    doc.Load(kPage);
+
+    CHECK_EQ(Query(doc, "li"), "l1 l2 l3");
+    CHECK_EQ(Query(doc, "*"), "root list l1 l2 l3 p1 a1 f i1 i2 i3 s p2 sp");
+    CHECK_EQ(Query(doc, "#list"), "list");
+    CHECK_EQ(Query(doc, ".item"), "l1 l2 l3 sp");
+    CHECK_EQ(Query(doc, "li.item.last"), "l3");
+    CHECK_EQ(Query(doc, "#missing"), "");
+
+    // :not() with and without a type, and with * as the subject
+    CHECK_EQ(Query(doc, ":not(li)"), "root list p1 a1 f i1 i2 i3 s p2 sp");
+    CHECK_EQ(Query(doc, "#list > li:not(.first)"), "l2 l3");
+    CHECK_EQ(Query(doc, "*:not(div):not(section)"), "list l1 l2 l3 p1 a1 f i1 i2 i3 p2 sp");
+    CHECK_EQ(Query(doc, ".item:not(li)"), "sp");
+    CHECK_EQ(Query(doc, "li:not([data-k])"), "l1");
+    CHECK_EQ(Query(doc, "div *"), "list l1 l2 l3 p1 a1 f i1 i2 i3");
+    CHECK_EQ(Query(doc, "* > span"), "sp");
+
+    // Combinators
+    CHECK_EQ(Query(doc, "ul .item"), "l1 l2 l3");
+    CHECK_EQ(Query(doc, "div p a"), "a1");
+    CHECK_EQ(Query(doc, "div > p"), "p1");
+    CHECK_EQ(Query(doc, "li + li"), "l2 l3");
+    CHECK_EQ(Query(doc, "li.first ~ li"), "l2 l3");
+    CHECK_EQ(Query(doc, "ul + p"), "p1");
+    CHECK_EQ(Query(doc, "section > p > span.item"), "sp");
+    CHECK_EQ(Query(doc, "section > span"), "");
+
+    // Structural pseudo-classes count element siblings only
+    CHECK_EQ(Query(doc, "li:first-child"), "l1");
+    CHECK_EQ(Query(doc, "li:last-child"), "l3");
+    CHECK_EQ(Query(doc, ":only-child"), "a1 p2 sp");
+    CHECK_EQ(Query(doc, "li:nth-child(2n+1)"), "l1 l3");
+    CHECK_EQ(Query(doc, "li:nth-child(2)"), "l2");
+    CHECK_EQ(Query(doc, "li:nth-last-child(1)"), "l3");
+    CHECK_EQ(Query(doc, "input:disabled"), "i1");
+    CHECK_EQ(Query(doc, ":checked"), "i2");
+
+    // Attributes
+    CHECK_EQ(Query(doc, "[data-k]"), "l2 l3");
+    CHECK_EQ(Query(doc, "[data-k|=en]"), "l2");
+    CHECK_EQ(Query(doc, "[data-k=FR i]"), "l3");
+    CHECK_EQ(Query(doc, "[data-k=FR]"), "");
+    CHECK_EQ(Query(doc, "[class~=last]"), "l3");
+    CHECK_EQ(Query(doc, "a[href^=https]"), "a1");
+    CHECK_EQ(Query(doc, "[href$='.html']"), "a1");
+    CHECK_EQ(Query(doc, "[href*=\"x.com\"]"), "a1");
+
+    // Selector lists come back once each, in document order
+    CHECK_EQ(Query(doc, "p, li.last"), "l3 p1 p2");
+    CHECK_EQ(Query(doc, ".item, li"), "l1 l2 l3 sp");
+
+    // A compound left of a sibling combinator is not an ancestor of the
+    // subject, even when a child or descendant combinator follows it
+    Document siblings;
+    siblings.Load("<div id=d><span id=s class=a></span><p id=b><i id=i>x</i></p></div>");
+    CHECK_EQ(Query(siblings, "span + p > *"), "i");
+    CHECK_EQ(Query(siblings, "span ~ p > *"), "i");
+    CHECK_EQ(Query(siblings, ".a + p :first-child"), "i");
+    CHECK_EQ(Query(siblings, ".a ~ p :first-child"), "i");
+    CHECK_EQ(Query(siblings, "div > span + p > i"), "i");
+    CHECK_EQ(Query(siblings, "#d .a ~ * *"), "i");
+    CHECK_EQ(Query(siblings, ".a + *"), "b");
+    CHECK_EQ(Query(siblings, "span ~ :last-child"), "b");
+    CHECK_EQ(Query(siblings, "i + *"), "");
+
+    for (const char* text : {"", "li >", "[", ":not(", "#", "li,,p", ":unknown-pseudo"}) {
+        std::shared_ptr<const CompiledSelector> selector = CompiledSelector::Compile(text);
+        CHECK(!selector->IsValid());
+        CHECK(SelectorMatcher(doc).QueryAll(*selector).empty());
+    }
+}
+
+void TestScopeAndLimits() {
+    Document doc;
+    doc.Load(kPage);
+    SelectorMatcher matcher(doc);
+    NodeId list = doc.ElementsById("list")[0];
+    NodeId section = doc.ElementsById("s")[0];
+    auto li = CompiledSelector::Compile("li");
+    auto item = CompiledSelector::Compile(".item");
+    auto any = CompiledSelector::Compile("*");
+
+    CHECK_EQ(Ids(doc, matcher.QueryAll(*li, list)), "l1 l2 l3");
+    CHECK_EQ(Ids(doc, matcher.QueryAll(*li, section)), "");
+    CHECK_EQ(Ids(doc, matcher.QueryAll(*item, section)), "sp");
+    CHECK_EQ(Ids(doc, matcher.QueryAll(*any, section)), "p2 sp");
+    CHECK_EQ(Ids(doc, matcher.QueryAll(*li, 0, 2)), "l1 l2");
+    CHECK_EQ(Ids(doc, matcher.QueryAll(*any, 0, 1)), "root");
+    CHECK_EQ(doc.GetId(matcher.QueryFirst(*li)), "l1");
+    CHECK_EQ(doc.GetId(matcher.QueryFirst(*item, section)), "sp");
+    CHECK_EQ(matcher.QueryFirst(*li, section), dom::kInvalidNode);
+
+    auto invalid = CompiledSelector::Compile("li >");
+    std::vector<dom::NodeList> many = matcher.QueryMany({li.get(), nullptr, invalid.get(), item.get()});
+    CHECK_EQ(many.size(), 4u);
+    if (many.size() == 4) {
+        CHECK_EQ(Ids(doc, many[0]), "l1 l2 l3");
+        CHECK(many[1].empty());
+        CHECK(many[2].empty());
+        CHECK_EQ(Ids(doc, many[3]), "l1 l2 l3 sp");
+    }
+}
+
+void TestCache() {
+    SelectorCache cache(2);
+    auto first = cache.Get("li.item");
+    CHECK(first->IsValid());
+    CHECK(cache.Get("li.item") == first);
+    CHECK_EQ(cache.Hits(), 1u);
+    CHECK_EQ(cache.Misses(), 1u);
+    cache.Get("p");
+    cache.Get("a");   // Evicts li.item, the least recently used
+    CHECK_EQ(cache.Size(), 2u);
+    CHECK(cache.Get("li.item") != first);
+    CHECK(!cache.Get("li >")->IsValid());
+    cache.Clear();
+    CHECK_EQ(cache.Size(), 0u);
+}
+
+std::string RandomDocument(std::mt19937* rng) {
+    static const char* const kTags[] = {"div", "p", "span", "a", "li", "ul", "section"};
+    static const char* const kClasses[] = {"", " class=a", " class=b", " class='a b'", " class=c"};
+    std::string html;
+    int count = 20 + static_cast<int>((*rng)() % 200);
+    std::vector<const char*> open;
+    for (int i = 0; i < count; ++i) {
+        if (!open.empty() && (*rng)() % 3 == 0) {
+            html += "</" + std::string(open.back()) + ">";
+            open.pop_back();
+            continue;
+        }
+        const char* tag = kTags[(*rng)() % 7];
+        html += "<" + std::string(tag) + kClasses[(*rng)() % 5];
+        if ((*rng)() % 6 == 0) html += " id=x" + std::to_string((*rng)() % 4);
+        if ((*rng)() % 5 == 0) html += " data-k=v" + std::to_string((*rng)() % 3);
+        html += ">";
+        if ((*rng)() % 2) html += "t";
+        open.push_back(tag);
+    }
+    return html;
+}
+
+std::string RandomCompound(std::mt19937* rng) {
+    static const char* const kSimple[] = {
+        "div", "p", "span", "li", "*", ".a", ".b", ".c", "#x1", "#x2", "[data-k]",
+        "[data-k=v1]", ":first-child", ":last-child", ":nth-child(2n)", ":not(.a)",
+        ":not(p)", ":not([data-k])", ":only-child", ":nth-last-child(odd)"};
+    std::string compound;
+    int parts = 1 + static_cast<int>((*rng)() % 3);
+    for (int i = 0; i < parts; ++i) {
+        const char* simple = kSimple[(*rng)() % 20];
+        // A type or * must come first in a compound
+        bool is_type = simple[0] != '.' && simple[0] != '#' && simple[0] != '[' && simple[0] != ':';
+        if (is_type && i > 0) continue;
+        compound += simple;
+    }
+    return compound;
+}
+
+// Random documents and selectors: every query path agrees with Matches()
+void TestAgainstMatches() {
+    static const char* const kCombinators[] = {" ", " > ", " + ", " ~ "};
+    std::mt19937 rng(2024);
+    Document doc;
+    for (int round = 0; round < 300; ++round) {
+        doc.Load(RandomDocument(&rng));
+        SelectorMatcher matcher(doc);
+        std::vector<std::shared_ptr<const CompiledSelector>> compiled;
+        std::vector<const CompiledSelector*> selectors;
+        for (int i = 0; i < 25; ++i) {
+            std::string text = RandomCompound(&rng);
+            int combinators = static_cast<int>(rng() % 4);
+            for (int k = 0; k < combinators; ++k) {
+                text += kCombinators[rng() % 4] + RandomCompound(&rng);
+            }
+            if (rng() % 5 == 0) text += ", " + RandomCompound(&rng);
+            compiled.push_back(CompiledSelector::Compile(text));
+            selectors.push_back(compiled.back().get());
+        }
+
+        NodeId scope = rng() % 2 ? 0 : static_cast<NodeId>(rng() % doc.Size());
+        if (!doc.IsElement(scope)) scope = 0;
+        std::vector<dom::NodeList> many = matcher.QueryMany(selectors, scope);
+        CHECK_EQ(many.size(), selectors.size());
+        for (size_t i = 0; i < selectors.size() && i < many.size(); ++i) {
+            const CompiledSelector& selector = *selectors[i];
+            CHECK(selector.IsValid());
+            dom::NodeList expected = BruteForce(doc, selector, scope);
+            dom::NodeList all = matcher.QueryAll(selector, scope);
+            if (all != expected) {
+                std::cerr << "  selector: " << selector.Text() << std::endl;
+            }
+            CHECK(all == expected);
+            CHECK(many[i] == expected);
+            NodeId first = matcher.QueryFirst(selector, scope);
+            CHECK_EQ(first, expected.empty() ? dom::kInvalidNode : expected[0]);
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    TestSyntax();
+    TestScopeAndLimits();
+    TestCache();
+    TestAgainstMatches();
+    return navigrab::test::Finish("selector_engine_test");
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Minimal checks for the NaviGrab core tests. Each test is a plain
+// executable run by ctest; a failed CHECK prints where it failed and the
+// run carries on, so one pass reports every broken expectation.
+//
+//   int main() {
+//       CHECK(ParseSomething() == 42);
+//       CHECK_EQ(Canonical("HTTP://A/"), "http://a/");
+//       return navigrab::test::Finish("something");
+//   }
+
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace navigrab {
+namespace test {
+
+inline int& FailureCount() {
+    static int failures = 0;
+    return failures;
+}
+
+inline void ReportFailure(const char* file, int line, const std::string& message) {
+    ++FailureCount();
+    std::cerr << file << ":" << line << ": CHECK failed: " << message << std::endl;
+}
+
+template <typename A, typename B>
+void CheckEqual(const A& actual, const B& expected, const char* expression, const char* file, int line) {
+    if (actual == expected) return;
+    std::ostringstream message;
+    message << expression << "\n    actual:   " << actual << "\n    expected: " << expected;
+    ReportFailure(file, line, message.str());
+}
+
+// Exit code for main(): 0 when every check passed
+inline int Finish(const char* name) {
+    if (FailureCount() == 0) {
+        std::cout << name << ": all checks passed" << std::endl;
+        return 0;
+    }
+    std::cout << name << ": " << FailureCount() << " check(s) failed" << std::endl;
+    return 1;
+}
+
+} // namespace test
+} // namespace navigrab
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) ::navigrab::test::ReportFailure(__FILE__, __LINE__, #condition); \
+    } while (0)
+
+#define CHECK_EQ(actual, expected) \
+    ::navigrab::test::CheckEqual((actual), (expected), #actual " == " #expected, __FILE__, __LINE__)